@@ -1,6 +1,6 @@
 #include <Editor/AnalyzeKey.h>
+#include <Editor/AudioAnalysis.h>
 
-#include <Gist.h>
 #include <Core/Utils.h>
 #include <vector>
 #include <math.h>
@@ -24,50 +24,16 @@ static const char* kKeyNames[24] = {
 	"F# Minor", "G Minor", "G# Minor", "A Minor", "A# Minor", "B Minor"
 };
 
-String DetectKey(const float* samples, int numSamples, int sampleRate)
+String DetectKey(const AnalysisFrames& frames)
 {
-	if (!samples || numSamples <= 0 || sampleRate <= 0) return "Unknown";
-
-	// Use parameters consistent with Waveform.cpp
-	const int frameSize = 4096;
-	const int hopSize = 2048; // Overlap for better resolution
-
-	if (numSamples < frameSize) return "Too Short";
-
-	Gist<float> gist(frameSize, sampleRate);
-	std::vector<float> audioFrame(frameSize);
-
-	int numBlocks = (numSamples - frameSize) / hopSize;
-	if (numBlocks < 1) numBlocks = 1;
+	if (frames.numFrames <= 0) return "Too Short";
 
+	// Sum the chroma of all frames.
 	std::vector<float> totalChroma(12, 0.0f);
-
-	for (int i = 0; i < numBlocks; ++i) {
-		int start = i * hopSize;
-		// Safely copy samples
-		for (int k = 0; k < frameSize; ++k) {
-			if (start + k < numSamples)
-				audioFrame[k] = samples[start + k];
-			else
-				audioFrame[k] = 0.0f;
-		}
-
-		gist.processAudioFrame(audioFrame);
-		const auto& spectrum = gist.getMagnitudeSpectrum();
-		int numBins = spectrum.size();
-
-		// Calculate Chromagram for this frame
-		for (int b = 0; b < numBins; ++b) {
-			float freq = b * sampleRate / (float)frameSize;
-			if (freq < 27.5f) continue; // Ignore below A0
-
-			float midiNote = 69.0f + 12.0f * log2(freq / 440.0f);
-			int noteIndex = (int)round(midiNote);
-			int chromaIdx = noteIndex % 12;
-			if (chromaIdx < 0) chromaIdx += 12;
-
-			// Add energy to the chroma bin
-			totalChroma[chromaIdx] += spectrum[b];
+	for (int i = 0; i < frames.numFrames; ++i) {
+		const float* chroma = frames.chromaAt(i);
+		for (int c = 0; c < 12; ++c) {
+			totalChroma[c] += chroma[c];
 		}
 	}
 
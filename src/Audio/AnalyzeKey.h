@@ -4,8 +4,14 @@
 
 namespace Vortex {
 
-	/// Detects the musical key of the provided audio samples.
+	struct AnalysisFrames;
+
+	/// Analysis resolution used for key detection, which is shared with the section detection.
+	static const int KEY_FRAME_SIZE = 4096;
+	static const int KEY_HOP_SIZE = 2048;
+
+	/// Detects the musical key from the chroma of the analyzed audio.
 	/// Returns a string describing the key (e.g. "C Major", "A Minor").
-	String DetectKey(const float* samples, int numSamples, int sampleRate);
+	String DetectKey(const AnalysisFrames& frames);
 
 }
@@ -1,971 +1,665 @@
-// Based on the general purpose FFT routines from Ooura's Mathematical Software Packages
-// (copyright Takuya OOURA, 1996-2001).
-
-#include <Precomp.h>
-
-// double to float conversion.
-#pragma warning(disable: 4244)
-
-namespace AV {
-namespace FFT {
-
-typedef float real;
-
-/* Fast Fourier/Cosine/Sine Transform
-
-	dimension   :one
-	data length :power of 2
-	decimation  :frequency
-	radix	   :8, 4, 2
-	data		:inplace
-	table	   :use
-
--------- Real DFT / Inverse of Real DFT --------
-
-	[definition]
-		<case1> RDFT
-			R[k] = sum_j=0^n-1 a[j]*cos(2*pi*j*k/n), 0<=k<=n/2
-			I[k] = sum_j=0^n-1 a[j]*sin(2*pi*j*k/n), 0<k<n/2
-		<case2> IRDFT (excluding scale)
-			a[k] = (R[0] + R[n/2]*cos(pi*k))/2 +
-			   sum_j=1^n/2-1 R[j]*cos(2*pi*j*k/n) +
-			   sum_j=1^n/2-1 I[j]*sin(2*pi*j*k/n), 0<=k<n
-	[usage]
-		<case1>
-			ip[0] = 0; // first startTime only
-			rdft(n, 1, a, ip, w);
-		<case2>
-			ip[0] = 0; // first startTime only
-			rdft(n, -1, a, ip, w);
-	[parameters]
-		n			  :data length (int)
-					n >= 2, n = power of 2
-		a[0...n-1]	 :input/output data (real *)
-					<case1>
-						output data
-						a[2*k] = R[k], 0<=k<n/2
-						a[2*k+1] = I[k], 0<k<n/2
-						a[1] = R[n/2]
-					<case2>
-						input data
-						a[2*j] = R[j], 0<=j<n/2
-						a[2*j+1] = I[j], 0<j<n/2
-						a[1] = R[n/2]
-		ip[0...*]	  :work area for bit reversal (int *)
-					length of ip >= 2+sqrt(n/2)
-					strictly,
-					length of ip >=
-						2+(1<<int(log(n/2+0.5)/log(2))/2).
-					ip[0],ip[1] are pointers of the cos/sin table.
-		w[0...n/2-1]   :cos/sin table (real *)
-					w[],ip[] are initialized if ip[0] == 0.
-*/
-
-static void bitrv2(int n, int* ip, real* a)
-{
-	int j, j1, k, k1, l, m, m2;
-	real xr, xi, yr, yi;
-
-	ip[0] = 0;
-	l = n;
-	m = 1;
-	while ((m << 3) < l) {
-		l >>= 1;
-		for (j = 0; j < m; j++) {
-			ip[m + j] = ip[j] + l;
-		}
-		m <<= 1;
-	}
-	m2 = 2 * m;
-	if ((m << 3) == l) {
-		for (k = 0; k < m; k++) {
-			for (j = 0; j < k; j++) {
-				j1 = 2 * j + ip[k];
-				k1 = 2 * k + ip[j];
-				xr = a[j1];
-				xi = a[j1 + 1];
-				yr = a[k1];
-				yi = a[k1 + 1];
-				a[j1] = yr;
-				a[j1 + 1] = yi;
-				a[k1] = xr;
-				a[k1 + 1] = xi;
-				j1 += m2;
-				k1 += 2 * m2;
-				xr = a[j1];
-				xi = a[j1 + 1];
-				yr = a[k1];
-				yi = a[k1 + 1];
-				a[j1] = yr;
-				a[j1 + 1] = yi;
-				a[k1] = xr;
-				a[k1 + 1] = xi;
-				j1 += m2;
-				k1 -= m2;
-				xr = a[j1];
-				xi = a[j1 + 1];
-				yr = a[k1];
-				yi = a[k1 + 1];
-				a[j1] = yr;
-				a[j1 + 1] = yi;
-				a[k1] = xr;
-				a[k1 + 1] = xi;
-				j1 += m2;
-				k1 += 2 * m2;
-				xr = a[j1];
-				xi = a[j1 + 1];
-				yr = a[k1];
-				yi = a[k1 + 1];
-				a[j1] = yr;
-				a[j1 + 1] = yi;
-				a[k1] = xr;
-				a[k1 + 1] = xi;
-			}
-			j1 = 2 * k + m2 + ip[k];
-			k1 = j1 + m2;
-			xr = a[j1];
-			xi = a[j1 + 1];
-			yr = a[k1];
-			yi = a[k1 + 1];
-			a[j1] = yr;
-			a[j1 + 1] = yi;
-			a[k1] = xr;
-			a[k1 + 1] = xi;
-		}
-	}
-	else {
-		for (k = 1; k < m; k++) {
-			for (j = 0; j < k; j++) {
-				j1 = 2 * j + ip[k];
-				k1 = 2 * k + ip[j];
-				xr = a[j1];
-				xi = a[j1 + 1];
-				yr = a[k1];
-				yi = a[k1 + 1];
-				a[j1] = yr;
-				a[j1 + 1] = yi;
-				a[k1] = xr;
-				a[k1 + 1] = xi;
-				j1 += m2;
-				k1 += m2;
-				xr = a[j1];
-				xi = a[j1 + 1];
-				yr = a[k1];
-				yi = a[k1 + 1];
-				a[j1] = yr;
-				a[j1 + 1] = yi;
-				a[k1] = xr;
-				a[k1 + 1] = xi;
-			}
-		}
-	}
+#include <Editor/FFT.h>
+
+#include <System/CpuFeatures.h>
+
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#ifdef CPU_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef CPU_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+// The generic kernels are forced inline into the entry point of every level,
+// where they are compiled for the instruction set of that level.
+#if defined(_MSC_VER)
+#define FFT_INLINE __forceinline
+#else
+#define FFT_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace Vortex {
+
+static const double PI = 3.14159265358979323846;
+
+// Everything the kernels need from a plan.
+struct PlanData {
+    int half;
+    const float* twiddles;
+    const float* firstTwiddles;
+    const float* splitCos;
+    const float* splitSin;
+};
+
+// ================================================================================================
+// Vector operations.
+
+// Operations that produce vectors write them to a reference, and vectors are
+// passed by reference, so no vector is passed by value to or returned from a
+// function. The generic kernels are not compiled for the instruction set of
+// every level, and would otherwise change the calling convention of the AVX2
+// operations that they call.
+
+struct ScalarOps {
+    typedef float V;
+    static const int WIDTH = 1;
+    static FFT_INLINE void load(V& r, const float* p) { r = *p; }
+    static FFT_INLINE void store(float* p, const V& v) { *p = v; }
+    static FFT_INLINE void set1(V& r, float v) { r = v; }
+    static FFT_INLINE void mul(V& r, const V& a, const V& b) { r = a * b; }
+    static FFT_INLINE void addSub(V& sum, V& diff, const V& a, const V& b) {
+        sum = a + b, diff = a - b;
+    }
+    // (rr, ri) = (tr + i * ti) * (wr + i * wi).
+    static FFT_INLINE void rotate(V& rr, V& ri, const V& tr, const V& ti,
+                                  const V& wr, const V& wi) {
+        rr = tr * wr - ti * wi, ri = tr * wi + ti * wr;
+    }
+    static FFT_INLINE void spread(V& r, const float* src, int, int) {
+        r = *src;
+    }
+    static FFT_INLINE void storeGroups(float* y, int stride, const V& t0,
+                                       const V& t1, const V& t2, const V& t3) {
+        y[0] = t0, y[stride] = t1, y[stride * 2] = t2, y[stride * 3] = t3;
+    }
+};
+
+#ifdef CPU_HAS_SSE2
+
+struct Sse2Ops {
+    typedef __m128 V;
+    static const int WIDTH = 4;
+    static FFT_INLINE void load(V& r, const float* p) { r = _mm_loadu_ps(p); }
+    static FFT_INLINE void store(float* p, const V& v) { _mm_storeu_ps(p, v); }
+    static FFT_INLINE void set1(V& r, float v) { r = _mm_set1_ps(v); }
+    static FFT_INLINE void mul(V& r, const V& a, const V& b) {
+        r = _mm_mul_ps(a, b);
+    }
+    static FFT_INLINE void addSub(V& sum, V& diff, const V& a, const V& b) {
+        sum = _mm_add_ps(a, b), diff = _mm_sub_ps(a, b);
+    }
+    static FFT_INLINE void rotate(V& rr, V& ri, const V& tr, const V& ti,
+                                  const V& wr, const V& wi) {
+        rr = _mm_sub_ps(_mm_mul_ps(tr, wr), _mm_mul_ps(ti, wi));
+        ri = _mm_add_ps(_mm_mul_ps(tr, wi), _mm_mul_ps(ti, wr));
+    }
+
+    // Only groups of stride 1 fit in a vector.
+    static FFT_INLINE void spread(V& r, const float* src, int, int step) {
+        if (step == 1) {
+            r = _mm_loadu_ps(src);
+        } else {
+            r = _mm_setr_ps(src[0], src[step], src[step * 2], src[step * 3]);
+        }
+    }
+    static FFT_INLINE void storeGroups(float* y, int, const V& t0, const V& t1,
+                                       const V& t2, const V& t3) {
+        V a = t0, b = t1, c = t2, d = t3;
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(y + 0, a);
+        _mm_storeu_ps(y + 4, b);
+        _mm_storeu_ps(y + 8, c);
+        _mm_storeu_ps(y + 12, d);
+    }
+};
+
+#endif
+
+#ifdef CPU_HAS_AVX2
+
+// These are not forced inline, since GCC only inlines them once the generic
+// kernel is part of a function that targets AVX2.
+struct Avx2Ops {
+    typedef __m256 V;
+    static const int WIDTH = 8;
+    CPU_TARGET_AVX2 static inline void load(V& r, const float* p) {
+        r = _mm256_loadu_ps(p);
+    }
+    CPU_TARGET_AVX2 static inline void store(float* p, const V& v) {
+        _mm256_storeu_ps(p, v);
+    }
+    CPU_TARGET_AVX2 static inline void set1(V& r, float v) {
+        r = _mm256_set1_ps(v);
+    }
+    CPU_TARGET_AVX2 static inline void mul(V& r, const V& a, const V& b) {
+        r = _mm256_mul_ps(a, b);
+    }
+    CPU_TARGET_AVX2 static inline void addSub(V& sum, V& diff, const V& a,
+                                              const V& b) {
+        sum = _mm256_add_ps(a, b), diff = _mm256_sub_ps(a, b);
+    }
+    CPU_TARGET_AVX2 static inline void rotate(V& rr, V& ri, const V& tr,
+                                              const V& ti, const V& wr,
+                                              const V& wi) {
+        rr = _mm256_fmsub_ps(tr, wr, _mm256_mul_ps(ti, wi));
+        ri = _mm256_fmadd_ps(tr, wi, _mm256_mul_ps(ti, wr));
+    }
+
+    // Groups of stride 1 or 4 fit in a vector.
+    CPU_TARGET_AVX2 static inline void spread(V& r, const float* src,
+                                              int stride, int step) {
+        if (stride == 4) {
+            __m256 lo = _mm256_castps128_ps256(_mm_set1_ps(src[0]));
+            r = _mm256_insertf128_ps(lo, _mm_set1_ps(src[step]), 1);
+        } else if (step == 1) {
+            r = _mm256_loadu_ps(src);
+        } else {
+            r = _mm256_setr_ps(src[0], src[step], src[step * 2], src[step * 3],
+                               src[step * 4], src[step * 5], src[step * 6],
+                               src[step * 7]);
+        }
+    }
+    CPU_TARGET_AVX2 static inline void storeGroups(float* y, int stride,
+                                                   const V& v0, const V& v1,
+                                                   const V& v2, const V& v3) {
+        V t0 = v0, t1 = v1, t2 = v2, t3 = v3;
+        if (stride == 1) {
+            // Transpose within the 128-bit halves, which hold p to p + 3 and
+            // p + 4 to p + 7.
+            V a = _mm256_unpacklo_ps(t0, t1), b = _mm256_unpackhi_ps(t0, t1);
+            V c = _mm256_unpacklo_ps(t2, t3), d = _mm256_unpackhi_ps(t2, t3);
+            t0 = _mm256_shuffle_ps(a, c, 0x44);
+            t1 = _mm256_shuffle_ps(a, c, 0xEE);
+            t2 = _mm256_shuffle_ps(b, d, 0x44);
+            t3 = _mm256_shuffle_ps(b, d, 0xEE);
+        }
+        _mm256_storeu_ps(y + 0, _mm256_permute2f128_ps(t0, t1, 0x20));
+        _mm256_storeu_ps(y + 8, _mm256_permute2f128_ps(t2, t3, 0x20));
+        _mm256_storeu_ps(y + 16, _mm256_permute2f128_ps(t0, t1, 0x31));
+        _mm256_storeu_ps(y + 24, _mm256_permute2f128_ps(t2, t3, 0x31));
+    }
+};
+
+#endif
+
+// ================================================================================================
+// Generic kernels.
+//
+// The complex transform is a Stockham autosort FFT, which needs no bit
+// reversal. Element p of a pass starts at float "stride * p", and is made of
+// "stride" consecutive floats that are transformed independently. These are
+// the lanes of a batch, and after the first passes also the interleaved
+// sub-transforms of a single frame. Real and imaginary parts are kept in
+// separate arrays, so every operation works on full vectors.
+
+template <class Ops>
+FFT_INLINE void Radix4(int n, int stride, const float* tw, const float* xr,
+                       const float* xi, float* yr, float* yi) {
+    typedef typename Ops::V V;
+    const int m = n / 4;
+    const size_t quarter = (size_t)stride * m;
+    for (int p = 0; p < m; ++p, tw += 6) {
+        V w1r, w1i, w2r, w2i, w3r, w3i;
+        Ops::set1(w1r, tw[0]), Ops::set1(w1i, tw[1]);
+        Ops::set1(w2r, tw[2]), Ops::set1(w2i, tw[3]);
+        Ops::set1(w3r, tw[4]), Ops::set1(w3i, tw[5]);
+        const size_t src = (size_t)stride * p;
+        const size_t dst = (size_t)stride * p * 4;
+        for (int q = 0; q < stride; q += Ops::WIDTH) {
+            const size_t a = src + q, b = a + quarter, c = b + quarter,
+                         d = c + quarter;
+            V ar, ai, br, bi, cr, ci, dr, di;
+            Ops::load(ar, xr + a), Ops::load(ai, xi + a);
+            Ops::load(br, xr + b), Ops::load(bi, xi + b);
+            Ops::load(cr, xr + c), Ops::load(ci, xi + c);
+            Ops::load(dr, xr + d), Ops::load(di, xi + d);
+
+            V apcR, amcR, apcI, amcI, bpdR, bmdR, bpdI, bmdI;
+            Ops::addSub(apcR, amcR, ar, cr), Ops::addSub(apcI, amcI, ai, ci);
+            Ops::addSub(bpdR, bmdR, br, dr), Ops::addSub(bpdI, bmdI, bi, di);
+
+            // t1 = (a - c) - i(b - d), t2 = (a + c) - (b + d),
+            // t3 = (a - c) + i(b - d).
+            V y0r, y0i, t1r, t1i, t2r, t2i, t3r, t3i;
+            Ops::addSub(t1r, t3r, amcR, bmdI), Ops::addSub(t3i, t1i, amcI, bmdR);
+            Ops::addSub(y0r, t2r, apcR, bpdR), Ops::addSub(y0i, t2i, apcI, bpdI);
+
+            V y1r, y1i, y2r, y2i, y3r, y3i;
+            Ops::rotate(y1r, y1i, t1r, t1i, w1r, w1i);
+            Ops::rotate(y2r, y2i, t2r, t2i, w2r, w2i);
+            Ops::rotate(y3r, y3i, t3r, t3i, w3r, w3i);
+
+            const size_t y0 = dst + q, y1 = y0 + stride, y2 = y1 + stride,
+                         y3 = y2 + stride;
+            Ops::store(yr + y0, y0r), Ops::store(yi + y0, y0i);
+            Ops::store(yr + y1, y1r), Ops::store(yi + y1, y1i);
+            Ops::store(yr + y2, y2r), Ops::store(yi + y2, y2i);
+            Ops::store(yr + y3, y3r), Ops::store(yi + y3, y3i);
+        }
+    }
 }
 
-static void cft1st(int n, real* a, real* w)
-{
-	int j, k1;
-	real wn4r, wtmp, wk1r, wk1i, wk2r, wk2i, wk3r, wk3i,
-		wk4r, wk4i, wk5r, wk5i, wk6r, wk6i, wk7r, wk7i;
-	real x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i,
-		y0r, y0i, y1r, y1i, y2r, y2i, y3r, y3i,
-		y4r, y4i, y5r, y5i, y6r, y6i, y7r, y7i;
-
-	wn4r = w[2];
-	x0r = a[0] + a[2];
-	x0i = a[1] + a[3];
-	x1r = a[0] - a[2];
-	x1i = a[1] - a[3];
-	x2r = a[4] + a[6];
-	x2i = a[5] + a[7];
-	x3r = a[4] - a[6];
-	x3i = a[5] - a[7];
-	y0r = x0r + x2r;
-	y0i = x0i + x2i;
-	y2r = x0r - x2r;
-	y2i = x0i - x2i;
-	y1r = x1r - x3i;
-	y1i = x1i + x3r;
-	y3r = x1r + x3i;
-	y3i = x1i - x3r;
-	x0r = a[8] + a[10];
-	x0i = a[9] + a[11];
-	x1r = a[8] - a[10];
-	x1i = a[9] - a[11];
-	x2r = a[12] + a[14];
-	x2i = a[13] + a[15];
-	x3r = a[12] - a[14];
-	x3i = a[13] - a[15];
-	y4r = x0r + x2r;
-	y4i = x0i + x2i;
-	y6r = x0r - x2r;
-	y6i = x0i - x2i;
-	x0r = x1r - x3i;
-	x0i = x1i + x3r;
-	x2r = x1r + x3i;
-	x2i = x1i - x3r;
-	y5r = wn4r * (x0r - x0i);
-	y5i = wn4r * (x0r + x0i);
-	y7r = wn4r * (x2r - x2i);
-	y7i = wn4r * (x2r + x2i);
-	a[2] = y1r + y5r;
-	a[3] = y1i + y5i;
-	a[10] = y1r - y5r;
-	a[11] = y1i - y5i;
-	a[6] = y3r - y7i;
-	a[7] = y3i + y7r;
-	a[14] = y3r + y7i;
-	a[15] = y3i - y7r;
-	a[0] = y0r + y4r;
-	a[1] = y0i + y4i;
-	a[8] = y0r - y4r;
-	a[9] = y0i - y4i;
-	a[4] = y2r - y6i;
-	a[5] = y2i + y6r;
-	a[12] = y2r + y6i;
-	a[13] = y2i - y6r;
-	if (n > 16) {
-		wk1r = w[4];
-		wk1i = w[5];
-		x0r = a[16] + a[18];
-		x0i = a[17] + a[19];
-		x1r = a[16] - a[18];
-		x1i = a[17] - a[19];
-		x2r = a[20] + a[22];
-		x2i = a[21] + a[23];
-		x3r = a[20] - a[22];
-		x3i = a[21] - a[23];
-		y0r = x0r + x2r;
-		y0i = x0i + x2i;
-		y2r = x0r - x2r;
-		y2i = x0i - x2i;
-		y1r = x1r - x3i;
-		y1i = x1i + x3r;
-		y3r = x1r + x3i;
-		y3i = x1i - x3r;
-		x0r = a[24] + a[26];
-		x0i = a[25] + a[27];
-		x1r = a[24] - a[26];
-		x1i = a[25] - a[27];
-		x2r = a[28] + a[30];
-		x2i = a[29] + a[31];
-		x3r = a[28] - a[30];
-		x3i = a[29] - a[31];
-		y4r = x0r + x2r;
-		y4i = x0i + x2i;
-		y6r = x0r - x2r;
-		y6i = x0i - x2i;
-		x0r = x1r - x3i;
-		x0i = x1i + x3r;
-		x2r = x1r + x3i;
-		x2i = x3r - x1i;
-		y5r = wk1i * x0r - wk1r * x0i;
-		y5i = wk1i * x0i + wk1r * x0r;
-		y7r = wk1r * x2r + wk1i * x2i;
-		y7i = wk1r * x2i - wk1i * x2r;
-		x0r = wk1r * y1r - wk1i * y1i;
-		x0i = wk1r * y1i + wk1i * y1r;
-		a[18] = x0r + y5r;
-		a[19] = x0i + y5i;
-		a[26] = y5i - x0i;
-		a[27] = x0r - y5r;
-		x0r = wk1i * y3r - wk1r * y3i;
-		x0i = wk1i * y3i + wk1r * y3r;
-		a[22] = x0r - y7r;
-		a[23] = x0i + y7i;
-		a[30] = y7i - x0i;
-		a[31] = x0r + y7r;
-		a[16] = y0r + y4r;
-		a[17] = y0i + y4i;
-		a[24] = y4i - y0i;
-		a[25] = y0r - y4r;
-		x0r = y2r - y6i;
-		x0i = y2i + y6r;
-		a[20] = wn4r * (x0r - x0i);
-		a[21] = wn4r * (x0i + x0r);
-		x0r = y6r - y2i;
-		x0i = y2r + y6i;
-		a[28] = wn4r * (x0r - x0i);
-		a[29] = wn4r * (x0i + x0r);
-		k1 = 4;
-		for (j = 32; j < n; j += 16) {
-			k1 += 4;
-			wk1r = w[k1];
-			wk1i = w[k1 + 1];
-			wk2r = w[k1 + 2];
-			wk2i = w[k1 + 3];
-			wtmp = 2 * wk2i;
-			wk3r = wk1r - wtmp * wk1i;
-			wk3i = wtmp * wk1r - wk1i;
-			wk4r = 1 - wtmp * wk2i;
-			wk4i = wtmp * wk2r;
-			wtmp = 2 * wk4i;
-			wk5r = wk3r - wtmp * wk1i;
-			wk5i = wtmp * wk1r - wk3i;
-			wk6r = wk2r - wtmp * wk2i;
-			wk6i = wtmp * wk2r - wk2i;
-			wk7r = wk1r - wtmp * wk3i;
-			wk7i = wtmp * wk3r - wk1i;
-			x0r = a[j] + a[j + 2];
-			x0i = a[j + 1] + a[j + 3];
-			x1r = a[j] - a[j + 2];
-			x1i = a[j + 1] - a[j + 3];
-			x2r = a[j + 4] + a[j + 6];
-			x2i = a[j + 5] + a[j + 7];
-			x3r = a[j + 4] - a[j + 6];
-			x3i = a[j + 5] - a[j + 7];
-			y0r = x0r + x2r;
-			y0i = x0i + x2i;
-			y2r = x0r - x2r;
-			y2i = x0i - x2i;
-			y1r = x1r - x3i;
-			y1i = x1i + x3r;
-			y3r = x1r + x3i;
-			y3i = x1i - x3r;
-			x0r = a[j + 8] + a[j + 10];
-			x0i = a[j + 9] + a[j + 11];
-			x1r = a[j + 8] - a[j + 10];
-			x1i = a[j + 9] - a[j + 11];
-			x2r = a[j + 12] + a[j + 14];
-			x2i = a[j + 13] + a[j + 15];
-			x3r = a[j + 12] - a[j + 14];
-			x3i = a[j + 13] - a[j + 15];
-			y4r = x0r + x2r;
-			y4i = x0i + x2i;
-			y6r = x0r - x2r;
-			y6i = x0i - x2i;
-			x0r = x1r - x3i;
-			x0i = x1i + x3r;
-			x2r = x1r + x3i;
-			x2i = x1i - x3r;
-			y5r = wn4r * (x0r - x0i);
-			y5i = wn4r * (x0r + x0i);
-			y7r = wn4r * (x2r - x2i);
-			y7i = wn4r * (x2r + x2i);
-			x0r = y1r + y5r;
-			x0i = y1i + y5i;
-			a[j + 2] = wk1r * x0r - wk1i * x0i;
-			a[j + 3] = wk1r * x0i + wk1i * x0r;
-			x0r = y1r - y5r;
-			x0i = y1i - y5i;
-			a[j + 10] = wk5r * x0r - wk5i * x0i;
-			a[j + 11] = wk5r * x0i + wk5i * x0r;
-			x0r = y3r - y7i;
-			x0i = y3i + y7r;
-			a[j + 6] = wk3r * x0r - wk3i * x0i;
-			a[j + 7] = wk3r * x0i + wk3i * x0r;
-			x0r = y3r + y7i;
-			x0i = y3i - y7r;
-			a[j + 14] = wk7r * x0r - wk7i * x0i;
-			a[j + 15] = wk7r * x0i + wk7i * x0r;
-			a[j] = y0r + y4r;
-			a[j + 1] = y0i + y4i;
-			x0r = y0r - y4r;
-			x0i = y0i - y4i;
-			a[j + 8] = wk4r * x0r - wk4i * x0i;
-			a[j + 9] = wk4r * x0i + wk4i * x0r;
-			x0r = y2r - y6i;
-			x0i = y2i + y6r;
-			a[j + 4] = wk2r * x0r - wk2i * x0i;
-			a[j + 5] = wk2r * x0i + wk2i * x0r;
-			x0r = y2r + y6i;
-			x0i = y2i - y6r;
-			a[j + 12] = wk6r * x0r - wk6i * x0i;
-			a[j + 13] = wk6r * x0i + wk6i * x0r;
-		}
-	}
+// Same as Radix4, for passes whose elements are narrower than a vector, which
+// happens in the first passes of a single frame. Every vector then holds the
+// elements of several consecutive values of p, and the results are stored as
+// groups of four elements per p. The twiddles of p are at tw + p * step.
+template <class Ops>
+FFT_INLINE void Radix4Narrow(int n, int stride, const float* tw, int step,
+                             int component, const float* xr, const float* xi,
+                             float* yr, float* yi) {
+    typedef typename Ops::V V;
+    const int m = n / 4, group = Ops::WIDTH / stride;
+    const size_t quarter = (size_t)stride * m;
+    for (int p = 0; p < m; p += group) {
+        const float* w = tw + (size_t)p * step;
+        V w1r, w1i, w2r, w2i, w3r, w3i;
+        Ops::spread(w1r, w + component * 0, stride, step);
+        Ops::spread(w1i, w + component * 1, stride, step);
+        Ops::spread(w2r, w + component * 2, stride, step);
+        Ops::spread(w2i, w + component * 3, stride, step);
+        Ops::spread(w3r, w + component * 4, stride, step);
+        Ops::spread(w3i, w + component * 5, stride, step);
+
+        const size_t a = (size_t)stride * p, b = a + quarter, c = b + quarter,
+                     d = c + quarter;
+        V ar, ai, br, bi, cr, ci, dr, di;
+        Ops::load(ar, xr + a), Ops::load(ai, xi + a);
+        Ops::load(br, xr + b), Ops::load(bi, xi + b);
+        Ops::load(cr, xr + c), Ops::load(ci, xi + c);
+        Ops::load(dr, xr + d), Ops::load(di, xi + d);
+
+        V apcR, amcR, apcI, amcI, bpdR, bmdR, bpdI, bmdI;
+        Ops::addSub(apcR, amcR, ar, cr), Ops::addSub(apcI, amcI, ai, ci);
+        Ops::addSub(bpdR, bmdR, br, dr), Ops::addSub(bpdI, bmdI, bi, di);
+
+        V y0r, y0i, t1r, t1i, t2r, t2i, t3r, t3i;
+        Ops::addSub(t1r, t3r, amcR, bmdI), Ops::addSub(t3i, t1i, amcI, bmdR);
+        Ops::addSub(y0r, t2r, apcR, bpdR), Ops::addSub(y0i, t2i, apcI, bpdI);
+
+        V y1r, y1i, y2r, y2i, y3r, y3i;
+        Ops::rotate(y1r, y1i, t1r, t1i, w1r, w1i);
+        Ops::rotate(y2r, y2i, t2r, t2i, w2r, w2i);
+        Ops::rotate(y3r, y3i, t3r, t3i, w3r, w3i);
+
+        const size_t dst = (size_t)stride * p * 4;
+        Ops::storeGroups(yr + dst, stride, y0r, y1r, y2r, y3r);
+        Ops::storeGroups(yi + dst, stride, y0i, y1i, y2i, y3i);
+    }
 }
 
-static void cftmdl(int n, int l, real* a, real* w)
-{
-	int j, j1, j2, j3, j4, j5, j6, j7, k, k1, m;
-	real wn4r, wtmp, wk1r, wk1i, wk2r, wk2i, wk3r, wk3i,
-		wk4r, wk4i, wk5r, wk5i, wk6r, wk6i, wk7r, wk7i;
-	real x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i,
-		y0r, y0i, y1r, y1i, y2r, y2i, y3r, y3i,
-		y4r, y4i, y5r, y5i, y6r, y6i, y7r, y7i;
-
-	m = l << 3;
-	wn4r = w[2];
-	for (j = 0; j < l; j += 2) {
-		j1 = j + l;
-		j2 = j1 + l;
-		j3 = j2 + l;
-		j4 = j3 + l;
-		j5 = j4 + l;
-		j6 = j5 + l;
-		j7 = j6 + l;
-		x0r = a[j] + a[j1];
-		x0i = a[j + 1] + a[j1 + 1];
-		x1r = a[j] - a[j1];
-		x1i = a[j + 1] - a[j1 + 1];
-		x2r = a[j2] + a[j3];
-		x2i = a[j2 + 1] + a[j3 + 1];
-		x3r = a[j2] - a[j3];
-		x3i = a[j2 + 1] - a[j3 + 1];
-		y0r = x0r + x2r;
-		y0i = x0i + x2i;
-		y2r = x0r - x2r;
-		y2i = x0i - x2i;
-		y1r = x1r - x3i;
-		y1i = x1i + x3r;
-		y3r = x1r + x3i;
-		y3i = x1i - x3r;
-		x0r = a[j4] + a[j5];
-		x0i = a[j4 + 1] + a[j5 + 1];
-		x1r = a[j4] - a[j5];
-		x1i = a[j4 + 1] - a[j5 + 1];
-		x2r = a[j6] + a[j7];
-		x2i = a[j6 + 1] + a[j7 + 1];
-		x3r = a[j6] - a[j7];
-		x3i = a[j6 + 1] - a[j7 + 1];
-		y4r = x0r + x2r;
-		y4i = x0i + x2i;
-		y6r = x0r - x2r;
-		y6i = x0i - x2i;
-		x0r = x1r - x3i;
-		x0i = x1i + x3r;
-		x2r = x1r + x3i;
-		x2i = x1i - x3r;
-		y5r = wn4r * (x0r - x0i);
-		y5i = wn4r * (x0r + x0i);
-		y7r = wn4r * (x2r - x2i);
-		y7i = wn4r * (x2r + x2i);
-		a[j1] = y1r + y5r;
-		a[j1 + 1] = y1i + y5i;
-		a[j5] = y1r - y5r;
-		a[j5 + 1] = y1i - y5i;
-		a[j3] = y3r - y7i;
-		a[j3 + 1] = y3i + y7r;
-		a[j7] = y3r + y7i;
-		a[j7 + 1] = y3i - y7r;
-		a[j] = y0r + y4r;
-		a[j + 1] = y0i + y4i;
-		a[j4] = y0r - y4r;
-		a[j4 + 1] = y0i - y4i;
-		a[j2] = y2r - y6i;
-		a[j2 + 1] = y2i + y6r;
-		a[j6] = y2r + y6i;
-		a[j6 + 1] = y2i - y6r;
-	}
-	if (m < n) {
-		wk1r = w[4];
-		wk1i = w[5];
-		for (j = m; j < l + m; j += 2) {
-			j1 = j + l;
-			j2 = j1 + l;
-			j3 = j2 + l;
-			j4 = j3 + l;
-			j5 = j4 + l;
-			j6 = j5 + l;
-			j7 = j6 + l;
-			x0r = a[j] + a[j1];
-			x0i = a[j + 1] + a[j1 + 1];
-			x1r = a[j] - a[j1];
-			x1i = a[j + 1] - a[j1 + 1];
-			x2r = a[j2] + a[j3];
-			x2i = a[j2 + 1] + a[j3 + 1];
-			x3r = a[j2] - a[j3];
-			x3i = a[j2 + 1] - a[j3 + 1];
-			y0r = x0r + x2r;
-			y0i = x0i + x2i;
-			y2r = x0r - x2r;
-			y2i = x0i - x2i;
-			y1r = x1r - x3i;
-			y1i = x1i + x3r;
-			y3r = x1r + x3i;
-			y3i = x1i - x3r;
-			x0r = a[j4] + a[j5];
-			x0i = a[j4 + 1] + a[j5 + 1];
-			x1r = a[j4] - a[j5];
-			x1i = a[j4 + 1] - a[j5 + 1];
-			x2r = a[j6] + a[j7];
-			x2i = a[j6 + 1] + a[j7 + 1];
-			x3r = a[j6] - a[j7];
-			x3i = a[j6 + 1] - a[j7 + 1];
-			y4r = x0r + x2r;
-			y4i = x0i + x2i;
-			y6r = x0r - x2r;
-			y6i = x0i - x2i;
-			x0r = x1r - x3i;
-			x0i = x1i + x3r;
-			x2r = x1r + x3i;
-			x2i = x3r - x1i;
-			y5r = wk1i * x0r - wk1r * x0i;
-			y5i = wk1i * x0i + wk1r * x0r;
-			y7r = wk1r * x2r + wk1i * x2i;
-			y7i = wk1r * x2i - wk1i * x2r;
-			x0r = wk1r * y1r - wk1i * y1i;
-			x0i = wk1r * y1i + wk1i * y1r;
-			a[j1] = x0r + y5r;
-			a[j1 + 1] = x0i + y5i;
-			a[j5] = y5i - x0i;
-			a[j5 + 1] = x0r - y5r;
-			x0r = wk1i * y3r - wk1r * y3i;
-			x0i = wk1i * y3i + wk1r * y3r;
-			a[j3] = x0r - y7r;
-			a[j3 + 1] = x0i + y7i;
-			a[j7] = y7i - x0i;
-			a[j7 + 1] = x0r + y7r;
-			a[j] = y0r + y4r;
-			a[j + 1] = y0i + y4i;
-			a[j4] = y4i - y0i;
-			a[j4 + 1] = y0r - y4r;
-			x0r = y2r - y6i;
-			x0i = y2i + y6r;
-			a[j2] = wn4r * (x0r - x0i);
-			a[j2 + 1] = wn4r * (x0i + x0r);
-			x0r = y6r - y2i;
-			x0i = y2r + y6i;
-			a[j6] = wn4r * (x0r - x0i);
-			a[j6 + 1] = wn4r * (x0i + x0r);
-		}
-		k1 = 4;
-		for (k = 2 * m; k < n; k += m) {
-			k1 += 4;
-			wk1r = w[k1];
-			wk1i = w[k1 + 1];
-			wk2r = w[k1 + 2];
-			wk2i = w[k1 + 3];
-			wtmp = 2 * wk2i;
-			wk3r = wk1r - wtmp * wk1i;
-			wk3i = wtmp * wk1r - wk1i;
-			wk4r = 1 - wtmp * wk2i;
-			wk4i = wtmp * wk2r;
-			wtmp = 2 * wk4i;
-			wk5r = wk3r - wtmp * wk1i;
-			wk5i = wtmp * wk1r - wk3i;
-			wk6r = wk2r - wtmp * wk2i;
-			wk6i = wtmp * wk2r - wk2i;
-			wk7r = wk1r - wtmp * wk3i;
-			wk7i = wtmp * wk3r - wk1i;
-			for (j = k; j < l + k; j += 2) {
-				j1 = j + l;
-				j2 = j1 + l;
-				j3 = j2 + l;
-				j4 = j3 + l;
-				j5 = j4 + l;
-				j6 = j5 + l;
-				j7 = j6 + l;
-				x0r = a[j] + a[j1];
-				x0i = a[j + 1] + a[j1 + 1];
-				x1r = a[j] - a[j1];
-				x1i = a[j + 1] - a[j1 + 1];
-				x2r = a[j2] + a[j3];
-				x2i = a[j2 + 1] + a[j3 + 1];
-				x3r = a[j2] - a[j3];
-				x3i = a[j2 + 1] - a[j3 + 1];
-				y0r = x0r + x2r;
-				y0i = x0i + x2i;
-				y2r = x0r - x2r;
-				y2i = x0i - x2i;
-				y1r = x1r - x3i;
-				y1i = x1i + x3r;
-				y3r = x1r + x3i;
-				y3i = x1i - x3r;
-				x0r = a[j4] + a[j5];
-				x0i = a[j4 + 1] + a[j5 + 1];
-				x1r = a[j4] - a[j5];
-				x1i = a[j4 + 1] - a[j5 + 1];
-				x2r = a[j6] + a[j7];
-				x2i = a[j6 + 1] + a[j7 + 1];
-				x3r = a[j6] - a[j7];
-				x3i = a[j6 + 1] - a[j7 + 1];
-				y4r = x0r + x2r;
-				y4i = x0i + x2i;
-				y6r = x0r - x2r;
-				y6i = x0i - x2i;
-				x0r = x1r - x3i;
-				x0i = x1i + x3r;
-				x2r = x1r + x3i;
-				x2i = x1i - x3r;
-				y5r = wn4r * (x0r - x0i);
-				y5i = wn4r * (x0r + x0i);
-				y7r = wn4r * (x2r - x2i);
-				y7i = wn4r * (x2r + x2i);
-				x0r = y1r + y5r;
-				x0i = y1i + y5i;
-				a[j1] = wk1r * x0r - wk1i * x0i;
-				a[j1 + 1] = wk1r * x0i + wk1i * x0r;
-				x0r = y1r - y5r;
-				x0i = y1i - y5i;
-				a[j5] = wk5r * x0r - wk5i * x0i;
-				a[j5 + 1] = wk5r * x0i + wk5i * x0r;
-				x0r = y3r - y7i;
-				x0i = y3i + y7r;
-				a[j3] = wk3r * x0r - wk3i * x0i;
-				a[j3 + 1] = wk3r * x0i + wk3i * x0r;
-				x0r = y3r + y7i;
-				x0i = y3i - y7r;
-				a[j7] = wk7r * x0r - wk7i * x0i;
-				a[j7 + 1] = wk7r * x0i + wk7i * x0r;
-				a[j] = y0r + y4r;
-				a[j + 1] = y0i + y4i;
-				x0r = y0r - y4r;
-				x0i = y0i - y4i;
-				a[j4] = wk4r * x0r - wk4i * x0i;
-				a[j4 + 1] = wk4r * x0i + wk4i * x0r;
-				x0r = y2r - y6i;
-				x0i = y2i + y6r;
-				a[j2] = wk2r * x0r - wk2i * x0i;
-				a[j2 + 1] = wk2r * x0i + wk2i * x0r;
-				x0r = y2r + y6i;
-				x0i = y2i - y6r;
-				a[j6] = wk6r * x0r - wk6i * x0i;
-				a[j6 + 1] = wk6r * x0i + wk6i * x0r;
-			}
-		}
-	}
+template <class Ops>
+FFT_INLINE void Radix2(int stride, const float* xr, const float* xi, float* yr,
+                       float* yi) {
+    typedef typename Ops::V V;
+    for (int q = 0; q < stride; q += Ops::WIDTH) {
+        V ar, ai, br, bi, sr, si, dr, di;
+        Ops::load(ar, xr + q), Ops::load(ai, xi + q);
+        Ops::load(br, xr + q + stride), Ops::load(bi, xi + q + stride);
+        Ops::addSub(sr, dr, ar, br), Ops::addSub(si, di, ai, bi);
+        Ops::store(yr + q, sr), Ops::store(yi + q, si);
+        Ops::store(yr + q + stride, dr), Ops::store(yi + q + stride, di);
+    }
 }
 
-static void cftfsub(int n, real* a, real* w)
-{
-	int j, j1, j2, j3, l;
-	real x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i;
-
-	l = 2;
-	if (n >= 16) {
-		cft1st(n, a, w);
-		l = 16;
-		while ((l << 3) <= n) {
-			cftmdl(n, l, a, w);
-			l <<= 3;
-		}
-	}
-	if ((l << 1) < n) {
-		for (j = 0; j < l; j += 2) {
-			j1 = j + l;
-			j2 = j1 + l;
-			j3 = j2 + l;
-			x0r = a[j] + a[j1];
-			x0i = a[j + 1] + a[j1 + 1];
-			x1r = a[j] - a[j1];
-			x1i = a[j + 1] - a[j1 + 1];
-			x2r = a[j2] + a[j3];
-			x2i = a[j2 + 1] + a[j3 + 1];
-			x3r = a[j2] - a[j3];
-			x3i = a[j2 + 1] - a[j3 + 1];
-			a[j] = x0r + x2r;
-			a[j + 1] = x0i + x2i;
-			a[j2] = x0r - x2r;
-			a[j2 + 1] = x0i - x2i;
-			a[j1] = x1r - x3i;
-			a[j1 + 1] = x1i + x3r;
-			a[j3] = x1r + x3i;
-			a[j3 + 1] = x1i - x3r;
-		}
-	}
-	else if ((l << 1) == n) {
-		for (j = 0; j < l; j += 2) {
-			j1 = j + l;
-			x0r = a[j] - a[j1];
-			x0i = a[j + 1] - a[j1 + 1];
-			a[j] += a[j1];
-			a[j + 1] += a[j1 + 1];
-			a[j1] = x0r;
-			a[j1 + 1] = x0i;
-		}
-	}
+// Transforms the complex elements in (re[0], im[0]), using (re[1], im[1]) as
+// the second buffer of the passes. Passes whose elements are narrower than a
+// vector combine several values of p per vector, or run with scalar
+// operations if there are too few of them. Returns the buffer with the result.
+template <class Ops>
+FFT_INLINE int Transform(const PlanData& plan, int lanes, float* const* re,
+                         float* const* im) {
+    int cur = 0, n = plan.half, stride = lanes;
+    const float* tw = plan.twiddles;
+    for (; n >= 4; tw += 6 * (n / 4), n /= 4, stride *= 4, cur ^= 1) {
+        if (stride % Ops::WIDTH == 0) {
+            Radix4<Ops>(n, stride, tw, re[cur], im[cur], re[cur ^ 1], im[cur ^ 1]);
+        } else if (stride == 1 && n / 4 >= Ops::WIDTH) {
+            // The first pass has its twiddles stored per component.
+            Radix4Narrow<Ops>(n, 1, plan.firstTwiddles, 1, n / 4, re[cur],
+                              im[cur], re[cur ^ 1], im[cur ^ 1]);
+        } else if (Ops::WIDTH == stride * 4 && n / 4 >= 4) {
+            Radix4Narrow<Ops>(n, stride, tw, 6, 1, re[cur], im[cur],
+                              re[cur ^ 1], im[cur ^ 1]);
+        } else {
+            Radix4<ScalarOps>(n, stride, tw, re[cur], im[cur], re[cur ^ 1],
+                              im[cur ^ 1]);
+        }
+    }
+    if (n == 2) {
+        if (stride % Ops::WIDTH == 0) {
+            Radix2<Ops>(stride, re[cur], im[cur], re[cur ^ 1], im[cur ^ 1]);
+        } else {
+            Radix2<ScalarOps>(stride, re[cur], im[cur], re[cur ^ 1], im[cur ^ 1]);
+        }
+        cur ^= 1;
+    }
+    return cur;
 }
 
-static void cftbsub(int n, real* a, real* w)
-{
-	int j, j1, j2, j3, j4, j5, j6, j7, l;
-	real wn4r, x0r, x0i, x1r, x1i, x2r, x2i, x3r, x3i,
-		y0r, y0i, y1r, y1i, y2r, y2i, y3r, y3i,
-		y4r, y4i, y5r, y5i, y6r, y6i, y7r, y7i;
-
-	l = 2;
-	if (n > 16) {
-		cft1st(n, a, w);
-		l = 16;
-		while ((l << 3) < n) {
-			cftmdl(n, l, a, w);
-			l <<= 3;
-		}
-	}
-	if ((l << 2) < n) {
-		wn4r = w[2];
-		for (j = 0; j < l; j += 2) {
-			j1 = j + l;
-			j2 = j1 + l;
-			j3 = j2 + l;
-			j4 = j3 + l;
-			j5 = j4 + l;
-			j6 = j5 + l;
-			j7 = j6 + l;
-			x0r = a[j] + a[j1];
-			x0i = -a[j + 1] - a[j1 + 1];
-			x1r = a[j] - a[j1];
-			x1i = -a[j + 1] + a[j1 + 1];
-			x2r = a[j2] + a[j3];
-			x2i = a[j2 + 1] + a[j3 + 1];
-			x3r = a[j2] - a[j3];
-			x3i = a[j2 + 1] - a[j3 + 1];
-			y0r = x0r + x2r;
-			y0i = x0i - x2i;
-			y2r = x0r - x2r;
-			y2i = x0i + x2i;
-			y1r = x1r - x3i;
-			y1i = x1i - x3r;
-			y3r = x1r + x3i;
-			y3i = x1i + x3r;
-			x0r = a[j4] + a[j5];
-			x0i = a[j4 + 1] + a[j5 + 1];
-			x1r = a[j4] - a[j5];
-			x1i = a[j4 + 1] - a[j5 + 1];
-			x2r = a[j6] + a[j7];
-			x2i = a[j6 + 1] + a[j7 + 1];
-			x3r = a[j6] - a[j7];
-			x3i = a[j6 + 1] - a[j7 + 1];
-			y4r = x0r + x2r;
-			y4i = x0i + x2i;
-			y6r = x0r - x2r;
-			y6i = x0i - x2i;
-			x0r = x1r - x3i;
-			x0i = x1i + x3r;
-			x2r = x1r + x3i;
-			x2i = x1i - x3r;
-			y5r = wn4r * (x0r - x0i);
-			y5i = wn4r * (x0r + x0i);
-			y7r = wn4r * (x2r - x2i);
-			y7i = wn4r * (x2r + x2i);
-			a[j1] = y1r + y5r;
-			a[j1 + 1] = y1i - y5i;
-			a[j5] = y1r - y5r;
-			a[j5 + 1] = y1i + y5i;
-			a[j3] = y3r - y7i;
-			a[j3 + 1] = y3i - y7r;
-			a[j7] = y3r + y7i;
-			a[j7 + 1] = y3i + y7r;
-			a[j] = y0r + y4r;
-			a[j + 1] = y0i - y4i;
-			a[j4] = y0r - y4r;
-			a[j4 + 1] = y0i + y4i;
-			a[j2] = y2r - y6i;
-			a[j2 + 1] = y2i - y6r;
-			a[j6] = y2r + y6i;
-			a[j6 + 1] = y2i + y6r;
-		}
-	}
-	else if ((l << 2) == n) {
-		for (j = 0; j < l; j += 2) {
-			j1 = j + l;
-			j2 = j1 + l;
-			j3 = j2 + l;
-			x0r = a[j] + a[j1];
-			x0i = -a[j + 1] - a[j1 + 1];
-			x1r = a[j] - a[j1];
-			x1i = -a[j + 1] + a[j1 + 1];
-			x2r = a[j2] + a[j3];
-			x2i = a[j2 + 1] + a[j3 + 1];
-			x3r = a[j2] - a[j3];
-			x3i = a[j2 + 1] - a[j3 + 1];
-			a[j] = x0r + x2r;
-			a[j + 1] = x0i - x2i;
-			a[j2] = x0r - x2r;
-			a[j2 + 1] = x0i + x2i;
-			a[j1] = x1r - x3i;
-			a[j1 + 1] = x1i - x3r;
-			a[j3] = x1r + x3i;
-			a[j3 + 1] = x1i + x3r;
-		}
-	}
-	else {
-		for (j = 0; j < l; j += 2) {
-			j1 = j + l;
-			x0r = a[j] - a[j1];
-			x0i = -a[j + 1] + a[j1 + 1];
-			a[j] += a[j1];
-			a[j + 1] = -a[j + 1] - a[j1 + 1];
-			a[j1] = x0r;
-			a[j1 + 1] = x0i;
-		}
-	}
+// Turns the transform Z of the even and odd samples, packed as complex
+// elements, into the spectrum X of the real frame, in place. Both buffers
+// have room for half + 1 elements. Bins k and half - k are made together:
+// X[k] = E + W^k * O and X[half - k] = conj(E - W^k * O), where
+// E = (Z[k] + conj(Z[half - k])) / 2 and O = (Z[k] - conj(Z[half - k])) / 2i.
+template <class Ops>
+FFT_INLINE void SplitForward(const PlanData& plan, int lanes, float* re,
+                             float* im) {
+    typedef typename Ops::V V;
+    V half;
+    Ops::set1(half, 0.5f);
+    for (int k = 0; k <= plan.half / 2; ++k) {
+        // W^k / 2 = (cos - i * sin) / 2, which also halves O.
+        V c, s;
+        Ops::set1(c, plan.splitCos[k] * 0.5f);
+        Ops::set1(s, plan.splitSin[k] * -0.5f);
+        const size_t zk = (size_t)k * lanes;
+        const size_t zj = (size_t)(k ? plan.half - k : 0) * lanes;
+        const size_t xj = (size_t)(plan.half - k) * lanes;
+        for (int q = 0; q < lanes; q += Ops::WIDTH) {
+            V kr, ki, jr, ji;
+            Ops::load(kr, re + zk + q), Ops::load(ki, im + zk + q);
+            Ops::load(jr, re + zj + q), Ops::load(ji, im + zj + q);
+
+            // 2E = (jr + kr, ki - ji) and 2O = (ki + ji, jr - kr).
+            V er, ei, sumI, diffR;
+            Ops::addSub(er, diffR, jr, kr), Ops::addSub(sumI, ei, ki, ji);
+            Ops::mul(er, er, half), Ops::mul(ei, ei, half);
+
+            // P = W^k * O.
+            V pr, pi;
+            Ops::rotate(pr, pi, sumI, diffR, c, s);
+
+            V xkr, xki, xjr, xji;
+            Ops::addSub(xkr, xjr, er, pr), Ops::addSub(xki, xji, pi, ei);
+            Ops::store(re + zk + q, xkr), Ops::store(im + zk + q, xki);
+            Ops::store(re + xj + q, xjr), Ops::store(im + xj + q, xji);
+        }
+    }
 }
 
-static void rftfsub(int n, real* a, int nc, real* c)
-{
-	int j, k, kk, ks, m;
-	real wkr, wki, xr, xi, yr, yi;
-
-	m = n >> 1;
-	ks = 2 * nc / m;
-	kk = 0;
-	for (j = 2; j < m; j += 2) {
-		k = n - j;
-		kk += ks;
-		wkr = 0.5 - c[nc - kk];
-		wki = c[kk];
-		xr = a[j] - a[k];
-		xi = a[j + 1] + a[k + 1];
-		yr = wkr * xr - wki * xi;
-		yi = wkr * xi + wki * xr;
-		a[j] -= yr;
-		a[j + 1] -= yi;
-		a[k] += yr;
-		a[k + 1] -= yi;
-	}
+// ================================================================================================
+// Entry points of every level.
+
+template <class Ops>
+FFT_INLINE void ForwardFrame(const PlanData& plan, const float* in, float* out,
+                             float* scratch) {
+    const int half = plan.half;
+    const size_t size = half + 1;
+    float* re[2] = {scratch, scratch + size * 2};
+    float* im[2] = {scratch + size, scratch + size * 3};
+    for (int k = 0; k < half; ++k) {
+        re[0][k] = in[k * 2 + 0];
+        im[0][k] = in[k * 2 + 1];
+    }
+    int cur = Transform<Ops>(plan, 1, re, im);
+    SplitForward<ScalarOps>(plan, 1, re[cur], im[cur]);
+    for (int k = 0; k <= half; ++k) {
+        out[k * 2 + 0] = re[cur][k];
+        out[k * 2 + 1] = im[cur][k];
+    }
 }
 
-static void rftbsub(int n, real* a, int nc, real* c)
-{
-	int j, k, kk, ks, m;
-	real wkr, wki, xr, xi, yr, yi;
-
-	a[1] = -a[1];
-	m = n >> 1;
-	ks = 2 * nc / m;
-	kk = 0;
-	for (j = 2; j < m; j += 2) {
-		k = n - j;
-		kk += ks;
-		wkr = 0.5 - c[nc - kk];
-		wki = c[kk];
-		xr = a[j] - a[k];
-		xi = a[j + 1] + a[k + 1];
-		yr = wkr * xr + wki * xi;
-		yi = wkr * xi - wki * xr;
-		a[j] -= yr;
-		a[j + 1] = yi - a[j + 1];
-		a[k] += yr;
-		a[k + 1] = yi - a[k + 1];
-	}
-	a[m + 1] = -a[m + 1];
+template <class Ops>
+FFT_INLINE void ForwardBatch(const PlanData& plan, const float* in,
+                             int inStride, float* out, int outStride,
+                             int numFrames, float* scratch) {
+    const int half = plan.half, lanes = Ops::WIDTH;
+    const size_t size = (size_t)(half + 1) * lanes;
+    float* re[2] = {scratch, scratch + size * 2};
+    float* im[2] = {scratch + size, scratch + size * 3};
+    for (int first = 0; first < numFrames; first += lanes) {
+        // Frame l of the group goes to lane l, and unused lanes are zero.
+        const int count = std::min(lanes, numFrames - first);
+        const float* src[Ops::WIDTH];
+        for (int l = 0; l < count; ++l) {
+            src[l] = in + (size_t)(first + l) * inStride;
+        }
+        for (int k = 0; k < half; ++k) {
+            float* dr = re[0] + (size_t)k * lanes;
+            float* di = im[0] + (size_t)k * lanes;
+            for (int l = 0; l < count; ++l) {
+                dr[l] = src[l][k * 2 + 0];
+                di[l] = src[l][k * 2 + 1];
+            }
+            for (int l = count; l < lanes; ++l) dr[l] = di[l] = 0.0f;
+        }
+        int cur = Transform<Ops>(plan, lanes, re, im);
+        SplitForward<Ops>(plan, lanes, re[cur], im[cur]);
+        float* dst[Ops::WIDTH];
+        for (int l = 0; l < count; ++l) {
+            dst[l] = out + (size_t)(first + l) * outStride;
+        }
+        for (int k = 0; k <= half; ++k) {
+            const float* sr = re[cur] + (size_t)k * lanes;
+            const float* si = im[cur] + (size_t)k * lanes;
+            for (int l = 0; l < count; ++l) {
+                dst[l][k * 2 + 0] = sr[l];
+                dst[l][k * 2 + 1] = si[l];
+            }
+        }
+    }
 }
 
-static void dctsub(int n, real* a, int nc, real* c)
-{
-	int j, k, kk, ks, m;
-	real wkr, wki, xr;
-
-	m = n >> 1;
-	ks = nc / n;
-	kk = 0;
-	for (j = 1; j < m; j++) {
-		k = n - j;
-		kk += ks;
-		wkr = c[kk] - c[nc - kk];
-		wki = c[kk] + c[nc - kk];
-		xr = wki * a[j] - wkr * a[k];
-		a[j] = wkr * a[j] + wki * a[k];
-		a[k] = xr;
-	}
-	a[m] *= c[0];
+// Rebuilds Z from the spectrum, and computes its inverse as the conjugate of
+// the forward transform of the conjugate.
+template <class Ops>
+FFT_INLINE void InverseFrame(const PlanData& plan, const float* in, float* out,
+                             float* scratch) {
+    const int half = plan.half;
+    const size_t size = half + 1;
+    float* re[2] = {scratch, scratch + size * 2};
+    float* im[2] = {scratch + size, scratch + size * 3};
+    for (int k = 0; k < half; ++k) {
+        const float kr = in[k * 2], ki = in[k * 2 + 1];
+        const float jr = in[(half - k) * 2], ji = in[(half - k) * 2 + 1];
+
+        // conj(W^k) = cos + i * sin, where the table holds k <= half / 2.
+        const int t = std::min(k, half - k);
+        const float c = (k == t) ? plan.splitCos[t] : -plan.splitCos[t];
+        const float s = plan.splitSin[t];
+
+        // 2E = X[k] + conj(X[half - k]), 2O = conj(W^k) * (X[k] - conj(...)).
+        const float er = kr + jr, ei = ki - ji;
+        const float dr = kr - jr, di = ki + ji;
+        const float or_ = c * dr - s * di, oi = c * di + s * dr;
+        re[0][k] = er - oi;
+        im[0][k] = -(ei + or_);
+    }
+    int cur = Transform<Ops>(plan, 1, re, im);
+    for (int k = 0; k < half; ++k) {
+        out[k * 2 + 0] = re[cur][k];
+        out[k * 2 + 1] = -im[cur][k];
+    }
 }
 
-static void dstsub(int n, real* a, int nc, real* c)
-{
-	int j, k, kk, ks, m;
-	real wkr, wki, xr;
-
-	m = n >> 1;
-	ks = nc / n;
-	kk = 0;
-	for (j = 1; j < m; j++) {
-		k = n - j;
-		kk += ks;
-		wkr = c[kk] - c[nc - kk];
-		wki = c[kk] + c[nc - kk];
-		xr = wki * a[k] - wkr * a[j];
-		a[k] = wkr * a[k] + wki * a[j];
-		a[j] = xr;
-	}
-	a[m] *= c[0];
+static void ForwardScalar(const PlanData& plan, const float* in, float* out,
+                          float* scratch) {
+    ForwardFrame<ScalarOps>(plan, in, out, scratch);
 }
 
-static void makewt(int nw, int* ip, real* w)
-{
-	int j, nwh;
-	real delta, x, y;
-
-	ip[0] = nw;
-	ip[1] = 1;
-	if (nw > 2) {
-		nwh = nw >> 1;
-		delta = atan(1.0) / nwh;
-		w[0] = 1;
-		w[1] = 0;
-		w[nwh] = cos(delta * nwh);
-		w[nwh + 1] = w[nwh];
-		if (nwh > 2) {
-			for (j = 2; j < nwh; j += 2) {
-				x = cos(delta * j);
-				y = sin(delta * j);
-				w[j] = x;
-				w[j + 1] = y;
-				w[nw - j] = y;
-				w[nw - j + 1] = x;
-			}
-			for (j = nwh - 2; j >= 2; j -= 2) {
-				x = w[2 * j];
-				y = w[2 * j + 1];
-				w[nwh + j] = x;
-				w[nwh + j + 1] = y;
-			}
-			bitrv2(nw, ip + 2, w);
-		}
-	}
+static void ForwardBatchScalar(const PlanData& plan, const float* in,
+                               int inStride, float* out, int outStride,
+                               int numFrames, float* scratch) {
+    ForwardBatch<ScalarOps>(plan, in, inStride, out, outStride, numFrames,
+                            scratch);
 }
 
-static void makect(int nc, int* ip, real* c)
-{
-	int j, nch;
-	real delta;
-
-	ip[1] = nc;
-	if (nc > 1) {
-		nch = nc >> 1;
-		delta = atan(1.0) / nch;
-		c[0] = cos(delta * nch);
-		c[nch] = 0.5 * c[0];
-		for (j = 1; j < nch; j++) {
-			c[j] = 0.5 * cos(delta * j);
-			c[nc - j] = 0.5 * sin(delta * j);
-		}
-	}
+static void InverseScalar(const PlanData& plan, const float* in, float* out,
+                          float* scratch) {
+    InverseFrame<ScalarOps>(plan, in, out, scratch);
 }
 
-void rdft(int n, int isgn, real* a, int* ip, real* w)
-{
-	int nw, nc;
-	real xi;
-
-	nw = ip[0];
-	if (n > (nw << 2)) {
-		nw = n >> 2;
-		makewt(nw, ip, w);
-	}
-	nc = ip[1];
-	if (n > (nc << 2)) {
-		nc = n >> 2;
-		makect(nc, ip, w + nw);
-	}
-	if (isgn >= 0) {
-		if (n > 4) {
-			bitrv2(n, ip + 2, a);
-			cftfsub(n, a, w);
-			rftfsub(n, a, nc, w + nw);
-		}
-		else if (n == 4) {
-			cftfsub(n, a, w);
-		}
-		xi = a[0] - a[1];
-		a[0] += a[1];
-		a[1] = xi;
-	}
-	else {
-		a[1] = 0.5 * (a[0] - a[1]);
-		a[0] -= a[1];
-		if (n > 4) {
-			rftbsub(n, a, nc, w + nw);
-			bitrv2(n, ip + 2, a);
-			cftbsub(n, a, w);
-		}
-		else if (n == 4) {
-			cftfsub(n, a, w);
-		}
-	}
+#ifdef CPU_HAS_SSE2
+
+static void ForwardSse2(const PlanData& plan, const float* in, float* out,
+                        float* scratch) {
+    ForwardFrame<Sse2Ops>(plan, in, out, scratch);
+}
+
+static void ForwardBatchSse2(const PlanData& plan, const float* in,
+                             int inStride, float* out, int outStride,
+                             int numFrames, float* scratch) {
+    ForwardBatch<Sse2Ops>(plan, in, inStride, out, outStride, numFrames,
+                          scratch);
+}
+
+static void InverseSse2(const PlanData& plan, const float* in, float* out,
+                        float* scratch) {
+    InverseFrame<Sse2Ops>(plan, in, out, scratch);
+}
+
+#endif  // CPU_HAS_SSE2
+
+#ifdef CPU_HAS_AVX2
+
+CPU_TARGET_AVX2 static void ForwardAvx2(const PlanData& plan, const float* in,
+                                        float* out, float* scratch) {
+    ForwardFrame<Avx2Ops>(plan, in, out, scratch);
+}
+
+CPU_TARGET_AVX2 static void ForwardBatchAvx2(const PlanData& plan,
+                                             const float* in, int inStride,
+                                             float* out, int outStride,
+                                             int numFrames, float* scratch) {
+    ForwardBatch<Avx2Ops>(plan, in, inStride, out, outStride, numFrames,
+                          scratch);
+}
+
+CPU_TARGET_AVX2 static void InverseAvx2(const PlanData& plan, const float* in,
+                                        float* out, float* scratch) {
+    InverseFrame<Avx2Ops>(plan, in, out, scratch);
+}
+
+#endif  // CPU_HAS_AVX2
+
+// ================================================================================================
+// Dispatch.
+
+struct Kernels {
+    int lanes;
+    void (*forward)(const PlanData&, const float*, float*, float*);
+    void (*forwardBatch)(const PlanData&, const float*, int, float*, int, int,
+                         float*);
+    void (*inverse)(const PlanData&, const float*, float*, float*);
+};
+
+static const Kernels& GetKernels() {
+    static const Kernels scalar = {ScalarOps::WIDTH, ForwardScalar,
+                                   ForwardBatchScalar, InverseScalar};
+#ifdef CPU_HAS_SSE2
+    static const Kernels sse2 = {Sse2Ops::WIDTH, ForwardSse2, ForwardBatchSse2,
+                                 InverseSse2};
+#endif
+#ifdef CPU_HAS_AVX2
+    static const Kernels avx2 = {Avx2Ops::WIDTH, ForwardAvx2, ForwardBatchAvx2,
+                                 InverseAvx2};
+#endif
+
+    CpuFeatures::Level level = CpuFeatures::getLevel();
+#ifdef CPU_HAS_AVX2
+    if (level >= CpuFeatures::AVX2) return avx2;
+#endif
+#ifdef CPU_HAS_SSE2
+    if (level >= CpuFeatures::SSE2) return sse2;
+#endif
+    return scalar;
+}
+
+// Work buffers of the calling thread, which hold two pairs of real and
+// imaginary arrays for the given number of lanes.
+static float* GetScratch(int half, int lanes) {
+    thread_local std::vector<float> scratch;
+    size_t size = (size_t)(half + 1) * lanes * 4;
+    if (scratch.size() < size) scratch.resize(size);
+    return scratch.data();
+}
+
+// ================================================================================================
+// RealFFT.
+
+RealFFT::RealFFT(int size) : mySize(size), myHalf(size / 2) {
+    // Twiddles of the radix-4 passes, in the order in which they run.
+    for (int n = myHalf; n >= 4; n /= 4) {
+        for (int p = 0; p < n / 4; ++p) {
+            for (int k = 1; k <= 3; ++k) {
+                double angle = -2.0 * PI * k * p / n;
+                myTwiddles.push_back((float)cos(angle));
+                myTwiddles.push_back((float)sin(angle));
+            }
+        }
+    }
+    // The first pass also has its twiddles stored per component, so that the
+    // twiddles of consecutive values of p can be loaded as a vector.
+    const int m = myHalf / 4;
+    myFirstTwiddles.resize(m * 6);
+    for (int p = 0; p < m; ++p) {
+        for (int c = 0; c < 6; ++c) {
+            myFirstTwiddles[c * m + p] = myTwiddles[p * 6 + c];
+        }
+    }
+    for (int k = 0; k <= myHalf / 2; ++k) {
+        double angle = 2.0 * PI * k / size;
+        mySplitCos.push_back((float)cos(angle));
+        mySplitSin.push_back((float)sin(angle));
+    }
+}
+
+const RealFFT& RealFFT::get(int size) {
+    static std::mutex mutex;
+    static std::map<int, std::unique_ptr<RealFFT>> plans;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& plan = plans[size];
+    if (!plan) plan.reset(new RealFFT(size));
+    return *plan;
+}
+
+void RealFFT::forward(const float* in, float* out) const {
+    PlanData plan = {myHalf, myTwiddles.data(), myFirstTwiddles.data(),
+                     mySplitCos.data(), mySplitSin.data()};
+    GetKernels().forward(plan, in, out, GetScratch(myHalf, 1));
+}
+
+void RealFFT::forward(const float* in, int inStride, float* out, int outStride,
+                      int numFrames) const {
+    PlanData plan = {myHalf, myTwiddles.data(), myFirstTwiddles.data(),
+                     mySplitCos.data(), mySplitSin.data()};
+    const Kernels& kernels = GetKernels();
+    kernels.forwardBatch(plan, in, inStride, out, outStride, numFrames,
+                         GetScratch(myHalf, kernels.lanes));
+}
+
+void RealFFT::inverse(const float* in, float* out) const {
+    PlanData plan = {myHalf, myTwiddles.data(), myFirstTwiddles.data(),
+                     mySplitCos.data(), mySplitSin.data()};
+    GetKernels().inverse(plan, in, out, GetScratch(myHalf, 1));
+}
+
+// ================================================================================================
+// Ooura compatible real DFT.
+
+void rdft(int n, int isgn, float* a, [[maybe_unused]] int* ip,
+          [[maybe_unused]] float* w) {
+    const RealFFT& fft = RealFFT::get(n);
+    thread_local std::vector<float> spectrum;
+    spectrum.resize(n + 2);
+    float* x = spectrum.data();
+    const int half = n / 2;
+    if (isgn >= 0) {
+        // The Ooura transform uses the opposite sign for the imaginary parts.
+        fft.forward(a, x);
+        a[0] = x[0];
+        a[1] = x[half * 2];
+        for (int k = 1; k < half; ++k) {
+            a[k * 2 + 0] = x[k * 2 + 0];
+            a[k * 2 + 1] = -x[k * 2 + 1];
+        }
+    } else {
+        x[0] = a[0], x[1] = 0.0f;
+        x[half * 2] = a[1], x[half * 2 + 1] = 0.0f;
+        for (int k = 1; k < half; ++k) {
+            x[k * 2 + 0] = a[k * 2 + 0];
+            x[k * 2 + 1] = -a[k * 2 + 1];
+        }
+        fft.inverse(x, a);
+        for (int i = 0; i < n; ++i) a[i] *= 0.5f;
+    }
 }
 
-} // namespace FFT
-} // namespace AV
+};  // namespace Vortex
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+namespace Vortex {
+
+/// Fast Fourier transform of real input with a fixed power-of-two size. The
+/// twiddle factors of every stage are computed once, when the plan is made,
+/// and a plan can be used by several threads at the same time. The complex
+/// transform runs in radix-4 stages, with vector kernels that are selected at
+/// runtime. Batches of frames are transformed side by side, one frame per
+/// vector lane, which keeps every stage of the transform vectorized.
+class RealFFT {
+   public:
+    /// Makes a plan for frames of the given size, which has to be a power of
+    /// two of at least two.
+    explicit RealFFT(int size);
+
+    /// Returns a shared plan for the given size, which is made on first use.
+    static const RealFFT& get(int size);
+
+    /// Returns the number of real samples per frame.
+    int getSize() const { return mySize; }
+
+    /// Computes the spectrum X[k] = sum x[j] * exp(-2 * pi * i * j * k / n) of
+    /// one frame. The output holds size / 2 + 1 bins as (real, imaginary)
+    /// pairs, so it has room for size + 2 floats.
+    void forward(const float* in, float* out) const;
+
+    /// Computes the spectra of several frames. Frame f is read from
+    /// in + f * inStride, so overlapping frames can be read directly from a
+    /// signal by using the hop size as stride, and is written to
+    /// out + f * outStride in the format of "forward".
+    void forward(const float* in, int inStride, float* out, int outStride,
+                 int numFrames) const;
+
+    /// Computes one frame from size / 2 + 1 bins in the format of "forward".
+    /// The output is not normalized, so it is the input of "forward"
+    /// multiplied by the size.
+    void inverse(const float* in, float* out) const;
+
+   private:
+    int mySize;
+    int myHalf;  // Size of the complex transform, which is mySize / 2.
+
+    std::vector<float> myTwiddles;  // Per radix-4 stage, (w1, w2, w3) per p.
+    std::vector<float> myFirstTwiddles;  // First stage, per component.
+    std::vector<float> mySplitCos;  // cos(2 * pi * k / size), k <= myHalf/2.
+    std::vector<float> mySplitSin;  // sin(2 * pi * k / size), k <= myHalf/2.
+};
+
+/// Drop-in replacement for the Ooura real DFT, on top of RealFFT. With isgn
+/// >= 0, the frame in a is replaced by R[k] = sum a[j] * cos(2 * pi * j * k /
+/// n) and I[k] = sum a[j] * sin(2 * pi * j * k / n), stored as a[2k] = R[k],
+/// a[2k+1] = I[k] and a[1] = R[n/2]. With isgn < 0, the inverse is computed,
+/// scaled by n / 2. The ip and w work areas are no longer used; the twiddle
+/// factors come from the shared plan of size n.
+void rdft(int n, int isgn, float* a, int* ip, float* w);
+
+};  // namespace Vortex
@@ -1,5 +1,6 @@
 ﻿#include <Editor/FindOnsets.h>
 #include <Editor/Aubio.h>
+#include <Editor/FFT.h>
 
 #include <Core/Utils.h>
 #include <Core/AlignedMemory.h>
@@ -19,8 +20,6 @@ typedef double real;
 
 namespace Vortex {
 
-extern void rdft(int n, int isgn, smpl_t *a, int *ip, smpl_t *w);
-
 namespace {
 
 // ================================================================================================
@@ -992,47 +991,41 @@ static void del_aubio_onset(aubio_onset_t *o)
 	AUBIO_FREE(o);
 }
 
-/* execute onset detection function on iput buffer */
-static void aubio_onset_do(aubio_onset_t *o, fvec_t * input, fvec_t * onset)
+/** onset candidate, before the minimum inter-onset interval is applied */
+struct aubio_onset_candidate_t {
+	uint_t pos;   /**< onset location, in frames, including the delay */
+	bool first;   /**< non-silent beginning of the file, which is always accepted */
+};
+
+/* execute onset detection function on input buffer. The minimum inter-onset interval depends on
+   the onsets that were accepted before, so it is left to the caller, which sees all candidates in
+   order. Returns 1 if the buffer contains a candidate. */
+static uint_t aubio_onset_do(aubio_onset_t *o, fvec_t * input, fvec_t * onset,
+	aubio_onset_candidate_t * candidate)
 {
 	smpl_t isonset = 0;
+	uint_t found = 0;
 	aubio_pvoc_do(o->pv, input, o->fftgrain);
 	aubio_specdesc_do(o->od, o->fftgrain, o->desc);
 	aubio_peakpicker_do(o->pp, o->desc, onset);
 	isonset = onset->data[0];
 	if(isonset > 0.) {
-		if(aubio_silence_detection(input, o->silence) == 1) {
-			//AUBIO_DBG ("silent onset, not marking as onset\n");
-			isonset = 0;
-		}
-		else {
-			uint_t new_onset = o->total_frames + (uint_t)ROUND(isonset * o->hop_size);
-			if(o->last_onset + o->minioi < new_onset) {
-				//AUBIO_DBG ("accepted detection, marking as onset\n");
-				o->last_onset = new_onset;
-			}
-			else {
-				//AUBIO_DBG ("doubled onset, not marking as onset\n");
-				isonset = 0;
-			}
+		if(aubio_silence_detection(input, o->silence) == 0) {
+			candidate->pos = o->total_frames + (uint_t)ROUND(isonset * o->hop_size);
+			candidate->first = false;
+			found = 1;
 		}
 	}
 	else {
 		// we are at the beginning of the file, and we don't find silence
 		if(o->total_frames == 0 && aubio_silence_detection(input, o->silence) == 0) {
-			//AUBIO_DBG ("beginning of file is not silent, marking as onset\n");
-			isonset = o->delay / o->hop_size;
-			o->last_onset = o->delay;
+			candidate->pos = o->delay;
+			candidate->first = true;
+			found = 1;
 		}
 	}
-	onset->data[0] = isonset;
 	o->total_frames += o->hop_size;
-	return;
-}
-
-static uint_t aubio_onset_get_last(aubio_onset_t *o)
-{
-	return o->last_onset - o->delay;
+	return found;
 }
 
 }; // anonymous namespace
@@ -1040,78 +1033,103 @@ static uint_t aubio_onset_get_last(aubio_onset_t *o)
 // ================================================================================================
 // Main function.
 
-void FindOnsets(const float* samples, int samplerate, int numFrames, int numThreads, std::vector<Onset>& out)
+static const int windowlen = 256;
+static const int bufsize = windowlen * 4;
+static char* method = "complex";
+
+// The state of the onset detector only depends on the last few hops: the phase vocoder holds three
+// hops, the spectral descriptor two frames, and the peak picker nine descriptor values. After this
+// many hops, a detector that starts in the middle of the signal is in the same state as one that
+// started at the beginning.
+static const int WARMUP_HOPS = 16;
+
+// Chunks are kept long enough that warming up the detector is a small part of the work.
+static const int MIN_CHUNK_HOPS = 512;
+
+// Finds the onset candidates of a range of hops. Chunks of the signal are processed independently,
+// each starting WARMUP_HOPS before its first hop, so the candidates are the same as those of a
+// single pass over the whole signal.
+struct OnsetChunks : public ParallelThreads
 {
-	static const int windowlen = 256;
-	static const int bufsize = windowlen * 4;
-	static char* method = "complex";
+	const float* samples;
+	int samplerate, numHops, hopsPerChunk;
+	std::vector<std::vector<aubio_onset_candidate_t>> candidates;
 
-	if(numThreads > 1)
+	void exec(int item, int thread) override
 	{
-		struct OnsetThreads : public ParallelThreads
-		{
-			CriticalSection lock;
-			const float* samples;
-			int numFrames, numThreads, samplerate;
-			std::vector<Onset> onsets;
+		int begin = item * hopsPerChunk;
+		int end = min(begin + hopsPerChunk, numHops);
+		int warmup = max(0, begin - WARMUP_HOPS);
 
-			OnsetThreads(const float* inSamples, int inFrames, int inThreads, int inSamplerate)
-			{
-				samples = inSamples;
-				numFrames = inFrames;
-				numThreads = inThreads;
-				samplerate = inSamplerate;
-			}
-			void exec(int item, int thread) override
-			{
-				int framesPerThread = numFrames / numThreads;
-				auto onset = new_aubio_onset(method, bufsize, windowlen, samplerate);
-				fvec_t* samplevec = new_fvec(windowlen), *beatvec = new_fvec(2);
-				int beginPos = framesPerThread * (thread + 0);
-				int endPos = framesPerThread * (thread + 1);
-				int paddedBegin = max(beginPos - bufsize, 0);
-				int paddedEnd = min(endPos + bufsize, numFrames - windowlen);
-				for(int i = paddedBegin; i < paddedEnd; i += windowlen)
-				{
-					memcpy(samplevec->data, samples + i, sizeof(float) * windowlen);
-					aubio_onset_do(onset, samplevec, beatvec);
-					if(beatvec->data[0] > 0)
-					{
-						int pos = aubio_onset_get_last(onset) + paddedBegin;
-						if(pos >= beginPos && pos < endPos)
-						{
-							lock.lock();
-							onsets.push_back({pos, 1.0});
-							lock.unlock();
-						}
-					}
-				}
-				del_fvec(samplevec);
-				del_fvec(beatvec);
-				del_aubio_onset(onset);
-			}
-		};
-		OnsetThreads threads = {samples, numFrames, numThreads, samplerate};
-		threads.run(numThreads);
-	}
-	else
-	{
 		auto onset = new_aubio_onset(method, bufsize, windowlen, samplerate);
 		fvec_t* samplevec = new_fvec(windowlen), *beatvec = new_fvec(2);
-		for(int i = 0; i <= numFrames - windowlen; i += windowlen)
+		onset->total_frames = warmup * windowlen;
+
+		aubio_onset_candidate_t candidate;
+		for(int hop = warmup; hop < end; ++hop)
 		{
-			memcpy(samplevec->data, samples + i, sizeof(float) * windowlen);
-			aubio_onset_do(onset, samplevec, beatvec);
-			if(beatvec->data[0] > 0)
+			memcpy(samplevec->data, samples + hop * windowlen, sizeof(float) * windowlen);
+			if(aubio_onset_do(onset, samplevec, beatvec, &candidate) && hop >= begin)
 			{
-				int pos = aubio_onset_get_last(onset);
-				if(pos >= 0) out.push_back({pos, 1.0});
+				candidates[item].push_back(candidate);
 			}
 		}
 		del_fvec(samplevec);
 		del_fvec(beatvec);
 		del_aubio_onset(onset);
 	}
+};
+
+void FindOnsets(const float* samples, int samplerate, int numFrames, int numThreads, std::vector<Onset>& out)
+{
+	int numHops = (numFrames >= windowlen) ? (numFrames - windowlen) / windowlen + 1 : 0;
+	if(numHops == 0) return;
+
+	int numChunks = 1;
+	if(numThreads > 1)
+	{
+		numChunks = max(1, min(numThreads * 4, numHops / MIN_CHUNK_HOPS));
+	}
+
+	OnsetChunks chunks;
+	chunks.samples = samples;
+	chunks.samplerate = samplerate;
+	chunks.numHops = numHops;
+	chunks.hopsPerChunk = (numHops + numChunks - 1) / numChunks;
+	chunks.candidates.resize(numChunks);
+	if(numChunks > 1)
+	{
+		chunks.run(numChunks, numThreads);
+	}
+	else
+	{
+		chunks.exec(0, 0);
+	}
+
+	// Apply the minimum inter-onset interval to the candidates of all chunks, in order.
+	auto onset = new_aubio_onset(method, bufsize, windowlen, samplerate);
+	uint_t delay = onset->delay, minioi = onset->minioi, last = 0;
+	del_aubio_onset(onset);
+
+	for(auto& chunk : chunks.candidates)
+	{
+		for(auto& candidate : chunk)
+		{
+			if(candidate.first)
+			{
+				last = delay;
+				if(delay / windowlen == 0) continue;
+			}
+			else if(last + minioi < candidate.pos)
+			{
+				last = candidate.pos;
+			}
+			else continue;
+
+			int pos = last - delay;
+			if(pos >= 0) out.push_back({pos, 1.0});
+		}
+	}
 }
 
 }; // namespace Vortex
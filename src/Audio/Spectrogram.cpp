@@ -2,73 +2,156 @@
 #include "Music.h"
 #include "View.h"
 
+#include <Editor/AudioAnalysis.h>
+
+#include <limits.h>
+#include <math.h>
+#include <algorithm>
+
 namespace Vortex {
 
+// Tiles this far outside of the view keep their textures, so scrolling back is free.
+static const int KEEP_TILE_MARGIN = 2;
+
+// ================================================================================================
+// Spectrogram.
+
 Spectrogram::Spectrogram(int frameSize, int sampleRate)
-    : gist(frameSize, sampleRate)
+    : frameSize(frameSize)
+    , sampleRate(sampleRate)
+    , numColumns(0)
 {
-    audioFrame.resize(frameSize);
-    onsetDetectionFunction.resize(0);
+    // Analysis frames do not overlap, so every column covers a distinct part of the song.
+    subscription = gAudioAnalysis->subscribe(frameSize, frameSize,
+        [this](const AnalysisFrames& frames) { setFrames(frames); });
 }
 
 Spectrogram::~Spectrogram()
 {
+    gAudioAnalysis->unsubscribe(subscription);
 }
 
 void Spectrogram::onChanges(int changes)
 {
+    if (changes & VCM_MUSIC_PATH_CHANGED)
+    {
+        clear();
+    }
 }
 
-void Spectrogram::draw()
+void Spectrogram::clear()
+{
+    numColumns = 0;
+    pixels.clear();
+    onsetCurve.clear();
+    tiles.clear();
+}
+
+void Spectrogram::setFrames(const AnalysisFrames& frames)
+{
+    clear();
+
+    sampleRate = frames.sampleRate;
+    numColumns = frames.numFrames;
+    // The onset curve is the spectral flux, normalized to the strongest onset.
+    onsetCurve = frames.flux;
+    float maxFlux = 0.0f;
+    for (float v : onsetCurve) maxFlux = std::max(maxFlux, v);
+    if (maxFlux > 0.0f)
+    {
+        for (float& v : onsetCurve) v /= maxFlux;
+    }
+    tiles.resize((numColumns + TILE_COLUMNS - 1) / TILE_COLUMNS);
+
+    // Magnitudes are quantized to bytes on a log scale.
+    pixels.resize(frames.magnitude.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        float v = log10f(1 + frames.magnitude[i] * 1000) * 255;
+        pixels[i] = (uchar)std::min(std::max(v, 0.0f), 255.0f);
+    }
+}
+
+void Spectrogram::uploadTile(int index)
 {
-    auto& music = gMusic->getSamples();
-    if (!music.isCompleted())
+    Tile& tile = tiles[index];
+    if (tile.tex.handle())
         return;
 
-    int frameSize = gist.getAudioFrameSize();
-    int sampleRate = gist.getSamplingFrequency();
-    int numFrames = music.getNumFrames();
-    int numBlocks = numFrames / frameSize;
+    int numBins = frameSize / 2;
+    int begin = index * TILE_COLUMNS;
+    int end = std::min(begin + TILE_COLUMNS, numColumns);
+    const uchar* src = pixels.data() + (size_t)begin * numBins;
 
-    if (!tex.handle() || tex.size().x != numBlocks || tex.size().y != frameSize / 2)
+    // The last tile is usually not full. Draw maps every tile to TILE_COLUMNS
+    // frames, so the rows past the end of the song are cleared.
+    std::vector<uchar> padded;
+    if (end - begin < TILE_COLUMNS)
     {
-        tex = Texture(numBlocks, frameSize / 2, Texture::ALPHA);
+        padded.assign((size_t)numBins * TILE_COLUMNS, 0);
+        std::copy(src, src + (size_t)(end - begin) * numBins, padded.begin());
+        src = padded.data();
     }
+    tile.tex = Texture(numBins, TILE_COLUMNS, src, false, Texture::ALPHA);
+}
 
-    std::vector<uchar> texBuf(numBlocks * (frameSize / 2));
-    onsetDetectionFunction.resize(numBlocks);
+void Spectrogram::draw()
+{
+    if (tiles.empty())
+        return;
 
-    for (int i = 0; i < numBlocks; ++i)
+    int w = gView->getWidth();
+    int h = gView->getHeight();
+    double secondsPerColumn = (double)frameSize / sampleRate;
+
+    // Time runs along the notefield, and frequency from left to right.
+    int firstVisible = INT_MAX, lastVisible = -1;
+    for (int i = 0; i < (int)tiles.size(); ++i)
     {
-        for (int j = 0; j < frameSize; ++j)
-        {
-            audioFrame[j] = music.samplesL()[i * frameSize + j];
-        }
+        int y0 = gView->timeToY(i * TILE_COLUMNS * secondsPerColumn);
+        int y1 = gView->timeToY((i + 1) * TILE_COLUMNS * secondsPerColumn);
+        if (std::max(y0, y1) < 0 || std::min(y0, y1) >= h)
+            continue;
+
+        firstVisible = std::min(firstVisible, i);
+        lastVisible = i;
 
-        gist.processAudioFrame(audioFrame);
-        onsetDetectionFunction[i] = gist.energyDifference();
-        const std::vector<float>& magSpec = gist.getMagnitudeSpectrum();
+        uploadTile(i);
+        Tile& tile = tiles[i];
 
-        for (int j = 0; j < frameSize / 2; ++j)
+        areaf uvs = {0, 0, 1, 1};
+        if (y1 < y0)
         {
-            texBuf[i * (frameSize / 2) + j] = (uchar)(log10(1 + magSpec[j] * 1000) * 255);
+            std::swap(y0, y1);
+            std::swap(uvs.t, uvs.b);
         }
+        Draw::fill({0, y0, w, y1 - y0}, Colors::white, tile.tex.handle(), uvs, Texture::ALPHA);
     }
 
-    tex.modify(0, 0, numBlocks, frameSize / 2, texBuf.data());
+    // Textures of tiles that scrolled out of view are released.
+    for (int i = 0; i < (int)tiles.size(); ++i)
+    {
+        bool keep = i >= firstVisible - KEEP_TILE_MARGIN && i <= lastVisible + KEEP_TILE_MARGIN;
+        if (!keep && tiles[i].tex.handle())
+        {
+            tiles[i].tex = Texture();
+        }
+    }
 
-    int w = gView->getWidth();
-    int h = gView->getHeight();
-    Draw::fill({0, 0, w, h}, Colors::white, tex.handle());
+    // Draw the cached onset curve of the visible part of the song.
+    if (lastVisible < 0)
+        return;
 
-    for (int i = 0; i < numBlocks; ++i)
+    int beginColumn = firstVisible * TILE_COLUMNS;
+    int endColumn = std::min((lastVisible + 1) * TILE_COLUMNS, numColumns);
+    for (int i = beginColumn; i < endColumn; ++i)
     {
-        float onset = onsetDetectionFunction[i];
-        if (onset > 0.1)
+        float onset = onsetCurve[i];
+        if (onset > 0.1f)
         {
-            int x = (int)((float)i / numBlocks * w);
-            int y = (int)(onset * h);
-            Draw::fill({x, h - y, 1, y}, Colors::red);
+            int y = gView->timeToY(i * secondsPerColumn);
+            int x = (int)(onset * w);
+            Draw::fill({0, y, x, 1}, Colors::red);
         }
     }
 }
@@ -2,13 +2,24 @@
 
 #include <Core/Draw.h>
 #include <Core/Vector.h>
-#include <Gist.h>
+
+#include <vector>
 
 namespace Vortex {
 
+struct AnalysisFrames;
+
+/// Magnitude spectrogram of the music. The spectrum is computed once by the
+/// audio analysis after the music is loaded, and stored as 8-bit tiles of
+/// TILE_COLUMNS analysis frames. Only the tiles in view are uploaded to
+/// textures, as the view scrolls. Not used by the editor yet: the spectrogram
+/// colour mode of the waveform does not create one.
 struct Spectrogram
 {
 public:
+    /// Number of analysis frames per tile.
+    static const int TILE_COLUMNS = 256;
+
     Spectrogram(int frameSize, int sampleRate);
     ~Spectrogram();
 
@@ -16,11 +27,27 @@ public:
 
     void draw();
 
+    /// Returns the onset detection curve, which is the spectral flux of every
+    /// analysis frame. The curve is empty until the analysis is done.
+    const std::vector<float>& getOnsetCurve() const { return onsetCurve; }
+
 private:
-    Gist<float> gist;
-    Texture tex;
-    std::vector<float> audioFrame;
-    std::vector<float> onsetDetectionFunction;
+    struct Tile
+    {
+        Texture tex;
+    };
+
+    void setFrames(const AnalysisFrames& frames);
+    void clear();
+    void uploadTile(int index);
+
+    int subscription;
+    int frameSize;
+    int sampleRate;
+    int numColumns;
+    std::vector<uchar> pixels;
+    std::vector<float> onsetCurve;
+    std::vector<Tile> tiles;
 };
 
 }; // namespace Vortex
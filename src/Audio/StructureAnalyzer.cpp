@@ -1,5 +1,5 @@
 #include <Editor/StructureAnalyzer.h>
-#include <Gist.h>
+#include <Editor/AudioAnalysis.h>
 #include <Core/Utils.h>
 #include <vector>
 #include <cmath>
@@ -7,12 +7,12 @@
 
 namespace Vortex {
 
-static float CosineDistance(const std::vector<float>& a, const std::vector<float>& b)
+static float CosineDistance(const float* a, const float* b)
 {
     float dot = 0.0f;
     float magA = 0.0f;
     float magB = 0.0f;
-    for (size_t i = 0; i < a.size(); ++i) {
+    for (int i = 0; i < AnalysisFrames::NUM_MFCC; ++i) {
         dot += a[i] * b[i];
         magA += a[i] * a[i];
         magB += b[i] * b[i];
@@ -21,27 +21,12 @@ static float CosineDistance(const std::vector<float>& a, const std::vector<float
     return 1.0f - (dot / (sqrt(magA) * sqrt(magB)));
 }
 
-void FindSections(const float* samples, int samplerate, int numFrames, Vector<Section>& out)
+void FindSections(const AnalysisFrames& frames, Vector<Section>& out)
 {
-    const int frameSize = 4096; // Large window for texture
-    const int hopSize = 2048;
-
-    if (numFrames < frameSize) return;
-
-    Gist<float> gist(frameSize, samplerate);
-    std::vector<float> audioFrame(frameSize);
-
-    // 1. Extract MFCCs
-    std::vector<std::vector<float>> features;
-    int numBlocks = (numFrames - frameSize) / hopSize;
-
-    for (int i = 0; i < numBlocks; ++i) {
-        int start = i * hopSize;
-        for (int j = 0; j < frameSize; ++j) {
-            audioFrame[j] = samples[start + j];
-        }
-        gist.processAudioFrame(audioFrame);
-        features.push_back(gist.getMelFrequencyCepstralCoefficients());
+    // 1. Gather the MFCCs of every frame.
+    std::vector<const float*> features;
+    for (int i = 0; i < frames.numFrames; ++i) {
+        features.push_back(frames.mfccAt(i));
     }
 
     if (features.empty()) return;
@@ -120,7 +105,7 @@ void FindSections(const float* samples, int samplerate, int numFrames, Vector<Se
             }
 
             if (isPeak) {
-                double time = (double)(i * hopSize) / samplerate;
+                double time = frames.frameToTime(i);
                 out.push_back({time, (double)val});
                 // Skip forward to avoid clusters
                 i += win;
@@ -9,6 +9,13 @@ struct Section {
     double score;
 };
 
-void FindSections(const float* samples, int samplerate, int numFrames, Vector<Section>& out);
+struct AnalysisFrames;
+
+// Analysis resolution used for section detection; large frames capture the texture of the music.
+static const int SECTION_FRAME_SIZE = 4096;
+static const int SECTION_HOP_SIZE = 2048;
+
+// Finds section boundaries from the novelty of the MFCCs of the analyzed audio.
+void FindSections(const AnalysisFrames& frames, Vector<Section>& out);
 
 }; // namespace Vortex
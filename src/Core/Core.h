@@ -66,4 +66,19 @@ extern void HudInfo(const char* fmt, ...);
 extern void HudWarning(const char* fmt, ...);
 extern void HudError(const char* fmt, ...);
 
+/// Drops the Hud messages of the calling task while it exists. Background
+/// work that can warn about thousands of files, like indexing a song library,
+/// uses this instead of flooding the Hud. Other tasks that run on the same
+/// thread in the meantime are not muted.
+struct HudMute {
+    HudMute();
+    ~HudMute();
+
+    HudMute(const HudMute&) = delete;
+    HudMute& operator=(const HudMute&) = delete;
+
+   private:
+    HudMute* myPrevious;
+};
+
 };  // namespace Vortex
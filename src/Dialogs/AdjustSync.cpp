@@ -3,12 +3,16 @@
 #include <Core/StringUtils.h>
 #include <Core/WidgetsLayout.h>
 
+#include <Managers/NoteMan.h>
 #include <Managers/SimfileMan.h>
 #include <Managers/TempoMan.h>
 
 #include <Dialogs/Dialog.h>
 #include <Core/Widgets.h>
+#include <Editor/AudioAnalysis.h>
+#include <Editor/BeatTracker.h>
 #include <Editor/Common.h>
+#include <Editor/FindOffset.h>
 #include <Editor/FindTempo.h>
 #include <Editor/History.h>
 #include <Editor/Selection.h>
@@ -35,6 +39,7 @@ DialogAdjustSync::~DialogAdjustSync() { delete myTempoDetector; }
 
 DialogAdjustSync::DialogAdjustSync()
     : mySelectedResult(0),
+      myDetectionMode(TempoDetector::MODE_INTERVAL_SEARCH),
       myOffset(0),
       myInitialBPM(0),
       myTempoDetector(nullptr),
@@ -100,6 +105,16 @@ void DialogAdjustSync::myCreateWidgets() {
         button->setTooltip(moveTooltip[i]);
     }
 
+    myLayout.row().col(128).col(108);
+    myOffsetLabel = myLayout.add<WgLabel>();
+
+    WgButton* findOffset = myLayout.add<WgButton>();
+    findOffset->text.set("{g:calculate} Auto offset");
+    findOffset->onPress.bind(this, &DialogAdjustSync::onFindOffset);
+    findOffset->setTooltip(
+        "Set the music offset that lines up the notes of the chart with the "
+        "onsets in the music");
+
     myLayout.row().col(240);
     myLayout.add<WgSeperator>();
 
@@ -109,6 +124,14 @@ void DialogAdjustSync::myCreateWidgets() {
     myBPMList->value.bind(&mySelectedResult);
     myBPMList->setTooltip("BPM estimates calculated by the editor");
 
+    WgCycleButton* mode = myLayout.add<WgCycleButton>("Method");
+    mode->addItem("Interval search");
+    mode->addItem("Autocorrelation");
+    mode->value.bind(&myDetectionMode);
+    mode->setTooltip(
+        "Interval search tests every tempo separately\n"
+        "Autocorrelation tests all tempos at once, which is faster on long songs");
+
     myLayout.row().col(118).col(118);
     myApplyBPM = myLayout.add<WgButton>();
     myApplyBPM->text.set("Apply BPM");
@@ -133,6 +156,7 @@ void DialogAdjustSync::onChanges(int changes) {
         } else {
             for (auto w : myLayout) w->setEnabled(false);
         }
+        myOffsetLabel->text.set("Sync to the notes");
         myResetBPMDetection();
     }
 }
@@ -223,14 +247,48 @@ void DialogAdjustSync::onFindBPM() {
             myDetectionRow = region.beginRow;
             double time = gTempo->rowToTime(region.beginRow);
             double len = gTempo->rowToTime(region.endRow) - time;
-            myTempoDetector = TempoDetector::New(time, len);
+            myTempoDetector = TempoDetector::New(
+                time, len, static_cast<TempoDetector::Mode>(myDetectionMode));
         } else {
             myDetectionRow = 0;
-            myTempoDetector = TempoDetector::New(0, 600.0);
+            myTempoDetector = TempoDetector::New(
+                0, 600.0, static_cast<TempoDetector::Mode>(myDetectionMode));
         }
     }
 }
 
+void DialogAdjustSync::onFindOffset() {
+    auto frames = gAudioAnalysis->get(BEAT_FRAME_SIZE, BEAT_HOP_SIZE);
+    if (!frames) {
+        HudError("The music is not loaded yet.");
+        return;
+    }
+
+    // Chords and holds only count once, and notes that are not hit do not
+    // count at all.
+    std::vector<double> times;
+    for (auto& note : *gNotes) {
+        if (note.isMine || note.isFake || note.isWarped) continue;
+        if (times.empty() || note.time != times.back()) {
+            times.push_back(note.time);
+        }
+    }
+    if (times.empty()) {
+        HudError("The chart has no notes to sync to.");
+        return;
+    }
+
+    OffsetResult result;
+    FindOffset(*frames, times, OFFSET_SEARCH_RANGE, result);
+
+    Str::fmt fmt("Moved %1 ms :: %2%");
+    fmt.arg(result.shift * 1000.0, 1, 1).arg(result.confidence * 100.0, 0, 0);
+    myOffsetLabel->text.set(fmt);
+
+    // Moving the notes later means the first beat starts later in the music.
+    gTempo->setOffset(gTempo->getOffset() - result.shift);
+}
+
 void DialogAdjustSync::myResetBPMDetection() {
     if (myTempoDetector) {
         delete myTempoDetector;
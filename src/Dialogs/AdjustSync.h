@@ -23,6 +23,7 @@ public:
 	void onAction(int id);	
 	void onApplyBPM();
 	void onFindBPM();
+	void onFindOffset();
 
 private:
 	WgSpinner* myCreateWidgetRow(StringRef, double&, int, int, const char*, const char*);
@@ -31,8 +32,9 @@ private:
 	void myResetBPMDetection();
 
 	int mySelectedResult;
+	int myDetectionMode;
 	double myOffset, myInitialBPM;
-	WgLabel* myBPMLabel;
+	WgLabel* myBPMLabel, *myOffsetLabel;
 	WgButton* myApplyBPM, *myFindBPM;
 	WgSelectList* myBPMList;
 	TempoDetector* myTempoDetector;
@@ -19,6 +19,8 @@
 #include <Editor/FindTempo.h>
 #include <Editor/FindOnsets.h>
 #include <Editor/AnalyzeKey.h>
+#include <Editor/AudioAnalysis.h>
+#include <Editor/BeatTracker.h>
 #include <Simfile/NoteList.h>
 
 #include <vector>
@@ -476,6 +478,8 @@ void Action::perform(Type action)
 
 	CASE(CONVERT_MUSIC_TO_OGG)
 		gMusic->startOggConversion();
+	CASE(RENDER_MIX_TO_WAV)
+		gMusic->renderMixToWav();
 
 	CASE(SPEED_RESET)
 		gMusic->setSpeed(100);
@@ -483,6 +487,8 @@ void Action::perform(Type action)
 		gMusic->setSpeed(gMusic->getSpeed() + 10);
 	CASE(SPEED_DECREASE)
 		gMusic->setSpeed(gMusic->getSpeed() - 10);
+	CASE(TOGGLE_TIME_STRETCH)
+		gMusic->toggleTimeStretch();
 
 	CASE(TOGGLE_LOOP_SELECTION)
 		{
@@ -683,16 +689,11 @@ void Action::perform(Type action)
 
 	CASE(DETECT_SONG_SECTIONS)
 		{
-			auto& music = gMusic->getSamples();
-			if(music.isCompleted() && music.getNumFrames() > 0) {
-				int numFrames = music.getNumFrames();
-				int samplerate = music.getFrequency();
-				std::vector<float> floatSamples(numFrames);
-				const short* src = music.samplesL(); // Mono analysis
-				for(int i=0; i<numFrames; ++i) floatSamples[i] = src[i] / 32768.0f;
-
+			// The features are shared with the other analyses, so they are often cached already.
+			auto frames = gAudioAnalysis->get(SECTION_FRAME_SIZE, SECTION_HOP_SIZE);
+			if(frames) {
 				Vector<Section> sections;
-				FindSections(floatSamples.data(), samplerate, numFrames, sections);
+				FindSections(*frames, sections);
 
 				for(const auto& s : sections) {
 					int row = gTempo->timeToRow(s.time);
@@ -1098,6 +1099,41 @@ void Action::perform(Type action)
 			HudNote("Applied %d BPM changes based on sections.", count);
 		}
 
+	CASE(TRACK_BEATS)
+		{
+			auto frames = gAudioAnalysis->get(BEAT_FRAME_SIZE, BEAT_HOP_SIZE);
+			if(!frames) {
+				HudError("Music not loaded.");
+				break;
+			}
+
+			std::vector<double> beats;
+			TrackBeats(*frames, beats);
+			TrackedTempo tempo;
+			FitTempoToBeats(beats, BEAT_TOLERANCE, tempo);
+			if(tempo.bpms.empty()) {
+				HudError("Could not find any beats.");
+				break;
+			}
+
+			Str::fmt msg("Tracked %1 beats with %2 BPM changes. Replace the current BPM changes?");
+			msg.arg((int)beats.size()).arg((int)tempo.bpms.size());
+			if(gSystem->showMessageDlg("Track Beats", msg, System::T_YES_NO, System::I_INFO) != System::R_YES) break;
+
+			SegmentEdit edit;
+			const SegmentGroup* segs = gTempo->getSegments();
+			if(segs) {
+				for(const auto& s : segs->getList<BpmChange>()) edit.rem.append(s);
+			}
+			for(const auto& bpm : tempo.bpms) edit.add.append(bpm);
+
+			// The offset and the BPM changes are undone together.
+			gHistory->startChain();
+			gTempo->setOffset(tempo.offset);
+			gTempo->modify(edit, false);
+			gHistory->finishChain("Applied tracked beats");
+		}
+
 	CASE(CONVERT_REGION_TO_CONSTANT_BPM)
 		{
 			auto region = gSelection->getSelectedRegion();
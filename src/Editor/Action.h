@@ -154,10 +154,12 @@ namespace Action {
 	VOLUME_MUTE,
 	
 	CONVERT_MUSIC_TO_OGG,
+	RENDER_MIX_TO_WAV,
 	
 	SPEED_RESET,
 	SPEED_INCREASE,
 	SPEED_DECREASE,
+	TOGGLE_TIME_STRETCH,
 
 	TOGGLE_LOOP_SELECTION,
 	
@@ -238,6 +240,7 @@ namespace Action {
 	PLACE_BEAT_AT_PLAYHEAD,
 	WARP_GRID_TO_AUDIO,
 	AUTO_SYNC_SECTIONS,
+	TRACK_BEATS,
 	CONVERT_REGION_TO_CONSTANT_BPM,
 	VERIFY_CHART_INTEGRITY,
 	SELECT_OFF_SYNC_NOTES,
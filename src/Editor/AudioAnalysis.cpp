@@ -0,0 +1,323 @@
+#include <Editor/AudioAnalysis.h>
+
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include <Core/Utils.h>
+
+#include <System/Thread.h>
+
+#include <Editor/Common.h>
+#include <Editor/Music.h>
+
+#include <Gist.h>
+
+namespace Vortex {
+
+// Number of analysis frames that a worker thread processes at once.
+static const int FRAMES_PER_ITEM = 64;
+
+// ================================================================================================
+// STFT pass.
+
+// Computes the features of all frames at one resolution, split over several threads. Each thread
+// has its own transform, and writes to its own range of frames.
+struct StftPass : public ParallelThreads
+{
+	StftPass(AnalysisFrames& out, const short* samples, std::stop_token token)
+		: out(out), samples(samples), token(token)
+	{
+		gists.resize(concurrency());
+		buffers.resize(concurrency());
+
+		// Map every magnitude bin to its pitch class, ignoring the bins below A0.
+		chromaBins.resize(out.numBins);
+		for(int b = 0; b < out.numBins; ++b)
+		{
+			float freq = b * out.sampleRate / (float)out.frameSize;
+			if(freq < 27.5f)
+			{
+				chromaBins[b] = -1;
+				continue;
+			}
+			int note = (int)round(69.0f + 12.0f * log2(freq / 440.0f));
+			chromaBins[b] = ((note % 12) + 12) % 12;
+		}
+	}
+
+	void exec(int item, int thread) override
+	{
+		if(token.stop_requested()) return;
+
+		auto& gist = gists[thread];
+		if(!gist) gist.reset(new Gist<float>(out.frameSize, out.sampleRate));
+		std::vector<float>& buffer = buffers[thread];
+		buffer.resize(out.frameSize);
+
+		int begin = item * FRAMES_PER_ITEM;
+		int end = min(begin + FRAMES_PER_ITEM, out.numFrames);
+		for(int i = begin; i < end; ++i)
+		{
+			const short* src = samples + (size_t)i * out.hopSize;
+			for(int j = 0; j < out.frameSize; ++j)
+			{
+				buffer[j] = src[j] * (1.0f / 32768.0f);
+			}
+			gist->processAudioFrame(buffer);
+
+			const std::vector<float>& spectrum = gist->getMagnitudeSpectrum();
+			float* magnitude = out.magnitude.data() + (size_t)i * out.numBins;
+			float* chroma = out.chroma.data() + (size_t)i * AnalysisFrames::NUM_CHROMA;
+			for(int b = 0; b < out.numBins; ++b)
+			{
+				magnitude[b] = spectrum[b];
+				if(chromaBins[b] >= 0) chroma[chromaBins[b]] += spectrum[b];
+			}
+
+			const std::vector<float>& coefs = gist->getMelFrequencyCepstralCoefficients();
+			int numCoefs = min((int)coefs.size(), AnalysisFrames::NUM_MFCC);
+			std::copy(coefs.begin(), coefs.begin() + numCoefs, out.mfcc.data() + (size_t)i * AnalysisFrames::NUM_MFCC);
+		}
+	}
+
+	AnalysisFrames& out;
+	const short* samples;
+	std::stop_token token;
+	std::vector<std::unique_ptr<Gist<float>>> gists;
+	std::vector<std::vector<float>> buffers;
+	std::vector<int> chromaBins;
+};
+
+// Sets the resolution of the frames, and allocates the features of the given number of samples.
+static void InitFrames(AnalysisFrames& out, int frameSize, int hopSize, int sampleRate, int numSamples)
+{
+	out.frameSize = frameSize;
+	out.hopSize = hopSize;
+	out.sampleRate = sampleRate;
+	out.numFrames = (numSamples - frameSize) / hopSize + 1;
+	out.numBins = frameSize / 2;
+	out.magnitude.assign((size_t)out.numFrames * out.numBins, 0.0f);
+	out.chroma.assign((size_t)out.numFrames * AnalysisFrames::NUM_CHROMA, 0.0f);
+	out.mfcc.assign((size_t)out.numFrames * AnalysisFrames::NUM_MFCC, 0.0f);
+	out.flux.assign(out.numFrames, 0.0f);
+}
+
+// Analyzes the music at one resolution in the background.
+struct AnalysisJob : public BackgroundThread
+{
+	AnalysisJob(AnalysisFrames& out, const short* samples)
+		: out(out), samples(samples)
+	{
+	}
+
+	void exec() override
+	{
+		StftPass pass(out, samples, getStopToken());
+		pass.run((out.numFrames + FRAMES_PER_ITEM - 1) / FRAMES_PER_ITEM);
+
+		// The spectral flux depends on the previous frame, so it follows the parallel pass.
+		for(int i = 1; i < out.numFrames; ++i)
+		{
+			const float* prev = out.magnitudeAt(i - 1);
+			const float* cur = out.magnitudeAt(i);
+			float flux = 0.0f;
+			for(int b = 0; b < out.numBins; ++b)
+			{
+				flux += max(cur[b] - prev[b], 0.0f);
+			}
+			out.flux[i] = flux;
+		}
+	}
+
+	AnalysisFrames& out;
+	const short* samples;
+};
+
+// Analyzes the samples at one resolution with the same background job as the music, and waits for
+// it to finish. Used by the unit tests.
+void AnalyzeFrames(const short* samples, int numSamples, int sampleRate, int frameSize, int hopSize,
+	AnalysisFrames& out)
+{
+	InitFrames(out, frameSize, hopSize, sampleRate, numSamples);
+	AnalysisJob job(out, samples);
+	job.start();
+	job.waitUntilDone();
+}
+
+// ================================================================================================
+// AudioAnalysisImpl :: member data.
+
+struct AudioAnalysisImpl : public AudioAnalysis {
+
+struct Entry
+{
+	AnalysisFrames frames;
+	std::unique_ptr<AnalysisJob> job;
+};
+
+struct Subscription
+{
+	int frameSize, hopSize;
+	Callback callback;
+	bool delivered;
+};
+
+typedef std::pair<int, int> Resolution;
+
+std::map<Resolution, std::unique_ptr<Entry>> myEntries;
+std::map<int, Subscription> mySubscriptions;
+int myNextId;
+
+// ================================================================================================
+// AudioAnalysisImpl :: constructor and destructor.
+
+~AudioAnalysisImpl()
+{
+	clear();
+}
+
+AudioAnalysisImpl()
+{
+	myNextId = 1;
+}
+
+// ================================================================================================
+// AudioAnalysisImpl :: analysis.
+
+void clear() override
+{
+	for(auto& it : myEntries)
+	{
+		if(it.second->job) it.second->job->terminate();
+	}
+	myEntries.clear();
+
+	for(auto& it : mySubscriptions)
+	{
+		it.second.delivered = false;
+	}
+}
+
+// Returns the cache entry of the given resolution, and starts analyzing it if it is new. Returns
+// null if there is no music to analyze.
+Entry* getEntry(int frameSize, int hopSize)
+{
+	auto it = myEntries.find({frameSize, hopSize});
+	if(it != myEntries.end()) return it->second.get();
+
+	auto& music = gMusic->getSamples();
+	if(!music.isCompleted() || music.getNumFrames() < frameSize || hopSize <= 0) return nullptr;
+
+	auto entry = new Entry;
+	AnalysisFrames& frames = entry->frames;
+	InitFrames(frames, frameSize, hopSize, music.getFrequency(), music.getNumFrames());
+
+	// Analyses of different resolutions run at the same time, each on its own threads.
+	entry->job.reset(new AnalysisJob(frames, music.samplesL()));
+	entry->job->start();
+
+	myEntries[{frameSize, hopSize}].reset(entry);
+	return entry;
+}
+
+// Calls the callbacks of the subscriptions whose features became available. Callbacks are called
+// after the loop, so they can subscribe and unsubscribe.
+void deliver()
+{
+	std::vector<std::pair<Callback, const AnalysisFrames*>> calls;
+	for(auto& it : mySubscriptions)
+	{
+		Subscription& sub = it.second;
+		if(sub.delivered) continue;
+
+		auto entry = myEntries.find({sub.frameSize, sub.hopSize});
+		if(entry != myEntries.end() && !entry->second->job)
+		{
+			sub.delivered = true;
+			calls.push_back({sub.callback, &entry->second->frames});
+		}
+	}
+	for(auto& call : calls)
+	{
+		call.first(*call.second);
+	}
+}
+
+// ================================================================================================
+// AudioAnalysisImpl :: API.
+
+void onChanges(int changes) override
+{
+	if(changes & VCM_MUSIC_IS_LOADED)
+	{
+		for(auto& it : mySubscriptions)
+		{
+			getEntry(it.second.frameSize, it.second.hopSize);
+		}
+	}
+}
+
+void tick() override
+{
+	bool finished = false;
+	for(auto& it : myEntries)
+	{
+		auto& job = it.second->job;
+		if(job && job->isDone())
+		{
+			job.reset();
+			finished = true;
+		}
+	}
+	if(finished) deliver();
+}
+
+int subscribe(int frameSize, int hopSize, Callback callback) override
+{
+	int id = myNextId++;
+	mySubscriptions[id] = {frameSize, hopSize, callback, false};
+	getEntry(frameSize, hopSize);
+	deliver();
+	return id;
+}
+
+void unsubscribe(int id) override
+{
+	mySubscriptions.erase(id);
+}
+
+const AnalysisFrames* get(int frameSize, int hopSize) override
+{
+	Entry* entry = getEntry(frameSize, hopSize);
+	if(!entry) return nullptr;
+
+	if(entry->job)
+	{
+		entry->job->waitUntilDone();
+		entry->job.reset();
+		deliver();
+	}
+	return &entry->frames;
+}
+
+}; // AudioAnalysisImpl
+
+// ================================================================================================
+// AudioAnalysis API.
+
+AudioAnalysis* gAudioAnalysis = nullptr;
+
+void AudioAnalysis::create()
+{
+	gAudioAnalysis = new AudioAnalysisImpl;
+}
+
+void AudioAnalysis::destroy()
+{
+	delete (AudioAnalysisImpl*)gAudioAnalysis;
+	gAudioAnalysis = nullptr;
+}
+
+}; // namespace Vortex
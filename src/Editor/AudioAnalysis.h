@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace Vortex {
+
+/// Spectral features of the music, from a short-time Fourier transform with a single frame size
+/// and hop size. Frame i covers the samples [i * hopSize, i * hopSize + frameSize).
+struct AnalysisFrames
+{
+	/// Number of mel-frequency cepstral coefficients per frame.
+	static const int NUM_MFCC = 13;
+
+	/// Number of pitch classes per frame, starting at C.
+	static const int NUM_CHROMA = 12;
+
+	int frameSize;
+	int hopSize;
+	int sampleRate;
+	int numFrames;
+	int numBins;  ///< Number of magnitude bins per frame, which is frameSize / 2.
+
+	std::vector<float> magnitude;  ///< numFrames * numBins magnitudes.
+	std::vector<float> chroma;     ///< numFrames * NUM_CHROMA chroma energies.
+	std::vector<float> mfcc;       ///< numFrames * NUM_MFCC cepstral coefficients.
+	std::vector<float> flux;       ///< numFrames half-wave rectified spectral flux values.
+
+	const float* magnitudeAt(int frame) const { return magnitude.data() + (size_t)frame * numBins; }
+	const float* chromaAt(int frame) const { return chroma.data() + (size_t)frame * NUM_CHROMA; }
+	const float* mfccAt(int frame) const { return mfcc.data() + (size_t)frame * NUM_MFCC; }
+
+	/// Returns the time in seconds at the start of the given frame.
+	double frameToTime(int frame) const { return (double)frame * hopSize / sampleRate; }
+};
+
+/// Runs a single STFT per resolution over the loaded music, on background threads, and caches the
+/// derived features until the music changes. Every consumer subscribes to the resolution it needs,
+/// so consumers that share a resolution share one pass over the samples.
+struct AudioAnalysis
+{
+	typedef std::function<void(const AnalysisFrames&)> Callback;
+
+	static void create();
+	static void destroy();
+
+	/// Called by the editor when changes were made to the simfile.
+	virtual void onChanges(int changes) = 0;
+
+	/// Delivers finished analyses to their subscribers.
+	virtual void tick() = 0;
+
+	/// Stops all analyses and discards the cached features. Called before the music is unloaded.
+	virtual void clear() = 0;
+
+	/// Calls the callback on the main thread once the features of the current music at the given
+	/// resolution are available, which is during this call if they were computed before. Starts a
+	/// background analysis if needed. The callback is called again whenever the music changes,
+	/// until the subscription is cancelled. Returns a subscription id.
+	virtual int subscribe(int frameSize, int hopSize, Callback callback) = 0;
+
+	/// Cancels a subscription.
+	virtual void unsubscribe(int id) = 0;
+
+	/// Returns the features of the current music at the given resolution. If they are not cached,
+	/// this waits for the background analysis. Returns null if no music is loaded.
+	virtual const AnalysisFrames* get(int frameSize, int hopSize) = 0;
+};
+
+extern AudioAnalysis* gAudioAnalysis;
+
+}; // namespace Vortex
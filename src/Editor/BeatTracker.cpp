@@ -0,0 +1,383 @@
+#include <Editor/BeatTracker.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include <Editor/AudioAnalysis.h>
+#include <Editor/FFT.h>
+
+#include <Simfile/Tempo.h>
+
+namespace Vortex {
+
+// Width of the smoothing of the envelope before the tempo is measured, in seconds. Without it,
+// onsets that are one frame wide correlate poorly at periods that are not a whole number of frames.
+static const double TEMPO_SMOOTHING_SECONDS = 0.01;
+
+// Tempo range of the tracker, and the tempo that is preferred when the onsets are ambiguous.
+static const double MIN_BPM = 60.0;
+static const double MAX_BPM = 240.0;
+static const double PREFERRED_BPM = 120.0;
+
+// Width of the preference for the global tempo, and of the preference of the local tempo for the
+// global tempo, in octaves.
+static const double GLOBAL_TEMPO_WIDTH = 1.0;
+static const double LOCAL_TEMPO_WIDTH = 0.25;
+
+// Length of the windows in which the local tempo is measured, and the distance between them.
+static const double LOCAL_WINDOW_SECONDS = 8.0;
+static const double LOCAL_STEP_SECONDS = 1.0;
+
+// Scale of the magnitudes before log compression.
+static const float LOG_COMPRESSION = 100.0f;
+
+// Penalty for beat intervals that differ from the local tempo; higher values track more rigidly.
+static const double TIGHTNESS = 100.0;
+
+// ================================================================================================
+// Onset envelope.
+
+// Returns log(1 + x) for x >= 0, with an error of about 1e-4. The exponent and mantissa of 1 + x are
+// split with integer operations, which makes the envelope several times faster than with the library
+// logarithm.
+static inline float FastLog1p(float x)
+{
+	float y = 1.0f + x;
+	uint32_t bits;
+	memcpy(&bits, &y, sizeof(bits));
+	float exponent = (float)((int)(bits >> 23) - 127);
+	bits = (bits & 0x007FFFFF) | 0x3F800000;
+	float t;
+	memcpy(&t, &bits, sizeof(t));
+	t -= 1.0f;
+
+	// Least squares fit of log2(1 + t) for t in [0, 1).
+	float mantissa = t * (1.4385454f + t * (-0.6780715f + t * (0.3236105f + t * -0.0842732f)));
+	return (exponent + mantissa) * 0.6931472f;
+}
+
+void ComputeOnsetEnvelope(const AnalysisFrames& frames, std::vector<float>& out)
+{
+	int numBins = frames.numBins;
+	out.assign(frames.numFrames, 0.0f);
+
+	std::vector<float> prev(numBins), cur(numBins);
+	for(int i = 0; i < frames.numFrames; ++i)
+	{
+		// The logarithms are computed in a separate loop, which the compiler can vectorize.
+		const float* magnitude = frames.magnitudeAt(i);
+		for(int b = 0; b < numBins; ++b)
+		{
+			cur[b] = FastLog1p(magnitude[b] * LOG_COMPRESSION);
+		}
+		float flux = 0.0f;
+		for(int b = 0; b < numBins; ++b)
+		{
+			flux += std::max(cur[b] - prev[b], 0.0f);
+		}
+		out[i] = (i > 0) ? flux : 0.0f;
+		prev.swap(cur);
+	}
+
+	double sum = 0.0, sumSq = 0.0;
+	for(float v : out)
+	{
+		sum += v;
+		sumSq += (double)v * v;
+	}
+	double mean = sum / std::max(1, frames.numFrames);
+	double deviation = sqrt(std::max(sumSq / std::max(1, frames.numFrames) - mean * mean, 0.0));
+	if(deviation > 0.0)
+	{
+		for(float& v : out) v = (float)(v / deviation);
+	}
+}
+
+// Smooths the envelope with a gaussian with the given width in frames.
+static void SmoothEnvelope(const std::vector<float>& envelope, double sigma, std::vector<float>& out)
+{
+	int n = (int)envelope.size();
+	int radius = (int)ceil(sigma * 3.0);
+	std::vector<float> kernel(radius * 2 + 1);
+	for(int i = -radius; i <= radius; ++i)
+	{
+		kernel[i + radius] = (float)exp(-0.5 * (i / sigma) * (i / sigma));
+	}
+	out.assign(n, 0.0f);
+	for(int i = 0; i < n; ++i)
+	{
+		int begin = std::max(0, i - radius), end = std::min(n, i + radius + 1);
+		float sum = 0.0f;
+		for(int j = begin; j < end; ++j) sum += envelope[j] * kernel[j - i + radius];
+		out[i] = sum;
+	}
+}
+
+double OnsetEnvelopeTime(const AnalysisFrames& frames, double frame)
+{
+	// The spectral flux of a frame peaks when an onset enters the falling half of its window, which
+	// is half a hop after three quarters of the frame.
+	double latency = frames.frameSize * 0.75 - frames.hopSize * 0.5;
+	return (frame * frames.hopSize + latency) / frames.sampleRate;
+}
+
+// ================================================================================================
+// Tempo estimation.
+
+// Weight of a beat period for a preferred period, a log-gaussian with the given width in octaves.
+static double TempoWeight(double period, double preferred, double width)
+{
+	double octaves = log2(period / preferred) / width;
+	return exp(-0.5 * octaves * octaves);
+}
+
+// Returns the position of the peak of a parabola through the value at i and its neighbours.
+static double RefinePeak(const float* v, int i, int n)
+{
+	if(i <= 0 || i >= n - 1) return (double)i;
+	double curvature = v[i - 1] - 2.0 * v[i] + v[i + 1];
+	if(curvature >= 0.0) return (double)i;
+	return i + 0.5 * (v[i - 1] - v[i + 1]) / curvature;
+}
+
+// Returns the beat period of the whole song in frames, from the autocorrelation of the envelope.
+static double EstimateGlobalPeriod(const std::vector<float>& envelope, double framesPerSecond)
+{
+	int n = (int)envelope.size();
+	int minLag = std::max(1, (int)(framesPerSecond * 60.0 / MAX_BPM));
+	int maxLag = std::min(n - 2, (int)ceil(framesPerSecond * 60.0 / MIN_BPM));
+	if(maxLag <= minLag) return framesPerSecond * 60.0 / PREFERRED_BPM;
+
+	// The autocorrelation is the inverse transform of the power spectrum of the zero-padded envelope.
+	int fftSize = 2;
+	while(fftSize < n * 2) fftSize *= 2;
+	std::vector<float> padded(fftSize, 0.0f), spectrum(fftSize + 2);
+	std::copy(envelope.begin(), envelope.end(), padded.begin());
+	RealFFT fft(fftSize);
+	fft.forward(padded.data(), spectrum.data());
+	for(int i = 0; i < fftSize + 2; i += 2)
+	{
+		spectrum[i] = spectrum[i] * spectrum[i] + spectrum[i + 1] * spectrum[i + 1];
+		spectrum[i + 1] = 0.0f;
+	}
+	fft.inverse(spectrum.data(), padded.data());
+
+	double preferred = framesPerSecond * 60.0 / PREFERRED_BPM;
+	std::vector<float> weighted(maxLag + 1, 0.0f);
+	int best = minLag;
+	for(int lag = minLag; lag <= maxLag; ++lag)
+	{
+		weighted[lag] = (float)(padded[lag] * TempoWeight(lag, preferred, GLOBAL_TEMPO_WIDTH));
+		if(weighted[lag] > weighted[best]) best = lag;
+	}
+	return RefinePeak(weighted.data(), best, maxLag + 1);
+}
+
+// Returns the beat period in frames for every frame. The period is measured in overlapping windows
+// near the global period, which keeps it on the same metrical level, and interpolated in between.
+static void EstimateLocalPeriods(const std::vector<float>& envelope, double framesPerSecond,
+	double globalPeriod, std::vector<float>& out)
+{
+	int n = (int)envelope.size();
+	int window = (int)(LOCAL_WINDOW_SECONDS * framesPerSecond);
+	int step = std::max(1, (int)(LOCAL_STEP_SECONDS * framesPerSecond));
+	int minLag = std::max(1, (int)(globalPeriod / sqrt(2.0)));
+	int maxLag = (int)ceil(globalPeriod * sqrt(2.0));
+
+	std::vector<double> centers, periods;
+	std::vector<float> correlation(maxLag + 1);
+	for(int center = 0; center < n + step; center += step)
+	{
+		int begin = std::max(0, center - window / 2);
+		int end = std::min(n, center + window / 2) - maxLag;
+		if(end - begin < maxLag * 2) continue;
+
+		int best = minLag;
+		for(int lag = minLag; lag <= maxLag; ++lag)
+		{
+			const float* a = envelope.data() + begin;
+			const float* b = a + lag;
+			float sum = 0.0f;
+			for(int i = 0, count = end - begin; i < count; ++i) sum += a[i] * b[i];
+			correlation[lag] = sum * (float)TempoWeight(lag, globalPeriod, LOCAL_TEMPO_WIDTH);
+			if(correlation[lag] > correlation[best]) best = lag;
+		}
+		centers.push_back(std::min(center, n - 1));
+		periods.push_back(RefinePeak(correlation.data() + minLag, best - minLag, maxLag - minLag + 1) + minLag);
+	}
+
+	// A median over five windows removes single windows that lock onto fills or breaks.
+	std::vector<double> smoothed(periods.size());
+	for(int i = 0; i < (int)periods.size(); ++i)
+	{
+		int begin = std::max(0, i - 2), end = std::min((int)periods.size(), i + 3);
+		double values[5];
+		std::copy(periods.begin() + begin, periods.begin() + end, values);
+		std::nth_element(values, values + (end - begin) / 2, values + (end - begin));
+		smoothed[i] = values[(end - begin) / 2];
+	}
+
+	out.assign(n, (float)globalPeriod);
+	for(int i = 0, w = 0; i < n && !smoothed.empty(); ++i)
+	{
+		while(w + 1 < (int)centers.size() && centers[w + 1] <= i) ++w;
+		if(i <= centers[w] || w + 1 == (int)centers.size())
+		{
+			out[i] = (float)smoothed[w];
+		}
+		else
+		{
+			double t = (i - centers[w]) / (centers[w + 1] - centers[w]);
+			out[i] = (float)(smoothed[w] * (1.0 - t) + smoothed[w + 1] * t);
+		}
+	}
+}
+
+// ================================================================================================
+// Beat tracking.
+
+void TrackBeats(const AnalysisFrames& frames, std::vector<double>& out)
+{
+	out.clear();
+	int n = frames.numFrames;
+	if(n < 4) return;
+
+	double framesPerSecond = (double)frames.sampleRate / frames.hopSize;
+	std::vector<float> envelope, smoothed, local, periods;
+	ComputeOnsetEnvelope(frames, envelope);
+	SmoothEnvelope(envelope, TEMPO_SMOOTHING_SECONDS * framesPerSecond, smoothed);
+	double globalPeriod = EstimateGlobalPeriod(smoothed, framesPerSecond);
+	EstimateLocalPeriods(smoothed, framesPerSecond, globalPeriod, periods);
+
+	// The local score is smoothed over 1/32 of a beat, which gives the beats some room to land next
+	// to the onset peaks.
+	SmoothEnvelope(envelope, std::max(globalPeriod / 32.0, 0.5), local);
+
+	// Every frame gets the best score of a beat sequence that ends on it: its own onset strength,
+	// plus the score of the best previous beat, minus a penalty for deviating from the local tempo.
+	// Previous beats are searched between half a period and two periods back, so the whole pass
+	// takes time linear in the length of the song.
+	std::vector<float> score(n);
+	std::vector<int> previous(n, -1);
+	for(int t = 0; t < n; ++t)
+	{
+		double period = periods[t];
+		int begin = std::max(0, t - (int)round(period * 2.0));
+		int end = t - (int)round(period * 0.5);
+		float best = 0.0f;
+		for(int p = begin; p <= end; ++p)
+		{
+			double deviation = log((t - p) / period);
+			float candidate = score[p] - (float)(TIGHTNESS * deviation * deviation);
+			if(previous[t] < 0 || candidate > best)
+			{
+				best = candidate;
+				previous[t] = p;
+			}
+		}
+		score[t] = local[t] + best;
+	}
+
+	// The last beat is the last peak of the score that is at least half the median peak, so the
+	// sequence does not end on a weak beat in the fade-out.
+	std::vector<float> peaks;
+	for(int t = 1; t < n - 1; ++t)
+	{
+		if(score[t] > score[t - 1] && score[t] >= score[t + 1]) peaks.push_back(score[t]);
+	}
+	if(peaks.empty()) return;
+	std::nth_element(peaks.begin(), peaks.begin() + peaks.size() / 2, peaks.end());
+	float threshold = peaks[peaks.size() / 2] * 0.5f;
+	int last = n - 2;
+	while(last > 0 && !(score[last] > score[last - 1] && score[last] >= score[last + 1] && score[last] >= threshold))
+	{
+		--last;
+	}
+
+	std::vector<int> beats;
+	for(int t = last; t >= 0; t = previous[t]) beats.push_back(t);
+	std::reverse(beats.begin(), beats.end());
+
+	// Leading and trailing beats without onsets are extrapolated through silence, so they are cut.
+	double sumSq = 0.0;
+	for(float v : local) sumSq += (double)v * v;
+	float silence = (float)(sqrt(sumSq / n) * 0.5);
+	int first = 0, end = (int)beats.size();
+	while(first < end && local[beats[first]] < silence) ++first;
+	while(end > first && local[beats[end - 1]] < silence) --end;
+
+	for(int i = first; i < end; ++i)
+	{
+		out.push_back(OnsetEnvelopeTime(frames, RefinePeak(local.data(), beats[i], n)));
+	}
+}
+
+// ================================================================================================
+// Tempo fitting.
+
+// Rounds a BPM value to the precision of the tempo editor.
+static double RoundBpm(double bpm)
+{
+	return round(bpm * 1000.0) / 1000.0;
+}
+
+// Returns true if all beats in [first, last] are within the tolerance of a grid with the given BPM
+// that starts at the given time.
+static bool FitsBeats(const std::vector<double>& beats, int first, int last, double start, double bpm,
+	double tolerance)
+{
+	double secondsPerBeat = 60.0 / bpm;
+	for(int i = first + 1; i <= last; ++i)
+	{
+		if(fabs(start + (i - first) * secondsPerBeat - beats[i]) > tolerance) return false;
+	}
+	return true;
+}
+
+void FitTempoToBeats(const std::vector<double>& beats, double tolerance, TrackedTempo& out)
+{
+	out.offset = 0.0;
+	out.bpms.clear();
+	int n = (int)beats.size();
+	if(n < 2) return;
+
+	// Each BPM change is extended over as many beats as it fits. The next one starts where the grid
+	// of the previous one ends, rather than at the tracked beat, so rounding errors do not add up.
+	std::vector<int> firstBeats;
+	std::vector<double> bpms;
+	double start = beats[0];
+	for(int first = 0; first < n - 1;)
+	{
+		int last = first + 1;
+		double bpm = RoundBpm(60.0 / std::max(beats[last] - start, 1e-3));
+		for(int end = last + 1; end < n; ++end)
+		{
+			double candidate = RoundBpm(60.0 * (end - first) / (beats[end] - start));
+			if(!FitsBeats(beats, first, end, start, candidate, tolerance)) break;
+			last = end;
+			bpm = candidate;
+		}
+		if(bpms.empty() || bpms.back() != bpm)
+		{
+			firstBeats.push_back(first);
+			bpms.push_back(bpm);
+		}
+		start += (last - first) * 60.0 / bpm;
+		first = last;
+	}
+
+	// The first BPM is extended back to the start of the music, and the offset puts a whole number
+	// of beats before the first tracked beat.
+	double secondsPerBeat = 60.0 / bpms[0];
+	int beatsBefore = (int)floor(beats[0] / secondsPerBeat);
+	out.offset = -(beats[0] - beatsBefore * secondsPerBeat);
+	for(int i = 0; i < (int)bpms.size(); ++i)
+	{
+		int row = (i == 0) ? 0 : (beatsBefore + firstBeats[i]) * ROWS_PER_BEAT;
+		out.bpms.push_back(BpmChange(row, bpms[i]));
+	}
+}
+
+}; // namespace Vortex
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Simfile/Segments.h>
+
+#include <vector>
+
+namespace Vortex {
+
+struct AnalysisFrames;
+
+/// Analysis resolution used for beat tracking; the short hops give beats a resolution of about
+/// six milliseconds.
+static const int BEAT_FRAME_SIZE = 512;
+static const int BEAT_HOP_SIZE = 256;
+
+/// Largest distance in seconds between a tracked beat and the beat of the fitted tempo.
+static const double BEAT_TOLERANCE = 0.010;
+
+/// Tempo that puts a beat on every tracked beat.
+struct TrackedTempo
+{
+	double offset;                ///< Music offset, in the format of TempoMan::setOffset.
+	std::vector<BpmChange> bpms;  ///< BPM changes in row order, starting at row zero.
+};
+
+/// Computes the onset strength of every analysis frame: the log-compressed spectral flux,
+/// normalized to unit standard deviation.
+void ComputeOnsetEnvelope(const AnalysisFrames& frames, std::vector<float>& out);
+
+/// Returns the time in seconds of an onset that peaks in the onset envelope at the given frame,
+/// which can be fractional.
+double OnsetEnvelopeTime(const AnalysisFrames& frames, double frame);
+
+/// Finds the beat times of the analyzed music, in seconds. The tracker follows the local tempo
+/// with dynamic programming over an onset envelope, in a single pass over the song, so it also
+/// follows recordings that drift.
+void TrackBeats(const AnalysisFrames& frames, std::vector<double>& out);
+
+/// Fits BPM changes to the given beat times. Consecutive beats share a BPM change as long as a
+/// constant BPM keeps all of them within the tolerance, so steady music gets few BPM changes.
+/// Leaves the BPM changes empty if there are fewer than two beats.
+void FitTempoToBeats(const std::vector<double>& beats, double tolerance, TrackedTempo& out);
+
+}; // namespace Vortex
@@ -8,6 +8,7 @@
 
 #include <System/Debug.h>
 #include <System/System.h>
+#include <System/TaskScheduler.h>
 
 #include <Editor/TextOverlay.h>
 
@@ -184,28 +185,55 @@ RowType ToRowType(int rowIndex)
 	if(len < 0 || len > 511) len = 511; \
 	buffer[len] = 0; va_end(args); \
 
+HudMute::HudMute()
+	: myPrevious((HudMute*)TaskScheduler::getScope(TaskScope::HudMute))
+{
+	TaskScheduler::setScope(TaskScope::HudMute, this);
+}
+
+HudMute::~HudMute()
+{
+	TaskScheduler::setScope(TaskScope::HudMute, myPrevious);
+}
+
+// Messages from background tasks are shown once the main thread gets to them.
+static void AddMessage(const char* text, TextOverlay::MessageType type)
+{
+	if(TaskScheduler::getScope(TaskScope::HudMute)) return;
+
+	if(TaskScheduler::isWorkerThread())
+	{
+		std::string message(text);
+		TaskScheduler::postToMainThread([message, type]() { AddMessage(message.c_str(), type); });
+	}
+	else if(gTextOverlay)
+	{
+		gTextOverlay->addMessage(text, type);
+	}
+}
+
 void HudNote(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::NOTE);
+	AddMessage(buffer, TextOverlay::NOTE);
 }
 
 void HudInfo(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::INFO);
+	AddMessage(buffer, TextOverlay::INFO);
 }
 
 void HudWarning(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::WARNING);
+	AddMessage(buffer, TextOverlay::WARNING);
 }
 
 void HudError(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::ERROR);
+	AddMessage(buffer, TextOverlay::ERROR);
 }
 
 }; // namespace Vortex
@@ -57,7 +57,7 @@ struct OggConversionPipe : public System::CommandPipe
 {
 	int read()
 	{
-		if(*terminateFlag)
+		if(token.stop_requested())
 		{
 			return 0;
 		}
@@ -81,7 +81,7 @@ struct OggConversionPipe : public System::CommandPipe
 	int totalFrames, framesLeft;
 	const short* srcL, *srcR;
 	short samples[4096 * 2];
-	uint8_t* terminateFlag;
+	std::stop_token token;
 };
 
 }; // Anonymous namepspace.
@@ -102,7 +102,7 @@ void OggConversionThread::exec()
 	pipe->srcR = music.samplesR();
 	pipe->firstChunk = true;
 	pipe->progress = &progress;
-	pipe->terminateFlag = &terminationFlag_;
+	pipe->token = getStopToken();
 	WriteWaveHeader((WaveHeader*)(pipe->samples), music.getNumFrames(), music.getFrequency());
 
 	// Encode the PCM file with the oggenc2 command line utility.
@@ -60,6 +60,12 @@ static Note PlacingNoteToNote(const PlacingNote& pnote, int col)
 	return out;
 }
 
+// The note that is placed in the given column by dragging from the start row to the end row.
+Note PlacedNote(int col, int player, int startRow, int endRow)
+{
+	return PlacingNoteToNote({player, startRow, endRow, PLACE_NEW}, col);
+}
+
 int noteKeysHeld = 0;
 
 // ================================================================================================
@@ -13,8 +13,10 @@
 #include <System/System.h>
 #include <System/File.h>
 #include <System/Debug.h>
+#include <System/TaskScheduler.h>
 
 #include <Editor/Music.h>
+#include <Editor/AudioAnalysis.h>
 #include <Editor/Menubar.h>
 #include <Editor/Action.h>
 #include <Editor/Shortcuts.h>
@@ -220,6 +222,7 @@ void init()
 	// Create the editor components.
 	Shortcuts::create();
 	Music::create(settings);
+	AudioAnalysis::create();
 	Selection::create();
 	Editing::create(settings);
 	View::create(settings);
@@ -272,6 +275,7 @@ void shutdown()
 	Notefield::destroy();
 	View::destroy();
 	Selection::destroy();
+	AudioAnalysis::destroy();
 	Music::destroy();
 	History::destroy();
 	Menubar::destroy();
@@ -824,12 +828,14 @@ void notifyChanges()
 	gSimfile->onChanges(myChanges);
 	gView->onChanges(myChanges);
 	gMusic->onChanges(myChanges);
+	gAudioAnalysis->onChanges(myChanges);
 	gMinimap->onChanges(myChanges);
 	gEditing->onChanges(myChanges);
 	gNotefield->onChanges(myChanges);
 	gTempoBoxes->onChanges(myChanges);
 	gWaveform->onChanges(myChanges);
 
+	gNotes->clearChangedRows();
 	myChanges = 0;
 }
 
@@ -944,9 +950,12 @@ void tick()
 
 	gSelection->handleInputs(events);
 
+	TaskScheduler::runMainThreadTasks();
+
 	if(gSimfile->isOpen())
 	{
 		gMusic->tick();
+		gAudioAnalysis->tick();
 		gMinimap->tick();
 		gTempoBoxes->tick();
 		gWaveform->tick();
@@ -0,0 +1,116 @@
+#include <Editor/FindOffset.h>
+
+#include <math.h>
+#include <algorithm>
+
+#include <Editor/AudioAnalysis.h>
+#include <Editor/BeatTracker.h>
+#include <Editor/FFT.h>
+
+namespace Vortex {
+
+// Width of the note impulses in frames. The impulses are gaussians rather than single frames, which
+// keeps the fractional position of every note and makes the correlation peak smooth enough to be
+// interpolated.
+static const double IMPULSE_WIDTH = 2.0;
+
+// Smallest distance in frames between the best shift and the runner-up that sets the confidence.
+static const int RUNNER_UP_DISTANCE = 3;
+
+// Adds a gaussian impulse centered on the given fractional frame.
+static void AddImpulse(std::vector<float>& train, int numFrames, double center)
+{
+	int radius = (int)ceil(IMPULSE_WIDTH * 3.0);
+	int begin = std::max(0, (int)floor(center) - radius);
+	int end = std::min(numFrames - 1, (int)ceil(center) + radius);
+	for(int i = begin; i <= end; ++i)
+	{
+		double x = (i - center) / IMPULSE_WIDTH;
+		train[i] += (float)exp(-0.5 * x * x);
+	}
+}
+
+// Returns the position of the peak of a parabola through the value at i and its neighbours.
+static double RefinePeak(const std::vector<double>& v, int i)
+{
+	if(i <= 0 || i >= (int)v.size() - 1) return (double)i;
+	double curvature = v[i - 1] - 2.0 * v[i] + v[i + 1];
+	if(curvature >= 0.0) return (double)i;
+	return i + 0.5 * (v[i - 1] - v[i + 1]) / curvature;
+}
+
+void FindOffset(const AnalysisFrames& frames, const std::vector<double>& noteTimes, double range,
+	OffsetResult& out)
+{
+	out.shift = 0.0;
+	out.confidence = 0.0;
+	int n = frames.numFrames;
+	if(n < 2 || noteTimes.empty()) return;
+
+	double framesPerSecond = (double)frames.sampleRate / frames.hopSize;
+	int maxLag = std::max(1, (int)ceil(range * framesPerSecond));
+
+	// Both signals are zero-padded by the largest lag, so the correlation does not wrap around.
+	int fftSize = 2;
+	while(fftSize < n + maxLag) fftSize *= 2;
+	std::vector<float> envelope, train(fftSize, 0.0f);
+	ComputeOnsetEnvelope(frames, envelope);
+	envelope.resize(fftSize, 0.0f);
+
+	// Notes are placed on the frame at which their onset would peak in the envelope.
+	double firstTime = OnsetEnvelopeTime(frames, 0.0);
+	int numNotes = 0;
+	for(double time : noteTimes)
+	{
+		double frame = (time - firstTime) * framesPerSecond;
+		if(frame < 0.0 || frame > n - 1) continue;
+		AddImpulse(train, n, frame);
+		++numNotes;
+	}
+	if(numNotes == 0) return;
+
+	// The cross-correlation is the inverse transform of the envelope spectrum times the conjugate
+	// of the note spectrum. Lag k is at index k, and negative lags wrap around to the end.
+	std::vector<float> envelopeSpectrum(fftSize + 2), trainSpectrum(fftSize + 2);
+	RealFFT fft(fftSize);
+	fft.forward(envelope.data(), envelopeSpectrum.data());
+	fft.forward(train.data(), trainSpectrum.data());
+	for(int i = 0; i < fftSize + 2; i += 2)
+	{
+		float er = envelopeSpectrum[i], ei = envelopeSpectrum[i + 1];
+		float tr = trainSpectrum[i], ti = trainSpectrum[i + 1];
+		envelopeSpectrum[i] = er * tr + ei * ti;
+		envelopeSpectrum[i + 1] = ei * tr - er * ti;
+	}
+	fft.inverse(envelopeSpectrum.data(), envelope.data());
+
+	std::vector<double> correlation(maxLag * 2 + 1);
+	for(int lag = -maxLag; lag <= maxLag; ++lag)
+	{
+		correlation[lag + maxLag] = envelope[(lag + fftSize) % fftSize];
+	}
+
+	int best = 0;
+	for(int i = 1; i < (int)correlation.size(); ++i)
+	{
+		if(correlation[i] > correlation[best]) best = i;
+	}
+	if(correlation[best] <= 0.0) return;
+
+	// The confidence compares the best shift to the best other local maximum, which is often a
+	// neighbouring beat or subdivision.
+	double runnerUp = 0.0;
+	for(int i = 1; i < (int)correlation.size() - 1; ++i)
+	{
+		if(abs(i - best) < RUNNER_UP_DISTANCE) continue;
+		if(correlation[i] > correlation[i - 1] && correlation[i] >= correlation[i + 1])
+		{
+			runnerUp = std::max(runnerUp, correlation[i]);
+		}
+	}
+
+	out.shift = (RefinePeak(correlation, best) - maxLag) / framesPerSecond;
+	out.confidence = std::clamp(1.0 - runnerUp / correlation[best], 0.0, 1.0);
+}
+
+}; // namespace Vortex
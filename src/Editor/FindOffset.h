@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+namespace Vortex {
+
+struct AnalysisFrames;
+
+/// Largest distance in seconds over which the notes are shifted by the offset finder.
+static const double OFFSET_SEARCH_RANGE = 0.25;
+
+struct OffsetResult
+{
+	double shift;       ///< Seconds by which the notes have to move later to line up with the music.
+	double confidence;  ///< Between zero and one; low if another shift lines up almost as well.
+};
+
+/// Finds the shift of the note times that lines them up best with the onsets in the analyzed music,
+/// within the given range. The note times are turned into a train of impulses, which is
+/// cross-correlated with the onset envelope through a single FFT, so a whole song takes a fraction of
+/// a second once the music is analyzed.
+void FindOffset(const AnalysisFrames& frames, const std::vector<double>& noteTimes, double range,
+	OffsetResult& out);
+
+}; // namespace Vortex
@@ -8,6 +8,7 @@
 
 #include <Editor/FindTempo.h>
 #include <Editor/FindOnsets.h>
+#include <Editor/FFT.h>
 #include <Editor/Music.h>
 
 #include <algorithm>
@@ -15,7 +16,7 @@
 #include <atomic>
 #include <vector>
 
-#define MarkProgress(number, text) { if(*data->terminate) {return;} data->progress = number; }
+#define MarkProgress(number, text) { if(data->token.stop_requested()) {return;} data->progress = number; }
 
 typedef double real;
 
@@ -27,6 +28,9 @@ static const real MaximumBPM = 205.0;
 static const int IntervalDelta = 10;
 static const int IntervalDownsample = 3;
 static const int MaxThreads = 8;
+static const int EnvelopeDownsample = 4;
+static const int EnvelopeWindow = 1024;
+static const int CombThreadIntervals = 256;
 
 // ================================================================================================
 // Helper structs.
@@ -41,11 +45,12 @@ struct TempoSort {
 
 struct SerializedTempo
 {
-	float* samples;
+	const float* samples;
 	int samplerate;
 	int numFrames;
 	int numThreads;
-	uchar* terminate;
+	TempoDetector::Mode mode;
+	std::stop_token token;
 	std::atomic_int progress;
 	TempoResults result;
 };
@@ -349,8 +354,8 @@ static void RemoveDuplicates(TempoResults& tempo)
 	}
 }
 
-// Rounds BPM values that are close to integer values.
-static void RoundBPMValues(IntervalTester& test, GapData& gapdata, TempoResults& tempo)
+// Rounds BPM values that are close to integer values, if the rounded value is about as fit.
+static void RoundBPMValues(TempoResults& tempo, const std::function<real(real)>& confidence)
 {
 	for(auto& t : tempo)
 	{
@@ -362,8 +367,8 @@ static void RoundBPMValues(IntervalTester& test, GapData& gapdata, TempoResults&
 		}
 		else if(diff < 0.05)
 		{
-			real old = GetConfidenceForBPM(gapdata, 0, test, t.bpm);
-			real cur = GetConfidenceForBPM(gapdata, 0, test, roundBPM);
+			real old = confidence(t.bpm);
+			real cur = confidence(roundBPM);
 			if(cur > old * 0.99) t.bpm = roundBPM;
 		}
 	}
@@ -419,7 +424,7 @@ static void CalculateBPM(SerializedTempo* data, Onset* onsets, int numOnsets)
 	// Round BPM values to integers when possible, and remove weaker duplicates.
 	std::stable_sort(tempo.begin(), tempo.end(), TempoSort());
 	RemoveDuplicates(tempo);
-	RoundBPMValues(test, *gapdata, tempo);
+	RoundBPMValues(tempo, [&](real bpm) { return GetConfidenceForBPM(*gapdata, 0, test, bpm); });
 
 	// If the fitness of the first and second option is very close, we ask for a second opinion.
 	if(tempo.size() >= 2 && tempo[0].fitness / tempo[1].fitness < 1.05)
@@ -437,6 +442,187 @@ static void CalculateBPM(SerializedTempo* data, Onset* onsets, int numOnsets)
 	delete gapdata;
 }
 
+// ================================================================================================
+// Autocorrelation testing
+
+struct CombTester
+{
+	CombTester(int samplerate, int numFrames, int numOnsets, const Onset* onsets);
+
+	int minInterval;
+	int maxInterval;
+	int numIntervals;
+	int samplerate;
+	std::vector<float> autocorr;
+	std::vector<real> fitness;
+	real coefs[4];
+};
+
+// Computes the autocorrelation of an envelope that has a Hann shaped pulse for every onset.
+CombTester::CombTester(int samplerate, int numFrames, int numOnsets, const Onset* onsets)
+	: samplerate(samplerate)
+{
+	minInterval = (int)(samplerate * 60.0 / MaximumBPM + 0.5);
+	maxInterval = (int)(samplerate * 60.0 / MinimumBPM + 0.5);
+	numIntervals = maxInterval - minInterval;
+	fitness.resize(numIntervals);
+
+	// The envelope has one sample per 2^EnvelopeDownsample frames, and is zero padded to twice its
+	// length so the lags of the circular autocorrelation do not wrap around.
+	int envelopeSize = (numFrames >> EnvelopeDownsample) + 1;
+	int fftSize = 2;
+	while(fftSize < envelopeSize * 2) fftSize *= 2;
+
+	std::vector<float> envelope(fftSize, 0.0f);
+	real halfWidth = (real)(EnvelopeWindow >> EnvelopeDownsample) * 0.5;
+	for(int i = 0; i < numOnsets; ++i)
+	{
+		real center = (real)onsets[i].pos / (real)(1 << EnvelopeDownsample);
+		int begin = std::max(0, (int)(center - halfWidth) + 1);
+		int end = std::min(envelopeSize, (int)(center + halfWidth) + 1);
+		for(int j = begin; j < end; ++j)
+		{
+			real x = ((real)j - center) / halfWidth;
+			envelope[j] += (float)(onsets[i].strength * (0.5 + 0.5 * cos(x * 3.14159265358979323846)));
+		}
+	}
+
+	// The autocorrelation is the inverse transform of the power spectrum. A large one-off plan is
+	// made locally, rather than kept alive in the shared plans.
+	RealFFT fft(fftSize);
+	std::vector<float> spectrum(fftSize + 2);
+	fft.forward(envelope.data(), spectrum.data());
+	float scale = 1.0f / (float)fftSize;
+	for(int i = 0; i < fftSize + 2; i += 2)
+	{
+		float re = spectrum[i], im = spectrum[i + 1];
+		spectrum[i] = (re * re + im * im) * scale;
+		spectrum[i + 1] = 0.0f;
+	}
+	fft.inverse(spectrum.data(), envelope.data());
+	autocorr.assign(envelope.begin(), envelope.begin() + envelopeSize);
+}
+
+// Returns the linearly interpolated autocorrelation for a lag in frames.
+static real AutocorrelationAt(const CombTester& test, real lag)
+{
+	real pos = lag / (real)(1 << EnvelopeDownsample);
+	int index = (int)pos;
+	if(index + 1 >= (int)test.autocorr.size()) return 0.0;
+	real t = pos - (real)index;
+	return test.autocorr[index] * (1.0 - t) + test.autocorr[index + 1] * t;
+}
+
+// Returns the sum of the autocorrelation at every multiple of the interval. Like the offbeats of
+// the interval search, the lags halfway between the multiples count for half.
+static real GetCombFitness(const CombTester& test, real interval)
+{
+	real maxLag = (real)((test.autocorr.size() - 1) << EnvelopeDownsample);
+	real beats = 0.0, offbeats = 0.0;
+	for(real lag = interval; lag < maxLag; lag += interval)
+	{
+		beats += AutocorrelationAt(test, lag);
+		offbeats += AutocorrelationAt(test, lag - interval * 0.5);
+	}
+	return beats + offbeats * 0.5;
+}
+
+static void FillCombIntervals(CombTester& test, int numThreads)
+{
+	struct CombThreads : public ParallelThreads
+	{
+		CombTester* test;
+		void exec(int item, int thread)
+		{
+			int begin = item * CombThreadIntervals;
+			int end = std::min(begin + CombThreadIntervals, test->numIntervals);
+			for(int i = begin; i < end; ++i)
+			{
+				test->fitness[i] = GetCombFitness(*test, (real)(test->minInterval + i));
+			}
+		}
+	};
+	CombThreads threads;
+	threads.test = &test;
+	int numItems = (test.numIntervals + CombThreadIntervals - 1) / CombThreadIntervals;
+	if(numThreads > 1)
+	{
+		threads.run(numItems, numThreads);
+	}
+	else
+	{
+		for(int i = 0; i < numItems; ++i) threads.exec(i, 0);
+	}
+}
+
+// Finds likely BPM candidates by combing the autocorrelation of the onsets, which scores every
+// interval in a single pass instead of wrapping the onsets around each of them.
+static void CalculateBPMFromAutocorrelation(SerializedTempo* data, Onset* onsets, int numOnsets)
+{
+	auto& tempo = data->result;
+
+	// In order to determine the BPM, we need at least two onsets.
+	if(numOnsets < 2)
+	{
+		tempo.push_back({SIM_DEFAULT_BPM, 0.0, 1.0});
+		return;
+	}
+
+	CombTester test(data->samplerate, data->numFrames, numOnsets, onsets);
+	MarkProgress(2, "Autocorrelation");
+
+	FillCombIntervals(test, data->numThreads);
+
+	// Normalize the fitness values with a polynomial approximation of the fitness curve, fitted to
+	// every 10th interval like the coarse intervals of the interval search.
+	std::vector<real> coarse(test.numIntervals, 0.0);
+	int numCoarseIntervals = 0;
+	for(int i = 0; i < test.numIntervals; i += IntervalDelta, ++numCoarseIntervals)
+	{
+		coarse[i] = std::max(0.001, test.fitness[i]);
+	}
+	mathalgo::polyfit(3, test.coefs, coarse.data(), numCoarseIntervals, test.minInterval);
+	real maxFitness = 0.001;
+	for(int i = 0; i < test.numIntervals; ++i)
+	{
+		NormalizeFitness(test.fitness[i], test.coefs, (real)(test.minInterval + i));
+		maxFitness = std::max(maxFitness, test.fitness[i]);
+	}
+
+	// Every interval that is the best of its neighbourhood and above the threshold is a candidate.
+	// The peak is refined to a fraction of a frame with a parabola through its neighbours.
+	real fitnessThreshold = maxFitness * 0.4;
+	const real* fit = test.fitness.data();
+	for(int i = 1; i < test.numIntervals - 1; ++i)
+	{
+		if(fit[i] <= fitnessThreshold) continue;
+
+		int begin = std::max(0, i - IntervalDelta);
+		int end = std::min(test.numIntervals, i + IntervalDelta + 1);
+		if(FindBestInterval(fit, begin, end) != i) continue;
+
+		real curvature = fit[i - 1] - 2.0 * fit[i] + fit[i + 1];
+		real shift = (curvature < 0.0) ? 0.5 * (fit[i - 1] - fit[i + 1]) / curvature : 0.0;
+		real interval = test.minInterval + i + shift;
+		tempo.push_back({data->samplerate * 60.0 / interval, 0.0, fit[i]});
+	}
+	MarkProgress(3, "Comb intervals");
+
+	// Round BPM values to integers when possible, and remove weaker duplicates.
+	std::stable_sort(tempo.begin(), tempo.end(), TempoSort());
+	RemoveDuplicates(tempo);
+	RoundBPMValues(tempo, [&](real bpm)
+	{
+		real interval = data->samplerate * 60.0 / bpm;
+		real fitness = GetCombFitness(test, interval);
+		NormalizeFitness(fitness, test.coefs, interval);
+		return fitness;
+	});
+	std::stable_sort(tempo.begin(), tempo.end(), TempoSort());
+
+	if(tempo.size() > 3) tempo.resize(3);
+}
+
 // ================================================================================================
 // Offset testing
 
@@ -576,10 +762,47 @@ static const char* sProgressText[]
 	"BPM detection results"
 };
 
+// Finds the onsets, BPM candidates and offsets of the samples in data.
+static void DetectTempo(SerializedTempo* data)
+{
+	// Run the aubio onset tracker to find note onsets.
+	std::vector<Onset> onsets;
+	FindOnsets(data->samples, data->samplerate, data->numFrames, data->numThreads, onsets);
+	MarkProgress(1, "Find onsets");
+
+	for(int i = 0; i < std::min(onsets.size(), size_t(100)); ++i)
+	{
+		int a = std::max(0, onsets[i].pos - 100);
+		int b = std::min(data->numFrames, onsets[i].pos + 100);
+		float v = 0.0f;
+		for(int j = a; j < b; ++j)
+		{
+			v += abs(data->samples[j]);
+		}
+		v /= (float)std::max(1, b - a);
+		onsets[i].strength = v;
+	}
+
+	// Find BPM values.
+	if(data->mode == TempoDetector::MODE_AUTOCORRELATION)
+	{
+		CalculateBPMFromAutocorrelation(data, onsets.data(), onsets.size());
+	}
+	else
+	{
+		CalculateBPM(data, onsets.data(), onsets.size());
+	}
+	MarkProgress(4, "Find BPM");
+
+	// Find offset values.
+	CalculateOffset(data, onsets.data(), onsets.size());
+	MarkProgress(5, "Find offsets");
+}
+
 class TempoDetectorImp : public TempoDetector, public BackgroundThread
 {
 public:
-	TempoDetectorImp(int firstFrame, int numFrames);
+	TempoDetectorImp(int firstFrame, int numFrames, Mode mode);
 	~TempoDetectorImp();
 
 	void exec();
@@ -593,26 +816,27 @@ private:
 	SerializedTempo data_;
 };
 
-TempoDetectorImp::TempoDetectorImp(int firstFrame, int numFrames)
+TempoDetectorImp::TempoDetectorImp(int firstFrame, int numFrames, Mode mode)
 {
 	auto& music = gMusic->getSamples();
 
-	data_.terminate = &terminationFlag_;
 	data_.progress = 0;
 	
 	data_.numThreads = ParallelThreads::concurrency();
+	data_.mode = mode;
 	data_.numFrames = numFrames;
 	data_.samplerate = music.getFrequency();
 
-	data_.samples = AlignedMalloc<float>(numFrames);
-	if(!data_.samples) return;
+	float* samples = AlignedMalloc<float>(numFrames);
+	data_.samples = samples;
+	if(!samples) return;
 
 	// Copy the input samples.
 	const short* l = music.samplesL() + firstFrame;
 	const short* r = music.samplesR() + firstFrame;
 	for(int i = 0; i < numFrames; ++i, ++l, ++r)
 	{
-		data_.samples[i] = (float)((int)*l + (int)*r) / 65536.0f;
+		samples[i] = (float)((int)*l + (int)*r) / 65536.0f;
 	}
 
 	start();
@@ -622,43 +846,18 @@ TempoDetectorImp::~TempoDetectorImp()
 {
 	terminate();
 
-	AlignedFree(data_.samples);
+	AlignedFree(const_cast<float*>(data_.samples));
 }
 
 void TempoDetectorImp::exec()
 {
-	SerializedTempo* data = &data_;
-
-	// Run the aubio onset tracker to find note onsets.
-	std::vector<Onset> onsets;
-	FindOnsets(data->samples, data->samplerate, data->numFrames, 1, onsets);
-	MarkProgress(1, "Find onsets");
-
-	for(int i = 0; i < std::min(onsets.size(), size_t(100)); ++i)
-	{
-		int a = std::max(0, onsets[i].pos - 100);
-		int b = std::min(data->numFrames, onsets[i].pos + 100);
-		float v = 0.0f;
-		for(int j = a; j < b; ++j)
-		{
-			v += abs(data->samples[j]);
-		}
-		v /= (float)std::max(1, b - a);
-		onsets[i].strength = v;
-	}
-
-	// Find BPM values.
-	CalculateBPM(data, onsets.data(), onsets.size());
-	MarkProgress(4, "Find BPM");
-
-	// Find offset values.
-	CalculateOffset(data, onsets.data(), onsets.size());
-	MarkProgress(5, "Find offsets");
+	data_.token = getStopToken();
+	DetectTempo(&data_);
 }
 
 }; // anonymous namespace
 
-TempoDetector* TempoDetector::New(double time, double len)
+TempoDetector* TempoDetector::New(double time, double len, Mode mode)
 {
 	auto& music = gMusic->getSamples();
 
@@ -680,7 +879,7 @@ TempoDetector* TempoDetector::New(double time, double len)
 	}
 
 	// If so, we can detect the BPM.
-	auto detector = new TempoDetectorImp(firstFrame, numFrames);
+	auto detector = new TempoDetectorImp(firstFrame, numFrames, mode);
 	if(!detector->hasSamples())
 	{
 		HudError("Insufficient memory to perform BPM detection.");
@@ -691,4 +890,19 @@ TempoDetector* TempoDetector::New(double time, double len)
 	return detector;
 }
 
+void FindTempo(const float* samples, int samplerate, int numFrames, int numThreads,
+	TempoDetector::Mode mode, std::vector<TempoResult>& out)
+{
+	SerializedTempo data;
+	data.samples = samples;
+	data.samplerate = samplerate;
+	data.numFrames = numFrames;
+	data.numThreads = numThreads;
+	data.mode = mode;
+	data.progress = 0;
+
+	DetectTempo(&data);
+	out.swap(data.result);
+}
+
 }; // namespace Vortex
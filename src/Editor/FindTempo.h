@@ -12,7 +12,17 @@ struct TempoResult
 class TempoDetector
 {
 public:
-	static TempoDetector* New(double time, double len);
+	// The way the fitness of the candidate beat intervals is determined.
+	enum Mode
+	{
+		// Wraps the onsets around every interval separately; precise, but slow on long songs.
+		MODE_INTERVAL_SEARCH,
+
+		// Combs the autocorrelation of an onset envelope, which scores all intervals at once.
+		MODE_AUTOCORRELATION,
+	};
+
+	static TempoDetector* New(double time, double len, Mode mode = MODE_INTERVAL_SEARCH);
 	virtual ~TempoDetector() {}
 
 	virtual const char* getProgress() const = 0;
@@ -20,4 +30,8 @@ public:
 	virtual const std::vector<TempoResult>& getResult() const = 0;
 };
 
+// Finds up to three BPM candidates and their offsets in the given samples, best candidate first.
+void FindTempo(const float* samples, int samplerate, int numFrames, int numThreads,
+	TempoDetector::Mode mode, std::vector<TempoResult>& out);
+
 }; // namespace Vortex
@@ -2,12 +2,16 @@
 
 #include <mad.h>
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <memory>
 #include <fstream>
+#include <vector>
 
 #include <System/File.h>
+#include <System/Thread.h>
 
 namespace Vortex {
 namespace {
@@ -175,21 +179,53 @@ fail:
 // ================================================================================================
 // MP3 loading.
 
+// Layer III frames can borrow up to 511 bytes of main data from the frames
+// before them (the bit reservoir).
+static const int MAX_RESERVOIR_BYTES = 511;
+
+// Upper bound on the frame header, CRC and side information, which are not
+// part of the main data.
+static const int MAX_FRAME_OVERHEAD = 38;
+
+// Frames decoded after the reservoir is filled, so the overlap-add and
+// synthesis filter state of the decoder match that of a serial decode.
+static const int WARMUP_FRAMES = 2;
+
+// The synthesis filter phase advances by a multiple of two per frame and wraps
+// at sixteen, so it returns to zero every eight frames for all layers.
+static const int SYNTH_PHASE_PERIOD = 8;
+
+// Files with fewer frames per segment are decoded on a single thread.
+static const int MIN_SEGMENT_FRAMES = 512;
+
+// Every thread decodes several segments, so the decoded part of the file grows
+// steadily from the start instead of only when the last long segment is done.
+static const int SEGMENTS_PER_THREAD = 4;
+
 struct MP3Loader : public SoundSource {
     MP3Loader();
     ~MP3Loader() override;
 
     int getFrequency() override { return frequency; }
-    int getNumFrames() override { return 0; }
+    int getNumFrames() override;
     int getNumChannels() override { return numChannels; }
     int getBytesPerSample() override { return 2; }
+    void prepare() override;
     int readFrames(int frames, short *buffer) override;
+    bool readAllFrames(short *dstL, short *dstR, std::stop_token token,
+                       const DecodeProgress &progress) override;
 
     int fillInputBuffer();
     bool decodeFirstFrame();
     int decodeNextFrame();
     void synthDecodedFrame();
 
+    bool readFileData();
+    bool indexFrames();
+    int getSegmentStart(int begin) const;
+    bool decodeSegment(int begin, int end, short *dstL, short *dstR,
+                       const std::stop_token &token) const;
+
     mad_stream madStream;
     mad_frame madFrame;
     mad_synth madSynth;
@@ -208,6 +244,14 @@ struct MP3Loader : public SoundSource {
     XingHeader xing;
 
     std::ifstream file;
+
+    // The entire file, padded with MAD_BUFFER_GUARD zeros, and the offset of
+    // every synthesized frame in it. Only present if the frames could be
+    // indexed, which allows the file to be decoded in independent segments.
+    std::vector<uint8_t> fileData;
+    std::vector<uint32_t> frameOffsets;
+    int samplesPerFrame;
+    bool skipFirstFrame;
 };
 
 MP3Loader::MP3Loader() {
@@ -224,6 +268,8 @@ MP3Loader::MP3Loader() {
     hasXingHeader = false;
 
     numChannels = 0;
+    samplesPerFrame = 0;
+    skipFirstFrame = false;
 
     memset(&xing, 0, sizeof(XingHeader));
 }
@@ -395,6 +441,277 @@ int MP3Loader::readFrames(int frames, short *buffer) {
     return framesWritten;
 }
 
+// ================================================================================================
+// Segmented decoding.
+
+int MP3Loader::getNumFrames() {
+    return static_cast<int>(frameOffsets.size()) * samplesPerFrame;
+}
+
+void MP3Loader::prepare() {
+    // Indexing the frames gives the exact length of the signal, so the sample
+    // buffers can be allocated and filled in parallel.
+    if (readFileData()) indexFrames();
+}
+
+bool MP3Loader::readFileData() {
+    // The serial decoder has already read the first frame from the stream, so
+    // its position and end-of-file state are restored afterwards in case
+    // decoding falls back to it.
+    bool wasAtEnd = file.eof();
+    std::streampos pos = wasAtEnd ? std::streampos(0) : file.tellg();
+    file.clear();
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    bool success = size > 0 && size <= INT32_MAX - MAD_BUFFER_GUARD;
+    if (success) {
+        fileData.resize(static_cast<size_t>(size) + MAD_BUFFER_GUARD, 0);
+        file.read(reinterpret_cast<char *>(fileData.data()), size);
+        success = (file.gcount() == size);
+    }
+
+    file.clear();
+    if (wasAtEnd) {
+        file.seekg(0, std::ios::end);
+        file.setstate(std::ios::eofbit);
+    } else {
+        file.seekg(pos);
+    }
+
+    if (!success) fileData.clear();
+    return success;
+}
+
+bool MP3Loader::indexFrames() {
+    // Walks the frame headers in the same way "decodeNextFrame" walks the
+    // frames, without decoding them. Anything the serial decoder would skip or
+    // resynchronize on makes the file unsuitable for segmented decoding.
+    mad_stream stream;
+    mad_frame frame;
+    mad_stream_init(&stream);
+    mad_frame_init(&frame);
+    mad_stream_buffer(&stream, fileData.data(), fileData.size());
+
+    bool success = true, isFirst = true;
+    while (success) {
+        // The first frame is decoded in full, to check for a Xing header.
+        int ret = isFirst ? mad_frame_decode(&frame, &stream)
+                          : mad_header_decode(&frame.header, &stream);
+        if (ret == -1) {
+            if (stream.error == MAD_ERROR_BUFLEN) break;
+            if (stream.error == MAD_ERROR_LOSTSYNC) {
+                const long tagsize = ID3TagQuery(
+                    stream.this_frame, stream.bufend - stream.this_frame);
+                if (tagsize > 0) {
+                    mad_stream_skip(&stream, tagsize);
+                    continue;
+                }
+            }
+            if (isFirst && stream.error == MAD_ERROR_BADDATAPTR) {
+                ret = 0;
+            } else {
+                success = false;
+                break;
+            }
+        }
+
+        const mad_header &header = frame.header;
+        if (isFirst) {
+            isFirst = false;
+            XingHeader first;
+            if (XingParse(&first, stream.anc_ptr, stream.anc_bitlen) == 0 &&
+                first.type == XingHeader::XING) {
+                skipFirstFrame = true;
+                continue;
+            }
+        }
+        if (samplesPerFrame == 0) {
+            samplesPerFrame = 32 * MAD_NSBSAMPLES(&header);
+        }
+
+        // Free format streams and streams that change their format midway are
+        // left to the serial decoder.
+        success = header.bitrate != 0 &&
+                  static_cast<int>(header.samplerate) == frequency &&
+                  MAD_NCHANNELS(&header) == numChannels &&
+                  32 * MAD_NSBSAMPLES(&header) == samplesPerFrame;
+
+        frameOffsets.push_back(
+            static_cast<uint32_t>(stream.this_frame - fileData.data()));
+    }
+
+    mad_frame_finish(&frame);
+    mad_stream_finish(&stream);
+
+    if (!success || frameOffsets.empty() ||
+        frameOffsets.size() > INT32_MAX / samplesPerFrame) {
+        frameOffsets.clear();
+        fileData.clear();
+        return false;
+    }
+    return true;
+}
+
+int MP3Loader::getSegmentStart(int begin) const {
+    if (begin == 0) return 0;
+
+    // Go back far enough for the bit reservoir of the first frame to be filled
+    // and for the decoder state to settle. Starting on a multiple of the
+    // synthesis filter period keeps the filter phase in step with a serial
+    // decode, which starts on frame zero.
+    int start = begin, reservoir = 0;
+    while (start > 0 && reservoir < MAX_RESERVOIR_BYTES) {
+        --start;
+        int frameSize = frameOffsets[start + 1] - frameOffsets[start];
+        reservoir += std::max(frameSize - MAX_FRAME_OVERHEAD, 0);
+    }
+    start = std::max(start - WARMUP_FRAMES, 0);
+    return start - start % SYNTH_PHASE_PERIOD;
+}
+
+bool MP3Loader::decodeSegment(int begin, int end, short *dstL, short *dstR,
+                              const std::stop_token &token) const {
+    const int start = getSegmentStart(begin);
+    const uint8_t *data = fileData.data();
+    const size_t startOffset = start > 0 ? frameOffsets[start] : 0;
+
+    mad_stream stream;
+    mad_frame frame;
+    mad_synth synth;
+    mad_stream_init(&stream);
+    mad_frame_init(&frame);
+    mad_synth_init(&synth);
+    mad_stream_buffer(&stream, data + startOffset,
+                      fileData.size() - startOffset);
+
+    bool success = true;
+    bool skipFrame = (start == 0 && skipFirstFrame);
+    for (int i = start; i < end;) {
+        if (token.stop_requested()) {
+            success = false;
+            break;
+        }
+
+        int ret = mad_frame_decode(&frame, &stream);
+        if (ret == -1 && stream.error == MAD_ERROR_LOSTSYNC) {
+            const long tagsize = ID3TagQuery(stream.this_frame,
+                                             stream.bufend - stream.this_frame);
+            if (tagsize > 0) {
+                mad_stream_skip(&stream, tagsize);
+                continue;
+            }
+        }
+
+        // Frames that lack reservoir data are silent in a serial decode as
+        // well, but only a segment that starts on the first frame is certain
+        // to lack the same data. Elsewhere, it is only expected while priming.
+        if (ret == -1 && stream.error == MAD_ERROR_BADDATAPTR &&
+            (start == 0 || i < begin)) {
+            ret = 0;
+        }
+        if (ret == -1) {
+            success = false;
+            break;
+        }
+
+        if (skipFrame) {
+            skipFrame = false;
+            continue;
+        }
+
+        if (stream.this_frame != data + frameOffsets[i]) {
+            success = false;
+            break;
+        }
+
+        mad_synth_frame(&synth, &frame);
+        if (i >= begin) {
+            if (synth.pcm.length != samplesPerFrame) {
+                success = false;
+                break;
+            }
+            const mad_fixed_t *srcL = synth.pcm.samples[0];
+            const mad_fixed_t *srcR = synth.pcm.samples[numChannels - 1];
+            short *outL = dstL + static_cast<size_t>(i) * samplesPerFrame;
+            short *outR = dstR + static_cast<size_t>(i) * samplesPerFrame;
+            for (int j = 0; j < samplesPerFrame; ++j) {
+                outL[j] = ScaleSample(srcL[j]);
+                outR[j] = ScaleSample(srcR[j]);
+            }
+        }
+        ++i;
+    }
+
+    mad_synth_finish(&synth);
+    mad_frame_finish(&frame);
+    mad_stream_finish(&stream);
+
+    return success;
+}
+
+bool MP3Loader::readAllFrames(short *dstL, short *dstR, std::stop_token token,
+                              const DecodeProgress &progress) {
+    if (frameOffsets.empty()) return false;
+
+    int numFrames = static_cast<int>(frameOffsets.size());
+    int numThreads = ParallelThreads::concurrency();
+    int numSegments = std::clamp(numFrames / MIN_SEGMENT_FRAMES, 1,
+                                 numThreads * SEGMENTS_PER_THREAD);
+
+    // Split the frames into ranges of roughly the same number of bytes, which
+    // take about equally long to decode, since the bitrate may vary.
+    std::vector<int> bounds(numSegments + 1, numFrames);
+    bounds[0] = 0;
+    uint64_t firstByte = frameOffsets.front();
+    uint64_t numBytes = frameOffsets.back() - firstByte;
+    for (int i = 1; i < numSegments; ++i) {
+        auto target = static_cast<uint32_t>(firstByte +
+                                            numBytes * i / numSegments);
+        auto it = std::lower_bound(frameOffsets.begin(), frameOffsets.end(),
+                                   target);
+        bounds[i] = std::max(static_cast<int>(it - frameOffsets.begin()),
+                             bounds[i - 1]);
+    }
+
+    // The segments are handed out in order, so the finished segments mostly
+    // form a prefix of the file that can be shown while the rest is decoding.
+    std::vector<int> frameBounds(bounds);
+    for (int &bound : frameBounds) bound *= samplesPerFrame;
+    SegmentProgress segmentProgress(std::move(frameBounds), progress);
+
+    std::vector<uint8_t> results(numSegments, 0);
+    struct SegmentThreads : public ParallelThreads {
+        const MP3Loader *loader;
+        const int *bounds;
+        short *dstL, *dstR;
+        uint8_t *results;
+        SegmentProgress *progress;
+        std::stop_token token;
+        void exec(int item, int thread) override {
+            results[item] = loader->decodeSegment(
+                bounds[item], bounds[item + 1], dstL, dstR, token);
+            if (results[item]) progress->finish(item);
+        }
+    };
+    SegmentThreads threads;
+    threads.loader = this;
+    threads.bounds = bounds.data();
+    threads.dstL = dstL;
+    threads.dstR = dstR;
+    threads.results = results.data();
+    threads.progress = &segmentProgress;
+    threads.token = token;
+    threads.run(numSegments, std::min(numSegments, numThreads));
+
+    // The serial decoder reads from the file stream, so the copy is no longer
+    // needed either way.
+    std::vector<uint8_t>().swap(fileData);
+
+    return std::find(results.begin(), results.end(), 0) == results.end();
+}
+
 };  // anonymous namespace.
 
 SoundSource *LoadMP3(std::ifstream &&file, std::string &title,
@@ -407,7 +724,9 @@ SoundSource *LoadMP3(std::ifstream &&file, std::string &title,
     // Open the file using the provided file stream.
     loader->file = std::move(file);
 
-    // Decode and synth the first frame to check if the file is valid.
+    // Decode and synth the first frame to check if the file is valid. The
+    // rest of the file is read and indexed by "prepare", on the decoding
+    // thread.
     if (!loader->decodeFirstFrame()) return nullptr;
 
     // The file is valid, return the MP3 loader.
@@ -6,14 +6,33 @@
 #include <vorbis/vorbisfile.h>
 #include <errno.h>
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <vector>
 
 #include <System/File.h>
+#include <System/Thread.h>
 
 namespace Vortex {
 namespace {
 
+// Songs with fewer frames per segment are decoded by a single handle.
+static const int MIN_SEGMENT_FRAMES = 1 << 18;
+
+// Every thread decodes several segments, so the decoded part of the song grows
+// steadily from the start instead of only when the last long segment is done.
+static const int SEGMENTS_PER_THREAD = 4;
+
+static const int SEGMENT_BUFFER_FRAMES = 4096;
+
+// Read position of a decoder handle in an in-memory copy of the file.
+struct OggMemoryReader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+};
+
 struct OggLoader : public SoundSource {
     ~OggLoader() override;
 
@@ -23,6 +42,13 @@ struct OggLoader : public SoundSource {
     int getBytesPerSample() override { return 2; }
 
     int readFrames(int frames, short* buffer) override;
+    bool readAllFrames(short* dstL, short* dstR, std::stop_token token,
+                       const DecodeProgress& progress) override;
+
+    bool readFileData(std::vector<uint8_t>& out);
+    bool decodeSegment(const std::vector<uint8_t>& data, int begin, int end,
+                       short* dstL, short* dstR,
+                       const std::stop_token& token) const;
 
     OggVorbis_File* vf;
     int numFrames;
@@ -65,6 +91,30 @@ static long OvTell(void* loader) {
     return file.tellg();
 }
 
+static size_t OvMemoryRead(void* ptr, size_t size, size_t nmemb,
+                           void* reader) {
+    auto r = static_cast<OggMemoryReader*>(reader);
+    size_t bytes = std::min(size * nmemb, r->size - r->pos);
+    memcpy(ptr, r->data + r->pos, bytes);
+    r->pos += bytes;
+    return size ? bytes / size : 0;
+}
+
+static int OvMemorySeek(void* reader, ogg_int64_t offset, int whence) {
+    auto r = static_cast<OggMemoryReader*>(reader);
+    ogg_int64_t base = 0;
+    if (whence == SEEK_CUR) base = static_cast<ogg_int64_t>(r->pos);
+    if (whence == SEEK_END) base = static_cast<ogg_int64_t>(r->size);
+    ogg_int64_t pos = base + offset;
+    if (pos < 0 || pos > static_cast<ogg_int64_t>(r->size)) return -1;
+    r->pos = static_cast<size_t>(pos);
+    return 0;
+}
+
+static long OvMemoryTell(void* reader) {
+    return static_cast<long>(static_cast<OggMemoryReader*>(reader)->pos);
+}
+
 static void ReadComment(const char* str, int len, const char* tag,
                         std::string& out) {
     const char* end = str + len;
@@ -78,6 +128,133 @@ static void ReadComment(const char* str, int len, const char* tag,
     }
 }
 
+// ================================================================================================
+// Segmented decoding.
+
+bool OggLoader::readFileData(std::vector<uint8_t>& out) {
+    // The serial decoder reads sequentially from the stream, so its position
+    // is restored afterwards in case decoding falls back to it.
+    std::streampos pos = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    bool success = size > 0;
+    if (success) {
+        out.resize(static_cast<size_t>(size));
+        file.read(reinterpret_cast<char*>(out.data()), size);
+        success = (file.gcount() == size);
+    }
+
+    file.clear();
+    file.seekg(pos);
+
+    return success;
+}
+
+bool OggLoader::decodeSegment(const std::vector<uint8_t>& data, int begin,
+                              int end, short* dstL, short* dstR,
+                              const std::stop_token& token) const {
+    OggMemoryReader reader = {data.data(), data.size(), 0};
+    OggVorbis_File segment;
+    if (ov_open_callbacks(&reader, &segment, nullptr, 0,
+                          ov_callbacks{OvMemoryRead, OvMemorySeek, nullptr,
+                                       OvMemoryTell}) < 0) {
+        return false;
+    }
+
+    // Seeking is sample accurate; the decoder primes itself with the block
+    // before the target, so the output overlaps exactly as in a serial decode.
+    bool success = (ov_pcm_seek(&segment, begin) == 0);
+
+    std::vector<short> buffer(SEGMENT_BUFFER_FRAMES * numChannels);
+    int bytesPerFrame = numChannels * 2;
+    int bitstream = 0;
+    for (int pos = begin; success && pos < end;) {
+        if (token.stop_requested()) {
+            success = false;
+            break;
+        }
+
+        int frames = std::min(SEGMENT_BUFFER_FRAMES, end - pos);
+        long bytesRead =
+            ov_read(&segment, reinterpret_cast<char*>(buffer.data()),
+                    frames * bytesPerFrame, 0, 2, 1, &bitstream);
+
+        // The serial decoder stops at the first read error, so holes in the
+        // stream leave the decoding to it.
+        if (bytesRead <= 0) {
+            success = false;
+            break;
+        }
+
+        int framesRead = static_cast<int>(bytesRead / bytesPerFrame);
+        const short* src = buffer.data();
+        for (int i = 0; i < framesRead; ++i, src += numChannels) {
+            dstL[pos + i] = src[0];
+            dstR[pos + i] = src[numChannels > 1 ? 1 : 0];
+        }
+        pos += framesRead;
+    }
+
+    ov_clear(&segment);
+
+    return success;
+}
+
+bool OggLoader::readAllFrames(short* dstL, short* dstR, std::stop_token token,
+                              const DecodeProgress& progress) {
+    // Chained files can change their format between streams.
+    if (numFrames <= 0 || ov_streams(vf) != 1 || !ov_seekable(vf)) {
+        return false;
+    }
+
+    // Every handle reads from its own position in a shared copy of the file.
+    std::vector<uint8_t> data;
+    if (!readFileData(data)) return false;
+
+    int numThreads = ParallelThreads::concurrency();
+    int numSegments = std::clamp(numFrames / MIN_SEGMENT_FRAMES, 1,
+                                 numThreads * SEGMENTS_PER_THREAD);
+    std::vector<int> bounds(numSegments + 1);
+    for (int i = 0; i <= numSegments; ++i) {
+        bounds[i] = static_cast<int>(static_cast<int64_t>(numFrames) * i /
+                                     numSegments);
+    }
+
+    // The segments are handed out in order, so the finished segments mostly
+    // form a prefix of the song that can be shown while the rest is decoding.
+    SegmentProgress segmentProgress(bounds, progress);
+
+    std::vector<uint8_t> results(numSegments, 0);
+    struct SegmentThreads : public ParallelThreads {
+        const OggLoader* loader;
+        const std::vector<uint8_t>* data;
+        const int* bounds;
+        short *dstL, *dstR;
+        uint8_t* results;
+        SegmentProgress* progress;
+        std::stop_token token;
+        void exec(int item, int thread) override {
+            results[item] = loader->decodeSegment(
+                *data, bounds[item], bounds[item + 1], dstL, dstR, token);
+            if (results[item]) progress->finish(item);
+        }
+    };
+    SegmentThreads threads;
+    threads.loader = this;
+    threads.data = &data;
+    threads.bounds = bounds.data();
+    threads.dstL = dstL;
+    threads.dstR = dstR;
+    threads.results = results.data();
+    threads.progress = &segmentProgress;
+    threads.token = token;
+    threads.run(numSegments, std::min(numSegments, numThreads));
+
+    return std::find(results.begin(), results.end(), 0) == results.end();
+}
+
 };  // anonymous namespace.
 
 SoundSource* LoadOgg(std::ifstream&& file, std::string& title,
@@ -46,6 +46,7 @@ Item* myBgStyleMenu;
 Item* myStatusMenu;
 Item* myEditMenu;
 Item* myAudioMenu;
+Item* myAudioSpeedMenu;
 
 UpdateFunction myUpdateFunctions[NUM_PROPERTIES];
 
@@ -298,6 +299,7 @@ void init(Item* menu)
 	add(hTempo, ESTIMATE_BPM_FROM_SELECTION, "Estimate BPM from selection");
 	add(hTempo, AUTO_SYNC_SONG, "Auto-sync song (Global)");
 	add(hTempo, AUTO_SYNC_SECTIONS, "Auto-sync sections (Local BPMs)");
+	add(hTempo, TRACK_BEATS, "Track beats (Variable BPM)");
 	add(hTempo, CONVERT_REGION_TO_CONSTANT_BPM, "Convert region to constant BPM");
 	add(hTempo, SNAP_OFFSET_TO_FIRST_BEAT, "Snap offset to first beat");
 	add(hTempo, QUANTIZE_TO_AUDIO, "Quantize to audio (Selection)");
@@ -314,11 +316,13 @@ void init(Item* menu)
 	add(hAudioVol, VOLUME_MUTE, "Mute");
 
 	// Audio > Speed menu.
-	Item* hAudioSpeed = newMenu();
+	Item* hAudioSpeed = myAudioSpeedMenu = newMenu();
 	add(hAudioSpeed, SPEED_RESET, "Default");
 	sep(hAudioSpeed);
 	add(hAudioSpeed, SPEED_INCREASE, "Faster");
 	add(hAudioSpeed, SPEED_DECREASE, "Slower");
+	sep(hAudioSpeed);
+	add(hAudioSpeed, TOGGLE_TIME_STRETCH, "Preserve pitch");
 
 	// Audio menu.
 	Item* hAudio = myAudioMenu = newMenu();
@@ -330,6 +334,7 @@ void init(Item* menu)
 	add(hAudio, TOGGLE_NOTE_TICK, "Note tick");
 	sep(hAudio);
 	add(hAudio, CONVERT_MUSIC_TO_OGG, "Convert to ogg");
+	add(hAudio, RENDER_MIX_TO_WAV, "Render mix to wav");
 
 	// View > Minimap menu.
 	Item* hViewMm = myMinimapMenu = newMenu();
@@ -561,6 +566,10 @@ void registerUpdateFunctions()
 	{
 		MENU->myAudioMenu->setChecked(TOGGLE_LOOP_SELECTION, gMusic->isLooping());
 	};
+	myUpdateFunctions[AUDIO_TIME_STRETCH] = []
+	{
+		MENU->myAudioSpeedMenu->setChecked(TOGGLE_TIME_STRETCH, gMusic->hasTimeStretch());
+	};
 	myUpdateFunctions[VIEW_NOTESKIN] = []
 	{
 		Item* hSkins = System::MenuItem::create();
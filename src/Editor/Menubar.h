@@ -38,6 +38,7 @@ struct Menubar
 	VIEW_NOTESKIN,
 
 	AUDIO_LOOP,
+	AUDIO_TIME_STRETCH,
 
 	STATUSBAR_CHART,
 	STATUSBAR_SNAP,
@@ -3,7 +3,9 @@
 #include <limits.h>
 #include <stdint.h>
 #include <math.h>
+#include <algorithm>
 #include <chrono>
+#include <memory>
 #include <vector>
 
 #include <Core/Reference.h>
@@ -11,34 +13,80 @@
 #include <Core/StringUtils.h>
 #include <Core/Xmr.h>
 
+#include <Managers/ChartMan.h>
 #include <Managers/MetadataMan.h>
 #include <Managers/SimfileMan.h>
 #include <Managers/TempoMan.h>
 #include <Managers/NoteMan.h>
 
 #include <Simfile/TimingData.h>
+#include <Simfile/Simfile.h>
+#include <Simfile/Chart.h>
+#include <Simfile/Tempo.h>
 
+#include <Editor/AudioAnalysis.h>
 #include <Editor/ConvertToOgg.h>
+#include <Editor/PcmCache.h>
 #include <Editor/Editor.h>
 #include <Editor/Common.h>
+#include <Editor/Menubar.h>
+#include <Editor/MusicMix.h>
+#include <Editor/VoiceScheduler.h>
 #include <Editor/TextOverlay.h>
+#include <Editor/Waveform.h>
 
 #include <System/File.h>
 #include <System/Debug.h>
 #include <System/Thread.h>
 #include <System/System.h>
 #include <System/Mixer.h>
+#include <System/NullMixer.h>
 
 namespace Vortex {
 
 struct TickData
 {
 	Sound sound;
-	std::vector<int> frames;
 	bool enabled;
 };
 
-static const int MIX_CHANNELS = 2;
+// Events of the note tick or keysound track, along with the row of the note that schedules each
+// event. Outside of warps, the events are sorted by both row and frame.
+struct NoteEvents
+{
+	std::vector<VoiceScheduler::Event> events;
+	std::vector<int> rows;
+};
+
+// Loads keysounds in the background, so opening a chart does not wait for its keysound files.
+struct KeysoundThread : public BackgroundThread
+{
+	KeysoundThread() : BackgroundThread(TaskPriority::Decode) {}
+
+	std::vector<std::string> paths;
+	std::vector<int> targets; // index of every loaded sound in the keysound table.
+	std::vector<std::unique_ptr<Sound>> sounds; // null if the sound could not be loaded.
+
+	void exec() override
+	{
+		sounds.resize(paths.size());
+		for(size_t i = 0; i < paths.size() && !getStopToken().stop_requested(); ++i)
+		{
+			String title, artist;
+			auto sound = std::make_unique<Sound>();
+			if(sound->load(paths[i], false, title, artist)) sounds[i] = std::move(sound);
+		}
+	}
+};
+
+static bool ByFrame(const VoiceScheduler::Event& a, const VoiceScheduler::Event& b)
+{
+	return a.frame < b.frame;
+}
+
+// Tracks of the voice scheduler, and the sounds they play.
+enum VoiceTrack { TRACK_BEAT_TICKS, TRACK_NOTE_TICKS, TRACK_KEYSOUNDS, NUM_VOICE_TRACKS };
+enum VoiceSound { SOUND_BEAT_TICK, SOUND_NOTE_TICK, SOUND_FIRST_KEYSOUND };
 
 enum LoadState { LOADING_ALLOCATING_AND_READING, LOADING_ALLOCATED_AND_READING, LOADING_DONE };
 
@@ -51,18 +99,25 @@ Mixer* myMixer;
 Sound mySamples;
 std::chrono::steady_clock::time_point myPlayTimer;
 TickData myBeatTick, myNoteTick;
+MusicMix myMix;
+std::vector<std::unique_ptr<Sound>> myKeysounds;
+std::vector<std::string> myKeysoundPaths;
+std::vector<std::string> myPendingKeysoundPaths;
+KeysoundThread* myKeysoundThread;
+NoteEvents myNoteTicks, myNoteKeysounds;
+bool myNoteEventsByRow;
 String myTitle, myArtist;
 int myMusicSpeed;
 int myMusicVolume;
 int myTickOffsetMs;
-double myPlayPosition;
+int myOutputRate;
+int myMixRate;
 double myPlayStartTime;
 bool myIsPaused, myIsMuted;
+bool myHasTimeStretch;
 LoadState myLoadState;
 Reference<InfoBoxWithProgress> myInfoBox;
 
-std::vector<short> myMixBuffer;
-
 OggConversionThread* myOggConversionThread;
 
 // ================================================================================================
@@ -70,22 +125,28 @@ OggConversionThread* myOggConversionThread;
 
 ~MusicImpl()
 {
+	stopLoadingKeysounds();
 	unload();
 	delete myMixer;
 }
 
 MusicImpl()
+	: myMix(NUM_VOICE_TRACKS)
 {
 	myMixer = Mixer::create();
 
 	myMusicSpeed = 100;
 	myMusicVolume = 100;
 	myTickOffsetMs = 0;
-	myPlayPosition = 0.0;
+	myOutputRate = 0;
+	myMixRate = 44100;
 	myPlayStartTime = 0.0;
 	myIsPaused = true;
 	myIsMuted = false;
+	myHasTimeStretch = false;
 	myLoadState = LOADING_DONE;
+	myKeysoundThread = nullptr;
+	myNoteEventsByRow = false;
 
 	myBeatTick.enabled = false;
 	myNoteTick.enabled = false;
@@ -99,6 +160,10 @@ MusicImpl()
 
 	success = myNoteTick.sound.load("assets/sound note tick.wav", false, String(), String());
 	if(!success) HudError("%s", "Failed to load note tick.\n");
+
+	myMix.voices.setEnabled(TRACK_BEAT_TICKS, false);
+	myMix.voices.setEnabled(TRACK_NOTE_TICKS, false);
+	updateVoiceSounds();
 }
 
 // ================================================================================================
@@ -111,6 +176,17 @@ void loadSettings(XmrNode& settings)
 	{
 		audio->get("musicVolume", &myMusicVolume);
 		audio->get("tickOffsetMs", &myTickOffsetMs);
+		audio->get("timeStretch", &myHasTimeStretch);
+
+		// An output samplerate of zero plays the music at its own samplerate.
+		audio->get("outputRate", &myOutputRate);
+		if(myOutputRate != 0) myOutputRate = min(max(myOutputRate, 8000), 192000);
+
+		int cacheLimitMb;
+		if(audio->get("pcmCacheLimitMb", &cacheLimitMb))
+		{
+			PcmCache::setSizeLimit((uint64_t)max(cacheLimitMb, 0) << 20);
+		}
 	}
 }
 
@@ -120,6 +196,9 @@ void saveSettings(XmrNode& settings)
 
 	audio->addAttrib("musicVolume", (long)myMusicVolume);
 	audio->addAttrib("tickOffsetMs", (long)myTickOffsetMs);
+	audio->addAttrib("timeStretch", myHasTimeStretch);
+	audio->addAttrib("outputRate", (long)myOutputRate);
+	audio->addAttrib("pcmCacheLimitMb", (long)(PcmCache::getSizeLimit() >> 20));
 }
 
 // ================================================================================================
@@ -131,6 +210,10 @@ void unload()
 
 	myMixer->close();
 
+	// Make sure the waveform and the analyses stop reading the samples before they are freed.
+	if(gWaveform) gWaveform->clearBlocks();
+	if(gAudioAnalysis) gAudioAnalysis->clear();
+
 	mySamples.clear();
 	myTitle.clear();
 
@@ -153,14 +236,18 @@ void load()
 	}
 
 	Path path(dir, file);
+	// Only the music is cached; keysounds are short and decode quickly.
 	bool success = mySamples.load(
-		path.str.str(), gEditor->hasMultithreading(), myTitle, myArtist);
+		path.str.str(), gEditor->hasMultithreading(), myTitle, myArtist, true);
 
 	if(success && mySamples.getFrequency() > 0)
 	{
 		myLoadState = LOADING_ALLOCATING_AND_READING;
 
-		myMixer->open(this, mySamples.getFrequency());
+		int songRate = mySamples.getFrequency();
+		myMixRate = myOutputRate > 0 ? myOutputRate : songRate;
+		myMix.timeStretch.setSampleRates(songRate, myMixRate);
+		myMixer->open(this, myMixRate);
 
 		auto box = myInfoBox.create();
 		box->left = "Loading music...";
@@ -175,181 +262,84 @@ void load()
 // ================================================================================================
 // MusicImpl :: mixing functions
 
-void WriteTickSamples(short* dst, int startFrame, int numFrames, const TickData& tick, int rate)
+void writeFrames(short* buffer, int frames) override
 {
-	if(rate != 100)
-	{
-		startFrame = (int)((int64_t)startFrame * 100 / rate);
-	}
-
-	const short* srcL = tick.sound.samplesL() + startFrame;
-	const short* srcR = tick.sound.samplesR() + startFrame;
-
-	if(rate == 100)
-	{
-		int n = min(numFrames, tick.sound.getNumFrames() - startFrame);
-		for(int i = 0; i < n; ++i)
-		{
-			*dst++ = min(max(*dst + *srcL++, SHRT_MIN), SHRT_MAX);
-			*dst++ = min(max(*dst + *srcR++, SHRT_MIN), SHRT_MAX);
-		}
-	}
-	else
-	{
-		int idx = 0;
-		double srcPos = 0.0;
-		const int tickEndPos = tick.sound.getNumFrames() - startFrame;
-		const double srcDelta = 100.0 / (double)rate;
-		for(; numFrames > 0 && idx < tickEndPos; --numFrames)
-		{
-			const float frac = (float)(srcPos - floor(srcPos));
-
-			float sampleL = lerp((float)srcL[idx], (float)srcL[idx + 1], frac);
-			float sampleR = lerp((float)srcR[idx], (float)srcR[idx + 1], frac);
-			
-			*dst++ = min(max(*dst + (short)sampleL, SHRT_MIN), SHRT_MAX);
-			*dst++ = min(max(*dst + (short)sampleR, SHRT_MIN), SHRT_MAX);
-
-			srcPos += srcDelta;
-			idx = (int)srcPos;
-		}
-	}
+	MusicMixInput input;
+	input.samplesL = mySamples.isAllocated() ? mySamples.samplesL() : nullptr;
+	input.samplesR = mySamples.isAllocated() ? mySamples.samplesR() : nullptr;
+	input.numFrames = mySamples.getNumFrames();
+	input.musicRate = mySamples.getFrequency();
+	input.outputRate = myMixRate;
+	input.speed = myMusicSpeed;
+	input.volume = myMusicVolume;
+	input.isMuted = myIsMuted;
+	input.hasTimeStretch = myHasTimeStretch;
+	myMix.write(buffer, frames, input);
 }
 
-void WriteTicks(short* buf, int frames, const TickData& tick, int rate)
-{
-	int playPos = (int)myPlayPosition;
-	int count = tick.frames.size();
-	const int* ticks = tick.frames.data();
 
-	// Jump forward to the first audible tick.
-	int first = 0, firstAudibleTickPos = playPos - tick.sound.getNumFrames();
-	while(first < count && ticks[first] < firstAudibleTickPos) ++first;
+// ================================================================================================
+// MusicImpl :: offline rendering.
 
-	// Write all ticks that intersect the current buffer.
-	int curFrame = -1;
-	for(int i = first; i < count; ++i)
+bool renderToFile(const std::string& path, double startTime, double endTime)
+{
+	if(myLoadState != LOADING_DONE || mySamples.getNumFrames() == 0)
 	{
-		int beginFrame = tick.frames[i] - playPos;
-		if(beginFrame == curFrame) continue; // avoid double ticks for jumps.
-		if(beginFrame > frames) break;
-
-		int srcPos = max(0, -beginFrame);
-		int dstPos = max(0, beginFrame);
-		short* dst = buf + dstPos * 2;
-		int dstFrames = frames - dstPos;
-
-		WriteTickSamples(dst, srcPos, frames - dstPos, tick, rate);
-
-		curFrame = beginFrame;
+		HudNote("Wait for the music to finish loading.");
+		return false;
 	}
-}
 
-void WriteSourceFrames(short* buffer, int frames, int64_t srcPos)
-{
-	short* dst = buffer;
-	int musicVolume = gMusic->getVolume();
+	// The audio device is paused while rendering, so only the renderer calls writeFrames.
+	interruptStream();
 
-	// If the stream pos is before the start of the song, start with silence.
-	int framesLeft = frames;
-	if(srcPos < 0)
+	NullMixer renderer;
+	renderer.open(this, myMixRate);
+	bool success = renderer.setOutputFile(path);
+	if(success)
 	{
-		int n = min(framesLeft, (int)max(-srcPos, (int64_t)INT_MIN));
-		memset(dst, 0, sizeof(short) * MIX_CHANNELS * n);
-		dst += n * MIX_CHANNELS;
-		framesLeft -= n;
-		srcPos = 0;
-	}
+		myMix.playPosition = startTime * (double)mySamples.getFrequency();
+		myMix.reset();
 
-	// Fill the remaining buffer with music samples.
-	if(framesLeft > 0 && mySamples.isAllocated() && musicVolume > 0 && !myIsMuted)
-	{
-		int n = (int)min(max(mySamples.getNumFrames() - srcPos, (int64_t)0), (int64_t)framesLeft);
-		const short* srcL = mySamples.samplesL() + srcPos;
-		const short* srcR = mySamples.samplesR() + srcPos;
-		if(musicVolume == 100)
-		{
-			for(int i = 0; i < n; ++i)
-			{
-				*dst++ = *srcL++;
-				*dst++ = *srcR++;
-			}
-		}
-		else
+		// The rendered mix plays at the current speed, so it lasts as long as playback would.
+		double seconds = (endTime - startTime) * 100.0 / (double)myMusicSpeed;
+		int64_t framesLeft = max((int64_t)0, (int64_t)llround(seconds * (double)myMixRate));
+
+		renderer.resume();
+		while(framesLeft > 0)
 		{
-			int vol = ((musicVolume * musicVolume) << 15) / (100 * 100);
-			for(int i = 0; i < n; ++i)
-			{
-				*dst++ = (short)(((*srcL++) * vol) >> 15);
-				*dst++ = (short)(((*srcR++) * vol) >> 15);
-			}
+			int n = (int)min(framesLeft, (int64_t)NullMixer::BLOCK_FRAMES * 16);
+			framesLeft -= renderer.render(n);
 		}
-		framesLeft -= n;
-	}
+		renderer.close();
 
-	// If there are still frames left, end with silence.
-	if(framesLeft > 0)
+		myMix.reset();
+	}
+	else
 	{
-		memset(dst, 0, sizeof(short) * MIX_CHANNELS * framesLeft);
+		HudError("Could not create \"%s\".", path.c_str());
 	}
 
-	// Write beat and step ticks.
-	int rate = gMusic->getSpeed();
-	if(myBeatTick.enabled) WriteTicks(buffer, frames, myBeatTick, rate);
-	if(myNoteTick.enabled) WriteTicks(buffer, frames, myNoteTick, rate);
+	resumeStream();
+	return success;
 }
 
-void writeFrames(short* buffer, int frames) override
+void renderMixToWav()
 {
-	double srcAdvance = (double)frames;
-	if(myMusicSpeed == 100)
-	{
-		// Source and target samplerate are equal.
-		int64_t srcPos = llround(myPlayPosition);
-		WriteSourceFrames(buffer, frames, srcPos);
-	}
-	else
-	{
-		double rate = (double)myMusicSpeed / 100.0;
-		srcAdvance *= rate;
-
-		// Source and target samplerate are different, mix to temporary buffer.
-		int64_t srcPos = (int64_t)(myPlayPosition);
-		int tmpFrames = frames * myMusicSpeed / 100;
-		myMixBuffer.resize(tmpFrames * 2);
-		WriteSourceFrames(myMixBuffer.data(), tmpFrames, srcPos);
-
-		// Interpolate to the target samplerate.
-		double tmpPos = 0.0;
-		const short* tmpL = myMixBuffer.data() + 0;
-		const short* tmpR = myMixBuffer.data() + 1;
-		int tmpEnd = tmpFrames - 1;
-
-		short* dst = buffer;
-		for(int i = 0; i < frames; ++i)
-		{
-			int index0 = min((int)tmpPos, tmpEnd);
-			int index1 = min(index0 + 1, tmpEnd);
-			index0 *= MIX_CHANNELS;
-			index1 *= MIX_CHANNELS;
-
-			float w1 = (float)(tmpPos - floor(tmpPos));
-			float w0 = 1.0f - w1;
+	if(gSimfile->isClosed()) return;
 
-			float l = (float)tmpL[index0] * w0 + (float)tmpL[index1] * w1;
-			float r = (float)tmpR[index0] * w0 + (float)tmpR[index1] * w1;
+	String dir = gSimfile->getDir();
+	String file = gSimfile->get()->music;
 
-			*dst++ = (short)min(max((int)l, SHRT_MIN), SHRT_MAX);
-			*dst++ = (short)min(max((int)r, SHRT_MIN), SHRT_MAX);
+	Path path(dir, file);
+	path.dropExt();
+	Str::append(path.str, " mix.wav");
 
-			tmpPos += rate;
-		}
+	if(renderToFile(path.str.str(), 0.0, getSongLength()))
+	{
+		HudNote("Saved the mix to \"%s\".", path.filename().str());
 	}
-
-	myPlayPosition += srcAdvance;
 }
 
-
 // ================================================================================================
 // MusicImpl :: OggVorbis conversion.
 
@@ -442,7 +432,7 @@ void resumeStream()
 {
 	if(!myIsPaused)
 	{
-		myPlayPosition = myPlayStartTime * (double)mySamples.getFrequency();
+		myMix.playPosition = myPlayStartTime * (double)mySamples.getFrequency();
 		myPlayTimer = Debug::getElapsedTime();
 		myMixer->resume();
 	}
@@ -492,6 +482,11 @@ void tick()
 			finishOggConversion();
 		}
 	}
+
+	if(myKeysoundThread && myKeysoundThread->isDone())
+	{
+		finishLoadingKeysounds();
+	}
 }
 
 void pause()
@@ -516,6 +511,7 @@ void seek(double seconds)
 {
 	interruptStream();
 	myPlayStartTime = seconds;
+	myMix.voices.reset();
 	resumeStream();
 }
 
@@ -572,6 +568,20 @@ int getSpeed()
 	return myMusicSpeed;
 }
 
+void toggleTimeStretch()
+{
+	interruptStream();
+	myHasTimeStretch = !myHasTimeStretch;
+	resumeStream();
+	HudNote("Preserve pitch: %s", myHasTimeStretch ? "on" : "off");
+	gMenubar->update(Menubar::AUDIO_TIME_STRETCH);
+}
+
+bool hasTimeStretch()
+{
+	return myHasTimeStretch;
+}
+
 void setVolume(int vol)
 {
 	vol = min(max(vol, 0), 100);
@@ -608,9 +618,8 @@ bool isMuted()
 
 void toggleBeatTick()
 {
-	interruptStream();
 	myBeatTick.enabled = !myBeatTick.enabled;
-	resumeStream();
+	myMix.voices.setEnabled(TRACK_BEAT_TICKS, myBeatTick.enabled);
 	HudNote("Beat tick: %s", myBeatTick.enabled ? "on" : "off");
 }
 
@@ -621,9 +630,8 @@ bool hasBeatTick()
 
 void toggleNoteTick()
 {
-	interruptStream();
 	myNoteTick.enabled = !myNoteTick.enabled;
-	resumeStream();
+	myMix.voices.setEnabled(TRACK_NOTE_TICKS, myNoteTick.enabled);
 	HudNote("Note tick: %s", myNoteTick.enabled ? "on" : "off");
 }
 
@@ -635,37 +643,228 @@ bool hasNoteTick()
 // ================================================================================================
 // MusicImpl :: handling of external changes.
 
-void updateBeatTicks()
+// Returns the music frame at which a sound scheduled at the given time starts.
+int64_t GetVoiceFrame(double time)
 {
-	myBeatTick.frames.clear();
-
-	double freq = (double)mySamples.getFrequency();
 	double ofs = myTickOffsetMs / 1000.0;
+	return (int64_t)((time + ofs) * (double)mySamples.getFrequency());
+}
+
+void updateBeatTicks()
+{
+	std::vector<VoiceScheduler::Event> events;
 
 	TempoTimeTracker tracker(gTempo->getTimingData());
 	for(int row = 0, end = gSimfile->getEndRow(); row < end; row += ROWS_PER_BEAT)
 	{
 		double time = tracker.advance(row);
-		int frame = (int)((time + ofs) * freq);
-		myBeatTick.frames.push_back(frame);
+		events.push_back({GetVoiceFrame(time), SOUND_BEAT_TICK, VoiceScheduler::UNITY_GAIN});
+	}
+
+	myMix.voices.setEvents(TRACK_BEAT_TICKS, events);
+}
+
+// Adds the note tick and keysound events of the given notes.
+void AddNoteEvents(const ExpandedNote* begin, const ExpandedNote* end, NoteEvents& ticks, NoteEvents& keysounds)
+{
+	int numKeysounds = (int)myKeysounds.size();
+	for(auto note = begin; note != end; ++note)
+	{
+		if(note->isWarped) continue;
+
+		int64_t frame = GetVoiceFrame(note->time);
+		if(!(note->isMine | (note->type == NOTE_FAKE)))
+		{
+			ticks.events.push_back({frame, SOUND_NOTE_TICK, VoiceScheduler::UNITY_GAIN});
+			ticks.rows.push_back(note->row);
+		}
+		if(note->keysound > 0 && (int)note->keysound <= numKeysounds)
+		{
+			int sound = SOUND_FIRST_KEYSOUND + (int)note->keysound - 1;
+			keysounds.events.push_back({frame, sound, VoiceScheduler::UNITY_GAIN});
+			keysounds.rows.push_back(note->row);
+		}
 	}
 }
 
 void updateNoteTicks()
 {
-	myNoteTick.frames.clear();
+	myNoteTicks = NoteEvents();
+	myNoteKeysounds = NoteEvents();
+	AddNoteEvents(gNotes->begin(), gNotes->end(), myNoteTicks, myNoteKeysounds);
 
-	double freq = (double)mySamples.getFrequency();
-	double ofs = myTickOffsetMs / 1000.0;
+	// Notes are sorted by row, which keeps them sorted by time outside of warps. Otherwise, the
+	// events are sorted by time, and every edit rebuilds all of them.
+	auto& ticks = myNoteTicks.events;
+	auto& keysounds = myNoteKeysounds.events;
+	myNoteEventsByRow = std::is_sorted(ticks.begin(), ticks.end(), ByFrame) &&
+		std::is_sorted(keysounds.begin(), keysounds.end(), ByFrame);
+	if(!myNoteEventsByRow)
+	{
+		std::stable_sort(ticks.begin(), ticks.end(), ByFrame);
+		std::stable_sort(keysounds.begin(), keysounds.end(), ByFrame);
+	}
+
+	myMix.voices.setEvents(TRACK_NOTE_TICKS, ticks);
+	myMix.voices.setEvents(TRACK_KEYSOUNDS, keysounds);
+}
+
+// Rebuilds the note tick and keysound events of the notes in the rows [beginRow, endRow) only.
+void updateNoteTicks(int beginRow, int endRow)
+{
+	if(!myNoteEventsByRow)
+	{
+		updateNoteTicks();
+		return;
+	}
+
+	auto byRow = [](const ExpandedNote& note, int row) { return note.row < row; };
+	const ExpandedNote* first = std::lower_bound(gNotes->begin(), gNotes->end(), beginRow, byRow);
+	const ExpandedNote* last = std::lower_bound(first, gNotes->end(), endRow, byRow);
+
+	NoteEvents ticks, keysounds;
+	AddNoteEvents(first, last, ticks, keysounds);
+	if(!spliceNoteEvents(TRACK_NOTE_TICKS, myNoteTicks, ticks, beginRow, endRow) ||
+		!spliceNoteEvents(TRACK_KEYSOUNDS, myNoteKeysounds, keysounds, beginRow, endRow))
+	{
+		updateNoteTicks();
+	}
+}
+
+// Replaces the events of the notes in the rows [beginRow, endRow) with the given events. Returns
+// false if the events would no longer be sorted by time, in which case nothing is replaced.
+bool spliceNoteEvents(int track, NoteEvents& current, const NoteEvents& replacement, int beginRow, int endRow)
+{
+	auto& rows = current.rows;
+	auto& events = current.events;
+	auto& added = replacement.events;
+
+	size_t first = std::lower_bound(rows.begin(), rows.end(), beginRow) - rows.begin();
+	size_t last = std::lower_bound(rows.begin() + first, rows.end(), endRow) - rows.begin();
+	if(!std::is_sorted(added.begin(), added.end(), ByFrame)) return false;
+	if(!added.empty())
+	{
+		if(first > 0 && added.front().frame < events[first - 1].frame) return false;
+		if(last < events.size() && events[last].frame < added.back().frame) return false;
+	}
 
-	for(auto& note : *gNotes)
+	events.erase(events.begin() + first, events.begin() + last);
+	events.insert(events.begin() + first, added.begin(), added.end());
+	rows.erase(rows.begin() + first, rows.begin() + last);
+	rows.insert(rows.begin() + first, replacement.rows.begin(), replacement.rows.end());
+
+	myMix.voices.replaceEvents(track, first, last - first, added);
+	return true;
+}
+
+// Returns the index of the keysound with the given path, or -1 if it is not loaded.
+int findKeysound(const std::string& path)
+{
+	auto it = std::find(myKeysoundPaths.begin(), myKeysoundPaths.end(), path);
+	if(it == myKeysoundPaths.end() || !myKeysounds[it - myKeysoundPaths.begin()]) return -1;
+	return (int)(it - myKeysoundPaths.begin());
+}
+
+// Loads the keysounds of the active chart, reusing the sounds that were already loaded. The other
+// sounds are loaded in the background, and replace the current keysounds once they are loaded.
+void updateKeysounds()
+{
+	std::vector<std::string> paths;
+	const Chart* chart = gChart->get();
+	if(!gSimfile->isClosed() && chart)
+	{
+		String dir = gSimfile->getDir();
+		for(auto& file : chart->getTempo(gSimfile->get())->keysounds)
+		{
+			Path path(dir, file);
+			paths.push_back(path.str.str());
+		}
+	}
+	if(myKeysoundThread)
+	{
+		if(paths == myPendingKeysoundPaths) return;
+		stopLoadingKeysounds();
+	}
+	if(paths == myKeysoundPaths) return;
+
+	// A keysound that is listed more than once gets a sound for every entry.
+	auto thread = new KeysoundThread;
+	for(size_t i = 0; i < paths.size(); ++i)
+	{
+		bool isRepeated = std::find(paths.begin(), paths.begin() + i, paths[i]) != paths.begin() + i;
+		if(isRepeated || findKeysound(paths[i]) < 0)
+		{
+			thread->paths.push_back(paths[i]);
+			thread->targets.push_back((int)i);
+		}
+	}
+	myKeysoundThread = thread;
+	myPendingKeysoundPaths.swap(paths);
+
+	if(gEditor->hasMultithreading() && !thread->paths.empty())
+	{
+		thread->start();
+	}
+	else
 	{
-		if(!(note.isMine | note.isWarped | (note.type == NOTE_FAKE)))
+		thread->exec();
+		finishLoadingKeysounds();
+	}
+}
+
+void finishLoadingKeysounds()
+{
+	std::vector<std::string> paths;
+	paths.swap(myPendingKeysoundPaths);
+
+	std::vector<std::unique_ptr<Sound>> sounds(paths.size());
+	std::vector<bool> isLoaded(paths.size(), false);
+	for(size_t i = 0; i < myKeysoundThread->targets.size(); ++i)
+	{
+		int target = myKeysoundThread->targets[i];
+		sounds[target] = std::move(myKeysoundThread->sounds[i]);
+		isLoaded[target] = true;
+		if(!sounds[target])
 		{
-			int frame = (int)((note.time + ofs) * freq);
-			myNoteTick.frames.push_back(frame);
+			HudWarning("Could not load keysound \"%s\".", paths[target].c_str());
 		}
 	}
+	for(size_t i = 0; i < paths.size(); ++i)
+	{
+		int index = isLoaded[i] ? -1 : findKeysound(paths[i]);
+		if(index >= 0) sounds[i] = std::move(myKeysounds[index]);
+	}
+	delete myKeysoundThread;
+	myKeysoundThread = nullptr;
+
+	// The old sounds are only released after the scheduler stops using them.
+	myKeysoundPaths.swap(paths);
+	myKeysounds.swap(sounds);
+	updateVoiceSounds();
+
+	// Keysound events are only scheduled for the sounds in the table.
+	if(!gSimfile->isClosed()) updateNoteTicks();
+}
+
+void stopLoadingKeysounds()
+{
+	if(myKeysoundThread)
+	{
+		myKeysoundThread->terminate();
+		delete myKeysoundThread;
+		myKeysoundThread = nullptr;
+		myPendingKeysoundPaths.clear();
+	}
+}
+
+void updateVoiceSounds()
+{
+	std::vector<const Sound*> sounds = {&myBeatTick.sound, &myNoteTick.sound};
+	for(auto& keysound : myKeysounds)
+	{
+		sounds.push_back(keysound.get());
+	}
+	myMix.voices.setSounds(sounds);
 }
 
 void onChanges(int changes)
@@ -674,20 +873,31 @@ void onChanges(int changes)
 
 	if (changes & bits)
 	{
-		if (changes & VCM_CHART_CHANGED) interruptStream();
+		// Only the events that changed are replaced, so playback continues during edits.
+		if (changes & VCM_CHART_CHANGED) updateKeysounds();
 
-		if (changes & VCM_TEMPO_CHANGED)
+		if (changes & (VCM_TEMPO_CHANGED | VCM_CHART_CHANGED))
 		{
 			updateNoteTicks();
 			updateBeatTicks();
 		}
 		else
 		{
-			if (changes & VCM_NOTES_CHANGED) updateNoteTicks();
+			if (changes & VCM_NOTES_CHANGED)
+			{
+				// Edits only rebuild the events of the rows they changed.
+				int beginRow, endRow;
+				if(!gNotes->getChangedRows(beginRow, endRow))
+				{
+					updateNoteTicks();
+				}
+				else if(beginRow < endRow)
+				{
+					updateNoteTicks(beginRow, endRow);
+				}
+			}
 			if (changes & VCM_END_ROW_CHANGED) updateBeatTicks();
 		}
-    
-		if (changes & VCM_CHART_CHANGED) resumeStream();
 	}
 }
 
@@ -49,6 +49,13 @@ struct Music
 	/// Returns the playback speed of the audio mixer [10-400%].
 	virtual int getSpeed() = 0;
 
+	/// Enables/disables time-stretching, which preserves the pitch of the music at playback speeds
+	/// other than 100%, instead of resampling it.
+	virtual void toggleTimeStretch() = 0;
+
+	/// Returns true if time-stretching is enabled, false otherwise.
+	virtual bool hasTimeStretch() = 0;
+
 	/// Enables/disables the beat tick sound.
 	virtual void toggleBeatTick() = 0;
 
@@ -67,6 +74,15 @@ struct Music
 	/// and the ogg-vorbis file is saved.
 	virtual void startOggConversion() = 0;
 
+	/// Renders the mix of the music, ticks and keysounds between the given song times to a wav file,
+	/// at the current speed and volume. Rendering does not wait for the audio device, so it runs
+	/// faster than real time, and the output is the same on every run. The render runs on the
+	/// calling thread without progress, so the editor does not respond until the file is written.
+	virtual bool renderToFile(const std::string& path, double startTime, double endTime) = 0;
+
+	/// Renders the mix of the entire song to a wav file next to the music file.
+	virtual void renderMixToWav() = 0;
+
 	/// Returns true if the audio mixer is paused, false otherwise.
 	virtual bool isPaused() = 0;
 
@@ -0,0 +1,66 @@
+#include <Editor/MusicMix.h>
+
+#include <System/MixKernels.h>
+
+#include <string.h>
+
+namespace Vortex {
+
+static const int MIX_CHANNELS = 2;
+
+static void ApplyMusicVolume(short* buffer, int frames,
+                             const MusicMixInput& input) {
+    if (input.volume == 0 || input.isMuted) {
+        memset(buffer, 0, sizeof(short) * MIX_CHANNELS * frames);
+    } else if (input.volume != 100) {
+        int vol = ((input.volume * input.volume) << 15) / (100 * 100);
+        MixKernels::scale(buffer, frames * MIX_CHANNELS, vol);
+    }
+}
+
+// ================================================================================================
+// MusicMix.
+
+MusicMix::MusicMix(int numVoiceTracks)
+    : voices(numVoiceTracks), playPosition(0.0) {}
+
+void MusicMix::write(short* buffer, int frames, const MusicMixInput& input) {
+    double speed = (double)input.speed / 100.0;
+    double srcStep = speed * (double)input.musicRate / (double)input.outputRate;
+
+    // Other speeds are either stretched in time, which preserves the pitch, or
+    // resampled. Both also convert the music to the output samplerate.
+    bool stretched = input.hasTimeStretch && input.speed != 100;
+    if (stretched) {
+        // The stretcher also runs while muted, so it stays in step with the
+        // play position.
+        timeStretch.process(buffer, frames, playPosition, srcStep,
+                            input.samplesL, input.samplesR,
+                            input.samplesL ? input.numFrames : 0);
+        ApplyMusicVolume(buffer, frames, input);
+    } else if (!input.samplesL || input.volume == 0 || input.isMuted) {
+        memset(buffer, 0, sizeof(short) * MIX_CHANNELS * frames);
+    } else {
+        // At normal speed and the music samplerate, the resampler copies the
+        // source frames as is.
+        resampler.setStep(srcStep);
+        resampler.write(buffer, frames, playPosition, input.samplesL,
+                        input.samplesR, input.numFrames);
+        ApplyMusicVolume(buffer, frames, input);
+    }
+
+    // Write beat ticks, note ticks and keysounds. Without time-stretching,
+    // they follow the speed of the music, otherwise they play at their
+    // original pitch.
+    double pitch = stretched ? 1.0 : speed;
+    voices.mix(buffer, frames, playPosition, srcStep, pitch, input.outputRate);
+
+    playPosition += frames * srcStep;
+}
+
+void MusicMix::reset() {
+    timeStretch.reset();
+    voices.reset();
+}
+
+};  // namespace Vortex
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Editor/Resampler.h>
+#include <Editor/TimeStretch.h>
+#include <Editor/VoiceScheduler.h>
+
+namespace Vortex {
+
+/// What the music player feeds into the mix for every block of output frames.
+struct MusicMixInput {
+    const short* samplesL;  ///< Music samples, or null if they are not
+    const short* samplesR;  ///< allocated yet, which mixes silent music.
+    int numFrames;          ///< Number of music frames.
+    int musicRate;          ///< Samplerate of the music.
+    int outputRate;         ///< Samplerate of the output.
+    int speed;              ///< Playback speed, in percent.
+    int volume;             ///< Music volume, in percent.
+    bool isMuted;
+    bool hasTimeStretch;    ///< Preserve the pitch at other speeds.
+};
+
+/// The mix that is played back and rendered to file: the music, resampled or
+/// time-stretched to the output samplerate and scaled by the music volume,
+/// with the ticks and keysounds of the voice scheduler on top.
+struct MusicMix {
+    explicit MusicMix(int numVoiceTracks);
+
+    /// Writes interleaved stereo output frames from the play position on, and
+    /// advances the play position.
+    void write(short* buffer, int numFrames, const MusicMixInput& input);
+
+    /// Stops the voices and the time-stretcher, so the next call to "write"
+    /// starts from a new play position.
+    void reset();
+
+    VoiceScheduler voices;
+    Resampler resampler;
+    TimeStretch timeStretch;
+    double playPosition;  ///< Music frame of the next output frame.
+};
+
+};  // namespace Vortex
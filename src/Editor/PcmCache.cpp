@@ -0,0 +1,307 @@
+#include <Editor/PcmCache.h>
+
+#include <Core/StringUtils.h>
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace Vortex {
+namespace PcmCache {
+
+static const char* CACHE_DIR = "cache/pcm";
+static const char CACHE_EXT[] = ".pcm";
+static const char CACHE_MAGIC[8] = {'A', 'V', 'P', 'C', 'M', 0, 0, 1};
+
+static const int HASH_SAMPLE_SIZE = 64 * 1024;
+static const int DATA_ALIGNMENT = 64;
+static const int WRITE_CHUNK_FRAMES = 1 << 20;
+
+// Set from the settings on the main thread, and read by the decode tasks that
+// store entries.
+static std::atomic<uint64_t> sizeLimit(static_cast<uint64_t>(2048) << 20);
+
+// Total size of the cache files, which is counted once when the first entry is
+// stored, and kept up to date by every store after that.
+static std::mutex cacheMutex;
+static uint64_t cacheSize = 0;
+static bool cacheSizeKnown = false;
+
+// Layout of a cache file: the header is followed by the source path, title
+// and artist strings, and the aligned left and right channel samples.
+struct Header {
+    char magic[8];
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t contentHash;
+    int32_t frequency;
+    int32_t numFrames;
+    uint32_t pathLength;
+    uint32_t titleLength;
+    uint32_t artistLength;
+    uint32_t dataOffset;
+};
+
+struct SourceInfo {
+    uint64_t size;
+    int64_t time;
+    uint64_t contentHash;
+};
+
+struct CacheFile {
+    fs::path path;
+    fs::file_time_type time;
+    uint64_t size;
+};
+
+// ================================================================================================
+// Helper functions.
+
+static uint64_t Fnv1a(const void* data, size_t size,
+                      uint64_t hash = 14695981039346656037ull) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool GetSourceInfo(const fs::path& source, SourceInfo& out) {
+    std::error_code ec;
+    out.size = fs::file_size(source, ec);
+    if (ec) return false;
+
+    auto time = fs::last_write_time(source, ec);
+    if (ec) return false;
+    out.time = static_cast<int64_t>(time.time_since_epoch().count());
+
+    // Together with the size and modification time, hashing the start and end
+    // of the file detects replaced files without reading all of it.
+    std::ifstream in(source, std::ios::in | std::ios::binary);
+    if (!in.good()) return false;
+
+    std::vector<char> buffer(HASH_SAMPLE_SIZE);
+    in.read(buffer.data(), HASH_SAMPLE_SIZE);
+    out.contentHash = Fnv1a(buffer.data(), static_cast<size_t>(in.gcount()));
+    if (out.size > HASH_SAMPLE_SIZE * 2) {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(out.size - HASH_SAMPLE_SIZE));
+        in.read(buffer.data(), HASH_SAMPLE_SIZE);
+        out.contentHash = Fnv1a(
+            buffer.data(), static_cast<size_t>(in.gcount()), out.contentHash);
+    }
+
+    return true;
+}
+
+// The name of a cache file is derived from the source path, size and
+// modification time, so a changed source never maps to the entry of the
+// previous version; that entry is left for eviction.
+static fs::path GetCachePath(const fs::path& source, const SourceInfo& info) {
+    std::string key = pathToUtf8(fs::absolute(source));
+    uint64_t hash = Fnv1a(key.data(), key.size());
+    hash = Fnv1a(&info.size, sizeof(info.size), hash);
+    hash = Fnv1a(&info.time, sizeof(info.time), hash);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx%s",
+             static_cast<unsigned long long>(hash), CACHE_EXT);
+    return fs::path(CACHE_DIR) / name;
+}
+
+static void WriteSamples(std::ofstream& out, const short* samples,
+                         int numFrames, const std::stop_token& token) {
+    for (int pos = 0; pos < numFrames && out.good(); pos += WRITE_CHUNK_FRAMES) {
+        if (token.stop_requested()) return;
+        int n = std::min(WRITE_CHUNK_FRAMES, numFrames - pos);
+        out.write(reinterpret_cast<const char*>(samples + pos),
+                  static_cast<std::streamsize>(n) * sizeof(short));
+    }
+}
+
+static uint64_t ListEntries(std::vector<CacheFile>* files) {
+    std::error_code ec;
+    uint64_t totalSize = 0;
+    for (const auto& entry : fs::directory_iterator(CACHE_DIR, ec)) {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != CACHE_EXT)
+            continue;
+        CacheFile file = {entry.path(), entry.last_write_time(ec),
+                          entry.file_size(ec)};
+        if (ec) continue;
+        totalSize += file.size;
+        if (files) files->push_back(file);
+    }
+    return totalSize;
+}
+
+// Removes the least recently used entries until the cache fits its size limit.
+// Only called when the running size exceeds the limit, so the directory is not
+// listed and sorted on every store. Must be called with the cache mutex held.
+static void EvictEntries() {
+    std::error_code ec;
+    std::vector<CacheFile> files;
+    uint64_t totalSize = ListEntries(&files);
+    uint64_t limit = sizeLimit;
+
+    // The modification time of an entry is updated whenever it is opened.
+    std::sort(files.begin(), files.end(),
+              [](const CacheFile& a, const CacheFile& b) {
+                  return a.time < b.time;
+              });
+
+    for (auto& file : files) {
+        if (totalSize <= limit) break;
+        if (fs::remove(file.path, ec)) totalSize -= file.size;
+    }
+    cacheSize = totalSize;
+}
+
+// ================================================================================================
+// PcmCache API.
+
+void setSizeLimit(uint64_t bytes) { sizeLimit = bytes; }
+
+uint64_t getSizeLimit() { return sizeLimit; }
+
+bool isCacheable(const fs::path& source) {
+    if (sizeLimit == 0) return false;
+
+    // Uncompressed files load about as fast as the cache itself.
+    auto ext = pathToUtf8(source.extension());
+    Str::toLower(ext);
+    return ext == ".mp3" || ext == ".ogg";
+}
+
+bool open(const fs::path& source, MappedFile& mapping, PcmCacheEntry& out) {
+    SourceInfo info;
+    if (!GetSourceInfo(source, info)) return false;
+
+    fs::path path = GetCachePath(source, info);
+    if (!mapping.open(path)) return false;
+
+    Header h;
+    if (mapping.size() < sizeof(Header)) {
+        mapping.close();
+        return false;
+    }
+    memcpy(&h, mapping.data(), sizeof(Header));
+
+    const char* strings =
+        reinterpret_cast<const char*>(mapping.data() + sizeof(Header));
+    std::string key = pathToUtf8(fs::absolute(source));
+    uint64_t stringsEnd = sizeof(Header) + static_cast<uint64_t>(h.pathLength) +
+                          h.titleLength + h.artistLength;
+    uint64_t dataEnd = h.dataOffset + static_cast<uint64_t>(h.numFrames) *
+                                          sizeof(short) * 2;
+
+    bool valid = memcmp(h.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 &&
+                 h.sourceSize == info.size && h.sourceTime == info.time &&
+                 h.contentHash == info.contentHash && h.frequency > 0 &&
+                 h.numFrames > 0 && h.dataOffset % DATA_ALIGNMENT == 0 &&
+                 stringsEnd <= h.dataOffset && dataEnd <= mapping.size() &&
+                 h.pathLength == key.size() &&
+                 memcmp(strings, key.data(), key.size()) == 0;
+    if (!valid) {
+        mapping.close();
+        return false;
+    }
+
+    strings += h.pathLength;
+    out.title.assign(strings, h.titleLength);
+    strings += h.titleLength;
+    out.artist.assign(strings, h.artistLength);
+
+    auto samples = reinterpret_cast<const short*>(mapping.data() + h.dataOffset);
+    out.samplesL = samples;
+    out.samplesR = samples + h.numFrames;
+    out.frequency = h.frequency;
+    out.numFrames = h.numFrames;
+
+    // Mark the entry as recently used.
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+    return true;
+}
+
+void store(const fs::path& source, const PcmCacheEntry& entry,
+           std::stop_token token) {
+    if (sizeLimit == 0 || entry.numFrames <= 0) return;
+
+    SourceInfo info;
+    if (!GetSourceInfo(source, info)) return;
+
+    std::string key = pathToUtf8(fs::absolute(source));
+
+    Header h = {};
+    memcpy(h.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    h.sourceSize = info.size;
+    h.sourceTime = info.time;
+    h.contentHash = info.contentHash;
+    h.frequency = entry.frequency;
+    h.numFrames = entry.numFrames;
+    h.pathLength = static_cast<uint32_t>(key.size());
+    h.titleLength = static_cast<uint32_t>(entry.title.size());
+    h.artistLength = static_cast<uint32_t>(entry.artist.size());
+
+    size_t stringsEnd =
+        sizeof(Header) + key.size() + entry.title.size() + entry.artist.size();
+    h.dataOffset = static_cast<uint32_t>(
+        (stringsEnd + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT);
+
+    // Entries that do not fit in the cache at all are not written.
+    uint64_t fileSize = h.dataOffset + static_cast<uint64_t>(entry.numFrames) *
+                                           sizeof(short) * 2;
+    if (fileSize > sizeLimit) return;
+
+    std::vector<char> prefix(h.dataOffset, 0);
+    char* dst = prefix.data();
+    memcpy(dst, &h, sizeof(Header));
+    dst += sizeof(Header);
+    memcpy(dst, key.data(), key.size());
+    dst += key.size();
+    memcpy(dst, entry.title.data(), entry.title.size());
+    dst += entry.title.size();
+    memcpy(dst, entry.artist.data(), entry.artist.size());
+
+    // Write to a temporary file first, so a partially written entry is never
+    // picked up by "open".
+    std::error_code ec;
+    fs::create_directories(CACHE_DIR, ec);
+    fs::path path = GetCachePath(source, info);
+    fs::path temp = path;
+    temp += ".tmp";
+
+    std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.good()) return;
+
+    out.write(prefix.data(), static_cast<std::streamsize>(prefix.size()));
+    WriteSamples(out, entry.samplesL, entry.numFrames, token);
+    WriteSamples(out, entry.samplesR, entry.numFrames, token);
+    bool success = out.good() && !token.stop_requested();
+    out.close();
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!cacheSizeKnown) {
+        cacheSize = ListEntries(nullptr);
+        cacheSizeKnown = true;
+    }
+
+    uint64_t replacedSize = fs::file_size(path, ec);
+    if (ec) replacedSize = 0;
+
+    if (success) fs::rename(temp, path, ec);
+    if (!success || ec) {
+        fs::remove(temp, ec);
+        return;
+    }
+
+    cacheSize = cacheSize - std::min(replacedSize, cacheSize) + fileSize;
+    if (cacheSize > sizeLimit) EvictEntries();
+}
+
+};  // namespace PcmCache
+};  // namespace Vortex
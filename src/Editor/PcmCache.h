@@ -0,0 +1,55 @@
+#pragma once
+
+#include <System/File.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <stop_token>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace Vortex {
+
+/// Decoded samples of a sound, as stored in the PCM cache.
+struct PcmCacheEntry {
+    const short* samplesL;
+    const short* samplesR;
+    int frequency;
+    int numFrames;
+    std::string title;
+    std::string artist;
+};
+
+/// On-disk cache of decoded audio. Every cached source file is stored as
+/// planar 16-bit PCM in a file that can be memory-mapped, so reopening a song
+/// does not have to decode it again. Entries are keyed by the source path,
+/// size and modification time, and are only used while a hash of the start and
+/// end of the source file is also unchanged.
+namespace PcmCache {
+
+/// Sets the maximum total size of the cache files in bytes. When the cache
+/// grows beyond this size, the least recently used entries are removed. A
+/// limit of zero disables the cache.
+void setSizeLimit(uint64_t bytes);
+
+/// Returns the maximum total size of the cache files in bytes.
+uint64_t getSizeLimit();
+
+/// Returns true if sounds decoded from the given file are worth caching.
+bool isCacheable(const fs::path& source);
+
+/// Maps the cached samples of the given source file into memory. Returns false
+/// if the source is not cached, or has changed since it was cached. On success,
+/// the sample pointers of the entry remain valid while the mapping is open.
+bool open(const fs::path& source, MappedFile& mapping, PcmCacheEntry& out);
+
+/// Writes the decoded samples of the given source file to the cache, and
+/// evicts the least recently used entries until the cache fits its size limit.
+/// Writing stops without leaving a partial entry when a stop is requested.
+void store(const fs::path& source, const PcmCacheEntry& entry,
+           std::stop_token token);
+
+};  // namespace PcmCache
+
+};  // namespace Vortex
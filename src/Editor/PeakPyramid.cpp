@@ -0,0 +1,134 @@
+#include <Editor/PeakPyramid.h>
+
+#include <limits.h>
+#include <algorithm>
+
+namespace Vortex {
+
+static void ScanSamples(const short* samples, int begin, int end, int& lo,
+                        int& hi) {
+    for (const short *it = samples + begin, *last = samples + end; it != last;
+         ++it) {
+        lo = std::min(lo, static_cast<int>(*it));
+        hi = std::max(hi, static_cast<int>(*it));
+    }
+}
+
+static void ScanPeaks(const PeakPyramid::Peak* peaks, int begin, int end,
+                      int& lo, int& hi) {
+    for (const PeakPyramid::Peak *it = peaks + begin, *last = peaks + end;
+         it != last; ++it) {
+        lo = std::min(lo, static_cast<int>(it->lo));
+        hi = std::max(hi, static_cast<int>(it->hi));
+    }
+}
+
+PeakPyramid::PeakPyramid()
+    : mySamples(nullptr), myTotalFrames(0), myNumFrames(0) {}
+
+void PeakPyramid::clear() {
+    myLevels.clear();
+    mySamples = nullptr;
+    myTotalFrames = 0;
+    myNumFrames = 0;
+}
+
+void PeakPyramid::allocate(const short* samples, int totalFrames) {
+    clear();
+
+    mySamples = samples;
+    myTotalFrames = std::max(totalFrames, 0);
+
+    // Every coarser level pairs up the entries of the level below it. A
+    // trailing unpaired entry is left out; queries fall back to the finer
+    // level for it.
+    for (int size = myTotalFrames >> BASE_SHIFT; size > 0; size /= 2) {
+        myLevels.emplace_back(size);
+    }
+}
+
+void PeakPyramid::extend(int numFrames) {
+    int oldFrames = myNumFrames.load(std::memory_order_relaxed);
+    numFrames = std::min(numFrames, myTotalFrames);
+    if (numFrames <= oldFrames) return;
+
+    // Entry i of level k is complete once all samples of its run are
+    // available, so only the entries between the old and new count change.
+    const int baseSize = 1 << BASE_SHIFT;
+    int begin = oldFrames >> BASE_SHIFT;
+    int end = numFrames >> BASE_SHIFT;
+    for (size_t level = 0; level < myLevels.size() && begin < end; ++level) {
+        Peak* dst = myLevels[level].data();
+        if (level == 0) {
+            for (int i = begin; i < end; ++i) {
+                int lo = SHRT_MAX, hi = SHRT_MIN;
+                ScanSamples(mySamples, i * baseSize, (i + 1) * baseSize, lo,
+                            hi);
+                dst[i] = {static_cast<short>(lo), static_cast<short>(hi)};
+            }
+        } else {
+            const Peak* src = myLevels[level - 1].data();
+            for (int i = begin; i < end; ++i) {
+                const Peak* pair = src + i * 2;
+                dst[i] = {std::min(pair[0].lo, pair[1].lo),
+                          std::max(pair[0].hi, pair[1].hi)};
+            }
+        }
+        begin /= 2;
+        end /= 2;
+    }
+
+    myNumFrames.store(numFrames, std::memory_order_release);
+}
+
+void PeakPyramid::build(const short* samples, int numFrames) {
+    allocate(samples, numFrames);
+    extend(numFrames);
+}
+
+bool PeakPyramid::getPeak(int begin, int end, int& outLo, int& outHi) const {
+    begin = std::max(begin, 0);
+    end = std::min(end, getNumFrames());
+    if (begin >= end) return false;
+
+    int lo = SHRT_MAX, hi = SHRT_MIN;
+
+    // Raw samples before the first and after the last whole base block.
+    const int baseMask = (1 << BASE_SHIFT) - 1;
+    int first = (begin + baseMask) & ~baseMask;
+    int last = end & ~baseMask;
+    if (first >= last || myLevels.empty()) {
+        ScanSamples(mySamples, begin, end, lo, hi);
+    } else {
+        ScanSamples(mySamples, begin, first, lo, hi);
+        ScanSamples(mySamples, last, end, lo, hi);
+
+        // Walk up the levels, consuming unpaired entries at both ends of the
+        // range until it is fully covered by the coarsest exact entries.
+        int a = first >> BASE_SHIFT, b = last >> BASE_SHIFT;
+        int top = static_cast<int>(myLevels.size()) - 1;
+        for (int level = 0; a < b; ++level) {
+            const Peak* peaks = myLevels[level].data();
+            if (level == top) {
+                ScanPeaks(peaks, a, b, lo, hi);
+                break;
+            }
+            if (a & 1) {
+                ScanPeaks(peaks, a, a + 1, lo, hi);
+                ++a;
+            }
+            if (b & 1) {
+                --b;
+                ScanPeaks(peaks, b, b + 1, lo, hi);
+            }
+            a >>= 1;
+            b >>= 1;
+        }
+    }
+
+    outLo = lo;
+    outHi = hi;
+    return true;
+}
+
+};  // namespace Vortex
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace Vortex {
+
+/// Multi-resolution min/max summary of a single channel of samples. Level k
+/// stores the minimum and maximum of every aligned run of 2^(k + BASE_SHIFT)
+/// samples, so the exact peaks of any sample range can be found by combining
+/// at most two entries per level instead of scanning the raw samples.
+class PeakPyramid {
+   public:
+    struct Peak {
+        short lo, hi;
+    };
+
+    /// Number of samples summarized by a single entry of the finest level.
+    static const int BASE_SHIFT = 4;
+
+    PeakPyramid();
+
+    /// Removes all levels and detaches the pyramid from its samples.
+    void clear();
+
+    /// Allocates the levels for a signal of the given length, without
+    /// summarizing any samples yet. The samples are not copied and must stay
+    /// valid for as long as the pyramid is used.
+    void allocate(const short* samples, int totalFrames);
+
+    /// Summarizes the allocated samples up to the given frame. This can be
+    /// called while other threads query the frames that were already covered,
+    /// which allows the pyramid to grow while the samples are being decoded.
+    void extend(int numFrames);
+
+    /// Allocates and summarizes the given samples in one go.
+    void build(const short* samples, int numFrames);
+
+    /// Finds the minimum and maximum sample value in the range [begin, end).
+    /// Returns false if the range does not contain any samples.
+    bool getPeak(int begin, int end, int& outLo, int& outHi) const;
+
+    /// Returns the number of samples covered by the pyramid.
+    int getNumFrames() const {
+        return myNumFrames.load(std::memory_order_acquire);
+    }
+
+    /// Returns the number of levels above the raw samples.
+    int getNumLevels() const { return static_cast<int>(myLevels.size()); }
+
+   private:
+    std::vector<std::vector<Peak>> myLevels;
+    const short* mySamples;
+    int myTotalFrames;
+    std::atomic<int> myNumFrames;
+};
+
+};  // namespace Vortex
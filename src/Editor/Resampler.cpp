@@ -0,0 +1,339 @@
+#include <Editor/Resampler.h>
+
+#include <Core/Utils.h>
+
+#include <System/CpuFeatures.h>
+#include <System/MixKernels.h>
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef CPU_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef CPU_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace Vortex {
+
+static const double PI = 3.14159265358979323846;
+
+// Number of taps when the source is not read faster than it is written. The
+// tap count grows with the step when downsampling, to keep the same
+// transition width relative to the lowered cutoff.
+static const int BASE_TAPS = 32;
+static const int MAX_TAPS = 128;
+
+// Tap counts are rounded to a multiple of this, for the vector kernels.
+static const int TAP_ALIGNMENT = 8;
+
+// Number of precomputed sub-sample phases.
+static const int NUM_PHASES = 128;
+
+// Cutoff relative to the lowest of the source and output Nyquist frequency.
+static const double CUTOFF = 0.88;
+
+// Shape of the Kaiser window, which trades transition width for stopband
+// attenuation. This gives roughly 70 dB of attenuation.
+static const double KAISER_BETA = 7.0;
+
+// ================================================================================================
+// Filter design.
+
+// Zeroth order modified Bessel function of the first kind.
+static double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 64; ++k) {
+        double f = x / (2.0 * k);
+        term *= f * f;
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// Fills the table with one row of taps per phase. Row p is centered on the
+// position p / NUM_PHASES past tap (numTaps / 2 - 1).
+static void BuildTable(std::vector<float>& table, int numTaps, double cutoff) {
+    const int half = numTaps / 2;
+    const double norm = 1.0 / BesselI0(KAISER_BETA);
+
+    table.resize((NUM_PHASES + 1) * numTaps);
+    std::vector<double> row(numTaps);
+    for (int p = 0; p <= NUM_PHASES; ++p) {
+        double frac = static_cast<double>(p) / NUM_PHASES;
+        double sum = 0.0;
+        for (int k = 0; k < numTaps; ++k) {
+            double x = (k - (half - 1)) - frac;
+            double w = x / half;
+            double window =
+                w * w < 1.0 ? BesselI0(KAISER_BETA * sqrt(1.0 - w * w)) * norm
+                            : 0.0;
+            double t = PI * cutoff * x;
+            double sinc = fabs(t) < 1e-9 ? 1.0 : sin(t) / t;
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+
+        // Normalize to unity gain at DC, so silence and offsets are kept.
+        float* dst = table.data() + p * numTaps;
+        for (int k = 0; k < numTaps; ++k) {
+            dst[k] = static_cast<float>(row[k] / sum);
+        }
+    }
+}
+
+// ================================================================================================
+// Kernels.
+
+// Computes one stereo output frame, using the taps interpolated between two
+// adjacent phases: taps = row0 + (row1 - row0) * t.
+typedef void (*Kernel)(const float* row0, const float* row1, float t,
+                       const short* l, const short* r, int numTaps, float* out);
+
+static void KernelScalar(const float* row0, const float* row1, float t,
+                         const short* l, const short* r, int numTaps,
+                         float* out) {
+    float sumL = 0.0f, sumR = 0.0f;
+    for (int k = 0; k < numTaps; ++k) {
+        float c = row0[k] + (row1[k] - row0[k]) * t;
+        sumL += l[k] * c;
+        sumR += r[k] * c;
+    }
+    out[0] = sumL;
+    out[1] = sumR;
+}
+
+#ifdef CPU_HAS_SSE2
+
+static float HorizontalSum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+// Converts the low or high four of eight 16-bit samples to float.
+static inline __m128 ToFloatLo(__m128i v) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+}
+
+static inline __m128 ToFloatHi(__m128i v) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+}
+
+static void KernelSse2(const float* row0, const float* row1, float t,
+                       const short* l, const short* r, int numTaps,
+                       float* out) {
+    const __m128 vt = _mm_set1_ps(t);
+    __m128 sumL0 = _mm_setzero_ps(), sumL1 = _mm_setzero_ps();
+    __m128 sumR0 = _mm_setzero_ps(), sumR1 = _mm_setzero_ps();
+    for (int k = 0; k < numTaps; k += 8) {
+        __m128 a0 = _mm_loadu_ps(row0 + k), a1 = _mm_loadu_ps(row0 + k + 4);
+        __m128 b0 = _mm_loadu_ps(row1 + k), b1 = _mm_loadu_ps(row1 + k + 4);
+        __m128 c0 = _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(b0, a0), vt));
+        __m128 c1 = _mm_add_ps(a1, _mm_mul_ps(_mm_sub_ps(b1, a1), vt));
+
+        // Sign-extend the 16-bit samples to 32 bits, then convert to float.
+        __m128i sl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + k));
+        __m128i sr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + k));
+        __m128 l0 = ToFloatLo(sl), l1 = ToFloatHi(sl);
+        __m128 r0 = ToFloatLo(sr), r1 = ToFloatHi(sr);
+
+        sumL0 = _mm_add_ps(sumL0, _mm_mul_ps(l0, c0));
+        sumL1 = _mm_add_ps(sumL1, _mm_mul_ps(l1, c1));
+        sumR0 = _mm_add_ps(sumR0, _mm_mul_ps(r0, c0));
+        sumR1 = _mm_add_ps(sumR1, _mm_mul_ps(r1, c1));
+    }
+    out[0] = HorizontalSum(_mm_add_ps(sumL0, sumL1));
+    out[1] = HorizontalSum(_mm_add_ps(sumR0, sumR1));
+}
+
+#endif  // CPU_HAS_SSE2
+
+#ifdef CPU_HAS_AVX2
+
+CPU_TARGET_AVX2 static void KernelAvx2(const float* row0, const float* row1,
+                                       float t, const short* l, const short* r,
+                                       int numTaps, float* out) {
+    const __m256 vt = _mm256_set1_ps(t);
+    __m256 sumL = _mm256_setzero_ps(), sumR = _mm256_setzero_ps();
+    for (int k = 0; k < numTaps; k += 8) {
+        __m256 a = _mm256_loadu_ps(row0 + k);
+        __m256 b = _mm256_loadu_ps(row1 + k);
+        __m256 c = _mm256_fmadd_ps(_mm256_sub_ps(b, a), vt, a);
+
+        __m128i sl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + k));
+        __m128i sr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + k));
+        __m256 vl = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(sl));
+        __m256 vr = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(sr));
+
+        sumL = _mm256_fmadd_ps(vl, c, sumL);
+        sumR = _mm256_fmadd_ps(vr, c, sumR);
+    }
+
+    // Sum the eight lanes of both channels at once.
+    __m256 lr = _mm256_hadd_ps(sumL, sumR);
+    __m128 v = _mm_add_ps(_mm256_castps256_ps128(lr),
+                          _mm256_extractf128_ps(lr, 1));
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    out[0] = _mm_cvtss_f32(v);
+    out[1] = _mm_cvtss_f32(_mm_shuffle_ps(v, v, 2));
+}
+
+#endif  // CPU_HAS_AVX2
+
+static Kernel SelectKernel() {
+    CpuFeatures::Level level = CpuFeatures::getLevel();
+#ifdef CPU_HAS_AVX2
+    if (level >= CpuFeatures::AVX2) return KernelAvx2;
+#endif
+#ifdef CPU_HAS_SSE2
+    if (level >= CpuFeatures::SSE2) return KernelSse2;
+#endif
+    return KernelScalar;
+}
+
+static inline short Saturate(int v) {
+    return static_cast<short>(clamp(v, SHRT_MIN, SHRT_MAX));
+}
+
+static inline short ToSample(float v) {
+    return Saturate(static_cast<int>(lrintf(v)));
+}
+
+static inline short AddSample(short a, float v) {
+    return Saturate(a + static_cast<int>(lrintf(v)));
+}
+
+// ================================================================================================
+// Resampler.
+
+Resampler::Resampler()
+    : myStep(0.0),
+      myCutoff(0.0),
+      myNumTaps(0),
+      myEdgeL(MAX_TAPS),
+      myEdgeR(MAX_TAPS) {
+    setStep(1.0);
+}
+
+void Resampler::setStep(double step) {
+    myStep = step;
+
+    double cutoff = CUTOFF / max(step, 1.0);
+    if (cutoff == myCutoff) return;
+
+    int numTaps = static_cast<int>(ceil(BASE_TAPS * max(step, 1.0)));
+    numTaps = min(numTaps, MAX_TAPS);
+    numTaps += (TAP_ALIGNMENT - numTaps % TAP_ALIGNMENT) % TAP_ALIGNMENT;
+
+    myCutoff = cutoff;
+    myNumTaps = numTaps;
+    BuildTable(myTable, numTaps, cutoff);
+}
+
+void Resampler::write(short* dst, int numFrames, double srcPos,
+                      const short* srcL, const short* srcR, int srcFrames) {
+    render(dst, numFrames, srcPos, srcL, srcR, srcFrames, false);
+}
+
+void Resampler::mix(short* dst, int numFrames, double srcPos,
+                    const short* srcL, const short* srcR, int srcFrames) {
+    render(dst, numFrames, srcPos, srcL, srcR, srcFrames, true);
+}
+
+void Resampler::copy(short* dst, int numFrames, double srcPos,
+                     const short* srcL, const short* srcR, int srcFrames,
+                     bool add) {
+    int64_t pos = llround(srcPos);
+    int begin = static_cast<int>(clamp<int64_t>(-pos, 0, numFrames));
+    int end = static_cast<int>(clamp<int64_t>(srcFrames - pos, 0, numFrames));
+    end = max(begin, end);
+
+    if (!add) {
+        memset(dst, 0, begin * 2 * sizeof(short));
+        memset(dst + end * 2, 0, (numFrames - end) * 2 * sizeof(short));
+    }
+    if (begin == end) return;
+
+    short* out = dst + begin * 2;
+    const short* l = srcL + pos + begin;
+    const short* r = srcR + pos + begin;
+    if (add) {
+        MixKernels::interleaveAdd(out, l, r, end - begin);
+    } else {
+        MixKernels::interleave(out, l, r, end - begin);
+    }
+}
+
+void Resampler::render(short* dst, int numFrames, double srcPos,
+                       const short* srcL, const short* srcR, int srcFrames,
+                       bool add) {
+    if (!srcL || !srcR) srcFrames = 0;
+
+    if (myStep == 1.0) {
+        copy(dst, numFrames, srcPos, srcL, srcR, srcFrames, add);
+        return;
+    }
+
+    const Kernel kernel = SelectKernel();
+    const int numTaps = myNumTaps;
+    const int before = numTaps / 2 - 1;
+    const float* table = myTable.data();
+
+    for (int i = 0; i < numFrames; ++i) {
+        // Positions are computed from the start, so errors do not accumulate.
+        double pos = srcPos + i * myStep;
+        double index = floor(pos);
+        int64_t first = static_cast<int64_t>(index) - before;
+
+        // Past the end of the source, the rest of the output is silent.
+        if (first >= srcFrames) {
+            if (!add) {
+                memset(dst + i * 2, 0, (numFrames - i) * 2 * sizeof(short));
+            }
+            return;
+        }
+
+        // Before the start of the source, the output is silent.
+        if (first + numTaps <= 0) {
+            if (!add) dst[i * 2 + 0] = dst[i * 2 + 1] = 0;
+            continue;
+        }
+
+        const short* l = srcL + first;
+        const short* r = srcR + first;
+        if (first < 0 || first + numTaps > srcFrames) {
+            for (int k = 0; k < numTaps; ++k) {
+                int64_t j = first + k;
+                bool inside = j >= 0 && j < srcFrames;
+                myEdgeL[k] = inside ? srcL[j] : 0;
+                myEdgeR[k] = inside ? srcR[j] : 0;
+            }
+            l = myEdgeL.data();
+            r = myEdgeR.data();
+        }
+
+        double phase = (pos - index) * NUM_PHASES;
+        int p = static_cast<int>(phase);
+        float t = static_cast<float>(phase - p);
+
+        float out[2];
+        const float* row = table + p * numTaps;
+        kernel(row, row + numTaps, t, l, r, numTaps, out);
+
+        if (add) {
+            dst[i * 2 + 0] = AddSample(dst[i * 2 + 0], out[0]);
+            dst[i * 2 + 1] = AddSample(dst[i * 2 + 1], out[1]);
+        } else {
+            dst[i * 2 + 0] = ToSample(out[0]);
+            dst[i * 2 + 1] = ToSample(out[1]);
+        }
+    }
+}
+
+};  // namespace Vortex
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+namespace Vortex {
+
+/// Polyphase windowed-sinc resampler for stereo 16-bit audio. The source is
+/// read directly from planar sample arrays at fractional positions, so it can
+/// start anywhere and needs no history between calls. Filter coefficients are
+/// precomputed for a fixed number of sub-sample phases, and interpolated
+/// between the two nearest phases. When the source is read faster than it is
+/// written, the cutoff is lowered with it, which removes the frequencies that
+/// would otherwise alias.
+class Resampler {
+   public:
+    Resampler();
+
+    /// Sets the number of source frames that are advanced per output frame.
+    /// The filter table is only rebuilt if its cutoff changes. A step of
+    /// exactly one copies source frames, rounded to the nearest position.
+    void setStep(double step);
+
+    /// Returns the number of source frames advanced per output frame.
+    double getStep() const { return myStep; }
+
+    /// Returns the number of source frames read around every position.
+    int getNumTaps() const { return myNumTaps; }
+
+    /// Writes interleaved stereo output frames, starting at the given source
+    /// frame. Source frames outside [0, srcFrames) are read as silence.
+    void write(short* dst, int numFrames, double srcPos, const short* srcL,
+               const short* srcR, int srcFrames);
+
+    /// Same as "write", but adds the output to the frames in dst, saturating
+    /// at the 16-bit range. Stops as soon as the end of the source is passed.
+    void mix(short* dst, int numFrames, double srcPos, const short* srcL,
+             const short* srcR, int srcFrames);
+
+   private:
+    void render(short* dst, int numFrames, double srcPos, const short* srcL,
+                const short* srcR, int srcFrames, bool add);
+    void copy(short* dst, int numFrames, double srcPos, const short* srcL,
+              const short* srcR, int srcFrames, bool add);
+
+    double myStep;
+    double myCutoff;
+    int myNumTaps;
+
+    std::vector<float> myTable;  // (NUM_PHASES + 1) rows of myNumTaps.
+    std::vector<short> myEdgeL, myEdgeR;
+};
+
+};  // namespace Vortex
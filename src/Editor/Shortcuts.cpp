@@ -286,6 +286,7 @@ E(VOLUME_MUTE)
 E(SPEED_RESET)
 E(SPEED_INCREASE)
 E(SPEED_DECREASE)
+E(TOGGLE_TIME_STRETCH)
 
 E(TOGGLE_BEAT_TICK)
 E(TOGGLE_NOTE_TICK)
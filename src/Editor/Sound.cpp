@@ -1,4 +1,5 @@
 #include <Editor/Sound.h>
+#include <Editor/PcmCache.h>
 
 #include <System/Debug.h>
 #include <System/File.h>
@@ -61,6 +62,31 @@ static void ConvertSamples(int numFrames, int16_t* dstL, int16_t* dstR,
     }
 }
 
+// ================================================================================================
+// SegmentProgress
+
+SegmentProgress::SegmentProgress(std::vector<int> bounds,
+                                 const DecodeProgress& progress)
+    : myProgress(progress),
+      myBounds(std::move(bounds)),
+      myFinished(myBounds.size(), 0),
+      myFrontier(0) {}
+
+void SegmentProgress::finish(int segment) {
+    std::lock_guard<std::mutex> lock(myMutex);
+    myFinished[segment] = 1;
+
+    int frontier = myFrontier;
+    while (frontier + 1 < static_cast<int>(myBounds.size()) &&
+           myFinished[frontier]) {
+        ++frontier;
+    }
+    if (frontier > myFrontier) {
+        myFrontier = frontier;
+        myProgress(myBounds[frontier]);
+    }
+}
+
 // ================================================================================================
 // Loader
 
@@ -72,17 +98,24 @@ class Sound::Thread : public BackgroundThread {
     Thread(Sound* sound, SoundSource* source);
 
     void exec() override;
+    void allocate();
+    bool readAll();
     bool readBlock();
+    void finish();
     void cleanup();
+    void storeInCache();
+    void setCacheSource(const fs::path& path, const std::string& title,
+                        const std::string& artist);
     uint8_t progress() { return myProgress; }
     double elapsedTime() { return Debug::getElapsedTime(myStartTime); }
 
    private:
     SoundSource* mySource;
     Sound* mySound;
+    fs::path myCacheSource;
+    std::string myCacheTitle, myCacheArtist;
     short* myBuffer;
     int myCurrentFrame;
-    int myReservedFrames;
     uint8_t myProgress;
     std::chrono::steady_clock::time_point myStartTime;
 };
@@ -92,7 +125,8 @@ Sound::Thread::~Thread() {
     cleanup();
 }
 
-Sound::Thread::Thread(Sound* sound, SoundSource* source) {
+Sound::Thread::Thread(Sound* sound, SoundSource* source)
+    : BackgroundThread(TaskPriority::Decode) {
     myStartTime = Debug::getElapsedTime();
 
     mySound = sound;
@@ -102,13 +136,59 @@ Sound::Thread::Thread(Sound* sound, SoundSource* source) {
     myBuffer = static_cast<short*>(malloc(BUFFER_SIZE * bytesPerFrame));
 
     myCurrentFrame = 0;
-    myReservedFrames = 0;
     myProgress = 0;
 }
 
 void Sound::Thread::exec() {
-    while (readBlock());
+    mySource->prepare();
+    allocate();
+    if (!readAll()) {
+        while (readBlock());
+    }
     cleanup();
+    storeInCache();
+}
+
+void Sound::Thread::allocate() {
+    // Sources that only know their length once they are prepared are
+    // allocated here; the stores already reserved room for any length.
+    int numFrames = mySource->getNumFrames();
+    if (mySound->myIsAllocated || numFrames <= 0) return;
+
+    if (!mySound->myStoreL.grow(numFrames) ||
+        !mySound->myStoreR.grow(numFrames)) {
+        return;
+    }
+
+    mySound->myNumFrames = numFrames;
+    mySound->myPeaksL.allocate(mySound->mySamplesL, numFrames);
+    mySound->myPeaksR.allocate(mySound->mySamplesR, numFrames);
+    mySound->myIsAllocated = true;
+}
+
+bool Sound::Thread::readAll() {
+    if (!mySound->myIsAllocated) return false;
+
+    // Preallocated buffers never move, so the frames of the segments that are
+    // finished can be summarized and published while the rest is decoding.
+    auto progress = [this](int numFrames) {
+        myProgress = static_cast<uint8_t>(static_cast<uint64_t>(100) *
+                                          numFrames / mySound->myNumFrames);
+        mySound->myPeaksL.extend(numFrames);
+        mySound->myPeaksR.extend(numFrames);
+        mySound->myDecodedFrames.store(numFrames, std::memory_order_release);
+    };
+
+    if (!mySource->readAllFrames(mySound->mySamplesL, mySound->mySamplesR,
+                                 getStopToken(), progress)) {
+        return false;
+    }
+
+    myCurrentFrame = mySound->myNumFrames;
+    myProgress = 100;
+    finish();
+
+    return true;
 }
 
 bool Sound::Thread::readBlock() {
@@ -123,27 +203,13 @@ bool Sound::Thread::readBlock() {
 
     if (framesRead > 0) {
         if (!mySound->myIsAllocated) {
-            if (myCurrentFrame + framesRead > myReservedFrames) {
-                myReservedFrames =
-                    max(myReservedFrames * 2, myCurrentFrame + framesRead);
-
-                short* newBufferL = static_cast<short*>(realloc(
-                    mySound->mySamplesL, myReservedFrames * sizeof(short)));
-                short* newBufferR = static_cast<short*>(realloc(
-                    mySound->mySamplesR, myReservedFrames * sizeof(short)));
-
-                if (newBufferL && newBufferR) {
-                    mySound->mySamplesL = newBufferL;
-                    mySound->mySamplesR = newBufferR;
-                } else {
-                    HudError(
-                        "Insufficient memory to load the entire audio file.");
-
-                    if (newBufferL) mySound->mySamplesL = newBufferL;
-                    if (newBufferR) mySound->mySamplesR = newBufferR;
-
-                    framesRead = 0;
-                }
+            // The stores commit more memory in place as the signal grows, so
+            // the decoded samples are never moved.
+            int numFrames = myCurrentFrame + framesRead;
+            if (!mySound->myStoreL.grow(numFrames) ||
+                !mySound->myStoreR.grow(numFrames)) {
+                HudError("Insufficient memory to load the entire audio file.");
+                framesRead = 0;
             }
             mySound->myNumFrames += framesRead;
         }
@@ -161,17 +227,73 @@ bool Sound::Thread::readBlock() {
             myProgress =
                 static_cast<uint8_t>(static_cast<uint64_t>(100) *
                                      myCurrentFrame / mySound->myNumFrames);
+
+            // Preallocated buffers never move, so the decoded frames can be
+            // summarized and published right away. After a failed parallel
+            // decode, the frames it published are decoded again first.
+            mySound->myPeaksL.extend(myCurrentFrame);
+            mySound->myPeaksR.extend(myCurrentFrame);
+            if (myCurrentFrame > mySound->getNumDecodedFrames()) {
+                mySound->myDecodedFrames.store(myCurrentFrame,
+                                               std::memory_order_release);
+            }
         }
     }
 
-    if (framesRead == 0) {
-        mySound->myIsAllocated = true;
-        mySound->myIsCompleted = true;
-    }
+    if (framesRead == 0) finish();
 
     return (framesRead > 0);
 }
 
+void Sound::Thread::finish() {
+    // A source can end before the length it reported up front, in which case
+    // the remaining frames are silent.
+    if (mySound->myIsAllocated && myCurrentFrame < mySound->myNumFrames) {
+        int numFrames = mySound->myNumFrames - myCurrentFrame;
+        memset(mySound->mySamplesL + myCurrentFrame, 0,
+               numFrames * sizeof(short));
+        memset(mySound->mySamplesR + myCurrentFrame, 0,
+               numFrames * sizeof(short));
+    }
+
+    // The pyramid levels of a signal of unknown length can only be allocated
+    // once the length is known, so it is summarized and published at the end.
+    if (mySound->myIsAllocated) {
+        mySound->myPeaksL.extend(mySound->myNumFrames);
+        mySound->myPeaksR.extend(mySound->myNumFrames);
+    } else {
+        mySound->myPeaksL.build(mySound->mySamplesL, mySound->myNumFrames);
+        mySound->myPeaksR.build(mySound->mySamplesR, mySound->myNumFrames);
+    }
+    mySound->myDecodedFrames.store(mySound->myNumFrames,
+                                   std::memory_order_release);
+
+    mySound->myIsAllocated = true;
+    mySound->myIsCompleted = true;
+}
+
+void Sound::Thread::setCacheSource(const fs::path& path,
+                                   const std::string& title,
+                                   const std::string& artist) {
+    myCacheSource = path;
+    myCacheTitle = title;
+    myCacheArtist = artist;
+}
+
+void Sound::Thread::storeInCache() {
+    if (myCacheSource.empty() || !mySound->myIsCompleted) return;
+
+    PcmCacheEntry entry;
+    entry.samplesL = mySound->mySamplesL;
+    entry.samplesR = mySound->mySamplesR;
+    entry.frequency = mySound->myFrequency;
+    entry.numFrames = mySound->myNumFrames;
+    entry.title = myCacheTitle;
+    entry.artist = myCacheArtist;
+
+    PcmCache::store(myCacheSource, entry, getStopToken());
+}
+
 void Sound::Thread::cleanup() {
     delete mySource;
     mySource = nullptr;
@@ -190,7 +312,11 @@ SoundSource* LoadMP3(std::ifstream&& file, std::string& title,
 SoundSource* LoadWav(std::ifstream&& file, std::string& title,
                      std::string& artist);  // Defined in "load_wav.cpp".
 
-Sound::Sound() : myThread(nullptr), mySamplesL(nullptr), mySamplesR(nullptr) {
+Sound::Sound()
+    : myThread(nullptr),
+      myMapping(nullptr),
+      mySamplesL(nullptr),
+      mySamplesR(nullptr) {
     clear();
 }
 
@@ -200,26 +326,61 @@ void Sound::clear() {
     delete myThread;
     myThread = nullptr;
 
-    if (mySamplesL) {
-        free(mySamplesL);
-        mySamplesL = nullptr;
-    }
+    myPeaksL.clear();
+    myPeaksR.clear();
 
-    if (mySamplesR) {
-        free(mySamplesR);
-        mySamplesR = nullptr;
-    }
+    // Samples mapped from the PCM cache are released along with the mapping.
+    delete myMapping;
+    myMapping = nullptr;
+
+    myStoreL.release();
+    myStoreR.release();
+    mySamplesL = nullptr;
+    mySamplesR = nullptr;
 
     myNumFrames = 0;
+    myDecodedFrames = 0;
     myFrequency = 44100;
     myIsAllocated = true;
     myIsCompleted = true;
 }
 
+bool Sound::loadCached(const fs::path& path, std::string& title,
+                       std::string& artist) {
+    auto mapping = new MappedFile;
+    PcmCacheEntry entry;
+    if (!PcmCache::open(path, *mapping, entry)) {
+        delete mapping;
+        return false;
+    }
+
+    // The mapping is read-only; the samples are never written after loading.
+    myMapping = mapping;
+    mySamplesL = const_cast<short*>(entry.samplesL);
+    mySamplesR = const_cast<short*>(entry.samplesR);
+    myFrequency = entry.frequency;
+    myNumFrames = entry.numFrames;
+
+    myPeaksL.build(mySamplesL, myNumFrames);
+    myPeaksR.build(mySamplesR, myNumFrames);
+    myDecodedFrames = myNumFrames;
+
+    myIsAllocated = true;
+    myIsCompleted = true;
+
+    if (!entry.title.empty()) title = entry.title;
+    if (!entry.artist.empty()) artist = entry.artist;
+
+    return true;
+}
+
 bool Sound::load(fs::path path, bool threaded, std::string& title,
-                 std::string& artist) {
+                 std::string& artist, bool cached) {
     clear();
 
+    bool cacheable = cached && PcmCache::isCacheable(path);
+    if (cacheable && loadCached(path, title, artist)) return true;
+
     SoundSource* source = nullptr;
 
     // Try to open the file.
@@ -250,36 +411,43 @@ bool Sound::load(fs::path path, bool threaded, std::string& title,
     myIsAllocated = false;
     myIsCompleted = false;
 
-    // If the number of frames is known beforehand, we can pre-allocate the
-    // buffer.
-    if (myNumFrames > 0) {
-        uint64_t numBytes = myNumFrames * sizeof(short);
+    // If the number of frames is known beforehand, the entire buffer can be
+    // committed right away. Otherwise, address space is reserved for the
+    // longest supported signal, and the buffer grows as frames are decoded.
+    int reservedFrames = (myNumFrames > 0) ? myNumFrames : INT_MAX;
+    bool allocated = myStoreL.reserve(reservedFrames) &&
+                     myStoreR.reserve(reservedFrames);
+    if (allocated && myNumFrames > 0) {
+        allocated = myStoreL.grow(myNumFrames) && myStoreR.grow(myNumFrames);
+    }
 
-        if (threaded) {
-            mySamplesL = static_cast<short*>(calloc(numBytes, 1));
-            mySamplesR = static_cast<short*>(calloc(numBytes, 1));
-        } else {
-            mySamplesL = static_cast<short*>(malloc(numBytes));
-            mySamplesR = static_cast<short*>(malloc(numBytes));
-        }
+    if (!allocated) {
+        HudError("Insufficient memory to load the entire audio file.");
 
-        if (!mySamplesL || !mySamplesR) {
-            HudError("Insufficient memory to load the entire audio file.");
+        clear();
+        delete source;
+        return false;
+    }
 
-            clear();
-            delete source;
-            return false;
-        }
+    mySamplesL = myStoreL.data();
+    mySamplesR = myStoreR.data();
+
+    if (myNumFrames > 0) {
+        myPeaksL.allocate(mySamplesL, myNumFrames);
+        myPeaksR.allocate(mySamplesR, myNumFrames);
 
         myIsAllocated = true;
     }
 
-    // Start a sample reading thread.
+    // Start a sample reading thread, which stores the decoded samples in the
+    // PCM cache once it is done.
     if (threaded) {
         myThread = new Sound::Thread(this, source);
+        if (cacheable) myThread->setCacheSource(path, title, artist);
         myThread->start();
     } else {
         Sound::Thread thread(this, source);
+        if (cacheable) thread.setCacheSource(path, title, artist);
         thread.exec();
     }
 
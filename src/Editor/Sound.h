@@ -1,8 +1,15 @@
 #pragma once
 
 #include <Core/Core.h>
+#include <Editor/PeakPyramid.h>
+#include <System/SampleStore.h>
+#include <atomic>
+#include <functional>
 #include <ios>
 #include <filesystem>
+#include <mutex>
+#include <stop_token>
+#include <vector>
 namespace fs = std::filesystem;
 
 namespace Vortex {
@@ -10,6 +17,11 @@ namespace Vortex {
 // In the following context, a sample refers to a single value.
 // A frame refers to a set samples, one for each audio channel.
 
+class MappedFile;
+
+/// Receives the number of leading frames that are completely decoded.
+using DecodeProgress = std::function<void(int numFrames)>;
+
 struct SoundSource {
     virtual ~SoundSource() {}
 
@@ -18,9 +30,49 @@ struct SoundSource {
     virtual int getNumChannels() = 0;     ///< Number of samples per frame.
     virtual int getBytesPerSample() = 0;  ///< Size of a sample value in bytes.
 
+    /// Called on the decoding thread before any frames are read, for work
+    /// that is too slow to do while the source is opened, such as scanning the
+    /// file to find its exact length. Afterwards, "getNumFrames" may return a
+    /// length that was not known before.
+    virtual void prepare() {}
+
     /// Writes audio frames into the buffer until either the buffer is filled
     /// or the source end is reached. Returns the number of frames written.
     virtual int readFrames(int numFrames, short* buffer) = 0;
+
+    /// Decodes the entire signal straight into planar buffers that can hold
+    /// getNumFrames() frames, possibly on multiple threads. While decoding,
+    /// "progress" is called with a growing number of leading frames that are
+    /// final; the calls are never made concurrently. Returns false if the
+    /// source does not support this, or could not reproduce the output of
+    /// "readFrames" exactly, in which case the frames are read one block at a
+    /// time instead.
+    virtual bool readAllFrames([[maybe_unused]] short* dstL,
+                               [[maybe_unused]] short* dstR,
+                               [[maybe_unused]] std::stop_token token,
+                               [[maybe_unused]] const DecodeProgress& progress) {
+        return false;
+    }
+};
+
+/// Reports the progress of a signal that is decoded in segments, which can
+/// finish in any order. Only the frames before the first unfinished segment
+/// are reported, so the reported frames always form a contiguous prefix.
+class SegmentProgress {
+   public:
+    /// Segment i covers the frames from bounds[i] up to bounds[i + 1].
+    SegmentProgress(std::vector<int> bounds, const DecodeProgress& progress);
+
+    /// Marks a segment as finished, and reports the frames up to the first
+    /// unfinished segment if they grew. Can be called from any thread.
+    void finish(int segment);
+
+   private:
+    std::mutex myMutex;
+    const DecodeProgress& myProgress;
+    std::vector<int> myBounds;
+    std::vector<uint8_t> myFinished;
+    int myFrontier;
 };
 
 class Sound {
@@ -33,9 +85,11 @@ class Sound {
     /// Destroys the current sample data and starts loading audio from a file.
     /// If title/artist fields are found in the metadata, they are written to
     /// the corresponding strings. When threaded, "isAllocated" and
-    /// "isCompleted" can be used to check loading progress.
+    /// "isCompleted" can be used to check loading progress. When cached,
+    /// compressed files that were decoded before are mapped from the PCM cache
+    /// instead, and newly decoded files are stored in it.
     bool load(fs::path path, bool threaded, std::string& title,
-              std::string& artist);
+              std::string& artist, bool cached = false);
 
     /// Returns the number of frames per second.
     int getFrequency() const { return myFrequency; }
@@ -49,6 +103,19 @@ class Sound {
     /// Returns the sample buffer for the right channel.
     const short* samplesR() const { return mySamplesR; }
 
+    /// Returns the number of frames that have been decoded so far. Samples and
+    /// peaks below this watermark can be read while the sound is still loading.
+    int getNumDecodedFrames() const {
+        return myDecodedFrames.load(std::memory_order_acquire);
+    }
+
+    /// Returns the min/max peak pyramid of the left channel. The pyramid grows
+    /// along with the decoded frames watermark.
+    const PeakPyramid& peaksL() const { return myPeaksL; }
+
+    /// Returns the min/max peak pyramid of the right channel.
+    const PeakPyramid& peaksR() const { return myPeaksR; }
+
     /// Returns true if the sample buffers allocation is completed, false
     /// otherwise.
     bool isAllocated() const { return myIsAllocated; }
@@ -67,13 +134,22 @@ class Sound {
     const char* lastError() const { return myError; }
 
    private:
+    bool loadCached(const fs::path& path, std::string& title,
+                    std::string& artist);
+
     class Thread;
     Thread* myThread;
+    MappedFile* myMapping;
+    SampleStore myStoreL;
+    SampleStore myStoreR;
     short* mySamplesL;
     short* mySamplesR;
+    PeakPyramid myPeaksL;
+    PeakPyramid myPeaksR;
     int myFrequency;
     int myNumFrames;
-    bool myIsAllocated;
+    std::atomic<int> myDecodedFrames;
+    std::atomic<bool> myIsAllocated;
     bool myIsCompleted;
     const char* myError;
 };
@@ -0,0 +1,331 @@
+#include <Editor/TimeStretch.h>
+
+#include <Core/Utils.h>
+
+#include <System/CpuFeatures.h>
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef CPU_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Vortex {
+
+static const double PI = 3.14159265358979323846;
+
+static const double SEGMENT_SECONDS = 0.040;
+static const double SEARCH_SECONDS = 0.012;
+
+// The search first tests every n-th offset, and then refines around the best.
+static const int COARSE_STEP = 4;
+
+// Segment lengths are rounded to a multiple of this, for the vector kernels.
+static const int SEGMENT_ALIGNMENT = 8;
+
+// ================================================================================================
+// Kernels.
+
+typedef float (*DotProductKernel)(const float* a, const float* b, int n);
+
+typedef void (*OverlapAddKernel)(short* dst, const float* overlapL,
+                                 const float* overlapR, const float* srcL,
+                                 const float* srcR, const float* window, int n);
+
+static float DotProductScalar(const float* a, const float* b, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+// Adds the windowed source to the overlap of the previous segment, and writes
+// the result as interleaved 16-bit samples.
+static void OverlapAddScalar(short* dst, const float* overlapL,
+                             const float* overlapR, const float* srcL,
+                             const float* srcR, const float* window, int n) {
+    for (int i = 0; i < n; ++i) {
+        int l = static_cast<int>(overlapL[i] + window[i] * srcL[i]);
+        int r = static_cast<int>(overlapR[i] + window[i] * srcR[i]);
+        dst[i * 2 + 0] = static_cast<short>(clamp(l, SHRT_MIN, SHRT_MAX));
+        dst[i * 2 + 1] = static_cast<short>(clamp(r, SHRT_MIN, SHRT_MAX));
+    }
+}
+
+#ifdef CPU_HAS_SSE2
+
+static float DotProductSse2(const float* a, const float* b, int n) {
+    int i = 0;
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        sum0 = _mm_add_ps(sum0,
+                          _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+                                           _mm_loadu_ps(b + i + 4)));
+    }
+    sum0 = _mm_add_ps(sum0, sum1);
+    sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+    sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+    float sum = _mm_cvtss_f32(sum0);
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+static void OverlapAddSse2(short* dst, const float* overlapL,
+                           const float* overlapR, const float* srcL,
+                           const float* srcR, const float* window, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 w = _mm_loadu_ps(window + i);
+        __m128 l = _mm_add_ps(_mm_loadu_ps(overlapL + i),
+                              _mm_mul_ps(w, _mm_loadu_ps(srcL + i)));
+        __m128 r = _mm_add_ps(_mm_loadu_ps(overlapR + i),
+                              _mm_mul_ps(w, _mm_loadu_ps(srcR + i)));
+
+        // Truncate to integers, then interleave and saturate to 16 bits.
+        __m128i li = _mm_cvttps_epi32(l);
+        __m128i ri = _mm_cvttps_epi32(r);
+        __m128i lr = _mm_packs_epi32(_mm_unpacklo_epi32(li, ri),
+                                     _mm_unpackhi_epi32(li, ri));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), lr);
+    }
+    OverlapAddScalar(dst + i * 2, overlapL + i, overlapR + i, srcL + i,
+                     srcR + i, window + i, n - i);
+}
+
+#endif  // CPU_HAS_SSE2
+
+static DotProductKernel SelectDotProduct() {
+#ifdef CPU_HAS_SSE2
+    if (CpuFeatures::getLevel() >= CpuFeatures::SSE2) return DotProductSse2;
+#endif
+    return DotProductScalar;
+}
+
+static OverlapAddKernel SelectOverlapAdd() {
+#ifdef CPU_HAS_SSE2
+    if (CpuFeatures::getLevel() >= CpuFeatures::SSE2) return OverlapAddSse2;
+#endif
+    return OverlapAddScalar;
+}
+
+// ================================================================================================
+// TimeStretch.
+
+TimeStretch::TimeStretch()
+    : mySrcL(nullptr),
+      mySrcR(nullptr),
+      mySrcFrames(0),
+      mySegmentLength(0),
+      myHopSize(0),
+      mySearchRange(0),
+      myRatio(1.0) {
+    setSampleRates(44100, 44100);
+}
+
+void TimeStretch::setSampleRates(int sourceRate, int outputRate) {
+    myRatio = static_cast<double>(sourceRate) / outputRate;
+    myResampler.setStep(myRatio);
+
+    int length = static_cast<int>(outputRate * SEGMENT_SECONDS);
+    length = max(length, SEGMENT_ALIGNMENT * 4);
+    length += (SEGMENT_ALIGNMENT - length % SEGMENT_ALIGNMENT) %
+              SEGMENT_ALIGNMENT;
+
+    mySegmentLength = length;
+    myHopSize = length / 2;
+    mySearchRange = static_cast<int>(outputRate * SEARCH_SECONDS);
+    mySearchRange -= mySearchRange % COARSE_STEP;
+
+    // A periodic Hann window, of which the two halves sum to one at 50%
+    // overlap, so overlapping segments keep their original level.
+    myWindow.resize(length);
+    for (int i = 0; i < length; ++i) {
+        double phase = 2.0 * PI * i / length;
+        myWindow[i] = static_cast<float>(0.5 - 0.5 * cos(phase));
+    }
+
+    int blockLength = mySearchRange * 2 + length;
+    myBlockL.assign(blockLength, 0.0f);
+    myBlockR.assign(blockLength, 0.0f);
+    myBlockMono.assign(blockLength, 0.0f);
+    myEnergy.assign(blockLength + 1, 0.0);
+    myReference.assign(myHopSize, 0.0f);
+    myOverlapL.assign(myHopSize, 0.0f);
+    myOverlapR.assign(myHopSize, 0.0f);
+    myHop.assign(myHopSize * 2, 0);
+    myResampled.assign(myRatio != 1.0 ? blockLength * 2 : 0, 0);
+
+    reset();
+}
+
+void TimeStretch::reset() {
+    mySpeed = 1.0;
+    myNominalPos = 0.0;
+    myExpectedPos = 0.0;
+    myPrevPos = 0;
+    myHopRead = myHopSize;
+    myIsStarted = false;
+}
+
+void TimeStretch::process(short* dst, int numFrames, double srcPos,
+                          double speed, const short* srcL, const short* srcR,
+                          int srcFrames) {
+    mySrcL = srcL;
+    mySrcR = srcR;
+    mySrcFrames = srcL && srcR ? srcFrames : 0;
+
+    // Seeks and speed changes start a new stretch at the requested position.
+    if (!myIsStarted || speed != mySpeed ||
+        fabs(srcPos - myExpectedPos) > 1.0) {
+        restart(srcPos, speed);
+    }
+
+    for (int pos = 0; pos < numFrames;) {
+        if (myHopRead == myHopSize) renderHop();
+        int n = min(numFrames - pos, myHopSize - myHopRead);
+        memcpy(dst + pos * 2, myHop.data() + myHopRead * 2,
+               n * 2 * sizeof(short));
+        myHopRead += n;
+        pos += n;
+    }
+
+    myExpectedPos = srcPos + numFrames * speed;
+}
+
+void TimeStretch::restart(double srcPos, double speed) {
+    int64_t start = llround(srcPos / myRatio);
+
+    // Pretend the previous segment ended on the start position, so the first
+    // segment lines up with it and playback starts without a fade-in.
+    myPrevPos = start - myHopSize;
+    readSource(start, myHopSize);
+    for (int i = 0; i < myHopSize; ++i) {
+        myOverlapL[i] = myWindow[myHopSize + i] * myBlockL[i];
+        myOverlapR[i] = myWindow[myHopSize + i] * myBlockR[i];
+    }
+
+    mySpeed = speed;
+    myNominalPos = static_cast<double>(start);
+    myExpectedPos = srcPos;
+    myHopRead = myHopSize;
+    myIsStarted = true;
+}
+
+void TimeStretch::readSource(int64_t pos, int numFrames) {
+    float* l = myBlockL.data();
+    float* r = myBlockR.data();
+    float* mono = myBlockMono.data();
+
+    // Different samplerates are converted while reading, which also reads
+    // frames outside the source as silence.
+    if (myRatio != 1.0) {
+        short* tmp = myResampled.data();
+        myResampler.write(tmp, numFrames, pos * myRatio, mySrcL, mySrcR,
+                          mySrcFrames);
+        for (int i = 0; i < numFrames; ++i) {
+            l[i] = tmp[i * 2 + 0];
+            r[i] = tmp[i * 2 + 1];
+            mono[i] = (l[i] + r[i]) * 0.5f;
+        }
+        return;
+    }
+
+    // Frames outside the source are silent.
+    int begin = static_cast<int>(clamp<int64_t>(-pos, 0, numFrames));
+    int end = static_cast<int>(clamp<int64_t>(mySrcFrames - pos, 0, numFrames));
+    end = max(begin, end);
+
+    std::fill(l, l + begin, 0.0f);
+    std::fill(r, r + begin, 0.0f);
+    for (int i = begin; i < end; ++i) {
+        l[i] = mySrcL[pos + i];
+        r[i] = mySrcR[pos + i];
+    }
+    std::fill(l + end, l + numFrames, 0.0f);
+    std::fill(r + end, r + numFrames, 0.0f);
+
+    for (int i = 0; i < numFrames; ++i) {
+        mono[i] = (l[i] + r[i]) * 0.5f;
+    }
+}
+
+int TimeStretch::findBestOffset(int64_t nominal) {
+    const int hop = myHopSize;
+    const int numOffsets = mySearchRange * 2 + 1;
+
+    // The reference is the source that would naturally follow the previous
+    // segment, which the new segment should overlap with.
+    readSource(myPrevPos + hop, hop);
+    std::copy(myBlockMono.begin(), myBlockMono.begin() + hop,
+              myReference.begin());
+
+    readSource(nominal - mySearchRange, mySearchRange * 2 + mySegmentLength);
+    const float* mono = myBlockMono.data();
+    const float* ref = myReference.data();
+
+    // Running energy of the block, to normalize the correlation of each
+    // candidate, so loud passages are not favored over similar ones.
+    double* energy = myEnergy.data();
+    energy[0] = 0.0;
+    for (int i = 0; i < numOffsets + hop; ++i) {
+        energy[i + 1] = energy[i] + mono[i] * mono[i];
+    }
+
+    const DotProductKernel dotProduct = SelectDotProduct();
+    auto score = [&](int offset) {
+        double e = energy[offset + hop] - energy[offset];
+        return dotProduct(mono + offset, ref, hop) / sqrt(e + 1.0);
+    };
+
+    int best = mySearchRange;
+    double bestScore = score(best);
+    for (int offset = 0; offset < numOffsets; offset += COARSE_STEP) {
+        double s = score(offset);
+        if (s > bestScore) {
+            bestScore = s;
+            best = offset;
+        }
+    }
+
+    int coarse = best;
+    int first = max(coarse - COARSE_STEP + 1, 0);
+    int last = min(coarse + COARSE_STEP - 1, numOffsets - 1);
+    for (int offset = first; offset <= last; ++offset) {
+        double s = score(offset);
+        if (s > bestScore) {
+            bestScore = s;
+            best = offset;
+        }
+    }
+
+    return best;
+}
+
+void TimeStretch::renderHop() {
+    const int hop = myHopSize;
+    int64_t nominal = llround(myNominalPos);
+    int offset = findBestOffset(nominal);
+
+    const float* segL = myBlockL.data() + offset;
+    const float* segR = myBlockR.data() + offset;
+    const float* window = myWindow.data();
+
+    // The first half of the segment completes the current hop, the second
+    // half is kept to overlap with the next segment.
+    const OverlapAddKernel overlapAdd = SelectOverlapAdd();
+    overlapAdd(myHop.data(), myOverlapL.data(), myOverlapR.data(), segL, segR,
+               window, hop);
+    for (int i = 0; i < hop; ++i) {
+        myOverlapL[i] = window[hop + i] * segL[hop + i];
+        myOverlapR[i] = window[hop + i] * segR[hop + i];
+    }
+
+    myPrevPos = nominal - mySearchRange + offset;
+    myNominalPos += hop * mySpeed / myRatio;
+    myHopRead = 0;
+}
+
+};  // namespace Vortex
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Editor/Resampler.h>
+
+namespace Vortex {
+
+/// Pitch-preserving time-stretcher for stereo playback, based on WSOLA
+/// (waveform similarity overlap-add). The output is built from overlapping
+/// windowed segments of the source. Every segment is taken near its nominal
+/// source position, at the offset where it lines up best with the signal that
+/// would have followed the previous segment, which keeps the waveform
+/// continuous without shifting the pitch. If the output samplerate differs
+/// from the source, segments are read through a resampler, so the stretch
+/// works at the output samplerate.
+class TimeStretch {
+   public:
+    TimeStretch();
+
+    /// Sets the samplerate of the source and of the output. The output
+    /// samplerate determines the segment length and search range. Discards
+    /// the current playback state.
+    void setSampleRates(int sourceRate, int outputRate);
+
+    /// Discards the current playback state, so the next call to "process"
+    /// starts a new stretch at its source position.
+    void reset();
+
+    /// Writes interleaved stereo output frames, starting at the given source
+    /// frame and advancing "speed" source frames per output frame. Successive
+    /// calls continue seamlessly as long as the source position follows on
+    /// from the previous call and the speed is unchanged. Source frames
+    /// outside [0, srcFrames) are read as silence.
+    void process(short* dst, int numFrames, double srcPos, double speed,
+                 const short* srcL, const short* srcR, int srcFrames);
+
+   private:
+    void restart(double srcPos, double speed);
+    void readSource(int64_t pos, int numFrames);
+    int findBestOffset(int64_t nominal);
+    void renderHop();
+
+    const short* mySrcL;
+    const short* mySrcR;
+    int mySrcFrames;
+
+    int mySegmentLength;  // window length in frames, twice the hop size.
+    int myHopSize;        // output frames produced per segment.
+    int mySearchRange;    // maximum offset from the nominal position.
+
+    std::vector<float> myWindow;
+    std::vector<float> myOverlapL, myOverlapR;
+    std::vector<float> myBlockL, myBlockR, myBlockMono;
+    std::vector<float> myReference;
+    std::vector<double> myEnergy;
+    std::vector<short> myHop;
+    std::vector<short> myResampled;
+    Resampler myResampler;
+
+    double myRatio;  // source frames per output-rate frame.
+    double mySpeed;
+    double myNominalPos;   // output-rate position of the next segment.
+    double myExpectedPos;  // source position expected by the next call.
+    int64_t myPrevPos;     // output-rate position of the previous segment.
+    int myHopRead;         // frames of the current hop already written.
+    bool myIsStarted;
+};
+
+};  // namespace Vortex
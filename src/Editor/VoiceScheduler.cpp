@@ -0,0 +1,206 @@
+#include <Editor/VoiceScheduler.h>
+
+#include <Editor/Sound.h>
+
+#include <System/MixKernels.h>
+
+#include <math.h>
+#include <algorithm>
+
+namespace Vortex {
+
+static bool operator==(const VoiceScheduler::Event& a,
+                       const VoiceScheduler::Event& b) {
+    return a.frame == b.frame && a.sound == b.sound && a.gain == b.gain;
+}
+
+// Returns the first event that starts at or after the given music frame.
+static size_t FindEvent(const std::vector<VoiceScheduler::Event>& events,
+                        double frame) {
+    auto it = std::lower_bound(
+        events.begin(), events.end(), frame,
+        [](const VoiceScheduler::Event& e, double f) { return e.frame < f; });
+    return it - events.begin();
+}
+
+// ================================================================================================
+// VoiceScheduler.
+
+VoiceScheduler::VoiceScheduler(int numTracks)
+    : myTracks(numTracks), myExpectedPos(0.0), myNeedsSeek(true) {
+    for (auto& track : myTracks) {
+        track.cursor = 0;
+        track.enabled = true;
+    }
+    myVoices.reserve(MAX_VOICES);
+}
+
+void VoiceScheduler::setSounds(const std::vector<const Sound*>& sounds) {
+    std::lock_guard<std::mutex> lock(myMutex);
+    mySounds = sounds;
+    myResamplers.resize(sounds.size());
+    myVoices.clear();
+}
+
+void VoiceScheduler::setEvents(int track, const std::vector<Event>& events) {
+    // Only the main thread changes events, so they can be compared to the new
+    // events without holding up the mixer.
+    std::vector<Event>& current = myTracks[track].events;
+    size_t oldSize = current.size(), newSize = events.size();
+    size_t common = std::min(oldSize, newSize);
+
+    size_t prefix = 0;
+    while (prefix < common && current[prefix] == events[prefix]) ++prefix;
+    if (prefix == oldSize && oldSize == newSize) return;
+
+    size_t suffix = 0;
+    while (suffix < common - prefix &&
+           current[oldSize - 1 - suffix] == events[newSize - 1 - suffix]) {
+        ++suffix;
+    }
+
+    spliceEvents(track, prefix, oldSize - prefix - suffix,
+                 events.data() + prefix, events.data() + newSize - suffix);
+}
+
+void VoiceScheduler::replaceEvents(int track, size_t first, size_t count,
+                                   const std::vector<Event>& events) {
+    spliceEvents(track, first, count, events.data(),
+                 events.data() + events.size());
+}
+
+void VoiceScheduler::spliceEvents(int track, size_t first, size_t count,
+                                  const Event* begin, const Event* end) {
+    std::lock_guard<std::mutex> lock(myMutex);
+    Track& t = myTracks[track];
+    t.events.erase(t.events.begin() + first,
+                   t.events.begin() + first + count);
+    t.events.insert(t.events.begin() + first, begin, end);
+
+    // If the change reaches back to the cursor, it is moved to the first event
+    // that has not started yet.
+    if (t.cursor > first) t.cursor = FindEvent(t.events, myExpectedPos);
+}
+
+void VoiceScheduler::setEnabled(int track, bool enabled) {
+    std::lock_guard<std::mutex> lock(myMutex);
+    myTracks[track].enabled = enabled;
+}
+
+void VoiceScheduler::reset() {
+    std::lock_guard<std::mutex> lock(myMutex);
+    myVoices.clear();
+    myNeedsSeek = true;
+}
+
+void VoiceScheduler::mix(short* dst, int numFrames, double playPos,
+                         double srcStep, double pitch, int outputRate) {
+    std::lock_guard<std::mutex> lock(myMutex);
+
+    for (size_t i = 0; i < mySounds.size(); ++i) {
+        if (mySounds[i]) {
+            double rate = static_cast<double>(mySounds[i]->getFrequency());
+            myResamplers[i].setStep(rate / outputRate * pitch);
+        }
+    }
+
+    if (myNeedsSeek || fabs(playPos - myExpectedPos) > 1.0) {
+        seek(playPos, srcStep);
+    }
+
+    // Start the voices of all events before the end of the output.
+    double endPos = playPos + numFrames * srcStep;
+    for (auto& track : myTracks) {
+        const Event* prev = nullptr;
+        for (; track.cursor < track.events.size(); ++track.cursor) {
+            const Event& event = track.events[track.cursor];
+            if (event.frame >= endPos) break;
+
+            // Simultaneous events of the same sound play once, which avoids
+            // double ticks for jumps.
+            bool isDouble = prev && prev->frame == event.frame &&
+                            prev->sound == event.sound;
+            if (track.enabled && !isDouble) {
+                startVoice(event, (event.frame - playPos) / srcStep);
+            }
+            prev = &event;
+        }
+    }
+
+    // Mix the voices, and remove the ones that have ended.
+    auto end = std::remove_if(
+        myVoices.begin(), myVoices.end(),
+        [&](Voice& voice) { return !mixVoice(voice, dst, numFrames); });
+    myVoices.erase(end, myVoices.end());
+
+    myExpectedPos = endPos;
+}
+
+void VoiceScheduler::seek(double playPos, double srcStep) {
+    myVoices.clear();
+    myNeedsSeek = false;
+
+    // Events that started up to one sound length before the play position
+    // are still audible, so they start again partway through.
+    double lookback = 0.0;
+    for (size_t i = 0; i < mySounds.size(); ++i) {
+        if (mySounds[i]) {
+            const Resampler& resampler = myResamplers[i];
+            double frames =
+                mySounds[i]->getNumFrames() + resampler.getNumTaps();
+            lookback = std::max(lookback,
+                                frames / resampler.getStep() * srcStep);
+        }
+    }
+
+    for (auto& track : myTracks) {
+        track.cursor = FindEvent(track.events, playPos - lookback);
+    }
+}
+
+void VoiceScheduler::startVoice(const Event& event, double beginFrame) {
+    if (event.sound < 0 || event.sound >= static_cast<int>(mySounds.size())) {
+        return;
+    }
+    const Sound* sound = mySounds[event.sound];
+    if (!sound || event.gain <= 0) return;
+
+    // Output frames are rounded to the nearest frame, and the sound starts
+    // partway through if the event is before the start of the output.
+    int begin = static_cast<int>(llround(std::max(beginFrame, -1e9)));
+    int delay = std::max(0, begin);
+    double pos = (delay - beginFrame) * myResamplers[event.sound].getStep();
+    if (pos >= sound->getNumFrames()) return;
+
+    if (myVoices.size() == MAX_VOICES) myVoices.erase(myVoices.begin());
+    myVoices.push_back({event.sound, event.gain, delay, pos});
+}
+
+bool VoiceScheduler::mixVoice(Voice& voice, short* dst, int numFrames) {
+    const Sound* sound = mySounds[voice.sound];
+    Resampler& resampler = myResamplers[voice.sound];
+
+    int n = numFrames - voice.delay;
+    short* out = dst + voice.delay * 2;
+    const short* srcL = sound->samplesL();
+    const short* srcR = sound->samplesR();
+    int srcFrames = sound->getNumFrames();
+
+    if (voice.gain >= UNITY_GAIN) {
+        resampler.mix(out, n, voice.pos, srcL, srcR, srcFrames);
+    } else {
+        myVoiceBuffer.resize(n * 2);
+        short* tmp = myVoiceBuffer.data();
+        resampler.write(tmp, n, voice.pos, srcL, srcR, srcFrames);
+        MixKernels::scale(tmp, n * 2, voice.gain);
+        MixKernels::add(out, tmp, n * 2);
+    }
+
+    voice.pos += n * resampler.getStep();
+    voice.delay = 0;
+
+    // The voice ends once the filter of the resampler has passed the sound.
+    return voice.pos < srcFrames + resampler.getNumTaps() / 2;
+}
+
+};  // namespace Vortex
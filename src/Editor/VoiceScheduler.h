@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <Editor/Resampler.h>
+
+namespace Vortex {
+
+class Sound;
+
+/// Plays short sounds, such as ticks and keysounds, at scheduled frames of the
+/// music. Events are kept per track, sorted by frame, and a cursor in every
+/// track follows the play position. Seeking moves the cursors with a binary
+/// search, and many sounds can play at the same time, each with its own gain.
+///
+/// Events and sounds are edited on the main thread, and mixed on the mixer
+/// thread. Edits only hold up the mixer for the range of events they change.
+class VoiceScheduler {
+   public:
+    /// Gain at which a sound plays at its original level.
+    static const int UNITY_GAIN = 1 << 15;
+
+    /// Maximum number of sounds that play at the same time. If more sounds
+    /// start, the oldest ones are cut off.
+    static const int MAX_VOICES = 128;
+
+    /// A sound that starts playing at a frame of the music.
+    struct Event {
+        int64_t frame;  ///< Music frame at which the sound starts.
+        int sound;      ///< Index of the sound in the sound table.
+        int gain;       ///< Q15 gain, where UNITY_GAIN is the original level.
+    };
+
+    explicit VoiceScheduler(int numTracks);
+
+    /// Replaces the sound table and stops all voices. Sounds are not owned,
+    /// and must stay valid until the table is replaced. Null entries are
+    /// silent.
+    void setSounds(const std::vector<const Sound*>& sounds);
+
+    /// Replaces the events of a track, which must be sorted by frame. Only the
+    /// range of events that differs from the current events is replaced, and
+    /// the track cursor is kept if the change is past it.
+    void setEvents(int track, const std::vector<Event>& events);
+
+    /// Replaces "count" events of a track, starting at index "first", with the
+    /// given events. The track must stay sorted by frame. This allows an edit
+    /// of a few events to be applied without comparing all of them.
+    void replaceEvents(int track, size_t first, size_t count,
+                       const std::vector<Event>& events);
+
+    /// Enables or disables a track. Disabled tracks start no new voices, but
+    /// their cursors keep following the play position.
+    void setEnabled(int track, bool enabled);
+
+    /// Stops all voices, and seeks all tracks on the next call to "mix".
+    void reset();
+
+    /// Adds the voices to interleaved stereo output frames. The output starts
+    /// at music frame "playPos" and advances "srcStep" music frames per output
+    /// frame. Sounds are resampled to the output samplerate, and their rate is
+    /// multiplied by "pitch". A play position that does not follow on from the
+    /// previous call seeks all tracks.
+    void mix(short* dst, int numFrames, double playPos, double srcStep,
+             double pitch, int outputRate);
+
+   private:
+    struct Track {
+        std::vector<Event> events;
+        size_t cursor;  // first event that has not started yet.
+        bool enabled;
+    };
+
+    struct Voice {
+        int sound;
+        int gain;
+        int delay;   // output frames before the voice starts.
+        double pos;  // sound frame at the start of the next output block.
+    };
+
+    void spliceEvents(int track, size_t first, size_t count, const Event* begin,
+                      const Event* end);
+    void seek(double playPos, double srcStep);
+    void startVoice(const Event& event, double beginFrame);
+    bool mixVoice(Voice& voice, short* dst, int numFrames);
+
+    std::mutex myMutex;
+    std::vector<Track> myTracks;
+    std::vector<Voice> myVoices;
+    std::vector<const Sound*> mySounds;
+    std::vector<Resampler> myResamplers;
+    std::vector<short> myVoiceBuffer;
+    double myExpectedPos;
+    bool myNeedsSeek;
+};
+
+};  // namespace Vortex
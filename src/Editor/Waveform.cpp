@@ -3,6 +3,11 @@
 #include <math.h>
 #include <stdint.h>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include <Core/Utils.h>
@@ -13,6 +18,7 @@
 
 #include <System/System.h>
 #include <System/Debug.h>
+#include <System/TaskScheduler.h>
 
 #include <Editor/Music.h>
 #include <Editor/View.h>
@@ -21,17 +27,29 @@
 #include <Editor/Menubar.h>
 #include <Editor/TextOverlay.h>
 #include <Editor/Butterworth.h>
+#include <Editor/PeakPyramid.h>
 
 namespace Vortex {
 
 static const int TEX_W = 256;
 static const int TEX_H = 128;
-static const int UNUSED_BLOCK = -1;
+
+// Number of blocks rendered ahead of the visible region.
+static const int PREFETCH_BLOCKS = 4;
+
+// Texture memory available for cached blocks, each of which uses up to four textures.
+static const int BLOCK_MEMORY_BUDGET = 16 * 1024 * 1024;
+static const int MAX_CACHED_BLOCKS = BLOCK_MEMORY_BUDGET / (TEX_W * TEX_H * 4);
+
+enum BlockState { BLOCK_QUEUED, BLOCK_URGENT, BLOCK_READY, BLOCK_REFRESHING };
 
 struct WaveBlock
 {
 	int id;
+	BlockState state;
+	int decodedFrames;
 	Texture tex[4];
+	std::list<WaveBlock*>::iterator lruPos;
 };
 
 // ================================================================================================
@@ -45,6 +63,9 @@ double strength;
 std::vector<short> samplesL;
 std::vector<short> samplesR;
 
+PeakPyramid peaksL;
+PeakPyramid peaksR;
+
 static void lowPassFilter(const short* src, short* dst,
 	int numFrames, int samplerate, double strength)
 {
@@ -73,6 +94,8 @@ void update()
 		filter = lowPassFilter;
 	}
 
+	peaksL.clear();
+	peaksR.clear();
 	samplesL.clear();
 	samplesR.clear();
 
@@ -87,22 +110,440 @@ void update()
 
 		filter(music.samplesL(), samplesL.data(), numFrames, samplerate, strength);
 		filter(music.samplesR(), samplesR.data(), numFrames, samplerate, strength);
+
+		peaksL.build(samplesL.data(), numFrames);
+		peaksR.build(samplesR.data(), numFrames);
 	}
 }
 
 }; // WaveFilter.
 
+// ================================================================================================
+// WaveRenderer.
+
+// Settings that determine the contents of a rendered block.
+struct WaveRenderParams
+{
+	int blockWidth;
+	int antiAliasing;
+	Waveform::WaveShape shape;
+	Waveform::Luminance luminance;
+	const WaveFilter* filter;
+	bool overlayFilter;
+	double pixPerSec;
+
+	bool operator==(const WaveRenderParams&) const = default;
+};
+
+// The pixels of a rendered block, which are uploaded to the block textures by the UI thread.
+struct WaveRaster
+{
+	int id;
+	int width;
+	int numTextures;
+	std::vector<uchar> pixels[4];
+};
+
+struct WaveEdge { int l, r; uchar lum; };
+
+// Rasterizes blocks without touching any GPU resources, so it can run on a worker thread.
+struct WaveRenderer {
+
+std::vector<uchar> textureBuffer;
+std::vector<WaveEdge> edgeBuffer;
+
+// ================================================================================================
+// WaveRenderer :: luminance functions.
+
+void edgeLumUniform(WaveEdge* edge, int h)
+{
+	for(int y = 0; y < h; ++y, ++edge)
+	{
+		edge->lum = 255;
+	}
+}
+
+void edgeLumAmplitude(WaveEdge* edge, int w, int h)
+{
+	int scalar = (255 << 16) * 2 / w;
+	for(int y = 0; y < h; ++y, ++edge)
+	{
+		int mag = max(abs(edge->l), abs(edge->r));
+		edge->lum = (mag * scalar) >> 16;
+	}
+}
+
+// ================================================================================================
+// WaveRenderer :: edge shape functions.
+
+void edgeShapeRectified(uchar* dst, const WaveEdge* edge, int w, int h)
+{
+	int cx = w / 2;
+	for(int y = 0; y < h; ++y, dst += w, ++edge)
+	{
+		int mag = max(abs(edge->l), abs(edge->r));
+		int l = cx - mag;
+		int r = cx + mag;
+		for(int x = l; x < r; ++x) dst[x] = edge->lum;
+	}
+}
+
+void edgeShapeSigned(uchar* dst, const WaveEdge* edge, int w, int h)
+{
+	int cx = w / 2;
+	for(int y = 0; y < h; ++y, dst += w, ++edge)
+	{
+		int l = cx + min(edge->l, 0);
+		int r = cx + max(edge->r, 0);
+		for(int x = l; x < r; ++x) dst[x] = edge->lum;
+	}
+}
+
+// ================================================================================================
+// WaveRenderer :: anti-aliasing functions.
+
+void antiAlias2x(uchar* dst, int w, int h)
+{
+	int newW = w / 2, newH = h / 2;
+	for(int y = 0; y < newH; ++y)
+	{
+		uchar* line = textureBuffer.data() + (y * 2) * w;
+		for(int x = 0; x < newW; ++x, ++dst)
+		{
+			uchar* a = line + (x * 2), *b = a + w;
+			int sum = 0;
+			sum += a[0] + a[1];
+			sum += b[0] + b[1];
+			*dst = sum / 4;
+		}
+	}
+}
+
+void antiAlias3x(uchar* dst, int w, int h)
+{
+	int newW = w / 3, newH = h / 3;
+	for(int y = 0; y < newH; ++y)
+	{
+		uchar* line = textureBuffer.data() + (y * 3) * w;
+		for(int x = 0; x < newW; ++x, ++dst)
+		{
+			uchar* a = line + (x * 3);
+			uchar* b = a + w, *c = b + w;
+			int sum = 0;
+			sum += a[0] + a[1] + a[2];
+			sum += b[0] + b[1] + b[2];
+			sum += c[0] + c[1] + c[2];
+			*dst = sum / 9;
+		}
+	}
+}
+
+void antiAlias4x(uchar* dst, int w, int h)
+{
+	int newW = w / 4, newH = h / 4;
+	for(int y = 0; y < newH; ++y)
+	{
+		uchar* line = textureBuffer.data() + (y * 4) * w;
+		for(int x = 0; x < newW; ++x, ++dst)
+		{
+			uchar* a = line + (x * 4), *b = a + w;
+			uchar* c = b + w, *d = c + w;
+			int sum = 0;
+			sum += a[0] + a[1] + a[2] + a[3];
+			sum += b[0] + b[1] + b[2] + b[3];
+			sum += c[0] + c[1] + c[2] + c[3];
+			sum += d[0] + d[1] + d[2] + d[3];
+			*dst = sum / 16;
+		}
+	}
+}
+
+// ================================================================================================
+// WaveRenderer :: block rendering functions.
+
+void sampleEdges(WaveEdge* edges, int w, int h, int channel, int blockId, const WaveRenderParams& params, bool filtered)
+{
+	auto& music = gMusic->getSamples();
+
+	double samplesPerSec = (double)music.getFrequency();
+	double samplesPerPixel = samplesPerSec / params.pixPerSec;
+	double samplesPerBlock = (double)TEX_H * samplesPerPixel;
+
+	// Only frames below the decoded watermark are read while the music is loading.
+	int64_t srcFrames = filtered ? params.filter->peaksL.getNumFrames() : music.getNumDecodedFrames();
+	int64_t samplePos = max((int64_t)0, (int64_t)(samplesPerBlock * (double)blockId));
+	double sampleCount = min((double) srcFrames - samplePos, samplesPerBlock);
+
+	if (samplePos >= srcFrames || sampleCount <= 0)
+	{
+		// A crash could occur if we try to access out-of-bounds memory.
+		// Fill the edges with zeroes to avoid this issue.
+		for (int y = 0; y < h; ++y)
+		{
+			edges[y] = {0, 0, 0};
+		}
+		return;
+	}
+
+	int wh = w / 2 - 1;
+
+	// Line peaks are read from the pyramids, which keeps the cost per line
+	// independent of the zoom level.
+	const PeakPyramid* peaks;
+	if(filtered)
+	{
+		peaks = (channel == 0) ? &params.filter->peaksL : &params.filter->peaksR;
+	}
+	else
+	{
+		peaks = (channel == 0) ? &music.peaksL() : &music.peaksR();
+	}
+
+	double advance = samplesPerPixel * TEX_H / h;
+	for(int y = 0; y < h; ++y)
+	{
+		// Determine the sample range of the line, which contains at least one sample.
+		int64_t lineBegin = samplePos + (int64_t)round(min(sampleCount, (double)y * advance));
+		int64_t lineEnd = samplePos + (int64_t)round(min(sampleCount, (double)(y + 1) * advance));
+		lineEnd = min(max(lineEnd, lineBegin + 1), srcFrames);
+
+		// Find the minimum/maximum amplitude within the line.
+		int minAmp = SHRT_MAX;
+		int maxAmp = SHRT_MIN;
+		peaks->getPeak((int)lineBegin, (int)lineEnd, minAmp, maxAmp);
+
+		// Clamp the minimum/maximum amplitude.
+		int l = (minAmp * wh) >> 15;
+		int r = (maxAmp * wh) >> 15;
+		if(r >= l)
+		{
+			edges[y] = {clamp(l, -wh, wh), clamp(r, -wh, wh), 0};
+		}
+		else
+		{
+			edges[y] = {0, 0, 0};
+		}
+	}
+}
+
+void renderWaveform(std::vector<uchar>* outPixels, int w, int h, int blockId, const WaveRenderParams& params, bool filtered)
+{
+	uchar* texBuf = textureBuffer.data();
+	WaveEdge* edgeBuf = edgeBuffer.data();
+	for(int channel = 0; channel < 2; ++channel)
+	{
+		memset(texBuf, 0, w * h);
+
+		// Process edges
+		sampleEdges(edgeBuf, w, h, channel, blockId, params, filtered);
+
+		// Apply luminance
+		if (params.luminance == Waveform::LL_UNIFORM) {
+			edgeLumUniform(edgeBuf, h);
+		}
+		else if (params.luminance == Waveform::LL_AMPLITUDE) {
+			edgeLumAmplitude(edgeBuf, w, h);
+		}
+
+		// Apply wave shape
+		if (params.shape == Waveform::WS_RECTIFIED) {
+			edgeShapeRectified(texBuf, edgeBuf, w, h);
+		}
+		else if (params.shape == Waveform::WS_SIGNED) {
+			edgeShapeSigned(texBuf, edgeBuf, w, h);
+		}
+
+		// Apply anti-aliasing
+		switch (params.antiAliasing) {
+		case 1: antiAlias2x(texBuf, w, h); break;
+		case 2: antiAlias3x(texBuf, w, h); break;
+		case 3: antiAlias4x(texBuf, w, h); break;
+		}
+
+		// The downsampled pixels are stored at the start of the texture buffer.
+		outPixels[channel].assign(texBuf, texBuf + params.blockWidth * TEX_H);
+	}
+}
+
+void renderBlock(WaveRaster& out, const WaveRenderParams& params, int id)
+{
+	int w = params.blockWidth * (params.antiAliasing + 1);
+	int h = TEX_H * (params.antiAliasing + 1);
+	textureBuffer.resize(w * h);
+	edgeBuffer.resize(h);
+
+	out.id = id;
+	out.width = params.blockWidth;
+	if(params.filter)
+	{
+		if(params.overlayFilter)
+		{
+			out.numTextures = 4;
+			renderWaveform(out.pixels + 0, w, h, id, params, false);
+			renderWaveform(out.pixels + 2, w, h, id, params, true);
+		}
+		else
+		{
+			out.numTextures = 2;
+			renderWaveform(out.pixels, w, h, id, params, true);
+		}
+	}
+	else
+	{
+		out.numTextures = 2;
+		renderWaveform(out.pixels, w, h, id, params, false);
+	}
+}
+
+}; // WaveRenderer.
+
+// ================================================================================================
+// WaveRasterizer.
+
+// Renders requested blocks in the background, so the UI thread only has to upload them. The blocks
+// are rendered by a task that is only queued while there are requests, so an idle waveform does not
+// hold on to a worker of the task scheduler.
+struct WaveRasterizer {
+
+std::mutex mutex_;
+std::condition_variable idle_;
+std::deque<int> pending_;
+std::vector<WaveRaster*> finished_;
+WaveRenderParams params_ = {};
+WaveRenderer renderer_;
+TaskHandle task_;
+int generation_ = 0;
+bool busy_ = false;
+bool running_ = false;
+
+~WaveRasterizer()
+{
+	terminate();
+	for(auto raster : finished_) delete raster;
+}
+
+// Renders requested blocks until there are none left.
+void exec(Task& task)
+{
+	std::stop_token token = task.getStopToken();
+	std::unique_lock<std::mutex> lock(mutex_);
+	while(!pending_.empty() && !token.stop_requested())
+	{
+		int id = pending_.front();
+		pending_.pop_front();
+
+		WaveRenderParams params = params_;
+		int generation = generation_;
+		busy_ = true;
+
+		lock.unlock();
+		auto raster = new WaveRaster;
+		renderer_.renderBlock(*raster, params, id);
+		lock.lock();
+
+		// Blocks requested before the last reset are outdated.
+		busy_ = false;
+		if(generation == generation_)
+		{
+			finished_.push_back(raster);
+		}
+		else
+		{
+			delete raster;
+		}
+		idle_.notify_all();
+	}
+	running_ = false;
+}
+
+// Stops rendering, and waits for the block that is being rendered.
+void terminate()
+{
+	TaskHandle task;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_.clear();
+		task = task_;
+	}
+	if(task)
+	{
+		task->cancel();
+		task->wait();
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	running_ = false;
+}
+
+// Discards all requested and finished blocks, and waits for the block that is being rendered.
+// Afterwards, the rasterizer no longer reads from the music or the previous filter.
+void reset(const WaveRenderParams& params)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_.wait(lock, [&] { return !busy_; });
+
+	for(auto raster : finished_) delete raster;
+	finished_.clear();
+	pending_.clear();
+
+	params_ = params;
+	++generation_;
+}
+
+// Queues a block for rendering. Urgent blocks are rendered before all other requested blocks.
+void request(int id, bool urgent)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if(urgent)
+	{
+		pending_.erase(std::remove(pending_.begin(), pending_.end(), id), pending_.end());
+		pending_.push_front(id);
+	}
+	else
+	{
+		pending_.push_back(id);
+	}
+	if(!running_)
+	{
+		running_ = true;
+		task_ = TaskScheduler::submit(TaskPriority::Interactive, [this](Task& task) { exec(task); });
+	}
+}
+
+// Removes a block from the requested blocks, so a block that is no longer cached is not rendered.
+void cancel(int id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	pending_.erase(std::remove(pending_.begin(), pending_.end(), id), pending_.end());
+}
+
+// Moves the blocks that finished rendering since the last call to the output list.
+void collect(std::vector<WaveRaster*>& out)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	out.insert(out.end(), finished_.begin(), finished_.end());
+	finished_.clear();
+}
+
+}; // WaveRasterizer.
+
 // ================================================================================================
 // WaveformImpl :: member data.
 
 struct WaveformImpl : public Waveform {
 
-std::vector<WaveBlock*> waveformBlocks_;
+std::unordered_map<int, WaveBlock*> waveformBlocks_;
+std::list<WaveBlock*> waveformBlockLru_;
+std::vector<WaveBlock*> waveformFreeBlocks_;
+
+WaveRasterizer waveformRasterizer_;
+WaveRenderer waveformRenderer_;
+WaveRenderParams waveformRenderParams_;
+std::vector<WaveRaster*> waveformFinishedBlocks_;
 
 WaveFilter* waveformFilter_;
-std::vector<uchar> waveformTextureBuffer_;
 
 int waveformBlockWidth_, waveformSpacing_;
+int waveformPrevVisibilityStartY_, waveformScrollDirection_;
 
 ColorScheme waveformColorScheme_;
 WaveShape waveformShape_;
@@ -115,21 +556,24 @@ bool waveformOverlayFilter_;
 
 ~WaveformImpl()
 {
-	for(auto block : waveformBlocks_) delete block;
+	waveformRasterizer_.terminate();
+	clearBlocks();
+	for(auto block : waveformFreeBlocks_) delete block;
 	delete waveformFilter_;
 }
 
 WaveformImpl()
 {
-	setPreset(PRESET_VORTEX);
-
 	waveformFilter_ = nullptr;
 	waveformOverlayFilter_ = true;
 
-	updateBlockW();
-	waveformTextureBuffer_.resize(TEX_W * TEX_H);
+	waveformBlockWidth_ = 0;
+	waveformSpacing_ = 0;
+	waveformPrevVisibilityStartY_ = 0;
+	waveformScrollDirection_ = 1;
 
-	clearBlocks();
+	setPreset(PRESET_VORTEX);
+	updateBlockW();
 }
 
 // ================================================================================================
@@ -204,12 +648,34 @@ void saveSettings(XmrNode& settings)
 // ================================================================================================
 // ViewImpl :: member functions.
 
+WaveRenderParams getRenderParams()
+{
+	WaveRenderParams params;
+	params.blockWidth = waveformBlockWidth_;
+	params.antiAliasing = waveformAntiAliasingMode_;
+	params.shape = waveformShape_;
+	params.luminance = waveformLuminance_;
+	params.filter = waveformFilter_;
+	params.overlayFilter = waveformOverlayFilter_;
+	params.pixPerSec = fabs(gView->getPixPerSec());
+	return params;
+}
+
 void clearBlocks()
 {
-	for(auto block : waveformBlocks_)
+	waveformRenderParams_ = getRenderParams();
+	waveformRasterizer_.reset(waveformRenderParams_);
+
+	for(auto raster : waveformFinishedBlocks_) delete raster;
+	waveformFinishedBlocks_.clear();
+
+	// Keep the blocks around, so their textures can be reused.
+	for(auto block : waveformBlockLru_)
 	{
-		block->id = UNUSED_BLOCK;
+		waveformFreeBlocks_.push_back(block);
 	}
+	waveformBlockLru_.clear();
+	waveformBlocks_.clear();
 }
 
 void setOverlayFilter(bool enabled)
@@ -226,6 +692,8 @@ bool getOverlayFilter()
 
 void enableFilter(FilterType type, double strength)
 {
+	waveformRasterizer_.reset(waveformRenderParams_);
+
 	delete waveformFilter_;
 	waveformFilter_ = new WaveFilter(type, strength);
 
@@ -234,6 +702,8 @@ void enableFilter(FilterType type, double strength)
 
 void disableFilter()
 {
+	waveformRasterizer_.reset(waveformRenderParams_);
+
 	delete waveformFilter_;
 	waveformFilter_ = nullptr;
 
@@ -249,7 +719,11 @@ void onChanges(int changes)
 {
 	if(changes & VCM_MUSIC_IS_LOADED)
 	{
+		waveformRasterizer_.reset(waveformRenderParams_);
 		if(waveformFilter_) waveformFilter_->update();
+
+		// Blocks rendered while the music was loading are incomplete.
+		clearBlocks();
 	}
 }
 
@@ -325,281 +799,137 @@ int getAntiAliasing()
 }
 
 // ================================================================================================
-// Waveform :: luminance functions.
+// WaveformImpl :: block management.
 
-struct WaveEdge { int l, r; uchar lum; };
-
-void edgeLumUniform(WaveEdge* edge, int h)
+// Returns the block with the given id if it is cached, and marks it as most recently used.
+WaveBlock* findBlock(int id)
 {
-	for(int y = 0; y < h; ++y, ++edge)
-	{
-		edge->lum = 255;
-	}
-}
+	auto it = waveformBlocks_.find(id);
+	if(it == waveformBlocks_.end()) return nullptr;
 
-void edgeLumAmplitude(WaveEdge* edge, int w, int h)
-{
-	int scalar = (255 << 16) * 2 / w;
-	for(int y = 0; y < h; ++y, ++edge)
-	{
-		int mag = max(abs(edge->l), abs(edge->r));
-		edge->lum = (mag * scalar) >> 16;
-	}
+	WaveBlock* block = it->second;
+	waveformBlockLru_.splice(waveformBlockLru_.begin(), waveformBlockLru_, block->lruPos);
+	return block;
 }
 
-// ================================================================================================
-// Waveform :: edge shape functions.
-
-void edgeShapeRectified(uchar* dst, const WaveEdge* edge, int w, int h)
+WaveBlock* allocateBlock(int id)
 {
-	int cx = w / 2;
-	for(int y = 0; y < h; ++y, dst += w, ++edge)
+	WaveBlock* block;
+	if((int)waveformBlocks_.size() >= MAX_CACHED_BLOCKS)
 	{
-		int mag = max(abs(edge->l), abs(edge->r));
-		int l = cx - mag;
-		int r = cx + mag;
-		for(int x = l; x < r; ++x) dst[x] = edge->lum;
+		// The cache is full, recycle the least recently used block.
+		block = waveformBlockLru_.back();
+		waveformBlockLru_.pop_back();
+		waveformBlocks_.erase(block->id);
+		if(block->state != BLOCK_READY)
+		{
+			waveformRasterizer_.cancel(block->id);
+		}
 	}
-}
-
-void edgeShapeSigned(uchar* dst, const WaveEdge* edge, int w, int h)
-{
-	int cx = w / 2;
-	for(int y = 0; y < h; ++y, dst += w, ++edge)
+	else if(!waveformFreeBlocks_.empty())
 	{
-		int l = cx + min(edge->l, 0);
-		int r = cx + max(edge->r, 0);
-		for(int x = l; x < r; ++x) dst[x] = edge->lum;
+		block = waveformFreeBlocks_.back();
+		waveformFreeBlocks_.pop_back();
 	}
-}
-
-// ================================================================================================
-// Waveform :: anti-aliasing functions.
-
-void antiAlias2x(uchar* dst, int w, int h)
-{
-	int newW = w / 2, newH = h / 2;
-	for(int y = 0; y < newH; ++y)
+	else
 	{
-		uchar* line = waveformTextureBuffer_.data() + (y * 2) * w;
-		for(int x = 0; x < newW; ++x, ++dst)
-		{
-			uchar* a = line + (x * 2), *b = a + w;
-			int sum = 0;
-			sum += a[0] + a[1];
-			sum += b[0] + b[1];
-			*dst = sum / 4;
-		}
+		block = new WaveBlock;
 	}
+
+	block->id = id;
+	block->state = BLOCK_QUEUED;
+	waveformBlockLru_.push_front(block);
+	block->lruPos = waveformBlockLru_.begin();
+	waveformBlocks_[id] = block;
+	return block;
 }
 
-void antiAlias3x(uchar* dst, int w, int h)
+void uploadBlock(WaveBlock* block, const WaveRaster& raster)
 {
-	int newW = w / 3, newH = h / 3;
-	for(int y = 0; y < newH; ++y)
+	for(int i = 0; i < raster.numTextures; ++i)
 	{
-		uchar* line = waveformTextureBuffer_.data() + (y * 3) * w;
-		for(int x = 0; x < newW; ++x, ++dst)
+		if(!block->tex[i].handle())
 		{
-			uchar* a = line + (x * 3);
-			uchar* b = a + w, *c = b + w;
-			int sum = 0;
-			sum += a[0] + a[1] + a[2];
-			sum += b[0] + b[1] + b[2];
-			sum += c[0] + c[1] + c[2];
-			*dst = sum / 9;
+			block->tex[i] = Texture(TEX_W, TEX_H, Texture::ALPHA);
 		}
+		block->tex[i].modify(0, 0, raster.width, TEX_H, raster.pixels[i].data());
 	}
+	block->state = BLOCK_READY;
 }
 
-void antiAlias4x(uchar* dst, int w, int h)
+// Uploads the blocks that were finished by the rasterizer; this is the only work done on the
+// UI thread for blocks that are rendered in the background.
+void uploadFinishedBlocks()
 {
-	int newW = w / 4, newH = h / 4;
-	for(int y = 0; y < newH; ++y)
+	waveformRasterizer_.collect(waveformFinishedBlocks_);
+	for(auto raster : waveformFinishedBlocks_)
 	{
-		uchar* line = waveformTextureBuffer_.data() + (y * 4) * w;
-		for(int x = 0; x < newW; ++x, ++dst)
+		auto it = waveformBlocks_.find(raster->id);
+		if(it != waveformBlocks_.end())
 		{
-			uchar* a = line + (x * 4), *b = a + w;
-			uchar* c = b + w, *d = c + w;
-			int sum = 0;
-			sum += a[0] + a[1] + a[2] + a[3];
-			sum += b[0] + b[1] + b[2] + b[3];
-			sum += c[0] + c[1] + c[2] + c[3];
-			sum += d[0] + d[1] + d[2] + d[3];
-			*dst = sum / 16;
+			uploadBlock(it->second, *raster);
 		}
+		delete raster;
 	}
+	waveformFinishedBlocks_.clear();
 }
 
-// ================================================================================================
-// Waveform :: block rendering functions.
-
-void sampleEdges(WaveEdge* edges, int w, int h, int channel, int blockId, bool filtered)
+// While the music is decoding, a block that was rendered before all of its frames were available
+// is outdated once more of its frames have been decoded.
+bool isOutdated(const WaveBlock* block)
 {
 	auto& music = gMusic->getSamples();
+	double framesPerBlock = (double)music.getFrequency() / waveformRenderParams_.pixPerSec * TEX_H;
+	int64_t blockBegin = (int64_t)(framesPerBlock * (double)block->id);
+	int64_t blockEnd = (int64_t)(framesPerBlock * (double)(block->id + 1));
+	int64_t decoded = music.getNumDecodedFrames();
+	return block->decodedFrames < blockEnd && decoded > max((int64_t)block->decodedFrames, blockBegin);
+}
 
-	double samplesPerSec = (double)music.getFrequency();
-	double samplesPerPixel = samplesPerSec / fabs(gView->getPixPerSec());
-	double samplesPerBlock = (double)TEX_H * samplesPerPixel;
-
-	int64_t srcFrames = filtered ? waveformFilter_->samplesL.size() : music.getNumFrames();
-	int64_t samplePos = max((int64_t)0, (int64_t)(samplesPerBlock * (double)blockId));
-	double sampleCount = min((double) srcFrames - samplePos, samplesPerBlock);
-
-	if (samplePos >= srcFrames || sampleCount <= 0)
-	{
-		// A crash could occur if we try to access out-of-bounds memory.
-		// Fill the edges with zeroes to avoid this issue.
-		for (int y = 0; y < h; ++y)
-		{
-			edges[y] = {0, 0, 0};
-		}
-		return;
-	}
-
-	double sampleSkip = max(0.001, (samplesPerPixel / 200.0));
-	int wh = w / 2 - 1;
-
-	const short* in = nullptr;
-	if(filtered)
+void renderBlock(WaveBlock* block, bool urgent)
+{
+	block->decodedFrames = gMusic->getSamples().getNumDecodedFrames();
+	if(gEditor->hasMultithreading())
 	{
-		in = ((channel == 0) ? waveformFilter_->samplesL.data() : waveformFilter_->samplesR.data());
+		waveformRasterizer_.request(block->id, urgent);
 	}
 	else
 	{
-		in = ((channel == 0) ? music.samplesL() : music.samplesR());
-	}
-	in += samplePos;
-
-	double advance = samplesPerPixel * TEX_H / h;
-	double ofs = 0;
-	for(int y = 0; y < h; ++y)
-	{
-		// Determine the last sample of the line.
-		double end = min(sampleCount, (double)(y + 1) * advance);
-
-		// Find the minimum/maximum amplitude within the line.
-		int minAmp = SHRT_MAX;
-		int maxAmp = SHRT_MIN;
-		while(ofs < end)
-		{
-			maxAmp = max(maxAmp, (int)*(in + (int) round(ofs)));
-			minAmp = min(minAmp, (int)*(in + (int) round(ofs)));
-			ofs += sampleSkip;
-		}
-
-		// Clamp the minimum/maximum amplitude.
-		int l = (minAmp * wh) >> 15;
-		int r = (maxAmp * wh) >> 15;
-		if(r >= l)
-		{
-			edges[y] = {clamp(l, -wh, wh), clamp(r, -wh, wh), 0};
-		}
-		else
-		{
-			edges[y] = {0, 0, 0};
-		}
+		WaveRaster raster;
+		waveformRenderer_.renderBlock(raster, waveformRenderParams_, block->id);
+		uploadBlock(block, raster);
 	}
 }
 
-void renderWaveform(Texture* textures, WaveEdge* edgeBuf, int w, int h, int blockId, bool filtered)
+// Returns the block with the given id, and requests it from the rasterizer if it is not cached.
+// Visible blocks are rendered before prefetched blocks.
+WaveBlock* getBlock(int id, bool visible)
 {
-	uchar* texBuf = waveformTextureBuffer_.begin();
-	for(int channel = 0; channel < 2; ++channel)
+	WaveBlock* block = findBlock(id);
+	if(!block)
 	{
-		memset(texBuf, 0, w * h);
-
-		// Process edges
-		sampleEdges(edgeBuf, w, h, channel, blockId, filtered);
-
-		// Apply luminance
-		if (waveformLuminance_ == LL_UNIFORM) {
-			edgeLumUniform(edgeBuf, h);
-		}
-		else if (waveformLuminance_ == LL_AMPLITUDE) {
-			edgeLumAmplitude(edgeBuf, w, h);
-		}
-
-		// Apply wave shape
-		if (waveformShape_ == WS_RECTIFIED) {
-			edgeShapeRectified(texBuf, edgeBuf, w, h);
-		}
-		else if (waveformShape_ == WS_SIGNED) {
-			edgeShapeSigned(texBuf, edgeBuf, w, h);
-		}
-
-		// Apply anti-aliasing
-		switch (waveformAntiAliasingMode_) {
-		case 1: antiAlias2x(texBuf, w, h); break;
-		case 2: antiAlias3x(texBuf, w, h); break;
-		case 3: antiAlias4x(texBuf, w, h); break;
-		}
-
-		// Create or update texture
-		if (!textures[channel].handle()) {
-			textures[channel] = Texture(TEX_W, TEX_H, Texture::ALPHA);
-		}
-		textures[channel].modify(0, 0, waveformBlockWidth_, TEX_H, texBuf);
+		block = allocateBlock(id);
+		block->state = visible ? BLOCK_URGENT : BLOCK_QUEUED;
+		renderBlock(block, visible);
 	}
-}
-
-void renderBlock(WaveBlock* block)
-{
-	int w = waveformBlockWidth_ * (waveformAntiAliasingMode_ + 1);
-	int h = TEX_H * (waveformAntiAliasingMode_ + 1);
-	waveformTextureBuffer_.resize(w * h);
-
-	std::vector<WaveEdge> edges;
-	edges.resize(h);
-
-	if(waveformFilter_)
+	else if(visible && block->state == BLOCK_QUEUED)
 	{
-		if(waveformOverlayFilter_)
-		{
-			renderWaveform(block->tex + 0, edges.data(), w, h, block->id, false);
-			renderWaveform(block->tex + 2, edges.data(), w, h, block->id, true);
-		}
-		else
-		{
-			renderWaveform(block->tex, edges.data(), w, h, block->id, true);
-		}
+		block->state = BLOCK_URGENT;
+		waveformRasterizer_.request(id, true);
 	}
-	else
+	else if(visible && block->state == BLOCK_READY && isOutdated(block))
 	{
-		renderWaveform(block->tex, edges.data(), w, h, block->id, false);
+		// Keep showing the current textures until the new frames are rendered.
+		block->state = BLOCK_REFRESHING;
+		renderBlock(block, true);
 	}
+	return block;
 }
 
-WaveBlock* getBlock(int id)
+// Returns true if the block textures contain a rendered block.
+static bool HasTextures(const WaveBlock* block)
 {
-	// Check if we already have the requested block.
-	for(auto block : waveformBlocks_)
-	{
-		if(block->id == id)
-		{
-			return block;
-		}
-	}
-
-	// If not, check if we have any free blocks available.
-	for(auto block : waveformBlocks_)
-	{
-		if(block->id == UNUSED_BLOCK)
-		{
-			block->id = id;
-			renderBlock(block);
-			return block;
-		}
-	}
-
-	// If not, create a new block.
-	WaveBlock* block = new WaveBlock;
-	waveformBlocks_.push_back(block);
-
-	block->id = id;
-	renderBlock(block);
-	return block;
+	return block->state == BLOCK_READY || block->state == BLOCK_REFRESHING;
 }
 
 void updateBlockW()
@@ -627,6 +957,11 @@ void drawPeaks()
 {
 	updateBlockW();
 
+	// Changes in zoom level invalidate all cached blocks.
+	if(!(getRenderParams() == waveformRenderParams_)) clearBlocks();
+
+	uploadFinishedBlocks();
+
 	bool reversed = gView->hasReverseScroll();
 	int visibilityStartY, visibilityEndY;
 	if(reversed)
@@ -640,19 +975,6 @@ void drawPeaks()
 		visibilityEndY = visibilityStartY + gView->getHeight();
 	}
 
-	// Free up blocks that are no longer visible.
-	for(auto block : waveformBlocks_)
-	{
-		if(block->id != UNUSED_BLOCK)
-		{
-			int y = block->id * TEX_H;
-			if(y >= visibilityEndY || y + TEX_H <= visibilityStartY)
-			{
-				block->id = UNUSED_BLOCK;
-			}
-		}
-	}
-
 	// Show blocks for the regions of the song that are visible.
 	int border = waveformSpacing_, pw = waveformBlockWidth_ / 2;
 	int cx = gView->getReceptorCoords().xc;
@@ -662,10 +984,12 @@ void drawPeaks()
 	areaf uvs = {0, 0, waveformBlockWidth_ / (float)TEX_W, 1};
 	if(reversed) swapValues(uvs.t, uvs.b);
 
-	int id = max(0, visibilityStartY / TEX_H);
+	int firstId = max(0, visibilityStartY / TEX_H);
+	int id = firstId;
 	for(; id * TEX_H < visibilityEndY; ++id)
 	{
-		auto block = getBlock(id);
+		auto block = getBlock(id, true);
+		if(!HasTextures(block)) continue;
 
 		int y = id * TEX_H - visibilityStartY;
 		if(reversed) y = gView->getHeight() - y - TEX_H;
@@ -687,6 +1011,26 @@ void drawPeaks()
 			Draw::fill({xr - pw, y, pw * 2, TEX_H}, filterCol, texR, uvs, Texture::ALPHA);
 		}
 	}
+	int lastId = id - 1;
+
+	// Prefetch blocks ahead of the scroll direction, or ahead of the cursor during playback.
+	if(visibilityStartY != waveformPrevVisibilityStartY_)
+	{
+		waveformScrollDirection_ = (visibilityStartY > waveformPrevVisibilityStartY_) ? 1 : -1;
+		waveformPrevVisibilityStartY_ = visibilityStartY;
+	}
+	if(!gMusic->isPaused())
+	{
+		waveformScrollDirection_ = 1;
+	}
+	if(gEditor->hasMultithreading())
+	{
+		for(int i = 1; i <= PREFETCH_BLOCKS; ++i)
+		{
+			int prefetchId = (waveformScrollDirection_ > 0) ? (lastId + i) : (firstId - i);
+			if(prefetchId >= 0) getBlock(prefetchId, false);
+		}
+	}
 }
 
 }; // WaveformImpl.
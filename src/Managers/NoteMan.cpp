@@ -1,5 +1,6 @@
 #include <Managers/NoteMan.h>
 
+#include <limits.h>
 #include <algorithm>
 #include <vector>
 
@@ -42,6 +43,9 @@ int myNumSteps, myNumJumps;
 int myNumHolds, myNumRolls;
 int myNumMines, myNumWarps;
 
+int myChangedBeginRow, myChangedEndRow;
+bool myAllNotesChanged;
+
 Simfile* mySimfile;
 Chart* myChart;
 
@@ -66,6 +70,7 @@ NotesManImpl()
 	, myNumWarps(0)
 {
 	myChart = nullptr;
+	clearChangedRows();
 
 	myApplyAddNoteId     = gHistory->addCallback(ApplyAddNote);
 	myApplyRemNoteId     = gHistory->addCallback(ApplyRemoveNote);
@@ -95,6 +100,7 @@ void myUpdateNotes()
 		it->type = note.type;
 		it->player = note.player;
 		it->quant = note.quant;
+		it->keysound = note.keysound;
 		++it;
 	}
 
@@ -204,6 +210,7 @@ void update(Simfile* simfile, Chart* chart)
 		myUpdateNoteStats();
 	}
 
+	myAllNotesChanged = true;
 	gEditor->reportChanges(VCM_NOTES_CHANGED);
 }
 
@@ -211,6 +218,21 @@ void updateTempo()
 {
 	myUpdateNoteTimes();
 	myUpdateWarpedNotes();
+	myAllNotesChanged = true;
+}
+
+void myAddChangedRows(int beginRow, int endRow)
+{
+	myChangedBeginRow = min(myChangedBeginRow, beginRow);
+	myChangedEndRow = max(myChangedEndRow, endRow);
+}
+
+void myAddChangedRows(const NoteList& notes)
+{
+	for(auto& note : notes)
+	{
+		myAddChangedRows(note.row, note.row + 1);
+	}
 }
 
 // ================================================================================================
@@ -269,6 +291,9 @@ void myApplyNotes(Chart* chart, const NoteList& add, const NoteList& rem, bool f
 
 		if(!updated) myUpdateNotes();
 
+		myAddChangedRows(add);
+		myAddChangedRows(rem);
+
 		gEditor->reportChanges(VCM_NOTES_CHANGED);
 	}
 }
@@ -506,6 +531,9 @@ String myApplyInsertRows(ReadStream& in, bool undo, bool redo)
 		if(myChart == target)
 		{
 			myUpdateNotes();
+
+			// Every note after the start row moved.
+			myAddChangedRows(startRow, INT_MAX);
 		}
 
 		// Jump to start row.
@@ -989,6 +1017,20 @@ bool empty() const
 	return myNotes.empty();
 }
 
+bool getChangedRows(int& beginRow, int& endRow) const
+{
+	beginRow = myChangedBeginRow;
+	endRow = myChangedEndRow;
+	return !myAllNotesChanged;
+}
+
+void clearChangedRows()
+{
+	myChangedBeginRow = INT_MAX;
+	myChangedEndRow = INT_MIN;
+	myAllNotesChanged = false;
+}
+
 }; // NotesManImpl
 
 // ================================================================================================
@@ -84,6 +84,14 @@ struct NotesMan
 
 	/// Returns the indices of all notes preceding the given time for each column.
 	virtual std::vector<const ExpandedNote*> getNotesBeforeTime(double time) const = 0;
+
+	/// Returns the range of rows [beginRow, endRow) that contains every note that was added or
+	/// removed since the last change notification. Returns false if any note may have changed,
+	/// for example because the active chart changed.
+	virtual bool getChangedRows(int& beginRow, int& endRow) const = 0;
+
+	/// Called by the editor after the change notifications are sent.
+	virtual void clearChangedRows() = 0;
 };
 
 extern NotesMan* gNotes;
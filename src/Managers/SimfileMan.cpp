@@ -142,7 +142,9 @@ void myUpdateChart()
 
 void onChanges(int changes)
 {
-	if(changes & (VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED | VCM_MUSIC_IS_LOADED))
+	// The song length is known as soon as the music is allocated, which lets the view and minimap
+	// span the whole song while it is still decoding.
+	if(changes & (VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED | VCM_MUSIC_IS_ALLOCATED | VCM_MUSIC_IS_LOADED))
 	{
 		myUpdateEndRow();
 	}
@@ -4,11 +4,14 @@
 #include <Core/Utils.h>
 #include <Core/StringUtils.h>
 
+#include <System/TaskScheduler.h>
+
 #include <Editor/Common.h>
 #include <Managers/NoteskinMan.h>
 #include <Managers/ChartMan.h>
 
 #include <algorithm>
+#include <mutex>
 #include <vector>
 
 namespace Vortex {
@@ -248,6 +251,24 @@ Style* CreateStyle(const XmrNode* node)
 	return out;
 }
 
+// ================================================================================================
+// FallbackStyleScope.
+
+FallbackStyleScope::FallbackStyleScope()
+	: myPrevious((FallbackStyleScope*)TaskScheduler::getScope(TaskScope::FallbackStyles))
+{
+	TaskScheduler::setScope(TaskScope::FallbackStyles, this);
+}
+
+FallbackStyleScope::~FallbackStyleScope()
+{
+	for(auto style : styles)
+	{
+		DeleteStyle(style);
+	}
+	TaskScheduler::setScope(TaskScope::FallbackStyles, myPrevious);
+}
+
 // ================================================================================================
 // StyleManImpl.
 
@@ -255,7 +276,10 @@ Style* CreateStyle(const XmrNode* node)
 
 struct StyleManImpl : public StyleMan {
 
+// Simfiles are also loaded by background tasks, which can add fallback styles while the editor reads
+// the list, so lookups and additions hold the mutex.
 std::vector<Style*> myStyles;
+mutable std::mutex myStylesMutex;
 int myNumDefaultStyles;
 Style* myActiveStyle;
 
@@ -310,6 +334,13 @@ static String getFallbackText(int numCols, int numPlayers)
 const Style* createFallbackStyle(StringRef id, int numCols, int numPlayers)
 {
 	auto style = CreateStyle(id, numCols, numPlayers);
+	auto scope = (FallbackStyleScope*)TaskScheduler::getScope(TaskScope::FallbackStyles);
+	if(scope)
+	{
+		style->index = -1;
+		scope->styles.push_back(style);
+		return style;
+	}
 	style->index = myStyles.size();
 	myStyles.push_back(style);
 	return style;
@@ -317,6 +348,7 @@ const Style* createFallbackStyle(StringRef id, int numCols, int numPlayers)
 
 const Style* findStyle(StringRef styleId)
 {
+	std::lock_guard<std::mutex> lock(myStylesMutex);
 	for(int i = 0; i < myStyles.size(); ++i)
 	{
 		if(myStyles[i]->id == styleId)
@@ -329,6 +361,8 @@ const Style* findStyle(StringRef styleId)
 
 const Style* findStyle(StringRef chartName, int numCols, int numPlayers)
 {
+	std::lock_guard<std::mutex> lock(myStylesMutex);
+
 	// First, check if an existing style matches the requested column and player count.
 	for(int i = 0; i < myStyles.size(); ++i)
 	{
@@ -347,6 +381,8 @@ const Style* findStyle(StringRef chartName, int numCols, int numPlayers)
 
 const Style* findStyle(StringRef chartName, int numCols, int numPlayers, StringRef id)
 {
+	std::lock_guard<std::mutex> lock(myStylesMutex);
+
 	/// Use lookup by column and player count if the id string is empty.
 	if(id.empty())
 	{
@@ -405,6 +441,7 @@ int getNumPlayers() const
 
 Style* get(int index) const
 {
+	std::lock_guard<std::mutex> lock(myStylesMutex);
 	return myStyles[index];
 }
 
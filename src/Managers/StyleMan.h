@@ -2,6 +2,8 @@
 
 #include <Core/Core.h>
 
+#include <vector>
+
 namespace Vortex {
 
 /// Holds data that determines the play style of a chart.
@@ -64,6 +66,24 @@ struct StyleMan {
     virtual Style* get() const = 0;
 };
 
+/// While it exists, the fallback styles that are created by the calling task
+/// are kept by the scope instead of being added to the style list. Loading a
+/// song library in the background uses this, so the unknown styles of its
+/// simfiles do not end up in the styles of the editor. The fallback styles
+/// have an index of -1, and are deleted together with the scope.
+struct FallbackStyleScope {
+    FallbackStyleScope();
+    ~FallbackStyleScope();
+
+    FallbackStyleScope(const FallbackStyleScope&) = delete;
+    FallbackStyleScope& operator=(const FallbackStyleScope&) = delete;
+
+    std::vector<Style*> styles;
+
+   private:
+    FallbackStyleScope* myPrevious;
+};
+
 extern StyleMan* gStyle;
 
 };  // namespace Vortex
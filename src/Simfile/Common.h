@@ -48,6 +48,7 @@ struct Note {
     uint32_t player : 4;
     uint32_t type : 4;
     uint32_t quant : 8;
+    uint32_t keysound = 0;  // index in the keysound list plus one, zero if none.
 };
 
 };  // namespace Vortex
@@ -391,14 +391,17 @@ static void ParseTag(Simfile* sim, std::string tag, char* val) {
 // File loading.
 
 bool LoadDwi(fs::path path, Simfile* sim) {
-    // Read the file.
-    std::string str;
-    if (!ParseSimfile(str, path)) return false;
-
-    // Read the tags.
-    char *tag, *val, *p = &str[0];
-    while (ParseNextTag(p, tag, val)) {
-        ParseTag(sim, tag, val);
+    // Map the file.
+    MappedFile file;
+    if (!OpenSimfile(file, path)) return false;
+
+    // Read the tags. The parsing functions split values up in place, so each
+    // value is copied to an editable buffer first.
+    std::string scratch;
+    SimfileTokenizer tokenizer(SimfileText(file));
+    for (std::string_view tag, val; tokenizer.next(tag, val);) {
+        scratch.assign(val);
+        ParseTag(sim, std::string(tag), scratch.data());
     }
 
     // Some things are not stored in the .dwi file, look for them
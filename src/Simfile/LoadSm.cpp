@@ -7,6 +7,7 @@
 
 #include <System/Debug.h>
 #include <System/File.h>
+#include <System/TaskScheduler.h>
 
 #include <Simfile/Parsing.h>
 #include <Simfile/Simfile.h>
@@ -14,12 +15,17 @@
 #include <Simfile/Tempo.h>
 #include <Simfile/Notes.h>
 #include <Simfile/SegmentGroup.h>
+#include <Simfile/NoteScan.h>
 
 #include <Editor/Common.h>
 
 #include <Managers/StyleMan.h>
 
 #include <cmath>
+#include <cstdlib>
+#include <charconv>
+#include <string>
+#include <string_view>
 
 namespace Vortex {
 namespace Sm {
@@ -34,10 +40,18 @@ static const int MEASURE_SUBDIV[] = { 4, 8, 12, 16, 24, 32, 48, 64, 96, 192 };
 static const int NUM_MEASURE_SUBDIV = 10;
 static const int ROWS_PER_NOTE_SECTION = 192;
 
+// Note data of a chart, which is decoded after all tags are read.
+struct PendingChart
+{
+	Chart* chart;
+	String styleId;
+	std::string_view notes;
+	int numCols, numPlayers;
+};
+
 struct ParseData
 {
 	bool isSM5;
-	int numKeySounds;
 
 	Simfile* sim;
 	Chart* chart;
@@ -46,6 +60,11 @@ struct ParseData
 	std::map<String, String*> simMap1;
 	std::map<String, ParseFunc> simMap2, chartMap;
 
+	// Editable copy of the current value, for the parsing functions that split it up in place.
+	std::string scratch;
+
+	Vector<PendingChart> pendingCharts;
+
 	Tempo* tempo();
 };
 
@@ -376,63 +395,59 @@ struct ReadNoteData
 	Vector<NoteType> holdType;
 };
 
-static void ReadNoteRow(ReadNoteData& data, int row, char* p, int quantization)
+static void ReadNote(ReadNoteData& data, int row, int col, char symbol, uint keysound, int quantization)
 {
-	for(int col = 0; col < data.numCols; ++col, ++p)
+	if(symbol == '1')
 	{
-		if(*p == '0')
-		{
-			// Do nothing.
-		}
-		else if(*p == '1')
-		{
-			data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_STEP_OR_HOLD, (uint) quantization});
-		}
-		else if(*p == '2' || *p == '4')
-		{
-			data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_STEP_OR_HOLD, (uint) quantization});
-			data.holdType[col] = (*p == '2') ? NOTE_STEP_OR_HOLD : NOTE_ROLL;
-			data.holdPos[col] = data.notes->size();
-		}
-		else if(*p == '3')
-		{
-			int holdPos = data.holdPos[col];
-			if(holdPos)
-			{
-				auto* hold = data.notes->begin() + holdPos - 1;
-				hold->endrow = row;
-				hold->type = data.holdType[col];
-				data.holdPos[col] = 0;
-			}
-		}
-		else if(*p == 'M')
-		{
-			data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_MINE, (uint) quantization});
-		}
-		else if(*p == 'L')
-		{
-			data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_LIFT, (uint) quantization});
-		}
-		else if(*p == 'F')
+		data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_STEP_OR_HOLD, (uint) quantization, keysound});
+	}
+	else if(symbol == '2' || symbol == '4')
+	{
+		data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_STEP_OR_HOLD, (uint) quantization, keysound});
+		data.holdType[col] = (symbol == '2') ? NOTE_STEP_OR_HOLD : NOTE_ROLL;
+		data.holdPos[col] = data.notes->size();
+	}
+	else if(symbol == '3')
+	{
+		int holdPos = data.holdPos[col];
+		if(holdPos)
 		{
-			data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_FAKE, (uint) quantization});
+			auto* hold = data.notes->begin() + holdPos - 1;
+			hold->endrow = row;
+			hold->type = data.holdType[col];
+			data.holdPos[col] = 0;
 		}
 	}
+	else if(symbol == 'M')
+	{
+		data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_MINE, (uint) quantization, keysound});
+	}
+	else if(symbol == 'L')
+	{
+		data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_LIFT, (uint) quantization, keysound});
+	}
+	else if(symbol == 'F')
+	{
+		data.notes->append({row, row, (uint)col, (uint)data.player, NOTE_FAKE, (uint) quantization, keysound});
+	}
 }
 
-static void ParseNotes(ParseData& data, Chart* chart, StringRef style, char* notes)
+static void DecodeNotes(PendingChart& pending)
 {
-	char* p = notes;
+	Chart* chart = pending.chart;
+	std::string_view notes = pending.notes;
+	size_t p = 0, end = notes.size();
 
 	// Derive the column count from the first note row.
 	int numPlayers = 1;
 	int numCols = 0;
-	while(*p == ' ' || *p == '\n') ++p;
-	for(; *p && *p != '\n'; ++p)
+	while(p < end && (notes[p] == ' ' || notes[p] == '\n')) ++p;
+	for(; p < end && notes[p] != '\n'; ++p)
 	{
-		if(*p == '[')
+		if(notes[p] == '[')
 		{
-			while(*p && *p != ']') ++p;
+			while(p < end && notes[p] != ']') ++p;
+			if(p == end) break;
 		}
 		else
 		{
@@ -440,10 +455,6 @@ static void ParseNotes(ParseData& data, Chart* chart, StringRef style, char* not
 		}
 	}
 
-	// Create an empty note line for quick comparison.
-	String emptylinestr(numCols, '0');
-	const char* emptyline = emptylinestr.str();
-
 	// Read the note data.
 	ReadNoteData readNoteData;
 	readNoteData.player = 0;
@@ -452,42 +463,60 @@ static void ParseNotes(ParseData& data, Chart* chart, StringRef style, char* not
 	readNoteData.holdPos.resize(numCols, 0);
 	readNoteData.holdType.resize(numCols, NOTE_STEP_OR_HOLD);
 
+	Vector<int> keysounds, notePositions, noteLines;
+	std::string measure;
 	int numSections = 0;
-	for(p = notes; *p;)
+	for(p = 0; p < end;)
 	{
 		readNoteData.player = numPlayers - 1;
 		int section = numSections;
-		char* measureText = p;
 
 		// Read the current section up until the comma (next section) or ampersand (next player).
-		while(*p && *p != ',' && *p != '&') ++p;
-		if(*p == ',')
+		size_t sectionEnd = notes.find_first_of(",&", p);
+		if(sectionEnd == std::string_view::npos) sectionEnd = end;
+		std::string_view sectionText = notes.substr(p, sectionEnd - p);
+		p = sectionEnd;
+		if(p < end && notes[p] == ',')
 		{
 			++numSections;
-			*p++ = 0;
+			++p;
 		}
-		else if(*p == '&')
+		else if(p < end && notes[p] == '&')
 		{
 			++numPlayers;
 			numSections = 0;
-			*p++ = 0;
+			++p;
 		}
 
-		// Remove whitespace from the section.
+		// Copy the section without whitespace, and store the keysound that follows each symbol as
+		// its index plus one. The note data itself is left untouched.
 		int numSymbols = 0;
-		for(char* read = measureText, *write = measureText; *read; ++read)
+		keysounds.clear();
+		measure.clear();
+		for(size_t read = 0; read < sectionText.size(); ++read)
 		{
-			if(*read == '[')
+			char c = sectionText[read];
+			if(c == '[')
 			{
-				++data.numKeySounds;
-				while(*read && *read != ']') ++read;
+				size_t close = sectionText.find(']', read);
+				if(numSymbols > 0)
+				{
+					int index = 0;
+					std::string_view digits = sectionText.substr(read + 1, close - read - 1);
+					std::from_chars(digits.data(), digits.data() + digits.size(), index);
+					keysounds[numSymbols - 1] = index + 1;
+				}
+				if(close == std::string_view::npos) break;
+				read = close;
 			}
-			else if(*read != ' ' && *read != '\n')
+			else if(c != ' ' && c != '\n')
 			{
-				*write = *read;
-				++numSymbols, ++write;
+				measure.push_back(c);
+				keysounds.push_back(0);
+				++numSymbols;
 			}
 		}
+		const char* measureText = measure.data();
 
 		// Read notes in the current section.
 		Vector<int> holds(numCols, 0);
@@ -496,24 +525,32 @@ static void ParseNotes(ParseData& data, Chart* chart, StringRef style, char* not
 		if(numLines > 0)
 		{
 			int startRow = section * ROWS_PER_NOTE_SECTION;
-			char* line = measureText;
-			int row = startRow; 
+
+			// Find the symbols that are not '0', and the lines they are on. Empty lines, which are
+			// most of a 192nd snap measure, are skipped in bulk.
+			notePositions.resize(numLines * numCols);
+			int numNotes = NoteScan::findNotes(measureText, numLines * numCols, notePositions.data());
+			noteLines.clear();
+			for(int i = 0; i < numNotes; ++i)
+			{
+				int line = notePositions[i] / numCols;
+				if(noteLines.empty() || noteLines.back() != line) noteLines.push_back(line);
+			}
 
 			// Try to find custom quantizations in any 192nd snap measures
 			if (numLines == ROWS_PER_NOTE_SECTION)
 			{
-				// Nothing better to than to check them all by hand
+				// Nothing better to than to check them all by hand, though only the lines with notes
+				// can rule out a quantization.
 				for (int i = 4; i < ROWS_PER_NOTE_SECTION; i++)
 				{
 					bool valid = true;
-					line = measureText;
 					float mod = (float) ROWS_PER_NOTE_SECTION / i;
-					for (int j = 0; valid && j < ROWS_PER_NOTE_SECTION; ++j, line += numCols)
+					for (int j : noteLines)
 					{
 						float rem = std::round(std::fmod(j, mod));
 						// Check all the compressed rows and make sure they are empty
-						if (rem > 0 && rem < static_cast<int>(mod)
-							&& memcmp(line, emptyline, numCols) != 0)
+						if (rem > 0 && rem < static_cast<int>(mod))
 						{
 							valid = false;
 							break;
@@ -528,22 +565,16 @@ static void ParseNotes(ParseData& data, Chart* chart, StringRef style, char* not
 				}
 			}
 
-			line = measureText;
-			int ofs = ROWS_PER_NOTE_SECTION / numLines;
-			for (int i = 0; i < numLines; ++i)
+			bool evenLines = (ROWS_PER_NOTE_SECTION % numLines == 0);
+			for (int i = 0; i < numNotes; ++i)
 			{
-				if (memcmp(line, emptyline, numCols) != 0)
-				{
-					ReadNoteRow(readNoteData, row, line, quantization);
-				}
+				int pos = notePositions[i];
+				int line = pos / numCols;
 
 				// Handle abnormal numbers of lines loading
-				if (ROWS_PER_NOTE_SECTION % numLines != 0)
-				{
-					ofs = (static_cast<int>(std::round(192.0f / numLines * (i + 1))) - static_cast<int>(std::round(192.0f / numLines * i)));
-				}
-				line += numCols;
-				row += ofs;
+				int ofs = evenLines ? line * (ROWS_PER_NOTE_SECTION / numLines)
+					: static_cast<int>(std::round(192.0f / numLines * line));
+				ReadNote(readNoteData, startRow + ofs, pos - line * numCols, measureText[pos], (uint)keysounds[pos], quantization);
 			}
 		}
 	}
@@ -554,42 +585,39 @@ static void ParseNotes(ParseData& data, Chart* chart, StringRef style, char* not
 		std::sort(chart->notes.begin(), chart->notes.end(), LessThanRowCol<Note, Note>);
 	}
 
-	// Find a style for the chart based on the style id, columns, and players.
-	chart->style = gStyle->findStyle(chart->description(), numCols, numPlayers, style);
+	pending.numCols = numCols;
+	pending.numPlayers = numPlayers;
 }
 
-static void ParseNotes(PARSE_ARGS)
+static void ParseNotes(ParseData& data, std::string_view val)
 {
-	char* p = str;
+	size_t p = 0;
 
 	// Split chart info "a:b:c:d:..." into parameters.
 	int numParams = 0;
-	char* params[6] = {};
-	for(; numParams < 6 && *p; ++numParams)
-	{
-		while(*p == ' ' || *p == '\n') ++p;
-		params[numParams] = p;
-		while(*p && *p != ':') ++p;
-		if(*p == ':') *p++ = 0;
-	}
-	for(int i = numParams; i < 6; ++i)
+	std::string_view params[6] = {};
+	for(; numParams < 6 && p < val.size(); ++numParams)
 	{
-		params[i] = p;
+		while(p < val.size() && (val[p] == ' ' || val[p] == '\n')) ++p;
+		size_t colon = std::min(val.find(':', p), val.size());
+		params[numParams] = val.substr(p, colon - p);
+		p = std::min(colon + 1, val.size());
 	}
 
 	// Make sure there is a chart.
 	if(!data.chart) data.chart = new Chart;
 
 	// Read the chart parameters.
-	char* notes = nullptr;
+	std::string_view notes;
 	if(numParams == 5 || numParams == 6)
 	{
 		// Stepmania 3.95/ITG notes format.
-		data.styleId = params[0];
-		data.chart->artist = params[1];
-		data.chart->difficulty = ToDiff(params[2]);
-		data.chart->meter = atoi(params[3]);
-		ParseRadar(data.chart, params[4]);
+		data.styleId = String(params[0]);
+		data.chart->artist = String(params[1]);
+		data.chart->difficulty = ToDiff(std::string(params[2]).c_str());
+		data.chart->meter = atoi(std::string(params[3]).c_str());
+		data.scratch.assign(params[4]);
+		ParseRadar(data.chart, data.scratch.data());
 		notes = params[5];
 	}
 	else if(numParams == 0 || numParams == 1)
@@ -597,7 +625,8 @@ static void ParseNotes(PARSE_ARGS)
 		// Stepmania 5 notes format.
 		notes = params[0];
 	}
-	ParseNotes(data, data.chart, data.styleId, notes);
+	// The notes are decoded after all tags are read, together with those of the other charts.
+	data.pendingCharts.push_back({data.chart, data.styleId, notes, 0, 0});
 
 	// Add the chart to the chart list.
 	data.sim->charts.push_back(data.chart);
@@ -639,9 +668,6 @@ static void MapSharedTags(FuncMap& map)
 	map["COMBOS"] = ParseCombos;
 	map["FAKES"] = ParseFakes;
 	map["DISPLAYBPM"] = ParseDisplayBpm;
-
-	map["NOTES"] = ParseNotes;
-	map["NOTES2"] = ParseNotes;
 }
 
 static void MapSimfileTags(StrMap& str, FuncMap& map, Simfile* sim)
@@ -686,15 +712,24 @@ static void MapChartTags(FuncMap& map)
 	map["STEPSTYPE"]    = [](PARSE_ARGS) { data.styleId = str; };
 }
 
-static void ParseTag(ParseData& data, String tag, char* val)
+static void ParseTag(ParseData& data, String tag, std::string_view val)
 {
+	// Note data is by far the largest part of most files, so it is read straight from the file
+	// instead of from a copy.
+	if(tag == "NOTES" || tag == "NOTES2")
+	{
+		ParseNotes(data, val);
+		return;
+	}
+
 	if(data.chart)
 	{
 		// Check if the tag is in the chart function map.
 		auto func = data.chartMap.find(tag);
 		if(func != data.chartMap.end())
 		{
-			func->second(data, tag, val);
+			data.scratch.assign(val);
+			func->second(data, tag, data.scratch.data());
 			return;
 		}
 	}
@@ -704,7 +739,7 @@ static void ParseTag(ParseData& data, String tag, char* val)
 		auto str = data.simMap1.find(tag);
 		if(str != data.simMap1.end())
 		{
-			*str->second = UnescapeTag(val);
+			*str->second = UnescapeTag(String(val));
 			return;
 		}
 
@@ -712,54 +747,90 @@ static void ParseTag(ParseData& data, String tag, char* val)
 		auto func = data.simMap2.find(tag);
 		if(func != data.simMap2.end())
 		{
-			func->second(data, tag, val);
+			data.scratch.assign(val);
+			func->second(data, tag, data.scratch.data());
 			return;
 		}
 	}
 
 	// Add the tag to the misc properties.
-	data.tempo()->misc.push_back({tag, val});
+	data.tempo()->misc.push_back({tag, String(val)});
 }
 
 // ===================================================================================
 // File importing
 
-bool LoadSm(StringRef path, Simfile* sim)
+// Reads the tags of the text into the simfile, and decodes the notes of its charts. The views into
+// the text that are kept for decoding stay valid until the function returns.
+static void ParseText(ParseData& data, std::string_view text, bool serial)
 {
-	ParseData data;
-
-	data.sim = sim;
-	data.chart = nullptr;
-	data.isSM5 = Str::endsWith(path, ".ssc", false);
-	data.numKeySounds = 0;
-
-	MapSimfileTags(data.simMap1, data.simMap2, sim);
+	MapSimfileTags(data.simMap1, data.simMap2, data.sim);
 	MapChartTags(data.chartMap);
 
-	// Read the file.
-	String str;
-	if(!ParseSimfile(str, path)) return false;
-
-	// Read the tags.
-	char* tag, *val, *p = str.begin();
-	while(ParseNextTag(p, tag, val))
+	SimfileTokenizer tokenizer(text);
+	for(std::string_view tag, val; tokenizer.next(tag, val);)
 	{
-		ParseTag(data, tag, val);
+		ParseTag(data, String(tag), val);
 	}
 
-	// Show a warning if keysounds were present.
-	if(data.numKeySounds > 0)
+	// Charts do not share anything but the text, so their notes are decoded at the same time, each
+	// into the note list of its own chart. Decoding them one after the other gives the same notes.
+	auto& pending = data.pendingCharts;
+	if(serial)
+	{
+		for(auto& it : pending) DecodeNotes(it);
+	}
+	else
 	{
-		HudWarning("Simfile has %i keysound(s), which are not yet supported and were ignored.",
-			data.numKeySounds);
+		TaskScheduler::parallelFor((int)pending.size(), TaskScheduler::numWorkers(), [&pending](int i, int)
+		{
+			DecodeNotes(pending[i]);
+		});
 	}
 
 	// If there is a pending chart, release it.
 	if(data.chart) delete data.chart;
+	data.chart = nullptr;
 
 	// Derive the load format from the loaded properties.
-	sim->format = (data.isSM5 ? SIM_SSC : SIM_SM);
-	
+	data.sim->format = (data.isSM5 ? SIM_SSC : SIM_SM);
+}
+
+bool ParseSm(std::string_view text, bool isSM5, bool serial, Simfile* sim)
+{
+	ParseData data;
+
+	data.sim = sim;
+	data.chart = nullptr;
+	data.isSM5 = isSM5;
+
+	// The styles are left unset; the unit tests that use this have no style manager.
+	ParseText(data, text, serial);
+
+	return true;
+}
+
+bool LoadSm(StringRef path, Simfile* sim)
+{
+	ParseData data;
+
+	data.sim = sim;
+	data.chart = nullptr;
+	data.isSM5 = Str::endsWith(path, ".ssc", false);
+
+	// Map the file, and read the tags straight from the mapping.
+	MappedFile file;
+	if(!OpenSimfile(file, path)) return false;
+
+	ParseText(data, SimfileText(file), false);
+
+	// Find a style for each chart based on the style id, columns, and players. This can create
+	// fallback styles and warnings, so it is done in file order, like the tags themselves.
+	for(auto& it : data.pendingCharts)
+	{
+		it.chart->style = gStyle->findStyle(it.chart->description(), it.numCols, it.numPlayers, it.styleId);
+	}
+
 	return true;
 }
 
@@ -473,7 +473,7 @@ void NoteList::prepareEdit(const NoteEdit& in, NoteEditResult& out, bool clearRe
 
 static void EncodeNote(WriteStream& out, const Note& in, int offsetRows)
 {
-	if(in.row == in.endrow && in.player == 0 && in.type == 0)
+	if(in.row == in.endrow && in.player == 0 && in.type == 0 && in.keysound == 0)
 	{
 		out.write<uchar>(in.col);
 		out.writeNum(in.row + offsetRows);
@@ -486,13 +486,14 @@ static void EncodeNote(WriteStream& out, const Note& in, int offsetRows)
 		out.writeNum(in.endrow + offsetRows);
 		out.write<uchar>((in.player << 4) | in.type);
 		out.write<uchar>(in.quant);
+		out.writeNum(in.keysound);
 	}
 }
 
 static void EncodeNote(WriteStream& out, const Note& in, TempoTimeTracker& tracker, double offsetTime)
 {
 	double time = tracker.advance(in.row);
-	if(in.row == in.endrow && in.player == 0 && in.type == 0)
+	if(in.row == in.endrow && in.player == 0 && in.type == 0 && in.keysound == 0)
 	{
 		out.write<uchar>(in.col);
 		out.write<double>(time + offsetTime);
@@ -505,6 +506,7 @@ static void EncodeNote(WriteStream& out, const Note& in, TempoTimeTracker& track
 		out.write<double>(tracker.lookAhead(in.endrow) + offsetTime);
 		out.write<uchar>((in.player << 4) | in.type);
 		out.write<uchar>(in.quant);
+		out.writeNum(in.keysound);
 	}
 }
 
@@ -549,6 +551,7 @@ static void DecodeNote(ReadStream& in, Note& out, int offsetRows)
 		out.player = v >> 4;
 		out.type = v & 0xF;
 		out.quant = in.read<uchar>();
+		out.keysound = in.readNum();
 	}
 	ApplyQuantOffset(out, offsetRows);
 }
@@ -575,6 +578,7 @@ static void DecodeNote(ReadStream& in, Note& out, TempoRowTracker& tracker, doub
 		out.player = v >> 4;
 		out.type = v & 0xF;
 		out.quant = in.read<uchar>();
+		out.keysound = in.readNum();
 	}
 	ApplyQuantOffset(out, offsetRows);
 }
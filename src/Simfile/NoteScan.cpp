@@ -0,0 +1,161 @@
+#include <Simfile/NoteScan.h>
+
+#include <System/CpuFeatures.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#ifdef CPU_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef CPU_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace Vortex {
+namespace NoteScan {
+
+// Appends the positions of the set bits in a mask of non-empty symbols, where
+// bit zero is the symbol at the given base position.
+static inline int AppendPositions(uint64_t mask, int base, int* out, int n) {
+    for (; mask; mask &= mask - 1) {
+        out[n++] = base + std::countr_zero(mask);
+    }
+    return n;
+}
+
+// ================================================================================================
+// Scalar kernel, which also processes the tails of the vector kernels.
+
+static int FindNotesScalar(const char* text, int size, int* out, int n,
+                           int base) {
+    for (int i = 0; i < size; ++i) {
+        if (text[i] != '0') out[n++] = base + i;
+    }
+    return n;
+}
+
+// ================================================================================================
+// SSE2 kernel.
+
+#ifdef CPU_HAS_SSE2
+
+static int FindNotesSse2(const char* text, int size, int* out, int n,
+                         int base) {
+    const __m128i zero = _mm_set1_epi8('0');
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        uint32_t empty = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        if (empty == 0xFFFF) continue;
+        n = AppendPositions(~empty & 0xFFFF, base + i, out, n);
+    }
+    return FindNotesScalar(text + i, size - i, out, n, base + i);
+}
+
+#endif  // CPU_HAS_SSE2
+
+// ================================================================================================
+// AVX2 kernel.
+
+#ifdef CPU_HAS_AVX2
+
+CPU_TARGET_AVX2 static int FindNotesAvx2(const char* text, int size, int* out,
+                                         int n, int base) {
+    // Two vectors are compared per step, so a 192nd note measure of a four
+    // column chart takes twelve steps. The rest is done sixteen at a time.
+    const __m256i zero = _mm256_set1_epi8('0');
+    int i = 0;
+    for (; i + 64 <= size; i += 64) {
+        auto p = reinterpret_cast<const __m256i*>(text + i);
+        uint32_t lo = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(p + 0), zero));
+        uint32_t hi = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(p + 1), zero));
+        uint64_t empty = lo | (static_cast<uint64_t>(hi) << 32);
+        if (empty == ~0ull) continue;
+        n = AppendPositions(~empty, base + i, out, n);
+    }
+    const __m128i zero128 = _mm_set1_epi8('0');
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        uint32_t empty = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero128));
+        if (empty == 0xFFFF) continue;
+        n = AppendPositions(~empty & 0xFFFF, base + i, out, n);
+    }
+    return FindNotesScalar(text + i, size - i, out, n, base + i);
+}
+
+#endif  // CPU_HAS_AVX2
+
+// ================================================================================================
+// Dispatch.
+
+typedef int (*FindNotesFunc)(const char*, int, int*, int, int);
+
+static FindNotesFunc GetFindNotes() {
+    CpuFeatures::Level level = CpuFeatures::getLevel();
+#ifdef CPU_HAS_AVX2
+    if (level >= CpuFeatures::AVX2) return FindNotesAvx2;
+#endif
+#ifdef CPU_HAS_SSE2
+    if (level >= CpuFeatures::SSE2) return FindNotesSse2;
+#endif
+    return FindNotesScalar;
+}
+
+int findNotes(const char* text, int size, int* out) {
+    return GetFindNotes()(text, size, out, 0, 0);
+}
+
+// ================================================================================================
+// Measure compression.
+
+static const int MIN_LINES_PER_MEASURE = 4;
+
+// For every line count, the rows that fall between the lines and therefore
+// have to be empty. Line counts that are not a factor of 192 round the row of
+// each line to the nearest row, like the note loader.
+struct SkippedRows {
+    MeasureRows rows[ROWS_PER_MEASURE + 1];
+
+    SkippedRows() {
+        for (int i = 2; i <= ROWS_PER_MEASURE; ++i) {
+            float mod = static_cast<float>(ROWS_PER_MEASURE) / i;
+            for (int j = 0; j < ROWS_PER_MEASURE; ++j) {
+                float rem = std::round(std::fmod(j, mod));
+                if (rem > 0 && rem < static_cast<int>(mod)) rows[i].set(j);
+            }
+        }
+    }
+};
+
+int measureLineCount(const MeasureRows& rows, int quantization) {
+    static const SkippedRows skipped;
+    quantization = std::min(quantization, ROWS_PER_MEASURE);
+
+    // Whole and half note measures are written as quarter notes.
+    int count = MIN_LINES_PER_MEASURE;
+    if (quantization > MIN_LINES_PER_MEASURE) {
+        count = quantization;
+        for (int i = quantization / 2; i >= MIN_LINES_PER_MEASURE; --i) {
+            if (quantization % i != 0) continue;
+            const uint64_t* mask = skipped.rows[i].bits;
+            if (((rows.bits[0] & mask[0]) | (rows.bits[1] & mask[1]) |
+                 (rows.bits[2] & mask[2])) == 0) {
+                count = i;
+                break;
+            }
+        }
+    }
+
+    // Snaps that are not standard are written as 192nds.
+    if (ROWS_PER_MEASURE % count != 0) count = ROWS_PER_MEASURE;
+    return count;
+}
+
+};  // namespace NoteScan
+};  // namespace Vortex
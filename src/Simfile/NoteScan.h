@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Vortex {
+
+/// Vectorized scanning of sm-style note data, in which most symbols are '0'.
+/// Every function selects the most capable implementation supported by the
+/// processor at runtime, and all implementations produce identical results.
+namespace NoteScan {
+
+/// Writes the positions of the symbols in the text that are not '0' to out,
+/// in increasing order, and returns the number of positions. Out needs room
+/// for one position per symbol. Runs of '0' are skipped 16 or 32 symbols at a
+/// time, so the cost mostly depends on the number of notes.
+int findNotes(const char* text, int size, int* out);
+
+/// Number of rows in a measure of sm-style note data.
+static const int ROWS_PER_MEASURE = 192;
+
+/// Bitmask with one bit per row of a measure, set for the rows with notes.
+struct MeasureRows {
+    uint64_t bits[3] = {};
+
+    void set(int row) { bits[row >> 6] |= 1ull << (row & 63); }
+};
+
+/// Returns the number of lines a measure is written with, given the rows with
+/// notes and the least common multiple of the quantizations of the notes.
+/// This is the largest factor of the quantization of at least four that skips
+/// no notes, or all rows if that factor is not a standard snap.
+int measureLineCount(const MeasureRows& rows, int quantization);
+
+};  // namespace NoteScan
+
+};  // namespace Vortex
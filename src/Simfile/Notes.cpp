@@ -8,7 +8,8 @@ namespace Vortex {
 // Regular note encoding.
 
 void EncodeNote(WriteStream& out, const Note& in) {
-    if (in.row == in.endrow && in.player == 0 && in.type == 0) {
+    if (in.row == in.endrow && in.player == 0 && in.type == 0 &&
+        in.keysound == 0) {
         out.write<uint8_t>(in.col);
         out.writeNum(in.row);
         out.write<uint8_t>(in.quant);
@@ -18,6 +19,7 @@ void EncodeNote(WriteStream& out, const Note& in) {
         out.writeNum(in.endrow);
         out.write<uint8_t>((in.player << 4) | in.type);
         out.write<uint8_t>(in.quant);
+        out.writeNum(in.keysound);
     }
 }
 
@@ -35,6 +37,7 @@ void DecodeNote(ReadStream& in, Note& out) {
         out.player = v >> 4;
         out.type = v & 0xF;
         out.quant = in.read<uint8_t>();
+        out.keysound = in.readNum();
     }
 }
 
@@ -42,7 +45,8 @@ void DecodeNote(ReadStream& in, Note& out) {
 // Time-based note encoding.
 
 void EncodeNoteWithTime(WriteStream& out, const ExpandedNote& in) {
-    if (in.time == in.endtime && in.player == 0 && in.type == 0) {
+    if (in.time == in.endtime && in.player == 0 && in.type == 0 &&
+        in.keysound == 0) {
         out.write<uint8_t>(in.col);
         out.write(in.time);
         out.write<uint8_t>(in.quant);
@@ -52,6 +56,7 @@ void EncodeNoteWithTime(WriteStream& out, const ExpandedNote& in) {
         out.write(in.endtime);
         out.write<uint8_t>((in.player << 4) | in.type);
         out.write<uint8_t>(in.quant);
+        out.writeNum(in.keysound);
     }
 }
 
@@ -60,6 +65,7 @@ void DecodeNoteWithTime(ReadStream& in, ExpandedNote& out) {
     if ((col & 0x80) == 0) {
         double time = in.read<double>();
         out.quant = in.read<uint8_t>();
+        out.keysound = 0;
     } else {
         out.col = col & 0x7F;
         in.read(out.time);
@@ -68,6 +74,7 @@ void DecodeNoteWithTime(ReadStream& in, ExpandedNote& out) {
         out.player = v >> 4;
         out.type = v & 0xF;
         out.quant = in.read<uint8_t>();
+        out.keysound = in.readNum();
     }
 }
 
@@ -57,6 +57,10 @@ struct ExpandedNote {
 
     /// Indicates the quantization of the note, if it is nonstandard
     uint32_t quant : 8;
+
+    /// Index of the keysound in the keysound list plus one, or zero if the
+    /// note has no keysound.
+    uint32_t keysound = 0;
 };
 
 // Converts and expanded note to a compact note.
@@ -66,7 +70,8 @@ inline Note CompressNote(const ExpandedNote& note) {
             (uint32_t)note.col,
             (uint32_t)note.player,
             (uint32_t)note.type,
-            (uint32_t)note.quant};
+            (uint32_t)note.quant,
+            note.keysound};
 }
 
 // Encodes a single note and writes it to a bytestream.
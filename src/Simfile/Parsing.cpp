@@ -15,6 +15,8 @@
 #include <Managers/StyleMan.h>
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 namespace Vortex {
 
@@ -40,56 +42,137 @@ bool LoadDwi(LOAD_ARGS);  // Defined in LoadDwi.cpp
 // ================================================================================================
 // Parsing utilities.
 
-bool ParseSimfile(std::string& out, fs::path path) {
-    bool success;
-    out = File::getText(path, &success);
-    if (!success) return false;
+bool OpenSimfile(MappedFile& out, const fs::path& path) {
+    if (out.open(path)) return true;
 
-    // Preprocess the file contents.
-    const char* read = &out[0];
-    char* write = &out[0];
-    while (*read) {
-        if (read[0] == '/' && read[1] == '/') {
-            while (*read && *read != '\n') ++read;
-        } else if (*read == '\r') {
-            ++read;
-        } else if (*read == '\t') {
-            *write = ' ';
-            ++read, ++write;
-        } else {
-            *write = *read;
-            ++read, ++write;
-        }
+    // Empty files cannot be mapped, but they are still valid simfiles.
+    std::error_code error;
+    if (fs::is_regular_file(path, error) && fs::file_size(path, error) == 0) {
+        return true;
     }
-    Str::truncate(out, static_cast<int>(write - &out[0]));
+    HudError("Failed to open file: %s", pathToUtf8(path).c_str());
+    return false;
+}
 
-    return true;
+std::string_view SimfileText(const MappedFile& file) {
+    return {reinterpret_cast<const char*>(file.data()), file.size()};
 }
 
-static char* ZeroTerminateItem(char* start, char* end) {
-    while (end != start && (end[-1] == ' ' || end[-1] == '\n')) --end;
-    *end = 0;
-    return start;
+// Characters that end the fast scan through a value, because they either end
+// the value or have to be removed from it.
+struct ValueStops {
+    bool table[256] = {};
+    constexpr ValueStops() {
+        for (unsigned char c : {';', '\n', '/', '\r', '\t'}) table[c] = true;
+    }
+};
+static constexpr ValueStops VALUE_STOPS;
+
+static bool IsComment(const char* p, const char* end) {
+    return p[0] == '/' && p + 1 != end && p[1] == '/';
 }
 
-bool ParseNextTag(char*& p, char*& outTag, char*& outVal) {
-    while (*p && *p != '#') ++p;
-    if (*p == 0) return false;
-    outTag = ++p;
+// Skips comments and carriage returns, and returns the next character that
+// remains after they are removed.
+static const char* SkipIgnored(const char* p, const char* end, bool& dirty) {
+    while (p != end) {
+        if (*p == '\r') {
+            ++p;
+        } else if (IsComment(p, end)) {
+            auto newline = static_cast<const char*>(memchr(p, '\n', end - p));
+            p = newline ? newline : end;
+        } else {
+            break;
+        }
+        dirty = true;
+    }
+    return p;
+}
 
-    while (*p && *p != ':') ++p;
-    if (*p) *p++ = 0;
+SimfileTokenizer::SimfileTokenizer(std::string_view text)
+    : myPos(text.data()), myEnd(text.data() + text.size()) {}
 
-    outVal = p;
-    // Allow : and ; to be escaped
-    while (*p && (*p != ';' || *(p - 1) == '\\') &&
-           !(p[0] == '\n' && p[1] == '#'))
+bool SimfileTokenizer::next(std::string_view& outTag,
+                            std::string_view& outVal) {
+    const char *p = myPos, *end = myEnd;
+    bool tagDirty = false, valDirty = false, ignored = false;
+
+    // Find the start of the tag.
+    while (true) {
+        p = SkipIgnored(p, end, ignored);
+        if (p == end) {
+            myPos = end;
+            return false;
+        }
+        if (*p == '#') break;
         ++p;
-    if (*p) *p++ = 0;
+    }
+    const char* tag = ++p;
+    while (true) {
+        p = SkipIgnored(p, end, tagDirty);
+        if (p == end || *p == ':') break;
+        tagDirty |= (*p == '\t');
+        ++p;
+    }
+    const char* tagEnd = p;
+    if (p != end) ++p;
+
+    // The value ends at the first semicolon that is not escaped, or at a line
+    // that starts with a new tag.
+    const char* val = p;
+    while (true) {
+        while (p != end && !VALUE_STOPS.table[static_cast<uint8_t>(*p)]) ++p;
+        if (p == end) break;
+        char c = *p;
+        if (c == ';') {
+            const char* prev = p - 1;
+            while (prev >= val && *prev == '\r') --prev;
+            if (prev < val || *prev != '\\') break;
+        } else if (c == '\n') {
+            const char* next = SkipIgnored(p + 1, end, ignored);
+            if (next != end && *next == '#') break;
+        } else if (c == '\t') {
+            valDirty = true;
+        } else if (c == '\r' || IsComment(p, end)) {
+            p = SkipIgnored(p, end, valDirty);
+            continue;
+        }
+        ++p;
+    }
+    const char* valEnd = p;
+    if (p != end) ++p;
 
+    myPos = p;
+    outTag = clean(tag, tagEnd, tagDirty);
+    outVal = clean(val, valEnd, valDirty);
     return true;
 }
 
+std::string_view SimfileTokenizer::clean(const char* begin, const char* end,
+                                         bool dirty) {
+    if (!dirty) return {begin, static_cast<size_t>(end - begin)};
+
+    std::string& out = myCleaned.emplace_back();
+    out.reserve(end - begin);
+    for (const char* p = begin; p != end;) {
+        if (IsComment(p, end)) {
+            while (p != end && *p != '\n') ++p;
+        } else if (*p == '\r') {
+            ++p;
+        } else {
+            out.push_back(*p == '\t' ? ' ' : *p);
+            ++p;
+        }
+    }
+    return out;
+}
+
+static char* ZeroTerminateItem(char* start, char* end) {
+    while (end != start && (end[-1] == ' ' || end[-1] == '\n')) --end;
+    *end = 0;
+    return start;
+}
+
 bool ParseNextItem(char*& p, char*& outVal, char seperator) {
     while (*p == ' ' || *p == '\n') ++p;
     if (*p == 0) return false;
@@ -1,19 +1,45 @@
 #pragma once
 
 #include <Simfile/Simfile.h>
+#include <deque>
 #include <filesystem>
+#include <string>
+#include <string_view>
 namespace fs = std::filesystem;
 
 namespace Vortex {
 
+class MappedFile;
+
 // ================================================================================================
 // Parsing utilities.
 
-/// Opens and reads a text file, removing comments, tabs, and carriage returns.
-bool ParseSimfile(std::string& out, fs::path path);
+/// Maps a simfile into memory for reading. Returns false if the file could not
+/// be opened; an empty file is opened as an empty mapping.
+bool OpenSimfile(MappedFile& out, const fs::path& path);
+
+/// Returns the contents of a mapped simfile as text.
+std::string_view SimfileText(const MappedFile& file);
+
+/// Splits sm-style tags (e.g. #TAG:VAL;) into tag-value pairs in a single pass,
+/// without copying or modifying the text. Comments, tabs, and carriage returns
+/// are only removed from the tags and values that contain them, which are then
+/// copied to a buffer owned by the tokenizer.
+class SimfileTokenizer {
+   public:
+    explicit SimfileTokenizer(std::string_view text);
+
+    /// Returns the next tag-value pair, or false if there are no more tags.
+    /// The views stay valid for as long as the text and the tokenizer exist.
+    bool next(std::string_view& outTag, std::string_view& outVal);
+
+   private:
+    std::string_view clean(const char* begin, const char* end, bool dirty);
 
-/// Parses the next tag-value pair in a list of sm-style tags (e.g. #TAG:VAL;).
-bool ParseNextTag(char*& p, char*& outTag, char*& outVal);
+    const char* myPos;
+    const char* myEnd;
+    std::deque<std::string> myCleaned;
+};
 
 /// Parses the next item in a list of values (e.g. "V1,V2,...").
 bool ParseNextItem(char*& p, char*& outVal, char seperator = ',');
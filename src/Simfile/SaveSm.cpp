@@ -8,11 +8,15 @@
 #include <Simfile/Notes.h>
 #include <Simfile/SegmentGroup.h>
 #include <Simfile/TimingData.h>
+#include <Simfile/NoteScan.h>
 
 #include <Managers/StyleMan.h>
 
+#include <algorithm>
 #include <cmath>
-#include <list>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
 
 namespace Vortex {
 namespace Sm {
@@ -24,17 +28,72 @@ enum ForceWrite { ALWAYS, SONG_ONLY, NEVER };
 static const int MEASURE_SUBDIV[] = {4, 8, 12, 16, 24, 32, 48, 64, 96, 192};
 static const int NUM_MEASURE_SUBDIV = 10;
 static const int ROWS_PER_NOTE_SECTION = 192;
-static const int MIN_SECTIONS_PER_MEASURE = 4;
 
 static double ToBeat(int row)
 {
 	return (double)row / ROWS_PER_BEAT;
 }
 
+// Collects the output in a buffer, which is written to the file in large blocks instead of one
+// symbol or line at a time.
+struct OutputSink
+{
+	static const size_t BUFFER_SIZE = 1 << 16;
+
+	~OutputSink()
+	{
+		flush();
+	}
+
+	bool open(const Path& path)
+	{
+		buffer.reserve(BUFFER_SIZE);
+		return file.open(path);
+	}
+
+	size_t write(const void* ptr, size_t size, size_t count)
+	{
+		buffer.append(static_cast<const char*>(ptr), size * count);
+		if(buffer.size() >= BUFFER_SIZE) flush();
+		return count;
+	}
+
+	void printf(const char* format, ...)
+	{
+		char text[256];
+		va_list args;
+		va_start(args, format);
+		int len = vsnprintf(text, sizeof(text), format, args);
+		va_end(args);
+		if(len < 0) return;
+		if(len < (int)sizeof(text))
+		{
+			write(text, len, 1);
+		}
+		else
+		{
+			std::string longText(len + 1, 0);
+			va_start(args, format);
+			vsnprintf(&longText[0], len + 1, format, args);
+			va_end(args);
+			write(longText.data(), len, 1);
+		}
+	}
+
+	void flush()
+	{
+		if(file.file && !buffer.empty()) file.write(buffer.data(), 1, buffer.size());
+		buffer.clear();
+	}
+
+	FileWriter file;
+	std::string buffer;
+};
+
 struct ExportData
 {
 	Vector<int> diffs;
-	FileWriter file;
+	OutputSink file;
 	const Simfile* sim;
 	const Chart* chart;
 	bool ssc;
@@ -454,93 +513,57 @@ static const char* GetDifficultyString(Difficulty difficulty)
 
 static int gcd(int a, int b)
 {
-	if (a == 0)
-	{
-		return b;
-	}
-	if (b == 0)
-	{
-		return a;
-	}
-	if (a > b)
-	{
-		return gcd(a - b, b);
-	}
-	else
+	while(b != 0)
 	{
-		return gcd(a, b - a);
+		int r = a % b;
+		a = b;
+		b = r;
 	}
+	return a;
 }
 
-static void GetSectionCompression(const char* section, int width, std::list<uint> quantVec, int& count, int& pitch)
+// Least common multiple of the quantizations of the notes in a section, capped at one line per row.
+struct SectionQuantization
 {
-	// Determines the best compression for the given section.
-	int best = ROWS_PER_NOTE_SECTION;
-	String zeroline(width, '0');
-	std::list<uint>::iterator it;
 	int lcm = 1;
-	for (it = quantVec.begin(); it != quantVec.end(); it++)
+	bool hasZero = false;
+
+	void add(uint quant)
 	{
-		if (*it <= 0)
+		if(quant == 0)
 		{
-			HudError("Bug: zero or negative quantization recorded in chart.");
-			continue;
+			hasZero = true;
 		}
-		lcm = lcm * *it / gcd(lcm, *it);
-		if (lcm > ROWS_PER_NOTE_SECTION)
+		else if(quant >= (uint)ROWS_PER_NOTE_SECTION)
 		{
 			lcm = ROWS_PER_NOTE_SECTION;
-			break;
+		}
+		else
+		{
+			lcm = std::min(lcm / gcd(lcm, (int)quant) * (int)quant, ROWS_PER_NOTE_SECTION);
 		}
 	}
+};
+
+static void WriteNoteLine(ExportData& data, const char* line, const uint* keysounds, int numCols)
+{
+	bool hasKeysounds = false;
+	for(int col = 0; col < numCols; ++col) hasKeysounds |= (keysounds[col] != 0);
 
-	// Set whole and half step measures to be quarter notes by default
-	if (lcm <= MIN_SECTIONS_PER_MEASURE)
+	if(!hasKeysounds)
 	{
-		count = MIN_SECTIONS_PER_MEASURE;
+		data.file.write(line, numCols, 1);
 	}
 	else
 	{
-	// Determines the best compression for the given section.
-    // Maybe lcm is the best factor, so just keep that.
-		count = lcm;
-		String zeroline(width, '0');
-
-		//The factor list is small, just check them all by hand
-		for (int i = lcm / 2; i >= 2; i--)
+		// Symbols with a keysound are followed by the keysound index in square brackets.
+		for(int col = 0; col < numCols; ++col)
 		{
-			// Skip anything that isn't a lcm factor
-			if (lcm % i > 0) continue;
-
-			bool valid = true;
-			float mod = (float) ROWS_PER_NOTE_SECTION / i;
-			for (int j = 0; valid && j < ROWS_PER_NOTE_SECTION; ++j)
-			{
-				float rem = std::round(std::fmod(j, mod));
-				// Check all the compressed rows and make sure they are empty
-				if (rem > 0 && rem < static_cast<int>(mod)
-					&& memcmp(section + j * width, zeroline.str(), width))
-				{ 
-					valid = false;
-					break;
-				}
-			}
-
-			// The first (largest) match is always the best
-			if (valid && i >= MIN_SECTIONS_PER_MEASURE)
-			{
-				count = i;
-				break;
-			}
+			data.file.write(line + col, 1, 1);
+			if(keysounds[col]) data.file.printf("[%u]", keysounds[col] - 1);
 		}
 	}
-	// Is our factor a standard snap? If so, use it.
-	// If not, save the measure as 192nds for SM5 Editor compatibility.
-	if (ROWS_PER_NOTE_SECTION % count != 0)
-	{
-		count = ROWS_PER_NOTE_SECTION;
-	}
-	pitch = (ROWS_PER_NOTE_SECTION * width) / count;
+	data.file.write("\n", 1, 1);
 }
 
 static void WriteSections(ExportData& data)
@@ -558,6 +581,16 @@ static void WriteSections(ExportData& data)
 	sectionVec.resize(sectionSize);
 	char* section = sectionVec.data();
 
+	// The keysound of each symbol in the section, as stored in the notes.
+	Vector<uint> keysoundVec;
+	keysoundVec.resize(sectionSize);
+	uint* keysounds = keysoundVec.data();
+
+	// The positions of the symbols in the section that are not '0'.
+	Vector<int> symbolVec;
+	symbolVec.resize(sectionSize);
+	int* symbols = symbolVec.data();
+
 	// Export note data for each player.
 	for(int pn = 0; pn < numPlayers; ++pn)
 	{
@@ -567,8 +600,6 @@ static void WriteSections(ExportData& data)
 		Vector<const Note*> holdVec(numCols, nullptr);
 		const Note** holds = holdVec.begin();
 
-		std::list<uint> quantVec;
-
 		const Note* it = chart->notes.begin();
 		const Note* end = chart->notes.end();
 
@@ -576,7 +607,9 @@ static void WriteSections(ExportData& data)
 		for(; it != end || remainingHolds > 0; startRow += ROWS_PER_NOTE_SECTION)
 		{
 			memset(section, '0', sectionSize);
+			memset(keysounds, 0, sizeof(uint) * sectionSize);
 			int endRow = startRow + ROWS_PER_NOTE_SECTION;
+			SectionQuantization quantization;
 
 			// Advance to the first note in the current section.
 			for(; it != end && (int)it->row < startRow; ++it);
@@ -587,15 +620,16 @@ static void WriteSections(ExportData& data)
 				if((int)it->player == pn)
 				{
 					int pos = (it->row - startRow) * numCols + it->col;
+					keysounds[pos] = it->keysound;
 					if(it->row == it->endrow)
 					{
 						section[pos] = GetNoteChar(it->type);
-						quantVec.push_front(it->quant);
+						quantization.add(it->quant);
 					}
 					else
 					{
 						section[pos] = GetHoldChar(it->type);
-						quantVec.push_front(it->quant);
+						quantization.add(it->quant);
 						auto hold = holds[it->col];
 						if(hold)
 						{
@@ -603,7 +637,7 @@ static void WriteSections(ExportData& data)
 							{
 								int pos = ((int)hold->endrow - startRow) * numCols + (int)hold->col;
 								section[pos] = '3';
-								quantVec.push_front(it->quant);
+								quantization.add(it->quant);
 								--remainingHolds;
 							}
 						}
@@ -626,27 +660,36 @@ static void WriteSections(ExportData& data)
 							int pos = (hold->endrow - startRow) * numCols + hold->col;
 							section[pos] = '3';
 							holds[col] = nullptr;
-							quantVec.push_front(it->quant);
+							quantization.add((it != end) ? it->quant : hold->quant);
 							--remainingHolds;
 						}
 					}
 				}
 			}
 
+			// Find the rows with notes, and the number of lines that keeps all of them.
+			NoteScan::MeasureRows usedRows;
+			int numSymbols = NoteScan::findNotes(section, sectionSize, symbols);
+			for(int i = 0; i < numSymbols; ++i)
+			{
+				usedRows.set(symbols[i] / numCols);
+			}
+			if(quantization.hasZero)
+			{
+				HudError("Bug: zero or negative quantization recorded in chart.");
+			}
+			int count = NoteScan::measureLineCount(usedRows, quantization.lcm);
+
 			// Write the current section to the file.
-			int count, pitch;
+			int pitch = (ROWS_PER_NOTE_SECTION * numCols) / count;
 			const char* m = section;
-			quantVec.unique();
-			GetSectionCompression(m, numCols, quantVec, count, pitch);
-			quantVec.clear();
 			if (ROWS_PER_NOTE_SECTION % count != 0)
 			{
 				HudError("Bug: trying to save a non-supported number of rows. Data loss expected.");
 			}
 			for (int k = 0; k < count; ++k, m += pitch)
 			{
-				data.file.write(m, numCols, 1);
-				data.file.write("\n", 1, 1);
+				WriteNoteLine(data, m, keysounds + (m - section), numCols);
 			}
 
 			// Write a comma if this is not the last section.
@@ -786,6 +829,7 @@ bool SaveSimfile(const Simfile* sim, bool ssc, bool backup)
 		data.chart = nullptr;
 	}
 
+	data.file.flush();
 	HudInfo("Saved: %s", path.filename().str());
 
 	return true;
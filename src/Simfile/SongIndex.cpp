@@ -0,0 +1,460 @@
+#include <Simfile/SongIndex.h>
+
+#include <Core/StringUtils.h>
+
+#include <System/File.h>
+#include <System/TaskScheduler.h>
+
+#include <Simfile/Chart.h>
+#include <Simfile/Notes.h>
+#include <Simfile/Parsing.h>
+#include <Simfile/SegmentGroup.h>
+#include <Simfile/Simfile.h>
+#include <Simfile/Tempo.h>
+#include <Simfile/TimingData.h>
+
+#include <Managers/StyleMan.h>
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+
+namespace Vortex {
+namespace SongIndex {
+
+static const char INDEX_MAGIC[8] = {'A', 'V', 'I', 'D', 'X', 0, 0, 1};
+
+// Rows in a measure of four beats, over which the notes per second are taken.
+static const int ROWS_PER_MEASURE = 192;
+
+// Preference of the simfile formats within a folder. Every .osu file holds a
+// single chart, so all of them are indexed.
+enum SimfileRank { RANK_SSC, RANK_SM, RANK_DWI, RANK_OSU, RANK_NONE };
+
+// Layout of an index file: the header is followed by the songs, each of which
+// is a list of length-prefixed strings and fixed size numbers, followed by its
+// charts.
+struct Header {
+    char magic[8];
+    uint32_t numSongs;
+    uint32_t reserved;
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+struct FoundFile {
+    fs::path path;
+    std::string key;
+    uint64_t size;
+    int64_t time;
+};
+
+// ================================================================================================
+// Helper functions.
+
+static uint64_t Fnv1a(const void* data, size_t size,
+                      uint64_t hash = 14695981039346656037ull) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+struct IndexWriter {
+    std::string data;
+
+    void put(const void* in, size_t bytes) {
+        data.append(static_cast<const char*>(in), bytes);
+    }
+
+    template <typename T>
+    void put(T val) {
+        put(&val, sizeof(T));
+    }
+
+    void putString(const std::string& str) {
+        put(static_cast<uint32_t>(str.size()));
+        put(str.data(), str.size());
+    }
+};
+
+// Reads from the data of an index file. Reading past the end sets valid to
+// false and returns zeros.
+struct IndexReader {
+    const char* pos;
+    const char* end;
+    bool valid;
+
+    void get(void* out, size_t bytes) {
+        if (bytes > static_cast<size_t>(end - pos)) {
+            memset(out, 0, bytes);
+            pos = end;
+            valid = false;
+            return;
+        }
+        memcpy(out, pos, bytes);
+        pos += bytes;
+    }
+
+    template <typename T>
+    T get() {
+        T val = T();
+        get(&val, sizeof(T));
+        return val;
+    }
+
+    std::string getString() {
+        uint32_t length = get<uint32_t>();
+        if (length > static_cast<size_t>(end - pos)) {
+            pos = end;
+            valid = false;
+            return std::string();
+        }
+        std::string out(pos, length);
+        pos += length;
+        return out;
+    }
+};
+
+static void WriteSong(IndexWriter& out, const IndexedSong& song) {
+    out.putString(song.path);
+    out.put(song.fileSize);
+    out.put(song.fileTime);
+    out.putString(song.title);
+    out.putString(song.artist);
+    out.put(song.minBpm);
+    out.put(song.maxBpm);
+    out.put(song.length);
+    out.put(static_cast<uint32_t>(song.charts.size()));
+    for (auto& chart : song.charts) {
+        out.putString(chart.style);
+        out.putString(chart.artist);
+        out.put(static_cast<int32_t>(chart.difficulty));
+        out.put(static_cast<int32_t>(chart.meter));
+        out.put(static_cast<int32_t>(chart.numSteps));
+        out.put(static_cast<int32_t>(chart.numHolds));
+        out.put(static_cast<int32_t>(chart.numMines));
+        out.put(chart.peakNps);
+    }
+}
+
+static void ReadSong(IndexReader& in, IndexedSong& song) {
+    song.path = in.getString();
+    song.fileSize = in.get<uint64_t>();
+    song.fileTime = in.get<int64_t>();
+    song.title = in.getString();
+    song.artist = in.getString();
+    song.minBpm = in.get<double>();
+    song.maxBpm = in.get<double>();
+    song.length = in.get<double>();
+    uint32_t numCharts = in.get<uint32_t>();
+    for (uint32_t i = 0; i < numCharts && in.valid; ++i) {
+        IndexedChart chart;
+        chart.style = in.getString();
+        chart.artist = in.getString();
+        chart.difficulty = in.get<int32_t>();
+        chart.meter = in.get<int32_t>();
+        chart.numSteps = in.get<int32_t>();
+        chart.numHolds = in.get<int32_t>();
+        chart.numMines = in.get<int32_t>();
+        chart.peakNps = in.get<float>();
+        song.charts.push_back(chart);
+    }
+}
+
+static void AddBpmRange(const Tempo* tempo, IndexedSong& song) {
+    auto segments = tempo->segments;
+    for (auto it = segments->begin<BpmChange>(), end = segments->end<BpmChange>();
+         it != end; ++it) {
+        if (song.minBpm == 0.0 && song.maxBpm == 0.0) {
+            song.minBpm = song.maxBpm = it->bpm;
+        } else {
+            song.minBpm = std::min(song.minBpm, it->bpm);
+            song.maxBpm = std::max(song.maxBpm, it->bpm);
+        }
+    }
+}
+
+// Returns the steps per second of a measure, or zero if the measure takes no
+// time, like a measure that is warped over.
+static float MeasureNps(const TimingData& timing, int measure, int numSteps) {
+    if (measure < 0 || numSteps == 0) return 0.0f;
+    double begin = timing.rowToTime(measure * ROWS_PER_MEASURE);
+    double end = timing.rowToTime((measure + 1) * ROWS_PER_MEASURE);
+    if (end <= begin) return 0.0f;
+    return static_cast<float>(numSteps / (end - begin));
+}
+
+static void SummarizeChart(const Chart& chart, const TimingData& timing,
+                           IndexedChart& out, double& length) {
+    out.style = chart.style ? chart.style->id : std::string();
+    out.artist = chart.artist;
+    out.difficulty = chart.difficulty;
+    out.meter = chart.meter;
+    out.numSteps = out.numHolds = out.numMines = 0;
+    out.peakNps = 0.0f;
+
+    // Notes are sorted by row, so the steps of a measure are consecutive.
+    int lastRow = -1, measure = -1, measureSteps = 0;
+    for (auto& note : chart.notes) {
+        lastRow = std::max(lastRow, note.endrow);
+        if (note.type == NOTE_MINE) {
+            ++out.numMines;
+            continue;
+        }
+        ++out.numSteps;
+        out.numHolds += (note.endrow > note.row);
+
+        int noteMeasure = note.row / ROWS_PER_MEASURE;
+        if (noteMeasure != measure) {
+            out.peakNps = std::max(out.peakNps, MeasureNps(timing, measure, measureSteps));
+            measure = noteMeasure;
+            measureSteps = 0;
+        }
+        ++measureSteps;
+    }
+    out.peakNps = std::max(out.peakNps, MeasureNps(timing, measure, measureSteps));
+
+    if (lastRow >= 0) length = std::max(length, timing.rowToTime(lastRow));
+}
+
+static SimfileRank GetRank(const fs::path& path) {
+    std::string ext = pathToUtf8(path.extension());
+    Str::toLower(ext);
+    if (ext == ".ssc") return RANK_SSC;
+    if (ext == ".sm") return RANK_SM;
+    if (ext == ".dwi") return RANK_DWI;
+    if (ext == ".osu") return RANK_OSU;
+    return RANK_NONE;
+}
+
+static void FindSimfiles(const fs::path& root, std::vector<FoundFile>& out,
+                         const std::stop_token& token) {
+    std::error_code ec;
+    std::vector<std::pair<fs::path, SimfileRank>> candidates;
+    std::map<fs::path, SimfileRank> preferred;
+    auto options = fs::directory_options::skip_permission_denied;
+    for (fs::recursive_directory_iterator it(root, options, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        if (token.stop_requested()) return;
+        if (!it->is_regular_file(ec)) continue;
+
+        SimfileRank rank = GetRank(it->path());
+        if (rank == RANK_NONE) continue;
+        candidates.emplace_back(it->path(), rank);
+        if (rank != RANK_OSU) {
+            auto folder = preferred.try_emplace(it->path().parent_path(), rank);
+            folder.first->second = std::min(folder.first->second, rank);
+        }
+    }
+
+    for (auto& [path, rank] : candidates) {
+        if (rank != RANK_OSU && preferred[path.parent_path()] != rank) continue;
+
+        FoundFile file;
+        file.size = fs::file_size(path, ec);
+        if (ec) continue;
+        auto time = fs::last_write_time(path, ec);
+        if (ec) continue;
+        file.time = static_cast<int64_t>(time.time_since_epoch().count());
+        file.key = pathToUtf8(path);
+        file.path = path;
+        out.push_back(std::move(file));
+    }
+}
+
+// ================================================================================================
+// SongIndex API.
+
+bool read(const fs::path& indexFile, std::vector<IndexedSong>& out) {
+    out.clear();
+
+    MappedFile mapping;
+    if (!mapping.open(indexFile)) return false;
+
+    Header h;
+    if (mapping.size() < sizeof(Header)) return false;
+    memcpy(&h, mapping.data(), sizeof(Header));
+
+    auto data = reinterpret_cast<const char*>(mapping.data() + sizeof(Header));
+    bool valid = memcmp(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                 h.dataSize == mapping.size() - sizeof(Header) &&
+                 h.numSongs <= h.dataSize &&
+                 h.dataHash == Fnv1a(data, h.dataSize);
+    if (!valid) return false;
+
+    IndexReader in = {data, data + h.dataSize, true};
+    out.resize(h.numSongs);
+    for (uint32_t i = 0; i < h.numSongs && in.valid; ++i) {
+        ReadSong(in, out[i]);
+    }
+    if (!in.valid || in.pos != in.end) {
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+bool write(const fs::path& indexFile, const std::vector<IndexedSong>& songs) {
+    IndexWriter data;
+    for (auto& song : songs) {
+        WriteSong(data, song);
+    }
+
+    Header h = {};
+    memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    h.numSongs = static_cast<uint32_t>(songs.size());
+    h.dataSize = data.data.size();
+    h.dataHash = Fnv1a(data.data.data(), data.data.size());
+
+    std::error_code ec;
+    if (indexFile.has_parent_path()) {
+        fs::create_directories(indexFile.parent_path(), ec);
+    }
+
+    fs::path temp = indexFile;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(Header));
+        out.write(data.data.data(), static_cast<std::streamsize>(data.data.size()));
+        if (!out.good()) {
+            out.close();
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+    fs::rename(temp, indexFile, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+void summarize(const Simfile& sim, IndexedSong& out) {
+    out.title = sim.title;
+    out.artist = sim.artist;
+    out.minBpm = out.maxBpm = 0.0;
+    out.length = 0.0;
+    out.charts.clear();
+
+    TimingData songTiming;
+    songTiming.update(sim.tempo);
+    AddBpmRange(sim.tempo, out);
+
+    for (auto chart : sim.charts) {
+        const Tempo* tempo = chart->getTempo(&sim);
+        TimingData chartTiming;
+        if (tempo != sim.tempo) {
+            chartTiming.update(tempo);
+            AddBpmRange(tempo, out);
+        }
+        const TimingData& timing = (tempo != sim.tempo) ? chartTiming : songTiming;
+
+        IndexedChart summary;
+        SummarizeChart(*chart, timing, summary, out.length);
+        out.charts.push_back(std::move(summary));
+    }
+}
+
+bool update(const fs::path& root, const fs::path& indexFile,
+            std::vector<IndexedSong>& out, std::stop_token token,
+            SongIndexStats* stats) {
+    std::vector<IndexedSong> previous;
+    read(indexFile, previous);
+    std::unordered_map<std::string, size_t> previousByPath;
+    for (size_t i = 0; i < previous.size(); ++i) {
+        previousByPath[previous[i].path] = i;
+    }
+
+    // A walk that was stopped has not seen every simfile, so the index is
+    // left as it is.
+    std::vector<FoundFile> files;
+    FindSimfiles(root, files, token);
+    if (token.stop_requested()) {
+        out = std::move(previous);
+        return false;
+    }
+
+    // Entries of unchanged simfiles are moved to the output as they are, the
+    // other simfiles are loaded.
+    out.clear();
+    out.resize(files.size());
+    std::vector<int> pending;
+    int numReused = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        const FoundFile& file = files[i];
+        auto it = previousByPath.find(file.key);
+        if (it != previousByPath.end()) {
+            IndexedSong& entry = previous[it->second];
+            if (entry.fileSize == file.size && entry.fileTime == file.time) {
+                out[i] = std::move(entry);
+                ++numReused;
+                continue;
+            }
+        }
+        out[i].path = file.key;
+        out[i].fileSize = file.size;
+        out[i].fileTime = file.time;
+        pending.push_back(static_cast<int>(i));
+    }
+
+    std::vector<char> loaded(files.size(), 1);
+    for (int i : pending) loaded[i] = 0;
+    std::atomic<int> numLoaded(0), numFailed(0);
+    TaskScheduler::parallelFor(
+        static_cast<int>(pending.size()), TaskScheduler::numWorkers(),
+        TaskPriority::Analysis, [&](int item, int) {
+            if (token.stop_requested()) return;
+            int index = pending[item];
+
+            // A library can have thousands of simfiles with unknown styles or
+            // odd values, which should neither add styles to the editor nor
+            // show a warning each. The fallback styles of a simfile are kept
+            // until it is summarized.
+            FallbackStyleScope fallbackStyles;
+            HudMute mute;
+            Simfile sim;
+            if (LoadSimfile(sim, files[index].path)) {
+                sim.sanitize();
+                summarize(sim, out[index]);
+            } else {
+                numFailed.fetch_add(1);
+            }
+            loaded[index] = 1;
+            numLoaded.fetch_add(1);
+        });
+
+    // Simfiles that were not loaded before a stop was requested are left out,
+    // and are loaded by the next update.
+    size_t numKept = 0;
+    for (size_t i = 0; i < out.size(); ++i) {
+        if (!loaded[i]) continue;
+        if (numKept != i) out[numKept] = std::move(out[i]);
+        ++numKept;
+    }
+    out.resize(numKept);
+    std::sort(out.begin(), out.end(),
+              [](const IndexedSong& a, const IndexedSong& b) {
+                  return a.path < b.path;
+              });
+
+    bool changed = numLoaded > 0 || numReused != static_cast<int>(previous.size());
+    if (changed) write(indexFile, out);
+
+    if (stats) {
+        stats->numFiles = static_cast<int>(files.size());
+        stats->numReused = numReused;
+        stats->numLoaded = numLoaded;
+        stats->numFailed = numFailed;
+    }
+    return !token.stop_requested();
+}
+
+};  // namespace SongIndex
+};  // namespace Vortex
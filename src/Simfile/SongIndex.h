@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace Vortex {
+
+struct Simfile;
+
+/// Summary of a chart, as stored in the song index.
+struct IndexedChart {
+    std::string style;   ///< Id of the chart style, e.g. "dance-single".
+    std::string artist;  ///< Step artist.
+    int difficulty;
+    int meter;
+    int numSteps;  ///< Notes that are not mines, like Chart::stepCount.
+    int numHolds;  ///< Holds and rolls.
+    int numMines;
+    float peakNps;  ///< Most steps per second in a single measure.
+};
+
+/// Summary of a simfile, as stored in the song index.
+struct IndexedSong {
+    std::string path;   ///< UTF-8 path of the simfile.
+    uint64_t fileSize;  ///< Size of the simfile when it was indexed.
+    int64_t fileTime;   ///< Modification time of the simfile when it was indexed.
+    std::string title;
+    std::string artist;
+    double minBpm;
+    double maxBpm;
+    double length;  ///< Seconds until the end of the last note of any chart.
+    std::vector<IndexedChart> charts;
+};
+
+/// Counts of the files that were found by an index update.
+struct SongIndexStats {
+    int numFiles;   ///< Simfiles found in the directory tree.
+    int numReused;  ///< Unchanged simfiles, of which the entry was kept.
+    int numLoaded;  ///< New or changed simfiles that were loaded.
+    int numFailed;  ///< Loaded simfiles that could not be read.
+};
+
+/// Index of the simfiles in a song library. The index is stored as a compact
+/// binary file, so browsing a library of thousands of songs does not have to
+/// load every simfile. Entries are keyed by the path of the simfile, and are
+/// only loaded again when its size or modification time changes.
+namespace SongIndex {
+
+/// Reads the index file. Returns false if the file does not exist or is not a
+/// valid index, in which case the output is empty.
+bool read(const fs::path& indexFile, std::vector<IndexedSong>& out);
+
+/// Writes the index file. The index is written to a temporary file that
+/// replaces the old index when it is complete, so a failed write leaves the
+/// old index intact.
+bool write(const fs::path& indexFile, const std::vector<IndexedSong>& songs);
+
+/// Fills in the song and chart summaries of an entry from a loaded simfile.
+/// The path, size, and modification time are left unchanged.
+void summarize(const Simfile& sim, IndexedSong& out);
+
+/// Walks the directory tree under root, and brings the index file up to date
+/// with the simfiles in it. In every folder, the .ssc, .sm, or .dwi file is
+/// indexed in that order of preference, along with every .osu file. Changed
+/// simfiles are loaded on the task scheduler at analysis priority, with the
+/// regular loaders, but without adding fallback styles to the editor or
+/// showing Hud messages. Simfiles that cannot be loaded keep an entry without
+/// charts, so they are not loaded again until they change. The output is
+/// sorted by path. Returns false if a stop was requested. A stop during the
+/// directory walk returns the old index and leaves the index file as it is; a
+/// stop while loading still writes the simfiles that were loaded up to that
+/// point to the index.
+bool update(const fs::path& root, const fs::path& indexFile,
+            std::vector<IndexedSong>& out, std::stop_token token,
+            SongIndexStats* stats = nullptr);
+
+};  // namespace SongIndex
+
+};  // namespace Vortex
@@ -0,0 +1,60 @@
+#include <System/CpuFeatures.h>
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace Vortex {
+namespace CpuFeatures {
+
+static std::atomic<int> maxLevel(AVX2);
+
+static Level DetectLevel() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    int numIds = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+
+    // The operating system has to save the upper halves of the registers.
+    bool ymmState = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+
+    bool avx2 = false;
+    if (numIds >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    if (avx && avx2 && fma && ymmState) return AVX2;
+    if (sse2) return SSE2;
+    return SCALAR;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) return SSE2;
+    return SCALAR;
+#else
+    return SCALAR;
+#endif
+}
+
+Level getLevel() {
+    static const Level detected = DetectLevel();
+    return static_cast<Level>(std::min<int>(detected, maxLevel));
+}
+
+void setMaxLevel(Level level) { maxLevel = level; }
+
+};  // namespace CpuFeatures
+};  // namespace Vortex
@@ -0,0 +1,44 @@
+#pragma once
+
+// Compile-time availability of the vector kernels. SSE2 code can be used
+// unconditionally when CPU_HAS_SSE2 is defined. AVX2 code has to be placed in
+// functions marked with CPU_TARGET_AVX2, and may only be called after
+// "CpuFeatures::getLevel" reports support for it.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_HAS_SSE2
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CPU_HAS_AVX2
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define CPU_HAS_AVX2
+#define CPU_TARGET_AVX2
+#endif
+
+namespace Vortex {
+
+/// Detection of the vector instruction sets supported by the processor, for
+/// kernels that select an implementation at runtime.
+namespace CpuFeatures {
+
+/// Instruction set levels, from least to most capable.
+enum Level {
+    SCALAR,  ///< No vector instructions.
+    SSE2,    ///< 128-bit vectors, available on every x86-64 processor.
+    AVX2,    ///< 256-bit integer and float vectors, with fused multiply-add.
+};
+
+/// Returns the most capable level that is supported by both the processor
+/// and the operating system, capped by "setMaxLevel".
+Level getLevel();
+
+/// Limits the level returned by "getLevel", which allows benchmarks and tests
+/// to compare the kernels of every level on the same machine.
+void setMaxLevel(Level level);
+
+};  // namespace CpuFeatures
+
+};  // namespace Vortex
@@ -7,6 +7,17 @@
 #include <fstream>
 #include <filesystem>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace Vortex {
 
 std::string pathToUtf8(fs::path path) {
@@ -21,6 +32,89 @@ fs::path utf8ToPath(std::string str) {
     return fs::path(reinterpret_cast<const char8_t*>(str.c_str()));
 }
 
+// ================================================================================================
+// MappedFile.
+
+MappedFile::MappedFile() : myData(nullptr), mySize(0), myHandle(nullptr) {}
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+
+bool MappedFile::open(fs::path path) {
+    close();
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The mapping keeps the file open, so the file handle can be closed.
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) return false;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    myData = static_cast<const uint8_t*>(view);
+    mySize = static_cast<size_t>(size.QuadPart);
+    myHandle = mapping;
+    return true;
+}
+
+void MappedFile::close() {
+    if (myData) UnmapViewOfFile(myData);
+    if (myHandle) CloseHandle(static_cast<HANDLE>(myHandle));
+    myData = nullptr;
+    mySize = 0;
+    myHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(fs::path path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file open, so the descriptor can be closed.
+    size_t size = static_cast<size_t>(info.st_size);
+    void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+
+    myData = static_cast<const uint8_t*>(view);
+    mySize = size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (myData) munmap(const_cast<uint8_t*>(myData), mySize);
+    myData = nullptr;
+    mySize = 0;
+    myHandle = nullptr;
+}
+
+#endif
+
 // ================================================================================================
 // File utilities.
 namespace File {
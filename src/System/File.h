@@ -5,6 +5,8 @@
 
 #include <Core/Vector.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 
 namespace fs = std::filesystem;
@@ -23,6 +25,39 @@ extern std::u8string stringToUtf8(std::string str);
 /// Always use this when creating paths that could have UTF-8 characters.
 extern fs::path utf8ToPath(std::string str);
 
+/// A read-only view of the contents of a file, mapped into memory by the
+/// operating system. Pages are loaded on first access and can be shared by
+/// several readers of the same file.
+class MappedFile {
+   public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Maps the entire file. Returns false if the file could not be opened or
+    /// is empty, in which case the view is left closed.
+    bool open(fs::path path);
+
+    /// Unmaps the file.
+    void close();
+
+    /// Returns true if a file is mapped.
+    bool isOpen() const { return myData != nullptr; }
+
+    /// Returns the first byte of the mapped file.
+    const uint8_t* data() const { return myData; }
+
+    /// Returns the size of the mapped file in bytes.
+    size_t size() const { return mySize; }
+
+   private:
+    const uint8_t* myData;
+    size_t mySize;
+    void* myHandle;
+};
+
 namespace File {
 
 /// Returns a string with the contents of a file.
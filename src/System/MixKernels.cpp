@@ -0,0 +1,256 @@
+#include <System/MixKernels.h>
+
+#include <System/CpuFeatures.h>
+
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef CPU_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef CPU_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace Vortex {
+namespace MixKernels {
+
+static const int UNITY_GAIN = 1 << 15;
+
+static inline short Saturate(int v) {
+    return static_cast<short>(std::min(std::max(v, SHRT_MIN), SHRT_MAX));
+}
+
+// ================================================================================================
+// Scalar kernels, which also process the tails of the vector kernels.
+
+static void InterleaveScalar(short* dst, const short* srcL, const short* srcR,
+                             int numFrames) {
+    for (int i = 0; i < numFrames; ++i) {
+        dst[i * 2 + 0] = srcL[i];
+        dst[i * 2 + 1] = srcR[i];
+    }
+}
+
+static void InterleaveAddScalar(short* dst, const short* srcL,
+                                const short* srcR, int numFrames) {
+    for (int i = 0; i < numFrames; ++i) {
+        dst[i * 2 + 0] = Saturate(dst[i * 2 + 0] + srcL[i]);
+        dst[i * 2 + 1] = Saturate(dst[i * 2 + 1] + srcR[i]);
+    }
+}
+
+static void AddScalar(short* dst, const short* src, int numSamples) {
+    for (int i = 0; i < numSamples; ++i) {
+        dst[i] = Saturate(dst[i] + src[i]);
+    }
+}
+
+static void ScaleScalar(short* samples, int numSamples, int gain) {
+    for (int i = 0; i < numSamples; ++i) {
+        samples[i] = static_cast<short>((samples[i] * gain) >> 15);
+    }
+}
+
+// ================================================================================================
+// SSE2 kernels.
+
+#ifdef CPU_HAS_SSE2
+
+static inline __m128i Load128(const short* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+static inline void Store128(short* p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+static void InterleaveSse2(short* dst, const short* srcL, const short* srcR,
+                           int numFrames) {
+    int i = 0;
+    for (; i + 8 <= numFrames; i += 8) {
+        __m128i l = Load128(srcL + i), r = Load128(srcR + i);
+        Store128(dst + i * 2 + 0, _mm_unpacklo_epi16(l, r));
+        Store128(dst + i * 2 + 8, _mm_unpackhi_epi16(l, r));
+    }
+    InterleaveScalar(dst + i * 2, srcL + i, srcR + i, numFrames - i);
+}
+
+static void InterleaveAddSse2(short* dst, const short* srcL, const short* srcR,
+                              int numFrames) {
+    int i = 0;
+    for (; i + 8 <= numFrames; i += 8) {
+        __m128i l = Load128(srcL + i), r = Load128(srcR + i);
+        __m128i lo = _mm_adds_epi16(Load128(dst + i * 2 + 0),
+                                    _mm_unpacklo_epi16(l, r));
+        __m128i hi = _mm_adds_epi16(Load128(dst + i * 2 + 8),
+                                    _mm_unpackhi_epi16(l, r));
+        Store128(dst + i * 2 + 0, lo);
+        Store128(dst + i * 2 + 8, hi);
+    }
+    InterleaveAddScalar(dst + i * 2, srcL + i, srcR + i, numFrames - i);
+}
+
+static void AddSse2(short* dst, const short* src, int numSamples) {
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        Store128(dst + i, _mm_adds_epi16(Load128(dst + i), Load128(src + i)));
+    }
+    AddScalar(dst + i, src + i, numSamples - i);
+}
+
+static void ScaleSse2(short* samples, int numSamples, int gain) {
+    // The full 32-bit products are formed from their low and high halves, so
+    // the result matches the scalar shift exactly.
+    const __m128i g = _mm_set1_epi16(static_cast<short>(gain));
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        __m128i s = Load128(samples + i);
+        __m128i lo = _mm_mullo_epi16(s, g);
+        __m128i hi = _mm_mulhi_epi16(s, g);
+        __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+        __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+        Store128(samples + i, _mm_packs_epi32(p0, p1));
+    }
+    ScaleScalar(samples + i, numSamples - i, gain);
+}
+
+#endif  // CPU_HAS_SSE2
+
+// ================================================================================================
+// AVX2 kernels.
+
+#ifdef CPU_HAS_AVX2
+
+CPU_TARGET_AVX2 static inline __m256i Load256(const short* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+CPU_TARGET_AVX2 static inline void Store256(short* p, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+// Interleaves sixteen frames. The unpack instructions work within 128-bit
+// lanes, so the lanes of their results are reordered afterwards.
+CPU_TARGET_AVX2 static inline void Interleave256(__m256i l, __m256i r,
+                                                 __m256i& out0,
+                                                 __m256i& out1) {
+    __m256i lo = _mm256_unpacklo_epi16(l, r);
+    __m256i hi = _mm256_unpackhi_epi16(l, r);
+    out0 = _mm256_permute2x128_si256(lo, hi, 0x20);
+    out1 = _mm256_permute2x128_si256(lo, hi, 0x31);
+}
+
+CPU_TARGET_AVX2 static void InterleaveAvx2(short* dst, const short* srcL,
+                                           const short* srcR, int numFrames) {
+    int i = 0;
+    for (; i + 16 <= numFrames; i += 16) {
+        __m256i a, b;
+        Interleave256(Load256(srcL + i), Load256(srcR + i), a, b);
+        Store256(dst + i * 2 + 0, a);
+        Store256(dst + i * 2 + 16, b);
+    }
+    InterleaveScalar(dst + i * 2, srcL + i, srcR + i, numFrames - i);
+}
+
+CPU_TARGET_AVX2 static void InterleaveAddAvx2(short* dst, const short* srcL,
+                                              const short* srcR,
+                                              int numFrames) {
+    int i = 0;
+    for (; i + 16 <= numFrames; i += 16) {
+        __m256i a, b;
+        Interleave256(Load256(srcL + i), Load256(srcR + i), a, b);
+        Store256(dst + i * 2 + 0, _mm256_adds_epi16(Load256(dst + i * 2), a));
+        Store256(dst + i * 2 + 16,
+                 _mm256_adds_epi16(Load256(dst + i * 2 + 16), b));
+    }
+    InterleaveAddScalar(dst + i * 2, srcL + i, srcR + i, numFrames - i);
+}
+
+CPU_TARGET_AVX2 static void AddAvx2(short* dst, const short* src,
+                                    int numSamples) {
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16) {
+        __m256i sum = _mm256_adds_epi16(Load256(dst + i), Load256(src + i));
+        Store256(dst + i, sum);
+    }
+    AddScalar(dst + i, src + i, numSamples - i);
+}
+
+CPU_TARGET_AVX2 static void ScaleAvx2(short* samples, int numSamples,
+                                      int gain) {
+    // Unpacking and packing both work within lanes, so the order is kept.
+    const __m256i g = _mm256_set1_epi16(static_cast<short>(gain));
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16) {
+        __m256i s = Load256(samples + i);
+        __m256i lo = _mm256_mullo_epi16(s, g);
+        __m256i hi = _mm256_mulhi_epi16(s, g);
+        __m256i p0 = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 15);
+        __m256i p1 = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 15);
+        Store256(samples + i, _mm256_packs_epi32(p0, p1));
+    }
+    ScaleScalar(samples + i, numSamples - i, gain);
+}
+
+#endif  // CPU_HAS_AVX2
+
+// ================================================================================================
+// Dispatch.
+
+struct Kernels {
+    void (*interleave)(short*, const short*, const short*, int);
+    void (*interleaveAdd)(short*, const short*, const short*, int);
+    void (*add)(short*, const short*, int);
+    void (*scale)(short*, int, int);
+};
+
+static const Kernels& GetKernels() {
+    static const Kernels scalar = {InterleaveScalar, InterleaveAddScalar,
+                                   AddScalar, ScaleScalar};
+#ifdef CPU_HAS_SSE2
+    static const Kernels sse2 = {InterleaveSse2, InterleaveAddSse2, AddSse2,
+                                 ScaleSse2};
+#endif
+#ifdef CPU_HAS_AVX2
+    static const Kernels avx2 = {InterleaveAvx2, InterleaveAddAvx2, AddAvx2,
+                                 ScaleAvx2};
+#endif
+
+    CpuFeatures::Level level = CpuFeatures::getLevel();
+#ifdef CPU_HAS_AVX2
+    if (level >= CpuFeatures::AVX2) return avx2;
+#endif
+#ifdef CPU_HAS_SSE2
+    if (level >= CpuFeatures::SSE2) return sse2;
+#endif
+    return scalar;
+}
+
+void interleave(short* dst, const short* srcL, const short* srcR,
+                int numFrames) {
+    GetKernels().interleave(dst, srcL, srcR, numFrames);
+}
+
+void interleaveAdd(short* dst, const short* srcL, const short* srcR,
+                   int numFrames) {
+    GetKernels().interleaveAdd(dst, srcL, srcR, numFrames);
+}
+
+void add(short* dst, const short* src, int numSamples) {
+    GetKernels().add(dst, src, numSamples);
+}
+
+void scale(short* samples, int numSamples, int gain) {
+    if (gain >= UNITY_GAIN) return;
+    if (gain <= 0) {
+        memset(samples, 0, sizeof(short) * numSamples);
+        return;
+    }
+    GetKernels().scale(samples, numSamples, gain);
+}
+
+};  // namespace MixKernels
+};  // namespace Vortex
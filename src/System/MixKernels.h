@@ -0,0 +1,28 @@
+#pragma once
+
+namespace Vortex {
+
+/// Vectorized kernels for mixing 16-bit stereo audio. Every function selects
+/// the most capable implementation supported by the processor at runtime, and
+/// all implementations produce identical results.
+namespace MixKernels {
+
+/// Writes interleaved stereo frames from separate left and right channels.
+void interleave(short* dst, const short* srcL, const short* srcR,
+                int numFrames);
+
+/// Adds separate left and right channels to interleaved stereo frames,
+/// saturating at the 16-bit range.
+void interleaveAdd(short* dst, const short* srcL, const short* srcR,
+                   int numFrames);
+
+/// Adds samples to the samples in dst, saturating at the 16-bit range.
+void add(short* dst, const short* src, int numSamples);
+
+/// Multiplies samples by a Q15 gain in [0, 32768], where 32768 is unity gain.
+/// Results are rounded towards negative infinity: (sample * gain) >> 15.
+void scale(short* samples, int numSamples, int gain);
+
+};  // namespace MixKernels
+
+};  // namespace Vortex
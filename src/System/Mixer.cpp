@@ -1,5 +1,8 @@
 #include <System/Mixer.h>
 
+// Other platforms use the NullMixer, see "NullMixer.cpp".
+#ifdef _WIN32
+
 #include <malloc.h>
 
 #include "windows.h"
@@ -9,7 +12,10 @@ namespace Vortex {
 
 static const int WAVEOUT_CHANNELS = 2;
 static const int WAVEOUT_BLOCKS = 8;
-static const int WAVEOUT_BLOCK_FRAMES = 8192;
+
+// The queued blocks hold about 370 ms at 44.1 kHz. Mixing a block takes a few
+// microseconds with the vector kernels, so blocks can be this small.
+static const int WAVEOUT_BLOCK_FRAMES = 2048;
 static const int WAVEOUT_BLOCK_SIZE =
     sizeof(short) * WAVEOUT_CHANNELS * WAVEOUT_BLOCK_FRAMES;
 
@@ -247,6 +253,6 @@ static DWORD WINAPI MixerThread(LPVOID mixer) {
 
 Mixer* Mixer::create() { return new MixerImpl; }
 
-Mixer::~Mixer() = default;
-
 };  // namespace Vortex
+
+#endif  // _WIN32
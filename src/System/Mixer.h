@@ -11,7 +11,7 @@ struct MixSource {
 struct Mixer {
     static Mixer* create();
 
-    virtual ~Mixer();
+    virtual ~Mixer() = default;
 
     /// Opens the mixer for audio output at the given samplerate. The mixer is
     /// initially paused.
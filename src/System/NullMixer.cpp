@@ -0,0 +1,151 @@
+#include <System/NullMixer.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+namespace Vortex {
+
+static const int NULL_MIXER_CHANNELS = 2;
+
+// Writes the 44-byte header of a 16-bit stereo PCM wav file. All values are
+// written in little-endian order.
+static void WriteWaveHeader(std::ofstream& file, int64_t numFrames,
+                            int samplerate) {
+    auto write32 = [&](uint32_t v) {
+        uint8_t b[4] = {static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8),
+                        static_cast<uint8_t>(v >> 16),
+                        static_cast<uint8_t>(v >> 24)};
+        file.write(reinterpret_cast<const char*>(b), 4);
+    };
+    auto write16 = [&](uint16_t v) {
+        uint8_t b[2] = {static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8)};
+        file.write(reinterpret_cast<const char*>(b), 2);
+    };
+
+    const int blockAlign = sizeof(short) * NULL_MIXER_CHANNELS;
+    uint32_t dataSize = static_cast<uint32_t>(numFrames * blockAlign);
+
+    file.write("RIFF", 4);
+    write32(36 + dataSize);
+    file.write("WAVE", 4);
+    file.write("fmt ", 4);
+    write32(16);
+    write16(1);
+    write16(NULL_MIXER_CHANNELS);
+    write32(samplerate);
+    write32(samplerate * blockAlign);
+    write16(blockAlign);
+    write16(sizeof(short) * 8);
+    file.write("data", 4);
+    write32(dataSize);
+}
+
+// ================================================================================================
+// NullMixer.
+
+NullMixer::NullMixer()
+    : mySource(nullptr),
+      myRenderedFrames(0),
+      myFileFrames(0),
+      myStats({0, 0.0, 0.0}),
+      myFrequency(0),
+      myIsOpened(false),
+      myIsPaused(true) {}
+
+NullMixer::~NullMixer() { close(); }
+
+bool NullMixer::open(MixSource* source, int samplerate) {
+    if (myIsOpened) close();
+
+    mySource = source;
+    myFrequency = samplerate;
+    myRenderedFrames = 0;
+    myStats = {0, 0.0, 0.0};
+    myIsOpened = true;
+    myIsPaused = true;
+
+    return true;
+}
+
+void NullMixer::close() {
+    finishOutputFile();
+
+    mySource = nullptr;
+    myIsOpened = false;
+    myIsPaused = true;
+}
+
+void NullMixer::pause() { myIsPaused = true; }
+
+void NullMixer::resume() {
+    if (myIsOpened) myIsPaused = false;
+}
+
+bool NullMixer::setOutputFile(const std::filesystem::path& path) {
+    finishOutputFile();
+
+    // The header is written again with the final size once the file is done.
+    myFile.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!myFile.good()) {
+        myFile.close();
+        return false;
+    }
+    myFileFrames = 0;
+    WriteWaveHeader(myFile, 0, myFrequency);
+
+    return true;
+}
+
+void NullMixer::finishOutputFile() {
+    if (!myFile.is_open()) return;
+
+    myFile.seekp(0);
+    WriteWaveHeader(myFile, myFileFrames, myFrequency);
+    myFile.close();
+}
+
+int NullMixer::render(int numFrames) {
+    myFrames.clear();
+    if (!myIsOpened || myIsPaused || numFrames <= 0) return 0;
+
+    myFrames.resize(static_cast<size_t>(numFrames) * NULL_MIXER_CHANNELS);
+    for (int pos = 0; pos < numFrames; pos += BLOCK_FRAMES) {
+        int n = std::min(BLOCK_FRAMES, numFrames - pos);
+        short* block = myFrames.data() + pos * NULL_MIXER_CHANNELS;
+
+        auto start = std::chrono::steady_clock::now();
+        mySource->writeFrames(block, n);
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        ++myStats.numCallbacks;
+        myStats.totalMicroseconds += elapsed.count();
+        myStats.maxMicroseconds =
+            std::max(myStats.maxMicroseconds, elapsed.count());
+    }
+
+    // Samples are written in little-endian order, which is the native order
+    // on all supported platforms.
+    if (myFile.is_open()) {
+        myFile.write(reinterpret_cast<const char*>(myFrames.data()),
+                     myFrames.size() * sizeof(short));
+        myFileFrames += numFrames;
+    }
+
+    myRenderedFrames += numFrames;
+    return numFrames;
+}
+
+double NullMixer::getTime() const {
+    if (myFrequency <= 0) return 0.0;
+    return static_cast<double>(myRenderedFrames) / myFrequency;
+}
+
+// On platforms without an audio device backend, the mixer is silent.
+#ifndef _WIN32
+Mixer* Mixer::create() { return new NullMixer; }
+#endif
+
+};  // namespace Vortex
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <System/Mixer.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace Vortex {
+
+/// Mixer without an audio device, for offline rendering and benchmarks. Frames
+/// are only mixed when "render" is called, on the calling thread, so the clock
+/// of the mixer is the number of rendered frames and the output never depends
+/// on timing. Rendered frames can be written to a 16-bit stereo wav file.
+class NullMixer : public Mixer {
+   public:
+    /// Maximum number of frames written by the mix source at once, which
+    /// matches the block size of the audio device.
+    static const int BLOCK_FRAMES = 2048;
+
+    /// Time spent in the "writeFrames" callback of the mix source.
+    struct Stats {
+        int64_t numCallbacks;
+        double totalMicroseconds;
+        double maxMicroseconds;
+    };
+
+    NullMixer();
+    ~NullMixer() override;
+
+    bool open(MixSource* source, int samplerate) override;
+    void close() override;
+    void pause() override;
+    void resume() override;
+
+    /// Writes all frames rendered from now on to a wav file, which is
+    /// completed when the mixer is closed. Returns false if the file could
+    /// not be created.
+    bool setOutputFile(const std::filesystem::path& path);
+
+    /// Mixes frames from the mix source in blocks of at most BLOCK_FRAMES,
+    /// and advances the clock. Nothing is mixed while the mixer is paused.
+    /// Returns the number of frames that were rendered.
+    int render(int numFrames);
+
+    /// Returns the frames that were rendered by the last call to "render",
+    /// as interleaved stereo samples.
+    const std::vector<short>& getFrames() const { return myFrames; }
+
+    /// Returns the number of frames rendered since the mixer was opened.
+    int64_t getRenderedFrames() const { return myRenderedFrames; }
+
+    /// Returns the time of the virtual clock in seconds, which is the number
+    /// of rendered frames divided by the samplerate.
+    double getTime() const;
+
+    /// Returns the callback timings since the mixer was opened.
+    const Stats& getStats() const { return myStats; }
+
+   private:
+    void finishOutputFile();
+
+    MixSource* mySource;
+    std::ofstream myFile;
+    std::vector<short> myFrames;
+    int64_t myRenderedFrames;
+    int64_t myFileFrames;
+    Stats myStats;
+    int myFrequency;
+    bool myIsOpened;
+    bool myIsPaused;
+};
+
+};  // namespace Vortex
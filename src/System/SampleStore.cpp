@@ -0,0 +1,109 @@
+#include <System/SampleStore.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace Vortex {
+
+// Reservations are halved until they succeed, down to this many samples.
+static const int MIN_RESERVED_FRAMES = SampleStore::CHUNK_FRAMES;
+
+// ================================================================================================
+// Platform functions.
+
+#ifdef _WIN32
+
+static void* ReserveMemory(size_t bytes) {
+    return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+static bool CommitMemory(void* ptr, size_t bytes) {
+    return VirtualAlloc(ptr, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+static void ReleaseMemory(void* ptr, size_t bytes) {
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#else
+
+static void* ReserveMemory(size_t bytes) {
+    void* ptr = mmap(nullptr, bytes, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+static bool CommitMemory(void* ptr, size_t bytes) {
+    return mprotect(ptr, bytes, PROT_READ | PROT_WRITE) == 0;
+}
+
+static void ReleaseMemory(void* ptr, size_t bytes) { munmap(ptr, bytes); }
+
+#endif
+
+static size_t ToBytes(int frames) {
+    return static_cast<size_t>(frames) * sizeof(short);
+}
+
+// ================================================================================================
+// SampleStore.
+
+SampleStore::SampleStore()
+    : myData(nullptr), myReservedFrames(0), myCommittedFrames(0) {}
+
+SampleStore::~SampleStore() { release(); }
+
+bool SampleStore::reserve(int maxFrames) {
+    release();
+
+    // The reserved range is a whole number of chunks, which are a multiple of
+    // the page size on all supported platforms.
+    int64_t chunks = (static_cast<int64_t>(maxFrames) + CHUNK_FRAMES - 1) /
+                     CHUNK_FRAMES;
+    int64_t frames = std::min<int64_t>(chunks * CHUNK_FRAMES, INT32_MAX);
+    frames -= frames % CHUNK_FRAMES;
+
+    for (; frames >= MIN_RESERVED_FRAMES; frames /= 2) {
+        void* ptr = ReserveMemory(ToBytes(static_cast<int>(frames)));
+        if (ptr) {
+            myData = static_cast<short*>(ptr);
+            myReservedFrames = static_cast<int>(frames);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SampleStore::grow(int numFrames) {
+    if (numFrames <= myCommittedFrames) return true;
+    if (numFrames > myReservedFrames) return false;
+
+    int64_t target = (static_cast<int64_t>(numFrames) + CHUNK_FRAMES - 1) /
+                     CHUNK_FRAMES * CHUNK_FRAMES;
+    int end = static_cast<int>(std::min<int64_t>(target, myReservedFrames));
+
+    if (!CommitMemory(myData + myCommittedFrames,
+                      ToBytes(end - myCommittedFrames))) {
+        return false;
+    }
+
+    myCommittedFrames = end;
+    return true;
+}
+
+void SampleStore::release() {
+    if (myData) ReleaseMemory(myData, ToBytes(myReservedFrames));
+    myData = nullptr;
+    myReservedFrames = 0;
+    myCommittedFrames = 0;
+}
+
+};  // namespace Vortex
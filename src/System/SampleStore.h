@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Vortex {
+
+/// Growable storage for the samples of a single audio channel. A contiguous
+/// range of address space is reserved up front, and page-aligned chunks of it
+/// are committed as the signal grows. Growing never moves or copies samples,
+/// so they can always be read as a plain array, and the memory in use stays
+/// close to the size of the samples themselves. Committed samples start out
+/// as zero.
+class SampleStore {
+   public:
+    /// Number of samples committed at once.
+    static const int CHUNK_FRAMES = 1 << 18;
+
+    SampleStore();
+    ~SampleStore();
+
+    SampleStore(const SampleStore&) = delete;
+    SampleStore& operator=(const SampleStore&) = delete;
+
+    /// Releases any previous storage, and reserves address space for up to
+    /// the given number of samples. If that much address space is not
+    /// available, a smaller range is reserved. Returns false if nothing could
+    /// be reserved.
+    bool reserve(int maxFrames);
+
+    /// Commits memory for at least the given number of samples. Returns false
+    /// if the reserved range is too small or the memory could not be
+    /// committed, in which case the store is left unchanged.
+    bool grow(int numFrames);
+
+    /// Releases the reserved and committed memory.
+    void release();
+
+    /// Returns the first sample of the store.
+    short* data() { return myData; }
+    const short* data() const { return myData; }
+
+    /// Returns the number of samples that can be stored without growing.
+    int capacity() const { return myCommittedFrames; }
+
+    /// Returns the number of samples the store can grow to.
+    int maxCapacity() const { return myReservedFrames; }
+
+   private:
+    short* myData;
+    int myReservedFrames;
+    int myCommittedFrames;
+};
+
+};  // namespace Vortex
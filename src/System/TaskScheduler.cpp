@@ -0,0 +1,292 @@
+#include <System/TaskScheduler.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Vortex {
+
+static const int NUM_PRIORITIES = 3;
+
+// Index of the worker that runs on the calling thread, or -1 for other threads.
+static thread_local int tWorkerIndex = -1;
+
+// Priority of the task that runs on the calling thread.
+static thread_local TaskPriority tCurrentPriority = TaskPriority::Interactive;
+
+// Scopes that the task running on the calling thread opened.
+static thread_local void* tScopes[(int)TaskScope::Count] = {};
+
+// ================================================================================================
+// TaskPool
+
+// The queued tasks of one worker, or the shared tasks of the other threads, per priority.
+struct TaskQueue {
+    std::mutex mutex;
+    std::deque<TaskHandle> tasks[NUM_PRIORITIES];
+};
+
+struct TaskPool {
+    TaskPool(int numWorkers);
+    ~TaskPool();
+
+    void push(TaskHandle task);
+    TaskHandle pop(TaskPriority leastUrgent);
+    bool runOne(TaskPriority leastUrgent);
+    void workerLoop(int index);
+
+    // One queue per worker, followed by the shared queue.
+    std::vector<std::unique_ptr<TaskQueue>> myQueues;
+    std::vector<std::thread> myThreads;
+
+    std::mutex mySleepMutex;
+    std::condition_variable myWakeup;
+    std::atomic<int> myNumQueued;
+    bool myQuit;
+
+    std::mutex myMainThreadMutex;
+    std::vector<std::function<void()>> myMainThreadTasks;
+};
+
+static TaskPool& GetPool() {
+    static TaskPool pool(std::clamp<int>(std::thread::hardware_concurrency(), 1, 16));
+    return pool;
+}
+
+TaskPool::TaskPool(int numWorkers) : myNumQueued(0), myQuit(false) {
+    for (int i = 0; i <= numWorkers; ++i) {
+        myQueues.emplace_back(new TaskQueue);
+    }
+    for (int i = 0; i < numWorkers; ++i) {
+        myThreads.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(mySleepMutex);
+        myQuit = true;
+    }
+    myWakeup.notify_all();
+    for (auto& thread : myThreads) thread.join();
+}
+
+void TaskPool::push(TaskHandle task) {
+    int index = (tWorkerIndex >= 0) ? tWorkerIndex : (int)myQueues.size() - 1;
+    TaskQueue& queue = *myQueues[index];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks[(int)task->getPriority()].push_back(task);
+    }
+    myNumQueued.fetch_add(1);
+
+    // Taking the lock orders the push before the check of a worker that is
+    // about to sleep, so the wakeup is never lost.
+    { std::lock_guard<std::mutex> lock(mySleepMutex); }
+    myWakeup.notify_one();
+}
+
+TaskHandle TaskPool::pop(TaskPriority leastUrgent) {
+    int numQueues = (int)myQueues.size();
+    int self = tWorkerIndex;
+    for (int p = 0; p <= (int)leastUrgent; ++p) {
+        // A worker takes its own newest task first, which is the one that is
+        // most likely to be in its cache. Other queues are visited starting
+        // with the shared queue, and their oldest tasks are stolen.
+        if (self >= 0) {
+            TaskQueue& queue = *myQueues[self];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            auto& tasks = queue.tasks[p];
+            if (!tasks.empty()) {
+                TaskHandle task = std::move(tasks.back());
+                tasks.pop_back();
+                myNumQueued.fetch_sub(1);
+                return task;
+            }
+        }
+        int numWorkers = numQueues - 1;
+        for (int i = 0; i < numQueues; ++i) {
+            int index = (i == 0) ? numWorkers : (self + i) % numWorkers;
+            if (index == self) continue;
+            TaskQueue& queue = *myQueues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            auto& tasks = queue.tasks[p];
+            if (!tasks.empty()) {
+                TaskHandle task = std::move(tasks.front());
+                tasks.pop_front();
+                myNumQueued.fetch_sub(1);
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool TaskPool::runOne(TaskPriority leastUrgent) {
+    TaskHandle task = pop(leastUrgent);
+    if (!task) return false;
+
+    // Tasks that were cancelled or run by a waiting thread are left in the
+    // queues, and are skipped here.
+    task->claimAndRun();
+    return true;
+}
+
+void TaskPool::workerLoop(int index) {
+    tWorkerIndex = index;
+    while (true) {
+        if (runOne(TaskPriority::Analysis)) continue;
+
+        std::unique_lock<std::mutex> lock(mySleepMutex);
+        myWakeup.wait(lock, [this] { return myQuit || myNumQueued.load() > 0; });
+        if (myQuit) return;
+    }
+}
+
+// ================================================================================================
+// Task
+
+Task::Task(TaskPriority priority, Work work)
+    : myWork(std::move(work)),
+      myPriority(priority),
+      myState(QUEUED),
+      myProgress(0.0f) {}
+
+void Task::cancel() {
+    myStopSource.request_stop();
+    int expected = QUEUED;
+    if (myState.compare_exchange_strong(expected, DONE)) {
+        myState.notify_all();
+    }
+}
+
+void Task::wait() {
+    if (claimAndRun()) return;
+
+    // The task is running on another thread. Workers keep running tasks that
+    // are at least as urgent in the meantime, so tasks that wait on each other
+    // can not use up all workers.
+    while (true) {
+        int state = myState.load();
+        if (state == DONE) return;
+        if (tWorkerIndex >= 0 && GetPool().runOne(myPriority)) continue;
+        myState.wait(state);
+    }
+}
+
+bool Task::isDone() const { return myState.load() == DONE; }
+
+std::stop_token Task::getStopToken() const { return myStopSource.get_token(); }
+
+TaskPriority Task::getPriority() const { return myPriority; }
+
+float Task::getProgress() const { return myProgress.load(); }
+
+void Task::setProgress(float progress) { myProgress.store(progress); }
+
+bool Task::claimAndRun() {
+    int expected = QUEUED;
+    if (!myState.compare_exchange_strong(expected, RUNNING)) return false;
+
+    // The thread can be waiting on another task, of which the scopes do not
+    // apply to this one.
+    void* scopes[(int)TaskScope::Count];
+    std::copy(std::begin(tScopes), std::end(tScopes), scopes);
+    std::fill(std::begin(tScopes), std::end(tScopes), nullptr);
+
+    TaskPriority previous = tCurrentPriority;
+    tCurrentPriority = myPriority;
+    myWork(*this);
+    tCurrentPriority = previous;
+
+    std::copy(std::begin(scopes), std::end(scopes), tScopes);
+
+    finish();
+    return true;
+}
+
+void Task::finish() {
+    // The work can refer to the stack of a thread that waits for it, so it is
+    // released before the waiting thread continues.
+    myWork = nullptr;
+    myState.store(DONE);
+    myState.notify_all();
+}
+
+// ================================================================================================
+// TaskScheduler
+
+int TaskScheduler::numWorkers() { return (int)GetPool().myThreads.size(); }
+
+TaskHandle TaskScheduler::submit(TaskPriority priority, Task::Work work) {
+    auto task = std::make_shared<Task>(priority, std::move(work));
+    GetPool().push(task);
+    return task;
+}
+
+void TaskScheduler::parallelFor(
+    int numItems, int numSlots,
+    const std::function<void(int item, int slot)>& work) {
+    parallelFor(numItems, numSlots, currentPriority(), work);
+}
+
+void TaskScheduler::parallelFor(
+    int numItems, int numSlots, TaskPriority priority,
+    const std::function<void(int item, int slot)>& work) {
+    numSlots = std::min({numSlots, numItems, numWorkers() + 1});
+    if (numSlots <= 0) return;
+
+    std::atomic<int> next(0);
+    auto runSlot = [&](int slot) {
+        for (int item = next.fetch_add(1); item < numItems;
+             item = next.fetch_add(1)) {
+            work(item, slot);
+        }
+    };
+
+    // The calling thread takes the first slot. Helpers that were not picked up
+    // by a worker before the items ran out are run inline by "wait", and
+    // return immediately.
+    std::vector<TaskHandle> helpers;
+    for (int slot = 1; slot < numSlots; ++slot) {
+        helpers.push_back(
+            submit(priority, [&runSlot, slot](Task&) { runSlot(slot); }));
+    }
+    TaskPriority previous = tCurrentPriority;
+    tCurrentPriority = priority;
+    runSlot(0);
+    tCurrentPriority = previous;
+    for (auto& helper : helpers) helper->wait();
+}
+
+TaskPriority TaskScheduler::currentPriority() { return tCurrentPriority; }
+
+void* TaskScheduler::getScope(TaskScope scope) { return tScopes[(int)scope]; }
+
+void TaskScheduler::setScope(TaskScope scope, void* value) {
+    tScopes[(int)scope] = value;
+}
+
+bool TaskScheduler::isWorkerThread() { return tWorkerIndex >= 0; }
+
+void TaskScheduler::postToMainThread(std::function<void()> function) {
+    TaskPool& pool = GetPool();
+    std::lock_guard<std::mutex> lock(pool.myMainThreadMutex);
+    pool.myMainThreadTasks.push_back(std::move(function));
+}
+
+void TaskScheduler::runMainThreadTasks() {
+    TaskPool& pool = GetPool();
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(pool.myMainThreadMutex);
+        tasks.swap(pool.myMainThreadTasks);
+    }
+    for (auto& task : tasks) task();
+}
+
+};  // namespace Vortex
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stop_token>
+
+namespace Vortex {
+
+/// Priority of a task. Idle workers always take the most urgent task that is queued.
+enum class TaskPriority {
+    Decode,       ///< Audio decoding, which most other work waits for.
+    Interactive,  ///< Work with results that are visible in the UI.
+    Analysis,     ///< Long running analysis, like BPM detection.
+};
+
+/// Scopes that the code running on a thread can open, like muting the Hud.
+/// They belong to the task that opened them: running a task clears them on
+/// its thread and restores them when the task returns, so the tasks that a
+/// worker runs while it waits for another task do not see the scopes of the
+/// task that is waiting.
+enum class TaskScope {
+    HudMute,         ///< The innermost HudMute of the thread.
+    FallbackStyles,  ///< The innermost FallbackStyleScope of the thread.
+    Count,
+};
+
+/// A unit of work that is run by the task scheduler. Handles to a task are
+/// shared by the scheduler and its owners, so a task can be waited on or
+/// cancelled until the last handle is released.
+class Task {
+   public:
+    typedef std::function<void(Task&)> Work;
+
+    Task(TaskPriority priority, Work work);
+
+    /// Requests the task to stop. A task that has not started yet is skipped;
+    /// a running task is responsible for testing its stop token and returning.
+    void cancel();
+
+    /// Waits until the task has finished or was skipped. A task that has not
+    /// been picked up by a worker yet is run on the calling thread instead.
+    /// Waiting workers run other queued tasks in the meantime.
+    void wait();
+
+    /// Returns true if the task has finished or was skipped.
+    bool isDone() const;
+
+    /// Returns the stop token that is signalled by "cancel".
+    std::stop_token getStopToken() const;
+
+    TaskPriority getPriority() const;
+
+    /// Progress of the task between zero and one, as reported by the task.
+    float getProgress() const;
+    void setProgress(float progress);
+
+   private:
+    friend struct TaskPool;
+
+    enum State { QUEUED, RUNNING, DONE };
+
+    // Runs the work if the task is still queued. Returns false otherwise.
+    bool claimAndRun();
+    void finish();
+
+    Work myWork;
+    TaskPriority myPriority;
+    std::stop_source myStopSource;
+    std::atomic<int> myState;
+    std::atomic<float> myProgress;
+};
+
+typedef std::shared_ptr<Task> TaskHandle;
+
+/// A process-wide pool of worker threads, one per hardware thread, that runs
+/// all background work of the editor. Each worker has its own queue of the
+/// tasks it submits, and idle workers steal from the queues of busy ones, so
+/// nested parallel work does not spawn extra threads.
+class TaskScheduler {
+   public:
+    /// Returns the number of worker threads.
+    static int numWorkers();
+
+    /// Queues a task. Tasks submitted by a worker go to the queue of that
+    /// worker; tasks from other threads go to a shared queue.
+    static TaskHandle submit(TaskPriority priority, Task::Work work);
+
+    /// Calls "work" for every item from zero up to numItems - 1, on at most
+    /// numSlots threads at the same time, including the calling thread. Each
+    /// call gets a slot index below numSlots that no concurrent call shares.
+    /// Returns when all items are done. The tasks inherit the priority of the
+    /// task that is running on the calling thread.
+    static void parallelFor(int numItems, int numSlots,
+                            const std::function<void(int item, int slot)>& work);
+
+    /// Like parallelFor above, but the items run at the given priority, also
+    /// on the calling thread. Used for bulk work that is started from the main
+    /// thread, which should not hold up interactive tasks.
+    static void parallelFor(int numItems, int numSlots, TaskPriority priority,
+                            const std::function<void(int item, int slot)>& work);
+
+    /// Returns the priority of the task that is running on the calling thread,
+    /// or Interactive if the thread is not running a task.
+    static TaskPriority currentPriority();
+
+    /// Returns the innermost scope of the given kind that the task running on
+    /// the calling thread opened, or null if there is none.
+    static void* getScope(TaskScope scope);
+
+    /// Sets the innermost scope of the given kind for the calling thread. The
+    /// scope is expected to restore the previous one when it closes.
+    static void setScope(TaskScope scope, void* value);
+
+    /// Returns true if the calling thread is one of the worker threads.
+    static bool isWorkerThread();
+
+    /// Queues a function that is called on the main thread, during the next
+    /// call to "runMainThreadTasks". Used to hand results back to the editor.
+    static void postToMainThread(std::function<void()> function);
+
+    /// Calls the functions that were posted to the main thread, in order.
+    /// Called by the editor once per frame.
+    static void runMainThreadTasks();
+};
+
+};  // namespace Vortex
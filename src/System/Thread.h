@@ -1,43 +1,61 @@
 #pragma once
 
 #include <Core/Core.h>
-#include <thread>
-#include <atomic>
+#include <System/TaskScheduler.h>
 
 namespace Vortex {
 
-/// A thread that performs a task, running in the background.
+/// A task that runs in the background, on the workers of the task scheduler.
 class BackgroundThread {
    public:
     virtual ~BackgroundThread();
 
-    BackgroundThread();
+    BackgroundThread(TaskPriority priority = TaskPriority::Analysis);
 
-    /// Creates a thread, which calls "exec" once, and then terminates. The
-    /// function returns when the thread is created; use "waitUntilDone" to wait
-    /// until the thread has terminated.
+    /// Submits a task, which calls "exec" once. The function returns when the
+    /// task is queued; use "waitUntilDone" to wait until the task is done.
     void start();
 
-    /// Sets the terminate flag and waits until the thread is terminated. The
-    /// terminate flag is only a request; The "exec" function is responsible for
-    /// testing the flag and returning.
+    /// Requests the task to stop and waits until it is done. The request is
+    /// only signalled through the stop token; The "exec" function is
+    /// responsible for testing the token and returning.
     void terminate();
 
-    /// Waits until the thread has terminated, after which the function returns.
+    /// Waits until the task is done, after which the function returns.
     void waitUntilDone();
 
     std::stop_token getStopToken();
 
-    /// Returns true if the thread has terminated, false if the thread is still
+    /// Returns true if the task is done, false if it is still queued or
     /// running.
     bool isDone() const;
 
-    /// The worker function called by the thread created in "start".
+    /// The worker function called by the task submitted in "start".
     virtual void exec() = 0;
 
    private:
-    std::jthread thread;
-    std::atomic_bool done;
+    TaskPriority priority;
+    TaskHandle task;
+};
+
+/// A set of threads that perform the same task, which is split into items.
+class ParallelThreads {
+   public:
+    virtual ~ParallelThreads();
+
+    ParallelThreads();
+
+    /// Returns the number of concurrent threads supported by the hardware.
+    static int concurrency();
+
+    /// Calls "exec" on up to numThreads threads concurrently, including the
+    /// calling thread, using the workers of the task scheduler. Once "exec" has
+    /// been called for every item from zero up to numItems - 1, the function
+    /// returns.
+    void run(int numItems, int numThreads = concurrency());
+
+    /// The worker function called by the threads in "run".
+    virtual void exec(int item, int thread) = 0;
 };
 
 };  // namespace Vortex
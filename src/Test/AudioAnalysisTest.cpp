@@ -0,0 +1,77 @@
+#include <Precomp.h>
+
+#include <Editor/AudioAnalysis.h>
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+void AnalyzeFrames(const short* samples, int numSamples, int sampleRate, int frameSize, int hopSize,
+	AnalysisFrames& out); // Defined in AudioAnalysis.cpp
+
+using namespace std;
+
+static const int RATE = 44100;
+static const int FRAME_SIZE = 2048;
+static const int HOP_SIZE = 512;
+
+// Returns the pitch class with the most energy in the given frame.
+static int StrongestPitchClass(const AnalysisFrames& frames, int frame)
+{
+	const float* chroma = frames.chromaAt(frame);
+	return (int)(max_element(chroma, chroma + AnalysisFrames::NUM_CHROMA) - chroma);
+}
+
+TestMethod(AnalysisFeaturesTest)
+{
+	// Half a second of silence, one second of A4, and one second of C5. The chroma of every frame
+	// inside a tone peaks at its pitch class, and the flux peaks where each tone starts.
+	vector<short> samples(RATE / 2, 0);
+	for(int i = 0; i < RATE * 2; ++i)
+	{
+		double freq = (i < RATE) ? 440.0 : 523.25;
+		samples.push_back((short)(12000.0 * sin(2.0 * M_PI * freq * i / RATE)));
+	}
+
+	AnalysisFrames frames;
+	AnalyzeFrames(samples.data(), (int)samples.size(), RATE, FRAME_SIZE, HOP_SIZE, frames);
+	Check(frames.numFrames == ((int)samples.size() - FRAME_SIZE) / HOP_SIZE + 1);
+	Check(frames.numBins == FRAME_SIZE / 2);
+
+	// Frames that lie entirely inside one of the tones.
+	int firstA = (RATE / 2) / HOP_SIZE + 1, lastA = (RATE * 3 / 2 - FRAME_SIZE) / HOP_SIZE;
+	int firstC = (RATE * 3 / 2) / HOP_SIZE + 1, lastC = frames.numFrames - 1;
+	int numWrongA = 0, numWrongC = 0, numSilentMfcc = 0;
+	for(int i = firstA; i <= lastA; ++i) numWrongA += (StrongestPitchClass(frames, i) != 9);
+	for(int i = firstC; i <= lastC; ++i) numWrongC += (StrongestPitchClass(frames, i) != 0);
+	for(int i = firstA; i <= lastC; ++i)
+	{
+		const float* mfcc = frames.mfccAt(i);
+		numSilentMfcc += all_of(mfcc, mfcc + AnalysisFrames::NUM_MFCC, [](float v) { return v == 0.0f; });
+	}
+	Check(numWrongA == 0);
+	Check(numWrongC == 0);
+	Check(numSilentMfcc == 0);
+
+	// The silence has no energy. The flux peaks in the frames that a tone fades into, and stays low
+	// while the tone holds.
+	Check(*max_element(frames.chromaAt(0), frames.chromaAt(0) + AnalysisFrames::NUM_CHROMA) == 0.0f);
+	Check(frames.flux[0] == 0.0f);
+	auto flux = frames.flux.begin();
+	int peakA = (int)(max_element(flux, flux + lastA + 1) - flux);
+	int peakC = (int)(max_element(flux + lastA + 1, frames.flux.end()) - flux);
+	double frameLength = (double)FRAME_SIZE / RATE;
+	Check(frames.frameToTime(peakA) > 0.5 - frameLength && frames.frameToTime(peakA) < 0.5);
+	Check(frames.frameToTime(peakC) > 1.5 - frameLength && frames.frameToTime(peakC) < 1.5);
+	Check(*max_element(flux + firstA + 1, flux + lastA + 1) < flux[peakA] * 0.05f);
+	Check(*max_element(flux + firstC + 1, frames.flux.end()) < flux[peakC] * 0.05f);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,101 @@
+#include <Precomp.h>
+
+#include <Editor/Sound.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+SoundSource* LoadOgg(std::ifstream&& file, std::string& title, std::string& artist);
+SoundSource* LoadMP3(std::ifstream&& file, std::string& title, std::string& artist);
+
+// Short songs that are long enough to be decoded in several segments, and a few that are decoded
+// in one, in stereo and mono. Every file in this directory is used to check that the decoders
+// produce the same samples on every decoding path.
+static const char* TEST_AUDIO_DIR = "test/audio";
+
+typedef SoundSource* (*LoadFunction)(std::ifstream&&, std::string&, std::string&);
+
+static SoundSource* OpenSource(const fs::path& path, LoadFunction load)
+{
+	std::string title, artist;
+	return load(std::ifstream(path, std::ios::in | std::ios::binary), title, artist);
+}
+
+static void ReadSerial(SoundSource* source, vector<short>& outL, vector<short>& outR)
+{
+	int numChannels = source->getNumChannels();
+	vector<short> buffer(1024 * numChannels);
+	while(true)
+	{
+		int numFrames = source->readFrames(1024, buffer.data());
+		if(numFrames <= 0) break;
+		for(int i = 0; i < numFrames; ++i)
+		{
+			outL.push_back(buffer[i * numChannels]);
+			outR.push_back(buffer[i * numChannels + numChannels - 1]);
+		}
+	}
+}
+
+static void CheckParallelDecode(const char* extension, LoadFunction load)
+{
+	int numFiles = 0;
+	std::error_code ec;
+	for(auto& entry : fs::directory_iterator(TEST_AUDIO_DIR, ec))
+	{
+		if(entry.path().extension() != extension) continue;
+		++numFiles;
+
+		unique_ptr<SoundSource> serial(OpenSource(entry.path(), load));
+		unique_ptr<SoundSource> parallel(OpenSource(entry.path(), load));
+		Check(serial && parallel);
+		if(!serial || !parallel) continue;
+
+		// Preparing a source does not change what the serial decoder reads.
+		vector<short> serialL, serialR;
+		serial->prepare();
+		ReadSerial(serial.get(), serialL, serialR);
+
+		parallel->prepare();
+		int numFrames = parallel->getNumFrames();
+		Check(numFrames == (int)serialL.size());
+
+		// The reported frames only grow, and end at the length of the signal.
+		vector<int> reported;
+		auto progress = [&](int frames) { reported.push_back(frames); };
+
+		vector<short> parallelL(numFrames), parallelR(numFrames);
+		Check(parallel->readAllFrames(parallelL.data(), parallelR.data(), std::stop_token(), progress));
+		Check(parallelL == serialL);
+		Check(parallelR == serialR);
+		Check(!reported.empty() && reported.back() == numFrames);
+		Check(is_sorted(reported.begin(), reported.end()) &&
+			adjacent_find(reported.begin(), reported.end()) == reported.end());
+	}
+
+	// A missing test directory would otherwise pass without decoding anything.
+	Check(numFiles > 0);
+}
+
+TestMethod(ParallelMp3DecodeTest)
+{
+	CheckParallelDecode(".mp3", LoadMP3);
+}
+
+TestMethod(ParallelOggDecodeTest)
+{
+	CheckParallelDecode(".ogg", LoadOgg);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,172 @@
+#include <Precomp.h>
+
+#include <Editor/BeatTracker.h>
+#include <Editor/AudioAnalysis.h>
+#include <Editor/FFT.h>
+
+#include <Simfile/Tempo.h>
+
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+// Tempo in BPM at the given time; drifts slowly around 120 BPM, like a band without a click track.
+static double DriftingTempo(double seconds)
+{
+	return 120.0 + 6.0 * sin(seconds * 2.0 * M_PI / 40.0);
+}
+
+static double SteadyTempo(double)
+{
+	return 128.37;
+}
+
+// Drum hits on beats that follow the given tempo curve, starting one second in, with accented
+// downbeats and quieter, shorter hits on the offbeats. Returns the true beat times.
+static vector<double> MakeDrumTrack(vector<float>& out, int samplerate, double seconds, double (*tempo)(double))
+{
+	SyntheticDrums drums(samplerate, seconds, 1);
+	drums.addPad(110.0, 0.05f);
+
+	vector<double> beats;
+	for(double time = 1.0; time < seconds - 1.0; time += 60.0 / tempo(time))
+	{
+		beats.push_back(time);
+	}
+	for(int beat = 0; beat < (int)beats.size(); ++beat)
+	{
+		int begin = (int)(beats[beat] * samplerate + 0.5);
+		drums.addNoise(begin, samplerate / 10, (beat % 4 == 0) ? 0.8f : 0.5f, 40.0);
+
+		int offbeat = begin + (int)(samplerate * 30.0 / tempo(beats[beat]));
+		drums.addNoise(offbeat, samplerate / 20, 0.15f, 120.0);
+	}
+	out.swap(drums.samples);
+	return beats;
+}
+
+// Returns the largest distance between a true beat and the nearest of the given beats.
+static double LargestBeatError(const vector<double>& expected, const vector<double>& actual)
+{
+	double largest = 0.0;
+	for(double beat : expected)
+	{
+		auto it = lower_bound(actual.begin(), actual.end(), beat);
+		double nearest = 1e9;
+		if(it != actual.end()) nearest = *it - beat;
+		if(it != actual.begin()) nearest = min(nearest, beat - *(it - 1));
+		largest = max(largest, nearest);
+	}
+	return largest;
+}
+
+// Returns the times of the whole beats of a tempo from TrackBeats, up to the given time.
+static vector<double> TempoBeats(const TrackedTempo& tempo, double seconds)
+{
+	vector<double> out;
+	double time = -tempo.offset;
+	for(int i = 0; i < (int)tempo.bpms.size(); ++i)
+	{
+		int beginBeat = tempo.bpms[i].row / ROWS_PER_BEAT;
+		int endBeat = (i + 1 < (int)tempo.bpms.size()) ? tempo.bpms[i + 1].row / ROWS_PER_BEAT : INT_MAX;
+		for(int beat = beginBeat; beat < endBeat && time < seconds; ++beat)
+		{
+			out.push_back(time);
+			time += 60.0 / tempo.bpms[i].bpm;
+		}
+	}
+	return out;
+}
+
+TestMethod(BeatTrackerSteadyTest)
+{
+	// A steady drum loop gets a single BPM value, with every beat on a hit.
+	const int samplerate = 44100;
+	vector<float> samples;
+	vector<double> expected = MakeDrumTrack(samples, samplerate, 60.0, SteadyTempo);
+
+	AnalysisFrames frames;
+	AnalyzeSamples(samples, samplerate, frames);
+	vector<double> beats;
+	TrackBeats(frames, beats);
+	Check(beats.size() == expected.size());
+	Check(LargestBeatError(expected, beats) < 0.010);
+
+	TrackedTempo tempo;
+	FitTempoToBeats(beats, BEAT_TOLERANCE, tempo);
+	Check(tempo.bpms.size() == 1);
+	Check(fabs(tempo.bpms[0].bpm - SteadyTempo(0)) < 0.01);
+	Check(LargestBeatError(expected, TempoBeats(tempo, 60.0)) < 0.015);
+}
+
+TestMethod(BeatTrackerDriftTest)
+{
+	// The tracker follows a tempo that drifts by five percent, and the BPM changes that are fitted
+	// to the tracked beats keep every beat close to a hit.
+	const int samplerate = 44100;
+	vector<float> samples;
+	vector<double> expected = MakeDrumTrack(samples, samplerate, 120.0, DriftingTempo);
+
+	AnalysisFrames frames;
+	AnalyzeSamples(samples, samplerate, frames);
+	vector<double> beats;
+	TrackBeats(frames, beats);
+	Check(beats.size() == expected.size());
+	Check(LargestBeatError(expected, beats) < 0.010);
+
+	TrackedTempo tempo;
+	FitTempoToBeats(beats, BEAT_TOLERANCE, tempo);
+	Check(tempo.bpms.size() > 1 && tempo.bpms.size() < beats.size() / 2);
+	Check(LargestBeatError(expected, TempoBeats(tempo, 120.0)) < 0.020);
+}
+
+TestMethod(FitTempoToBeatsTest)
+{
+	// A tempo change in the middle of otherwise steady beats gives exactly two BPM changes.
+	vector<double> beats;
+	double time = 2.3;
+	for(int i = 0; i < 64; ++i)
+	{
+		beats.push_back(time + ((i * 7) % 5 - 2) * 0.001);
+		time += (i < 32) ? 0.6 : 0.4;
+	}
+
+	TrackedTempo tempo;
+	FitTempoToBeats(beats, BEAT_TOLERANCE, tempo);
+	Check(tempo.bpms.size() == 2);
+	Check(fabs(tempo.bpms[0].bpm - 100.0) < 0.05 && tempo.bpms[0].row == 0);
+	Check(fabs(tempo.bpms[1].bpm - 150.0) < 0.05 && tempo.bpms[1].row == (3 + 32) * ROWS_PER_BEAT);
+	Check(fabs(tempo.offset + 0.5) < 0.005);
+
+	// Fewer than two beats have no tempo.
+	FitTempoToBeats(vector<double>(1, 1.0), BEAT_TOLERANCE, tempo);
+	Check(tempo.bpms.empty());
+}
+
+BenchmarkMethod(BeatTrackerBenchmark)
+{
+	using Clock = chrono::high_resolution_clock;
+	const int samplerate = 44100;
+	vector<float> samples;
+	MakeDrumTrack(samples, samplerate, 300.0, DriftingTempo);
+	AnalysisFrames frames;
+	AnalyzeSamples(samples, samplerate, frames);
+
+	vector<double> beats;
+	auto start = Clock::now();
+	TrackBeats(frames, beats);
+	double seconds = chrono::duration<double>(Clock::now() - start).count();
+	Report("%.1f ms for 5 minutes of audio", seconds * 1000.0);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
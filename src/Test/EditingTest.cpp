@@ -0,0 +1,48 @@
+#include <Precomp.h>
+
+#include <Simfile/Common.h>
+#include <Simfile/Notes.h>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+Note PlacedNote(int col, int player, int startRow, int endRow); // Defined in Editing.cpp
+
+using namespace std;
+
+// Leaves a recognizable pattern on the stack where the next call puts its locals.
+static void DirtyStack()
+{
+	volatile uint32_t garbage[64];
+	for(auto& v : garbage) v = 0xDEADBEEF;
+}
+
+TestMethod(PlacedNoteKeysoundTest)
+{
+	// Notes placed in the editor have no keysound, whatever was on the stack before.
+	int numWrong = 0;
+	for(int col = 0; col < 8; ++col)
+	{
+		DirtyStack();
+		Note tap = PlacedNote(col, col % 2, 96, 96);
+		DirtyStack();
+		Note hold = PlacedNote(col, col % 2, 240, 48);
+		numWrong += (tap.keysound != 0) + (hold.keysound != 0);
+		numWrong += (hold.row != 48 || hold.endrow != 240 || (int)hold.col != col);
+	}
+	Check(numWrong == 0);
+
+	// The same goes for notes that are built field by field, like the ones added from Lua.
+	DirtyStack();
+	Note note;
+	note.row = note.endrow = 0;
+	Check(note.keysound == 0);
+	ExpandedNote expanded;
+	Check(expanded.keysound == 0);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,219 @@
+#include <Precomp.h>
+
+#include <Editor/FFT.h>
+
+#include <System/CpuFeatures.h>
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+// The Ooura real DFT that rdft replaced, in OouraFFT.cpp.
+namespace Ooura {
+void rdft(int n, int isgn, float* a, int* ip, float* w);
+};
+
+static const char* LEVEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+static void MakeSignal(vector<float>& out, int numSamples)
+{
+	out.resize(numSamples);
+	for(auto& s : out) s = (float)(rand() % 20001 - 10000) / 10000.0f;
+}
+
+// Direct evaluation of the DFT in double precision, as (real, imaginary) pairs of bins 0 to n/2.
+static vector<double> ReferenceDFT(const float* in, int n)
+{
+	vector<double> out(n + 2);
+	for(int k = 0; k <= n / 2; ++k)
+	{
+		double re = 0.0, im = 0.0;
+		for(int j = 0; j < n; ++j)
+		{
+			double angle = 2.0 * M_PI * (double)((long long)j * k % n) / n;
+			re += in[j] * cos(angle);
+			im -= in[j] * sin(angle);
+		}
+		out[k * 2 + 0] = re;
+		out[k * 2 + 1] = im;
+	}
+	return out;
+}
+
+// Largest difference relative to the norm of the expected spectrum.
+template <typename T>
+static double RelativeError(const float* actual, const T* expected, int count)
+{
+	double maxDiff = 0.0, norm = 0.0;
+	for(int i = 0; i < count; ++i)
+	{
+		maxDiff = max(maxDiff, fabs(actual[i] - (double)expected[i]));
+		norm += (double)expected[i] * expected[i];
+	}
+	return maxDiff / max(sqrt(norm / count), 1e-9);
+}
+
+TestMethod(FFTForwardTest)
+{
+	// Single frames and batches match the direct DFT at every level, including batches that do not
+	// fill every lane.
+	for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+	{
+		CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+		if(CpuFeatures::getLevel() != level) continue;
+
+		for(int size = 2; size <= 2048; size *= 2)
+		{
+			const RealFFT& fft = RealFFT::get(size);
+			const int numFrames = 11, hop = size / 2 + 1;
+
+			vector<float> signal, single(size + 2), batch((size + 2) * numFrames);
+			MakeSignal(signal, hop * (numFrames - 1) + size);
+			fft.forward(signal.data(), hop, batch.data(), size + 2, numFrames);
+
+			bool matches = true;
+			for(int f = 0; f < numFrames; ++f)
+			{
+				const float* frame = signal.data() + f * hop;
+				vector<double> expected = ReferenceDFT(frame, size);
+				fft.forward(frame, single.data());
+				matches &= RelativeError(single.data(), expected.data(), size + 2) < 1e-5;
+				matches &= RelativeError(batch.data() + f * (size + 2), expected.data(), size + 2) < 1e-5;
+			}
+			Check(matches);
+		}
+	}
+	CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+}
+
+TestMethod(FFTInverseTest)
+{
+	// The inverse of the spectrum is the frame, multiplied by the size.
+	for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+	{
+		CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+		if(CpuFeatures::getLevel() != level) continue;
+
+		for(int size = 2; size <= 8192; size *= 2)
+		{
+			const RealFFT& fft = RealFFT::get(size);
+			vector<float> signal, spectrum(size + 2), result(size);
+			MakeSignal(signal, size);
+			fft.forward(signal.data(), spectrum.data());
+			fft.inverse(spectrum.data(), result.data());
+			for(float& v : result) v /= size;
+			Check(RelativeError(result.data(), signal.data(), size) < 1e-5);
+		}
+	}
+	CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+}
+
+TestMethod(FFTOouraLayoutTest)
+{
+	// The rdft replacement keeps the packing, signs and inverse scale of the Ooura routine.
+	for(int n : {4, 16, 512})
+	{
+		vector<float> signal;
+		MakeSignal(signal, n);
+		vector<double> dft = ReferenceDFT(signal.data(), n);
+
+		vector<double> expected(n);
+		expected[0] = dft[0];
+		expected[1] = dft[n];
+		for(int k = 1; k < n / 2; ++k)
+		{
+			expected[k * 2 + 0] = dft[k * 2 + 0];
+			expected[k * 2 + 1] = -dft[k * 2 + 1];
+		}
+
+		vector<float> a = signal;
+		vector<int> ip(n / 2 + 1, 0);
+		vector<float> w(n / 2 + 1);
+		rdft(n, 1, a.data(), ip.data(), w.data());
+		Check(RelativeError(a.data(), expected.data(), n) < 1e-5);
+
+		rdft(n, -1, a.data(), ip.data(), w.data());
+		for(float& v : a) v *= 2.0f / n;
+		Check(RelativeError(a.data(), signal.data(), n) < 1e-5);
+
+		// The output matches the Ooura routine that it replaced.
+		vector<float> b = signal;
+		ip[0] = 0;
+		Ooura::rdft(n, 1, b.data(), ip.data(), w.data());
+		a = signal;
+		rdft(n, 1, a.data(), ip.data(), w.data());
+		Check(RelativeError(a.data(), b.data(), n) < 1e-5);
+	}
+}
+
+BenchmarkMethod(FFTBenchmark)
+{
+	// Frames per second of the Ooura routine, and of single frame calls and batches for every level.
+	using Clock = chrono::high_resolution_clock;
+	const int samplesPerRun = 1 << 22;
+	for(int size = 512; size <= 8192; size *= 2)
+	{
+		const RealFFT& fft = RealFFT::get(size);
+		const int numFrames = samplesPerRun / size;
+		vector<float> signal, spectra((size_t)(size + 2) * numFrames);
+		MakeSignal(signal, samplesPerRun);
+
+		// The Ooura routine transforms in place, so every run starts from a copy of the signal.
+		vector<int> ip(size / 2 + 1, 0);
+		vector<float> w(size / 2 + 1), frames;
+		double ooura = 1e9;
+		for(int run = 0; run < 3; ++run)
+		{
+			frames = signal;
+			auto start = Clock::now();
+			for(int f = 0; f < numFrames; ++f)
+			{
+				Ooura::rdft(size, 1, frames.data() + (size_t)f * size, ip.data(), w.data());
+			}
+			ooura = min(ooura, chrono::duration<double>(Clock::now() - start).count());
+		}
+
+		char line[256];
+		int length = snprintf(line, sizeof(line), "size %i: ooura %.0f", size, numFrames / ooura);
+		for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+		{
+			CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+			if(CpuFeatures::getLevel() != level) continue;
+
+			// Best of three runs, which is the least disturbed by other processes.
+			double single = 1e9, batch = 1e9;
+			for(int run = 0; run < 3; ++run)
+			{
+				auto start = Clock::now();
+				for(int f = 0; f < numFrames; ++f)
+				{
+					fft.forward(signal.data() + (size_t)f * size, spectra.data() + (size_t)f * (size + 2));
+				}
+				single = min(single, chrono::duration<double>(Clock::now() - start).count());
+
+				start = Clock::now();
+				fft.forward(signal.data(), size, spectra.data(), size + 2, numFrames);
+				batch = min(batch, chrono::duration<double>(Clock::now() - start).count());
+			}
+
+			length += snprintf(line + length, sizeof(line) - length, " %s %.0f/%.0f (%.2fx)",
+				LEVEL_NAMES[level], numFrames / single, numFrames / batch, ooura / single);
+		}
+		Report("%s", line);
+	}
+	Report("(frames per second, single/batch, and single frame speed relative to ooura)");
+	CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,116 @@
+#include <Precomp.h>
+
+#include <Editor/FindOffset.h>
+#include <Editor/BeatTracker.h>
+#include <Editor/AudioAnalysis.h>
+#include <Editor/FFT.h>
+
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+// Drum hits on a random selection of the eighth notes of a steady tempo, starting one second in,
+// with quiet hi-hats on the sixteenth notes in between. Returns the times of the drum hits, which
+// are the notes that a chart for the music would have.
+static vector<double> MakeDrumTrack(vector<float>& out, int samplerate, double seconds, double bpm)
+{
+	SyntheticDrums drums(samplerate, seconds, 7);
+	drums.addPad(110.0, 0.05f);
+
+	vector<double> notes;
+	double step = 15.0 / bpm;
+	for(int i = 0; 1.0 + i * step < seconds - 1.0; ++i)
+	{
+		double time = 1.0 + i * step;
+		bool hit = (i % 2 == 0) && (i % 8 == 0 || drums.random() % 2 == 0);
+		int begin = (int)(time * samplerate + 0.5);
+		if(hit)
+		{
+			drums.addNoise(begin, samplerate / 10, 0.6f, 40.0);
+			notes.push_back(time);
+		}
+		else
+		{
+			drums.addNoise(begin, samplerate / 40, 0.1f, 160.0);
+		}
+	}
+	out.swap(drums.samples);
+	return notes;
+}
+
+static vector<double> ShiftNotes(const vector<double>& notes, double seconds)
+{
+	vector<double> out(notes);
+	for(double& time : out) time += seconds;
+	return out;
+}
+
+TestMethod(FindOffsetShiftTest)
+{
+	// Notes that are early or late by less than the search range are moved back onto the hits,
+	// with an error well below a millisecond.
+	const int samplerate = 44100;
+	vector<float> samples;
+	vector<double> notes = MakeDrumTrack(samples, samplerate, 60.0, 150.0);
+	AnalysisFrames frames;
+	AnalyzeSamples(samples, samplerate, frames);
+
+	const double shifts[] = {-0.2, -0.0373, 0.0, 0.0061, 0.1234};
+	for(double shift : shifts)
+	{
+		OffsetResult result;
+		FindOffset(frames, ShiftNotes(notes, -shift), OFFSET_SEARCH_RANGE, result);
+		Check(fabs(result.shift - shift) < 0.0005);
+		Check(result.confidence > 0.1);
+	}
+
+	// Without notes, there is nothing to line up.
+	OffsetResult result;
+	FindOffset(frames, vector<double>(), OFFSET_SEARCH_RANGE, result);
+	Check(result.shift == 0.0 && result.confidence == 0.0);
+}
+
+TestMethod(FindOffsetConfidenceTest)
+{
+	// Notes that have nothing to do with the music line up about as well at any shift, so they get
+	// a low confidence.
+	const int samplerate = 44100;
+	vector<float> samples;
+	MakeDrumTrack(samples, samplerate, 60.0, 150.0);
+	AnalysisFrames frames;
+	AnalyzeSamples(samples, samplerate, frames);
+
+	vector<double> notes;
+	for(double time = 1.0; time < 59.0; time += 0.37) notes.push_back(time);
+	OffsetResult result;
+	FindOffset(frames, notes, OFFSET_SEARCH_RANGE, result);
+	Check(result.confidence < 0.05);
+}
+
+BenchmarkMethod(FindOffsetBenchmark)
+{
+	using Clock = chrono::high_resolution_clock;
+	const int samplerate = 44100;
+	vector<float> samples;
+	vector<double> notes = MakeDrumTrack(samples, samplerate, 300.0, 150.0);
+	AnalysisFrames frames;
+	AnalyzeSamples(samples, samplerate, frames);
+
+	OffsetResult result;
+	auto start = Clock::now();
+	FindOffset(frames, ShiftNotes(notes, 0.05), OFFSET_SEARCH_RANGE, result);
+	double seconds = chrono::duration<double>(Clock::now() - start).count();
+	Report("%.1f ms for 5 minutes of audio, after the audio analysis", seconds * 1000.0);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,84 @@
+#include <Precomp.h>
+
+#include <Editor/FindOnsets.h>
+
+#include <System/Thread.h>
+
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+// Decaying noise bursts at a steady tempo, with a soft pad underneath, so the detector has onsets to
+// find in every chunk.
+static void MakeDrumLoop(vector<float>& out, int samplerate, double seconds, double bpm)
+{
+	SyntheticDrums drums(samplerate, seconds, 1);
+	drums.addPad(220.0, 0.05f);
+
+	int numFrames = (int)drums.samples.size();
+	double beatFrames = samplerate * 60.0 / bpm;
+	for(double beat = beatFrames * 0.5; beat < numFrames; beat += beatFrames)
+	{
+		drums.addNoise((int)beat, samplerate / 10, 0.8f, 40.0);
+	}
+	out.swap(drums.samples);
+}
+
+TestMethod(FindOnsetsChunkTest)
+{
+	// Detecting onsets in parallel chunks finds exactly the onsets of a single pass.
+	const int samplerate = 44100;
+	vector<float> samples;
+	MakeDrumLoop(samples, samplerate, 60.0, 137.0);
+
+	vector<Onset> serial;
+	FindOnsets(samples.data(), samplerate, (int)samples.size(), 1, serial);
+	Check(serial.size() >= 130);
+
+	for(int numThreads : {2, 3, 8})
+	{
+		vector<Onset> parallel;
+		FindOnsets(samples.data(), samplerate, (int)samples.size(), numThreads, parallel);
+
+		bool equal = parallel.size() == serial.size();
+		for(size_t i = 0; equal && i < serial.size(); ++i)
+		{
+			equal = parallel[i].pos == serial[i].pos;
+		}
+		Check(equal);
+	}
+
+	// Signals shorter than a hop have no onsets.
+	vector<Onset> none;
+	FindOnsets(samples.data(), samplerate, 100, 8, none);
+	Check(none.empty());
+}
+
+BenchmarkMethod(FindOnsetsBenchmark)
+{
+	using Clock = chrono::high_resolution_clock;
+	const int samplerate = 44100;
+	vector<float> samples;
+	MakeDrumLoop(samples, samplerate, 180.0, 137.0);
+
+	for(int numThreads : {1, ParallelThreads::concurrency()})
+	{
+		vector<Onset> onsets;
+		auto start = Clock::now();
+		FindOnsets(samples.data(), samplerate, (int)samples.size(), numThreads, onsets);
+		double seconds = chrono::duration<double>(Clock::now() - start).count();
+		Report("%i threads: %.1f ms for 3 minutes of audio", numThreads, seconds * 1000.0);
+	}
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
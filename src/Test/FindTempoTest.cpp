@@ -0,0 +1,131 @@
+#include <Precomp.h>
+
+#include <Editor/FindTempo.h>
+#include <Editor/FindOnsets.h>
+
+#include <System/Thread.h>
+
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+static const char* MODE_NAMES[] = {"interval search", "autocorrelation"};
+
+struct ClickTrack
+{
+	double bpm, offset;
+	vector<float> samples;
+};
+
+// Short decaying tones on every beat with an accent on the first beat of each measure, over a soft
+// pad. Half of the tracks also have noise bursts on random sixteenth notes, like a busy hi-hat.
+static void MakeClickTrack(ClickTrack& out, int samplerate, double seconds, unsigned int seed)
+{
+	SyntheticDrums drums(samplerate, seconds, seed);
+	out.bpm = round((89.0 + drums.uniform() * 116.0) * 100.0) / 100.0;
+	out.offset = drums.uniform() * 60.0 / out.bpm;
+	bool hihat = drums.uniform() < 0.5;
+	drums.addPad(110.0, 0.05f);
+
+	int numFrames = (int)drums.samples.size();
+	double stepFrames = samplerate * 15.0 / out.bpm;
+	for(int step = 0; out.offset * samplerate + step * stepFrames < numFrames; ++step)
+	{
+		int begin = (int)(out.offset * samplerate + step * stepFrames + 0.5);
+		if(step % 4 == 0)
+		{
+			bool accent = (step % 16 == 0);
+			drums.addTone(begin, samplerate / 20, accent ? 0.8f : 0.5f, accent ? 1760.0 : 880.0, 60.0);
+		}
+		else if(hihat && drums.uniform() < 0.5)
+		{
+			drums.addNoise(begin, samplerate / 20, 0.2f, 120.0);
+		}
+	}
+	out.samples.swap(drums.samples);
+}
+
+static void MakeCorpus(vector<ClickTrack>& out, int samplerate, int numTracks, double seconds)
+{
+	out.resize(numTracks);
+	for(int i = 0; i < numTracks; ++i)
+	{
+		MakeClickTrack(out[i], samplerate, seconds, 1234 + i * 7919);
+	}
+}
+
+TestMethod(FindTempoClickTrackTest)
+{
+	// Both modes find the tempo of every click track, up to a rounding error.
+	const int samplerate = 44100;
+	vector<ClickTrack> corpus;
+	MakeCorpus(corpus, samplerate, 4, 30.0);
+
+	for(int mode = TempoDetector::MODE_INTERVAL_SEARCH; mode <= TempoDetector::MODE_AUTOCORRELATION; ++mode)
+	{
+		for(auto& track : corpus)
+		{
+			vector<TempoResult> result;
+			FindTempo(track.samples.data(), samplerate, (int)track.samples.size(), 1,
+				(TempoDetector::Mode)mode, result);
+			Check(!result.empty() && fabs(result[0].bpm - track.bpm) < 0.05);
+		}
+	}
+}
+
+BenchmarkMethod(FindTempoBenchmark)
+{
+	// Accuracy and speed of both modes on a larger corpus of two minute tracks. A track counts as
+	// correct when the best candidate is within 0.05 BPM of the tempo it was made with. The time of
+	// the onset detection, which both modes share, is listed separately.
+	using Clock = chrono::high_resolution_clock;
+	const int samplerate = 44100, numThreads = ParallelThreads::concurrency();
+	vector<ClickTrack> corpus;
+	MakeCorpus(corpus, samplerate, 12, 120.0);
+	double minutes = corpus.size() * 2.0;
+
+	auto start = Clock::now();
+	for(auto& track : corpus)
+	{
+		vector<Onset> onsets;
+		FindOnsets(track.samples.data(), samplerate, (int)track.samples.size(), numThreads, onsets);
+	}
+	double onsetSeconds = chrono::duration<double>(Clock::now() - start).count();
+	Report("onset detection: %.1f ms per minute of audio", onsetSeconds * 1000.0 / minutes);
+
+	for(int mode = TempoDetector::MODE_INTERVAL_SEARCH; mode <= TempoDetector::MODE_AUTOCORRELATION; ++mode)
+	{
+		int numCorrect = 0, numInTopThree = 0;
+		start = Clock::now();
+		for(auto& track : corpus)
+		{
+			vector<TempoResult> result;
+			FindTempo(track.samples.data(), samplerate, (int)track.samples.size(), numThreads,
+				(TempoDetector::Mode)mode, result);
+			for(int i = 0; i < (int)result.size(); ++i)
+			{
+				if(fabs(result[i].bpm - track.bpm) < 0.05)
+				{
+					numCorrect += (i == 0);
+					++numInTopThree;
+				}
+			}
+		}
+		double seconds = chrono::duration<double>(Clock::now() - start).count();
+		Report("%s: %i/%i correct, %i in top 3, %.1f ms per minute of audio after onset detection",
+			MODE_NAMES[mode], numCorrect, (int)corpus.size(), numInTopThree,
+			(seconds - onsetSeconds) * 1000.0 / minutes);
+	}
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,127 @@
+#include <Precomp.h>
+
+#include <Simfile/Simfile.h>
+#include <Simfile/Chart.h>
+#include <Simfile/Notes.h>
+
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+namespace Sm {
+bool ParseSm(std::string_view text, bool isSM5, bool serial, Simfile* sim); // Defined in LoadSm.cpp
+};
+
+using namespace std;
+
+// Note data with the given number of measures, where every measure has one of the usual line counts
+// or one of the odd ones that are spread over the measure by rounding. Holds and rolls are closed
+// on later lines or measures, and some notes have a keysound.
+static string MakeMeasures(int numCols, int numMeasures)
+{
+	static const int LINE_COUNTS[] = {4, 7, 8, 12, 13, 16, 24, 48, 192};
+	string out;
+	vector<bool> holding(numCols, false);
+	for(int measure = 0; measure < numMeasures; ++measure)
+	{
+		if(measure > 0) out += ",\n";
+		int numLines = LINE_COUNTS[rand() % 9];
+		int density = (numLines == 192) ? 64 : 6;
+		for(int line = 0; line < numLines; ++line)
+		{
+			for(int col = 0; col < numCols; ++col)
+			{
+				int r = rand() % density;
+				char symbol = '0';
+				if(holding[col])
+				{
+					if(r < 2) symbol = '3', holding[col] = false;
+				}
+				else if(r < 5)
+				{
+					symbol = "1124MLF"[rand() % 7];
+					holding[col] = (symbol == '2' || symbol == '4');
+				}
+				out += symbol;
+				if(symbol != '0' && symbol != '3' && rand() % 3 == 0)
+				{
+					out += "[" + to_string(rand() % 12) + "]";
+				}
+			}
+			out += '\n';
+		}
+	}
+	return out;
+}
+
+static string MakeChart(const char* style, const char* difficulty, const string& notes)
+{
+	return string("#NOTEDATA:;\n#STEPSTYPE:") + style + ";\n#DIFFICULTY:" + difficulty +
+		";\n#METER:10;\n#NOTES:\n" + notes + ";\n\n";
+}
+
+static bool SameNotes(const Chart* a, const Chart* b)
+{
+	if(a->notes.size() != b->notes.size()) return false;
+	for(int i = 0; i < a->notes.size(); ++i)
+	{
+		const Note& x = a->notes.begin()[i];
+		const Note& y = b->notes.begin()[i];
+		if(x.row != y.row || x.endrow != y.endrow || x.col != y.col || x.player != y.player ||
+			x.type != y.type || x.quant != y.quant || x.keysound != y.keysound) return false;
+	}
+	return true;
+}
+
+TestMethod(ParallelDecodeTest)
+{
+	// Decoding the charts at the same time gives the same notes as decoding them one after the
+	// other, for singles, doubles, and couples charts of which the players are separated by '&'.
+	srand(7);
+	string text = "#TITLE:Decode;\n#VERSION:0.83;\n#BPMS:0.000=150.000;\n\n";
+	text += MakeChart("dance-single", "Beginner", MakeMeasures(4, 24));
+	text += MakeChart("dance-single", "Challenge", MakeMeasures(4, 64));
+	text += MakeChart("dance-double", "Hard", MakeMeasures(8, 48));
+	text += MakeChart("dance-routine", "Medium", MakeMeasures(8, 32) + "&\n" + MakeMeasures(8, 32));
+	text += MakeChart("pump-single", "Edit", MakeMeasures(5, 40));
+
+	Simfile serial;
+	Check(ParseSm(text, true, true, &serial));
+	Check(serial.charts.size() == 5);
+
+	// Make sure the note data covers what the decoding has to get right.
+	int numHolds = 0, numRolls = 0, numKeysounds = 0, numOddLines = 0, numSecondPlayer = 0;
+	for(auto chart : serial.charts)
+	{
+		for(auto& note : chart->notes)
+		{
+			numHolds += (note.type == NOTE_STEP_OR_HOLD && note.endrow > note.row);
+			numRolls += (note.type == NOTE_ROLL);
+			numKeysounds += (note.keysound > 0);
+			numOddLines += (note.quant == 7 || note.quant == 13);
+			numSecondPlayer += (note.player == 1);
+		}
+	}
+	Check(numHolds > 0 && numRolls > 0 && numKeysounds > 0 && numOddLines > 0 && numSecondPlayer > 0);
+
+	for(int run = 0; run < 4; ++run)
+	{
+		Simfile parallel;
+		Check(ParseSm(text, true, false, &parallel));
+		Check(parallel.charts.size() == serial.charts.size());
+		for(int i = 0; i < serial.charts.size() && i < parallel.charts.size(); ++i)
+		{
+			Check(SameNotes(serial.charts[i], parallel.charts[i]));
+		}
+	}
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
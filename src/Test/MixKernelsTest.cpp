@@ -0,0 +1,150 @@
+#include <Precomp.h>
+
+#include <System/CpuFeatures.h>
+#include <System/MixKernels.h>
+
+#include <chrono>
+#include <limits.h>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+static const char* LEVEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+static void MakeNoise(vector<short>& out, int numSamples)
+{
+	out.resize(numSamples);
+	for(auto& s : out) s = (short)((rand() & 0xFFFF) - 32768);
+
+	// Include the extremes, which saturate when added.
+	if(numSamples >= 4)
+	{
+		out[0] = SHRT_MAX, out[1] = SHRT_MIN, out[2] = SHRT_MAX, out[3] = -1;
+	}
+}
+
+TestMethod(MixKernelsEquivalenceTest)
+{
+	// Every level produces the same output as the scalar kernels, including the unaligned tails.
+	for(int numFrames : {0, 1, 7, 15, 16, 17, 33, 1000})
+	{
+		vector<short> l, r, base;
+		MakeNoise(l, numFrames);
+		MakeNoise(r, numFrames);
+		MakeNoise(base, numFrames * 2);
+
+		vector<short> expected[4], out;
+		for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+		{
+			CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+			if(CpuFeatures::getLevel() != level) continue;
+
+			vector<short> result[4];
+			result[0].resize(numFrames * 2);
+			MixKernels::interleave(result[0].data(), l.data(), r.data(), numFrames);
+
+			result[1] = base;
+			MixKernels::interleaveAdd(result[1].data(), l.data(), r.data(), numFrames);
+
+			result[2] = base;
+			MixKernels::scale(result[2].data(), numFrames * 2, 12345);
+
+			result[3] = base;
+			MixKernels::add(result[3].data(), l.data(), numFrames);
+
+			for(int i = 0; i < 4; ++i)
+			{
+				if(level == CpuFeatures::SCALAR)
+				{
+					expected[i] = result[i];
+				}
+				else
+				{
+					Check(result[i] == expected[i]);
+				}
+			}
+		}
+		CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+
+		// The scalar results match the definitions.
+		for(int i = 0; i < numFrames; ++i)
+		{
+			Check(expected[0][i * 2] == l[i] && expected[0][i * 2 + 1] == r[i]);
+			int sum = min(max(base[i * 2] + l[i], SHRT_MIN), SHRT_MAX);
+			Check(expected[1][i * 2] == sum);
+			Check(expected[2][i * 2] == (short)((base[i * 2] * 12345) >> 15));
+			Check(expected[3][i] == min(max(base[i] + l[i], SHRT_MIN), SHRT_MAX));
+		}
+	}
+}
+
+// The per-sample mixing that the kernels replace, for comparison.
+static void MixPerSample(short* dst, const short* l, const short* r, const short* tick, int n, int vol)
+{
+	short* out = dst;
+	for(int i = 0; i < n; ++i)
+	{
+		*out++ = (short)((l[i] * vol) >> 15);
+		*out++ = (short)((r[i] * vol) >> 15);
+	}
+	for(int i = 0; i < n; ++i)
+	{
+		dst[i * 2 + 0] = (short)min(max(dst[i * 2 + 0] + tick[i], SHRT_MIN), SHRT_MAX);
+		dst[i * 2 + 1] = (short)min(max(dst[i * 2 + 1] + tick[i], SHRT_MIN), SHRT_MAX);
+	}
+}
+
+static void MixWithKernels(short* dst, const short* l, const short* r, const short* tick, int n, int vol)
+{
+	MixKernels::interleave(dst, l, r, n);
+	MixKernels::scale(dst, n * 2, vol);
+	MixKernels::interleaveAdd(dst, tick, tick, n);
+}
+
+BenchmarkMethod(MixKernelsBenchmark)
+{
+	// Measures the cost of one mixer callback: copying the music, applying the volume, and adding
+	// a tick, for several mixer buffer sizes.
+	const int maxFrames = 8192, repeats = 2000;
+	vector<short> l, r, tick, dst(maxFrames * 2);
+	MakeNoise(l, maxFrames);
+	MakeNoise(r, maxFrames);
+	MakeNoise(tick, maxFrames);
+	const int vol = ((80 * 80) << 15) / (100 * 100);
+
+	for(int numFrames : {512, 2048, 8192})
+	{
+		auto start = chrono::steady_clock::now();
+		for(int i = 0; i < repeats; ++i)
+		{
+			MixPerSample(dst.data(), l.data(), r.data(), tick.data(), numFrames, vol);
+		}
+		chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+		Report("%5i frames, per sample: %.2f us per callback", numFrames, elapsed.count() / repeats);
+
+		for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+		{
+			CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+			if(CpuFeatures::getLevel() != level) continue;
+
+			start = chrono::steady_clock::now();
+			for(int i = 0; i < repeats; ++i)
+			{
+				MixWithKernels(dst.data(), l.data(), r.data(), tick.data(), numFrames, vol);
+			}
+			elapsed = chrono::steady_clock::now() - start;
+			Report("%5i frames, %s: %.2f us per callback",
+				numFrames, LEVEL_NAMES[level], elapsed.count() / repeats);
+		}
+	}
+	CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,254 @@
+#include <Precomp.h>
+
+#include <System/CpuFeatures.h>
+#include <Simfile/NoteScan.h>
+
+#include <chrono>
+#include <math.h>
+#include <numeric>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+static const char* LEVEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+// Note data of 192nd snap measures for a chart with the given number of columns, where every row
+// has a note with the given probability.
+static string MakeNoteData(int numRows, int numCols, int notesPerThousandRows)
+{
+	const char symbols[] = "1234MLF";
+	string out(numRows * numCols, '0');
+	for(int row = 0; row < numRows; ++row)
+	{
+		if(rand() % 1000 >= notesPerThousandRows) continue;
+		out[row * numCols + rand() % numCols] = symbols[rand() % 7];
+	}
+	return out;
+}
+
+static vector<int> FindNotes(const string& text)
+{
+	vector<int> out(text.size());
+	out.resize(NoteScan::findNotes(text.data(), (int)text.size(), out.data()));
+	return out;
+}
+
+TestMethod(NoteScanEquivalenceTest)
+{
+	// Every level finds the same symbols as the scalar scan, including the unaligned tails, and
+	// symbols in the last position of a vector.
+	for(int size : {0, 1, 15, 16, 17, 63, 64, 65, 100, 768, 1000})
+	{
+		for(int density : {0, 50, 500, 1000})
+		{
+			string text = MakeNoteData(size, 1, density);
+			if(size > 0 && density > 0) text[size - 1] = '1';
+			if(size > 63 && density > 0) text[63] = '3', text[31] = 'M', text[15] = '2';
+
+			vector<int> expected;
+			for(int i = 0; i < size; ++i)
+			{
+				if(text[i] != '0') expected.push_back(i);
+			}
+
+			for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+			{
+				CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+				if(CpuFeatures::getLevel() != level) continue;
+				Check(FindNotes(text) == expected);
+			}
+			CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+		}
+	}
+}
+
+// The per-symbol decoding that the scan replaces, which compares every row against an empty row
+// and then branches on every symbol of the rows that are not empty.
+static int CountNotesPerSymbol(const string& text, int numCols)
+{
+	string emptyRow(numCols, '0');
+	int count = 0;
+	for(size_t row = 0; row + numCols <= text.size(); row += numCols)
+	{
+		if(memcmp(text.data() + row, emptyRow.data(), numCols) == 0) continue;
+		for(int col = 0; col < numCols; ++col)
+		{
+			char c = text[row + col];
+			if(c == '1' || c == '2' || c == '3' || c == '4' || c == 'M' || c == 'L' || c == 'F') ++count;
+		}
+	}
+	return count;
+}
+
+BenchmarkMethod(NoteScanBenchmark)
+{
+	// Scans a long 192nd snap chart with a note on about one row in twelve, like a sixteenth note
+	// stream, for four and eight columns.
+	const int numRows = 192 * 5000, repeats = 10;
+	for(int numCols : {4, 8})
+	{
+		string text = MakeNoteData(numRows, numCols, 80);
+		vector<int> positions(text.size());
+		double megabytes = text.size() * repeats / 1e6;
+
+		auto start = chrono::steady_clock::now();
+		int count = 0;
+		for(int i = 0; i < repeats; ++i) count += CountNotesPerSymbol(text, numCols);
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+		Report("%i columns, per symbol: %.0f MB/s", numCols, megabytes / elapsed.count());
+
+		for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+		{
+			CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+			if(CpuFeatures::getLevel() != level) continue;
+
+			start = chrono::steady_clock::now();
+			int found = 0;
+			for(int i = 0; i < repeats; ++i)
+			{
+				found += NoteScan::findNotes(text.data(), (int)text.size(), positions.data());
+			}
+			elapsed = chrono::steady_clock::now() - start;
+			Check(found == count);
+			Report("%i columns, %s scan: %.0f MB/s", numCols, LEVEL_NAMES[level], megabytes / elapsed.count());
+		}
+		CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+	}
+}
+
+// The measure compression of earlier versions of the saver, which tried every factor of the
+// quantization against every row of the measure.
+static int ReferenceLineCount(const string& section, int width, const vector<int>& quants)
+{
+	int lcm = 1;
+	for(int q : quants)
+	{
+		lcm = lcm * q / gcd(lcm, q);
+		if(lcm > 192)
+		{
+			lcm = 192;
+			break;
+		}
+	}
+	int count = 4;
+	if(lcm > 4)
+	{
+		count = lcm;
+		string zeroline(width, '0');
+		for(int i = lcm / 2; i >= 2; i--)
+		{
+			if(lcm % i > 0) continue;
+			bool valid = true;
+			float mod = (float)192 / i;
+			for(int j = 0; valid && j < 192; ++j)
+			{
+				float rem = std::round(std::fmod(j, mod));
+				if(rem > 0 && rem < static_cast<int>(mod) && memcmp(section.data() + j * width, zeroline.data(), width))
+				{
+					valid = false;
+				}
+			}
+			if(valid && i >= 4)
+			{
+				count = i;
+				break;
+			}
+		}
+	}
+	if(192 % count != 0) count = 192;
+	return count;
+}
+
+// A measure with notes on the lines of a few random quantizations, which are also returned.
+static string MakeMeasure(int width, vector<int>& quants)
+{
+	const int snaps[] = {1, 2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 24, 32, 40, 48, 64, 96, 192};
+	string out(192 * width, '0');
+	quants.clear();
+	for(int n = rand() % 4; n >= 0; --n)
+	{
+		int q = snaps[rand() % 18];
+		quants.push_back(q);
+		int row = (int)std::round(192.0f / q * (rand() % q));
+		out[row * width + rand() % width] = '1';
+	}
+	return out;
+}
+
+static NoteScan::MeasureRows FindRows(const string& section, int width)
+{
+	NoteScan::MeasureRows rows;
+	for(int pos : FindNotes(section)) rows.set(pos / width);
+	return rows;
+}
+
+TestMethod(MeasureLineCountTest)
+{
+	// The line count from the row mask is the same as the one found by trying every factor.
+	int numWrong = 0;
+	for(int i = 0; i < 20000; ++i)
+	{
+		vector<int> quants;
+		string section = MakeMeasure(4, quants);
+		if(i % 4 == 0) quants.push_back(quants[0] * 2);
+		int lcm = 1;
+		for(int q : quants) lcm = min(lcm / gcd(lcm, q) * q, 192);
+		int count = NoteScan::measureLineCount(FindRows(section, 4), lcm);
+		numWrong += (count != ReferenceLineCount(section, 4, quants));
+	}
+	Check(numWrong == 0);
+
+	// Empty and whole note measures are written as quarter notes, and snaps that are not standard
+	// as 192nds.
+	NoteScan::MeasureRows rows;
+	Check(NoteScan::measureLineCount(rows, 1) == 4);
+	rows.set(0);
+	Check(NoteScan::measureLineCount(rows, 2) == 4);
+	Check(NoteScan::measureLineCount(rows, 5) == 192);
+	for(int row = 0; row < 192; ++row) rows.set(row);
+	Check(NoteScan::measureLineCount(rows, 192) == 192);
+}
+
+BenchmarkMethod(MeasureLineCountBenchmark)
+{
+	// Compresses the measures of twenty charts of a thousand measures, as an autosave of a large
+	// .ssc file would.
+	const int numMeasures = 20000;
+	vector<string> sections(256);
+	vector<vector<int>> quants(256);
+	vector<int> lcms(256, 1);
+	for(int i = 0; i < 256; ++i)
+	{
+		sections[i] = MakeMeasure(4, quants[i]);
+		for(int q : quants[i]) lcms[i] = min(lcms[i] / gcd(lcms[i], q) * q, 192);
+	}
+
+	auto start = chrono::steady_clock::now();
+	int total = 0;
+	for(int i = 0; i < numMeasures; ++i) total += ReferenceLineCount(sections[i & 255], 4, quants[i & 255]);
+	chrono::duration<double, milli> reference = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+	int found = 0;
+	for(int i = 0; i < numMeasures; ++i)
+	{
+		found += NoteScan::measureLineCount(FindRows(sections[i & 255], 4), lcms[i & 255]);
+	}
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	Check(found == total);
+	Report("%i measures: %.1f ms trying every factor, %.1f ms with row masks",
+		numMeasures, reference.count(), elapsed.count());
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,254 @@
+#include <Precomp.h>
+
+#include <Editor/MusicMix.h>
+#include <Editor/Sound.h>
+
+#include <System/CpuFeatures.h>
+#include <System/MixKernels.h>
+#include <System/NullMixer.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <math.h>
+#include <stdint.h>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// Golden mixes, relative to the working directory. Every run checks that the mix still matches
+// them bit for bit.
+static const char* GOLDEN_DIR = "test/golden";
+
+static const char* LEVEL_NAMES[] = {"scalar", "sse2", "avx2"};
+
+// Writes a sample counter, so every frame shows where it was mixed.
+struct CounterSource : public MixSource
+{
+	void writeFrames(short* buffer, int frames) override
+	{
+		for(int i = 0; i < frames; ++i, ++counter)
+		{
+			buffer[i * 2 + 0] = (short)counter;
+			buffer[i * 2 + 1] = (short)-counter;
+		}
+		++numCallbacks;
+	}
+	int counter = 0, numCallbacks = 0;
+};
+
+// Writes a 16-bit stereo wav file with the given samples on both channels, and loads it.
+static bool LoadTestSound(Sound& sound, const vector<short>& samples, const char* name)
+{
+	fs::path path = fs::temp_directory_path() / name;
+	{
+		ofstream file(path, ios::out | ios::binary);
+		auto write32 = [&](uint32_t v) { file.write((const char*)&v, 4); };
+		auto write16 = [&](uint16_t v) { file.write((const char*)&v, 2); };
+
+		uint32_t dataSize = (uint32_t)samples.size() * 4;
+		file.write("RIFF", 4), write32(36 + dataSize), file.write("WAVE", 4);
+		file.write("fmt ", 4), write32(16), write16(1), write16(2);
+		write32(44100), write32(44100 * 4), write16(4), write16(16);
+		file.write("data", 4), write32(dataSize);
+		for(short s : samples) write16((uint16_t)s), write16((uint16_t)s);
+	}
+	string title, artist;
+	bool success = sound.load(path, false, title, artist);
+	fs::remove(path);
+	return success && sound.getNumFrames() == (int)samples.size();
+}
+
+// Plays a tone through the music mix of the editor at a non-integer speed and a lower volume, with
+// a tick on every beat. The first second of output is resampled, and the rest is time-stretched,
+// which starts in the middle of a block for most block sizes.
+struct MusicMixSource : public MixSource
+{
+	MusicMixSource() : mix(1)
+	{
+		const int numFrames = 44100 * 4;
+		for(int i = 0; i < numFrames; ++i)
+		{
+			double t = (double)i / 44100.0;
+			musicL.push_back((short)(8000.0 * sin(t * 2.0 * M_PI * 440.0 * (1.0 + t))));
+			musicR.push_back((short)(8000.0 * sin(t * 2.0 * M_PI * 330.0)));
+		}
+		vector<short> samples;
+		for(int i = 0; i < 800; ++i)
+		{
+			samples.push_back((short)(6000.0 * sin(i * 0.3) * (1.0 - i / 800.0)));
+		}
+		hasTick = LoadTestSound(tick, samples, "null_mixer_tick.wav");
+
+		vector<VoiceScheduler::Event> beats;
+		for(int frame = 0; frame < numFrames; frame += 22050)
+		{
+			beats.push_back({frame, 0, VoiceScheduler::UNITY_GAIN});
+		}
+		mix.voices.setSounds({&tick});
+		mix.voices.setEvents(0, beats);
+		mix.timeStretch.setSampleRates(44100, 44100);
+
+		input.samplesL = musicL.data();
+		input.samplesR = musicR.data();
+		input.numFrames = numFrames;
+		input.musicRate = 44100;
+		input.outputRate = 44100;
+		input.speed = 125;
+		input.volume = 80;
+		input.isMuted = false;
+		input.hasTimeStretch = false;
+	}
+	void writeFrames(short* buffer, int frames) override
+	{
+		int resampled = (int)min<int64_t>(frames, max<int64_t>(0, 44100 - numWritten));
+		if(resampled > 0) mix.write(buffer, resampled, input);
+		input.hasTimeStretch = (numWritten + resampled >= 44100);
+		if(resampled < frames) mix.write(buffer + resampled * 2, frames - resampled, input);
+		numWritten += frames;
+	}
+	vector<short> musicL, musicR;
+	Sound tick;
+	bool hasTick;
+	MusicMix mix;
+	MusicMixInput input;
+	int64_t numWritten = 0;
+};
+
+static vector<char> ReadFile(const fs::path& path)
+{
+	ifstream file(path, ios::in | ios::binary);
+	return vector<char>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+static uint32_t Read32(const vector<char>& data, int pos)
+{
+	uint32_t v = 0;
+	for(int i = 3; i >= 0; --i) v = (v << 8) | (uint8_t)data[pos + i];
+	return v;
+}
+
+TestMethod(NullMixerClockTest)
+{
+	CounterSource source;
+	NullMixer mixer;
+
+	// Nothing is mixed before the mixer is opened and resumed.
+	Check(mixer.render(100) == 0);
+	mixer.open(&source, 48000);
+	Check(mixer.render(100) == 0 && mixer.getRenderedFrames() == 0);
+
+	// Frames are mixed in blocks, and the clock follows the rendered frames.
+	mixer.resume();
+	Check(mixer.render(5000) == 5000);
+	Check(source.numCallbacks == 3 && mixer.getStats().numCallbacks == 3);
+	Check(mixer.getRenderedFrames() == 5000);
+	Check(mixer.getTime() == 5000.0 / 48000.0);
+
+	const vector<short>& frames = mixer.getFrames();
+	Check(frames.size() == 10000);
+	bool continuous = true;
+	for(int i = 0; i < 5000; ++i) continuous &= (frames[i * 2] == i && frames[i * 2 + 1] == -i);
+	Check(continuous);
+
+	mixer.pause();
+	Check(mixer.render(100) == 0 && mixer.getRenderedFrames() == 5000);
+	mixer.close();
+}
+
+TestMethod(NullMixerWavFileTest)
+{
+	fs::path path = fs::temp_directory_path() / "null_mixer_test.wav";
+
+	CounterSource source;
+	NullMixer mixer;
+	mixer.open(&source, 44100);
+	Check(mixer.setOutputFile(path));
+	mixer.resume();
+
+	vector<short> expected;
+	for(int n : {1000, 3000, 1})
+	{
+		mixer.render(n);
+		expected.insert(expected.end(), mixer.getFrames().begin(), mixer.getFrames().end());
+	}
+	mixer.close();
+
+	// The header is completed with the number of frames when the mixer closes.
+	vector<char> data = ReadFile(path);
+	fs::remove(path);
+	Check(data.size() == 44 + 4001 * 4);
+	if(data.size() != 44 + 4001 * 4) return;
+
+	Check(memcmp(data.data(), "RIFF", 4) == 0 && memcmp(data.data() + 8, "WAVEfmt ", 8) == 0);
+	Check(Read32(data, 4) == 36 + 4001 * 4);
+	Check(Read32(data, 24) == 44100 && Read32(data, 28) == 44100 * 4);
+	Check(memcmp(data.data() + 36, "data", 4) == 0 && Read32(data, 40) == 4001 * 4);
+	Check(memcmp(data.data() + 44, expected.data(), 4001 * 4) == 0);
+}
+
+TestMethod(NullMixerGoldenMixTest)
+{
+	// Offline renders of the music mix are identical on every run, and with every block size.
+	for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+	{
+		CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+		if(CpuFeatures::getLevel() != level) continue;
+
+		vector<char> renders[2];
+		for(int run = 0; run < 2; ++run)
+		{
+			fs::path path = fs::temp_directory_path() / "null_mixer_golden.wav";
+			MusicMixSource source;
+			Check(source.hasTick);
+			NullMixer mixer;
+			mixer.open(&source, 44100);
+			mixer.setOutputFile(path);
+			mixer.resume();
+			for(int left = 44100 * 2; left > 0;)
+			{
+				left -= mixer.render(min(left, run ? 777 : 44100));
+			}
+			mixer.close();
+			renders[run] = ReadFile(path);
+			fs::remove(path);
+		}
+		Check(renders[0].size() == 44 + 44100 * 2 * 4);
+		Check(renders[0] == renders[1]);
+
+		// Floating-point kernels may round differently per instruction set, so every level has its
+		// own golden file. A missing golden file fails the test.
+		fs::path golden = fs::path(GOLDEN_DIR) / (string("mix-") + LEVEL_NAMES[level] + ".wav");
+		std::error_code ec;
+		Check(fs::exists(golden, ec));
+		Check(ReadFile(golden) == renders[0]);
+	}
+	CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+}
+
+BenchmarkMethod(NullMixerBenchmark)
+{
+	// Measures the callback cost of the music mix, rendered faster than real time.
+	MusicMixSource source;
+	NullMixer mixer;
+	mixer.open(&source, 44100);
+	mixer.resume();
+	for(int i = 0; i < 60; ++i) mixer.render(NullMixer::BLOCK_FRAMES);
+
+	const NullMixer::Stats& stats = mixer.getStats();
+	double audioMicroseconds = mixer.getTime() * 1e6;
+	Report("%lli callbacks: %.2f us average, %.2f us max, %.0fx real time",
+		(long long)stats.numCallbacks, stats.totalMicroseconds / stats.numCallbacks,
+		stats.maxMicroseconds, audioMicroseconds / stats.totalMicroseconds);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,160 @@
+#include <Precomp.h>
+
+#include <Editor/Resampler.h>
+#include <System/CpuFeatures.h>
+
+#include <chrono>
+#include <math.h>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+static const double TEST_PI = 3.14159265358979323846;
+static const int TEST_RATE = 44100;
+static const int TEST_BLOCK = 1024;
+static const double TEST_AMPLITUDE = 16000.0;
+
+static void MakeTone(vector<short>& out, int numFrames, double frequency)
+{
+	out.resize(numFrames);
+	for(int i = 0; i < numFrames; ++i)
+	{
+		out[i] = (short)lrint(TEST_AMPLITUDE * sin(2.0 * TEST_PI * frequency * i / TEST_RATE));
+	}
+}
+
+// Resamples the signal in blocks, as the mixer would, and returns the left channel.
+static vector<short> Resample(Resampler& resampler, const vector<short>& src, double step)
+{
+	int numFrames = (int)(src.size() / step);
+	numFrames -= numFrames % TEST_BLOCK;
+	vector<short> block(TEST_BLOCK * 2), out(numFrames);
+
+	resampler.setStep(step);
+	for(int i = 0; i < numFrames; i += TEST_BLOCK)
+	{
+		resampler.write(block.data(), TEST_BLOCK, i * step, src.data(), src.data(), (int)src.size());
+		for(int j = 0; j < TEST_BLOCK; ++j) out[i + j] = block[j * 2];
+	}
+	return out;
+}
+
+// The two-tap linear interpolation that the resampler replaces, for comparison.
+static vector<short> ResampleLinear(const vector<short>& src, double step)
+{
+	int numFrames = (int)((src.size() - 1) / step);
+	vector<short> out(numFrames);
+	for(int i = 0; i < numFrames; ++i)
+	{
+		double pos = i * step;
+		int index = (int)pos;
+		double frac = pos - index;
+		out[i] = (short)lrint(src[index] * (1.0 - frac) + src[index + 1] * frac);
+	}
+	return out;
+}
+
+// Returns the ratio in decibels between the energy of the expected tone and the difference from
+// it, skipping the ramps at the start and end of the signal.
+static double GetSnr(const vector<short>& out, double step, double frequency)
+{
+	double signal = 0.0, noise = 0.0;
+	int margin = TEST_RATE / 10;
+	for(int i = margin; i < (int)out.size() - margin; ++i)
+	{
+		double expected = TEST_AMPLITUDE * sin(2.0 * TEST_PI * frequency * i * step / TEST_RATE);
+		signal += expected * expected;
+		noise += (out[i] - expected) * (out[i] - expected);
+	}
+	return 10.0 * log10(signal / max(noise, 1.0));
+}
+
+// Returns the energy of the signal in decibels relative to the test tone.
+static double GetLevel(const vector<short>& out)
+{
+	double energy = 0.0;
+	int margin = TEST_RATE / 10;
+	for(int i = margin; i < (int)out.size() - margin; ++i)
+	{
+		energy += (double)out[i] * out[i];
+	}
+	double reference = TEST_AMPLITUDE * TEST_AMPLITUDE * 0.5 * (out.size() - margin * 2);
+	return 10.0 * log10(max(energy, 1.0) / reference);
+}
+
+TestMethod(ResamplerPassbandTest)
+{
+	Resampler resampler;
+	vector<short> src;
+	MakeTone(src, TEST_RATE * 4, 1000.0);
+
+	// A tone well below the cutoff is reproduced accurately, at rates up and down.
+	for(double step : {44100.0 / 48000.0, 44100.0 / 96000.0, 1.5, 2.5, 3.7})
+	{
+		double snr = GetSnr(Resample(resampler, src, step), step, 1000.0);
+		double linear = GetSnr(ResampleLinear(src, step), step, 1000.0);
+		Report("step %.3f: %.1f dB snr, linear %.1f dB", step, snr, linear);
+		Check(snr > 60.0);
+		Check(snr > linear);
+	}
+}
+
+TestMethod(ResamplerAliasingTest)
+{
+	Resampler resampler;
+	vector<short> src;
+
+	// A tone above the output Nyquist frequency is removed instead of folding back.
+	for(double step : {1.5, 2.0, 3.0, 4.0})
+	{
+		double frequency = TEST_RATE * 0.5 / step * 1.3;
+		MakeTone(src, TEST_RATE * 4, frequency);
+
+		double level = GetLevel(Resample(resampler, src, step));
+		double linear = GetLevel(ResampleLinear(src, step));
+		Report("step %.1f, %.0f Hz: %.1f dB alias, linear %.1f dB", step, frequency, level, linear);
+		Check(level < -60.0);
+	}
+}
+
+BenchmarkMethod(ResamplerBenchmark)
+{
+	vector<short> src(TEST_RATE * 30);
+	for(auto& s : src) s = (short)((rand() % 32768) - 16384);
+
+	vector<short> dst(TEST_BLOCK * 2);
+	Resampler resampler;
+
+	const char* names[] = {"scalar", "sse2", "avx2"};
+	for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::AVX2; ++level)
+	{
+		CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+		if(CpuFeatures::getLevel() != level) continue;
+
+		for(double step : {44100.0 / 48000.0, 1.5, 4.0})
+		{
+			resampler.setStep(step);
+			int numFrames = (int)((src.size() - TEST_BLOCK * 4) / step);
+			numFrames -= numFrames % TEST_BLOCK;
+
+			auto start = chrono::steady_clock::now();
+			for(int i = 0; i < numFrames; i += TEST_BLOCK)
+			{
+				resampler.write(dst.data(), TEST_BLOCK, i * step, src.data(), src.data(), (int)src.size());
+			}
+			chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+			Report("%s, step %.3f (%i taps): %.1f ns per output frame",
+				names[level], step, resampler.getNumTaps(), elapsed.count() / numFrames);
+		}
+	}
+	CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
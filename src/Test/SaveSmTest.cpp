@@ -0,0 +1,153 @@
+#include <Precomp.h>
+
+#include <Simfile/Simfile.h>
+#include <Simfile/Chart.h>
+#include <Simfile/Tempo.h>
+#include <Simfile/Notes.h>
+#include <Simfile/Segments.h>
+#include <Simfile/SegmentGroup.h>
+#include <Managers/StyleMan.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+namespace Sm {
+bool SaveSsc(const Simfile* sim, bool backup); // Defined in SaveSm.cpp
+};
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char* GOLDEN_DIR = "test/golden";
+
+static vector<char> ReadFile(const fs::path& path)
+{
+	ifstream file(path, ios::in | ios::binary);
+	return vector<char>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+// Linear congruential generator for the note data. Unlike rand(), it gives the same sequence with
+// every C runtime, which the golden file depends on.
+static unsigned int randomSeed = 0;
+
+static int Random()
+{
+	randomSeed = randomSeed * 1103515245 + 12345;
+	return (randomSeed >> 16) & 0x7FFF;
+}
+
+// Fills the chart with random taps, mines, lifts, fakes, holds, and rolls for every player, some of
+// them with a keysound. Every measure has notes on the lines of one snap, which includes the 7ths
+// and 13ths that are written as 192nds. Holds end on 16ths, and all of them end before the last
+// measure, which only has taps.
+static void AddNotes(Chart* chart, int numCols, int numPlayers, int numMeasures)
+{
+	static const int SNAPS[] = {4, 8, 12, 16, 24, 32, 48, 64, 192, 7, 13};
+	vector<int> busy(numCols * numPlayers, -1);
+	int lastHoldRow = (numMeasures - 1) * 192;
+	for(int measure = 0; measure < numMeasures; ++measure)
+	{
+		int snap = (measure == numMeasures - 1) ? 4 : SNAPS[Random() % 11];
+		for(int line = 0; line < snap; ++line)
+		{
+			int row = measure * 192 + (int)round(192.0f / snap * line);
+			for(int col = 0; col < numCols; ++col)
+			{
+				for(int player = 0; player < numPlayers; ++player)
+				{
+					int& end = busy[col * numPlayers + player];
+					if(end >= row || Random() % (snap > 48 ? 24 : 6)) continue;
+					Note note = {row, row, (uint)col, (uint)player, NOTE_STEP_OR_HOLD, (uint)snap, 0};
+					int kind = Random() % 8;
+					if(kind == 0) note.type = NOTE_MINE;
+					if(kind == 1) note.type = NOTE_LIFT;
+					if(kind == 2) note.type = NOTE_FAKE;
+					if(kind >= 5) note.endrow = (row / 12 + 1 + Random() % 40) * 12;
+					if(note.endrow >= lastHoldRow) note.endrow = row;
+					if(kind == 7 && note.endrow > row) note.type = NOTE_ROLL;
+					if(Random() % 4 == 0) note.keysound = 1 + Random() % 6;
+					chart->notes.append(note);
+					end = note.endrow;
+				}
+			}
+		}
+	}
+}
+
+static void MakeSimfile(Simfile& sim, const Style* styles)
+{
+	sim.title = "Save Test";
+	sim.artist = "Vortex";
+	sim.music = "music.ogg";
+	sim.previewStart = 32.5;
+	sim.previewLength = 15.0;
+	sim.tempo->offset = -0.012;
+	sim.tempo->segments->append(BpmChange(0, 150.0));
+	sim.tempo->segments->append(BpmChange(192 * 8, 175.5));
+	sim.tempo->segments->append(Stop(192 * 16 + 48, 0.25));
+	for(const char* keysound : {"kick.ogg", "snare.ogg", "hat.ogg", "clap.ogg", "bass.ogg", "lead.ogg"})
+	{
+		sim.tempo->keysounds.push_back(keysound);
+	}
+
+	// A singles chart, a doubles chart, and a couples chart of which the players are separated by
+	// an ampersand.
+	const Difficulty difficulties[] = {DIFF_HARD, DIFF_CHALLENGE, DIFF_MEDIUM};
+	const int numMeasures[] = {120, 80, 60};
+	for(int i = 0; i < 3; ++i)
+	{
+		Chart* chart = new Chart;
+		chart->style = &styles[i];
+		chart->artist = "Stepper";
+		chart->difficulty = difficulties[i];
+		chart->meter = 9 + i;
+		AddNotes(chart, styles[i].numCols, styles[i].numPlayers, numMeasures[i]);
+		sim.charts.push_back(chart);
+	}
+}
+
+TestMethod(SaveSscTest)
+{
+	// Saving a multi-chart simfile gives the same file as the saver that tried every factor of
+	// each measure and wrote one symbol at a time. A missing golden file fails the test.
+	const Style styles[] = {
+		{0, "dance-single", "Single", 4, 1},
+		{1, "dance-double", "Double", 8, 1},
+		{2, "dance-routine", "Routine", 8, 2},
+	};
+	randomSeed = 24;
+	Simfile sim;
+	MakeSimfile(sim, styles);
+	sim.dir = fs::temp_directory_path().string() + "/";
+	sim.file = "vortex-save-test";
+	fs::path path = fs::temp_directory_path() / "vortex-save-test.ssc";
+
+	auto start = chrono::steady_clock::now();
+	Check(Sm::SaveSsc(&sim, false));
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+	vector<char> saved = ReadFile(path);
+	fs::remove(path);
+
+	int numNotes = 0;
+	for(auto chart : sim.charts) numNotes += chart->notes.size();
+	Report("%i charts, %i notes: saved in %.2f ms", sim.charts.size(), numNotes, elapsed.count());
+
+	fs::path golden = fs::path(GOLDEN_DIR) / "save-multichart.ssc";
+	std::error_code ec;
+	Check(fs::exists(golden, ec));
+	Check(ReadFile(golden) == saved);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
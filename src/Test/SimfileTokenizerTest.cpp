@@ -0,0 +1,173 @@
+#include <Precomp.h>
+
+#include <Simfile/Parsing.h>
+#include <System/File.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+typedef vector<pair<string, string>> TagList;
+
+// The tag parsing that came before the tokenizer, which rewrote a copy of the whole file before
+// cutting it up with zero terminators. Kept as the reference for the tokenizer.
+static TagList ReferenceTokenize(string text)
+{
+	char* write = &text[0];
+	for(const char* read = text.c_str(); *read;)
+	{
+		if(read[0] == '/' && read[1] == '/')
+		{
+			while(*read && *read != '\n') ++read;
+		}
+		else if(*read == '\r')
+		{
+			++read;
+		}
+		else
+		{
+			*write++ = (*read == '\t') ? ' ' : *read;
+			++read;
+		}
+	}
+	text.resize(write - &text[0]);
+
+	TagList out;
+	for(char* p = &text[0];;)
+	{
+		while(*p && *p != '#') ++p;
+		if(*p == 0) break;
+		char* tag = ++p;
+		while(*p && *p != ':') ++p;
+		if(*p) *p++ = 0;
+		char* val = p;
+		while(*p && (*p != ';' || *(p - 1) == '\\') && !(p[0] == '\n' && p[1] == '#')) ++p;
+		if(*p) *p++ = 0;
+		out.push_back({tag, val});
+	}
+	return out;
+}
+
+static TagList Tokenize(string_view text)
+{
+	TagList out;
+	SimfileTokenizer tokenizer(text);
+	for(string_view tag, val; tokenizer.next(tag, val);)
+	{
+		out.push_back({string(tag), string(val)});
+	}
+	return out;
+}
+
+// A gimmick-heavy .ssc file: long timing lists, a comment on every measure, and windows line
+// endings, with the given number of charts.
+static string MakeGimmickSsc(int numCharts, int numMeasures)
+{
+	string out = "#VERSION:0.83;\r\n#TITLE:Gimmicks // test\r\n#OFFSET:-0.009;\r\n#SPEEDS:";
+	for(int i = 0; i < numMeasures * 4; ++i)
+	{
+		out += to_string(i) + ".000=" + to_string(1 + i % 7) + ".500=0.250=0,\r\n";
+	}
+	out += ";\r\n";
+	for(int c = 0; c < numCharts; ++c)
+	{
+		out += "//--------------- dance-single - Chart " + to_string(c) + " ---------------\r\n";
+		out += "#NOTEDATA:;\r\n#STEPSTYPE:dance-single;\r\n#DIFFICULTY:Challenge;\r\n#METER:13;\r\n";
+		out += "#NOTES:\r\n";
+		for(int m = 0; m < numMeasures; ++m)
+		{
+			for(int r = 0; r < 16; ++r)
+			{
+				out += (r % 4 == 0) ? "1000\r\n" : (r % 4 == 2) ? "0M01\r\n" : "0000\r\n";
+			}
+			out += (m + 1 < numMeasures) ? ", // measure " + to_string(m + 1) + "\r\n" : ";\r\n";
+		}
+	}
+	return out;
+}
+
+TestMethod(SimfileTokenizerTest)
+{
+	// Clean values point into the text itself.
+	string_view text = "#TITLE:Song;\n#BPMS:0.000=150.000;\n";
+	SimfileTokenizer tokenizer(text);
+	string_view tag, val;
+	Check(tokenizer.next(tag, val) && tag == "TITLE" && val == "Song");
+	Check(val.data() >= text.data() && val.data() < text.data() + text.size());
+	Check(tokenizer.next(tag, val) && tag == "BPMS" && val == "0.000=150.000");
+	Check(!tokenizer.next(tag, val));
+
+	// Comments, carriage returns, and tabs are removed, escaped semicolons are kept, and a missing
+	// semicolon ends the value at the next tag.
+	const char* cases[] =
+	{
+		"#TITLE:A // comment ; #FAKE:1;\r\n\t;#ARTIST:B",
+		"// #COMMENTED:1;\n#SUBTITLE:x\\;y;#GENRE:a\r\\;b;",
+		"#BPMS:0=120\n#STOPS:;#:;##;#A//:b\n:c;",
+		"#NOTES:\n0000\n//;\n1000\n;\n#OFFSET:0\r\n// x\n#END",
+		"#A:/;#B:\\",
+		"",
+	};
+	for(const char* c : cases)
+	{
+		Check(Tokenize(c) == ReferenceTokenize(c));
+	}
+
+	// Random mixes of the special characters give the same tags as the reference.
+	const char alphabet[] = "#:;\\/\r\n\t a";
+	unsigned int seed = 5;
+	auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7FFF; };
+	int numWrong = 0;
+	for(int i = 0; i < 20000; ++i)
+	{
+		string s(random() % 40, 'a');
+		for(char& ch : s) ch = alphabet[random() % (sizeof(alphabet) - 1)];
+		numWrong += (Tokenize(s) != ReferenceTokenize(s));
+	}
+	Check(numWrong == 0);
+
+	string ssc = MakeGimmickSsc(4, 64);
+	Check(Tokenize(ssc) == ReferenceTokenize(ssc));
+}
+
+BenchmarkMethod(SimfileTokenizerBenchmark)
+{
+	using Clock = chrono::high_resolution_clock;
+	fs::path path = fs::temp_directory_path() / "vortex-tokenizer-benchmark.ssc";
+	string ssc = MakeGimmickSsc(24, 1200);
+	ofstream(path, ios::binary).write(ssc.data(), ssc.size());
+
+	auto start = Clock::now();
+	bool success;
+	size_t numReference = ReferenceTokenize(File::getText(path, &success)).size();
+	double reference = chrono::duration<double>(Clock::now() - start).count();
+
+	start = Clock::now();
+	size_t numTags = 0;
+	{
+		MappedFile file;
+		OpenSimfile(file, path);
+		SimfileTokenizer tokenizer(SimfileText(file));
+		for(string_view tag, val; tokenizer.next(tag, val);) ++numTags;
+	}
+	double mapped = chrono::duration<double>(Clock::now() - start).count();
+
+	fs::remove(path);
+	Check(numTags == numReference);
+	Report("%.1f MB: %.1f ms copied and rewritten, %.1f ms mapped and tokenized",
+		ssc.size() / 1e6, reference * 1000.0, mapped * 1000.0);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,305 @@
+#include <Precomp.h>
+
+#include <Simfile/SongIndex.h>
+#include <Simfile/Simfile.h>
+#include <Simfile/Chart.h>
+#include <Simfile/Tempo.h>
+#include <Simfile/Notes.h>
+#include <Simfile/Segments.h>
+#include <Simfile/SegmentGroup.h>
+#include <Managers/StyleMan.h>
+#include <System/File.h>
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <math.h>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+static IndexedSong MakeSong(int index)
+{
+	IndexedSong song = {};
+	song.path = "Songs/Pack/Song " + to_string(index) + "/song.ssc";
+	song.fileSize = 20000 + index;
+	song.fileTime = 1700000000ll * 10000000 + index;
+	song.title = "Song " + to_string(index);
+	song.artist = (index % 3) ? "Artist" : "";
+	song.minBpm = 100.0 + index % 50;
+	song.maxBpm = song.minBpm * 2.0;
+	song.length = 90.0 + index % 60;
+	for(int c = 0; c < index % 6; ++c)
+	{
+		IndexedChart chart = {"dance-single", "Stepper", c, c * 3 + 1, 100 * c, 10 * c, c, 4.5f + c};
+		song.charts.push_back(chart);
+	}
+	return song;
+}
+
+static bool SameSong(const IndexedSong& a, const IndexedSong& b)
+{
+	bool same = a.path == b.path && a.fileSize == b.fileSize && a.fileTime == b.fileTime &&
+		a.title == b.title && a.artist == b.artist && a.minBpm == b.minBpm &&
+		a.maxBpm == b.maxBpm && a.length == b.length && a.charts.size() == b.charts.size();
+	for(size_t i = 0; same && i < a.charts.size(); ++i)
+	{
+		const IndexedChart& x = a.charts[i];
+		const IndexedChart& y = b.charts[i];
+		same = x.style == y.style && x.artist == y.artist && x.difficulty == y.difficulty &&
+			x.meter == y.meter && x.numSteps == y.numSteps && x.numHolds == y.numHolds &&
+			x.numMines == y.numMines && x.peakNps == y.peakNps;
+	}
+	return same;
+}
+
+static void WriteText(const fs::path& path, const string& text)
+{
+	fs::create_directories(path.parent_path());
+	ofstream(path, ios::binary).write(text.data(), text.size());
+}
+
+static string ReadBytes(const fs::path& path)
+{
+	ifstream in(path, ios::binary);
+	return string(istreambuf_iterator<char>(in), {});
+}
+
+// An index entry that matches the current size and modification time of a simfile, as if it was
+// indexed by an earlier update.
+static IndexedSong IndexedEntry(const fs::path& path)
+{
+	IndexedSong song = {};
+	song.path = pathToUtf8(path);
+	song.fileSize = fs::file_size(path);
+	song.fileTime = (int64_t)fs::last_write_time(path).time_since_epoch().count();
+	song.title = pathToUtf8(path.parent_path().filename());
+	return song;
+}
+
+TestMethod(SongIndexFileTest)
+{
+	fs::path path = fs::temp_directory_path() / "vortex-song-index-test.idx";
+	vector<IndexedSong> songs, read;
+	for(int i = 0; i < 100; ++i) songs.push_back(MakeSong(i));
+
+	// Every field survives a round trip.
+	Check(SongIndex::write(path, songs));
+	Check(SongIndex::read(path, read));
+	Check(read.size() == songs.size());
+	int numWrong = 0;
+	for(size_t i = 0; i < songs.size() && i < read.size(); ++i)
+	{
+		numWrong += !SameSong(songs[i], read[i]);
+	}
+	Check(numWrong == 0);
+
+	// Damaged and truncated files are not read.
+	string data = ReadBytes(path);
+	data[data.size() / 2] ^= 1;
+	WriteText(path, data);
+	Check(!SongIndex::read(path, read) && read.empty());
+	WriteText(path, data.substr(0, data.size() - 1));
+	Check(!SongIndex::read(path, read) && read.empty());
+
+	fs::remove(path);
+	Check(!SongIndex::read(path, read));
+}
+
+TestMethod(SongIndexUpdateTest)
+{
+	// A library in which every simfile is unchanged since the last update is not loaded again.
+	fs::path root = fs::temp_directory_path() / "vortex-song-index-library";
+	fs::path path = root / "index.idx";
+	fs::remove_all(root);
+	vector<IndexedSong> previous;
+	for(int i = 0; i < 50; ++i)
+	{
+		fs::path folder = root / "Pack" / ("Song " + to_string(i));
+		WriteText(folder / "song.ssc", "#TITLE:Song " + to_string(i) + ";\n");
+		WriteText(folder / "song.mp3", "");
+		if(i % 5 == 0) WriteText(folder / "song.sm", "#TITLE:Song;\n");
+		previous.push_back(IndexedEntry(folder / "song.ssc"));
+	}
+	Check(SongIndex::write(path, previous));
+
+	vector<IndexedSong> songs;
+	SongIndexStats stats;
+	Check(SongIndex::update(root, path, songs, stop_token(), &stats));
+	Check(stats.numFiles == 50 && stats.numReused == 50 && stats.numLoaded == 0);
+	Check(songs.size() == 50 && songs[0].title == "Song 0");
+
+	// Removed simfiles are removed from the index file.
+	fs::remove_all(root / "Pack" / "Song 7");
+	Check(SongIndex::update(root, path, songs, stop_token(), &stats));
+	Check(stats.numFiles == 49 && stats.numReused == 49 && songs.size() == 49);
+	vector<IndexedSong> read;
+	Check(SongIndex::read(path, read) && read.size() == 49);
+
+	fs::remove_all(root);
+}
+
+TestMethod(SongIndexChangeTest)
+{
+	// Only the simfile that changed since the last update is loaded again, and its entry has the
+	// new title.
+	fs::path root = fs::temp_directory_path() / "vortex-song-index-change";
+	fs::path path = root / "index.idx";
+	fs::remove_all(root);
+	for(int i = 0; i < 10; ++i)
+	{
+		WriteText(root / "Pack" / ("Song " + to_string(i)) / "song.ssc", "#TITLE:Song " + to_string(i) + ";\n");
+	}
+	vector<IndexedSong> songs;
+	SongIndexStats stats;
+	Check(SongIndex::update(root, path, songs, stop_token(), &stats));
+	Check(stats.numFiles == 10 && stats.numLoaded == 10 && stats.numFailed == 0);
+
+	WriteText(root / "Pack" / "Song 3" / "song.ssc", "#TITLE:Song 3 (Extended Mix);\n");
+	Check(SongIndex::update(root, path, songs, stop_token(), &stats));
+	Check(stats.numFiles == 10 && stats.numReused == 9 && stats.numLoaded == 1);
+	Check(songs.size() == 10 && songs[3].title == "Song 3 (Extended Mix)");
+
+	vector<IndexedSong> read;
+	Check(SongIndex::read(path, read) && read.size() == 10 && read[3].title == songs[3].title);
+
+	fs::remove_all(root);
+}
+
+TestMethod(SongIndexPreferenceTest)
+{
+	// A folder with only an .sm file has its .sm file indexed, and a folder with both has its .ssc
+	// file indexed instead.
+	fs::path root = fs::temp_directory_path() / "vortex-song-index-preference";
+	fs::path path = root / "index.idx";
+	fs::remove_all(root);
+	WriteText(root / "Pack" / "A" / "song.sm", "#TITLE:A;\n");
+	WriteText(root / "Pack" / "B" / "song.sm", "#TITLE:B old;\n");
+	WriteText(root / "Pack" / "B" / "song.ssc", "#TITLE:B;\n");
+
+	vector<IndexedSong> songs;
+	SongIndexStats stats;
+	Check(SongIndex::update(root, path, songs, stop_token(), &stats));
+	Check(stats.numFiles == 2 && songs.size() == 2);
+	if(songs.size() == 2)
+	{
+		Check(fs::path(songs[0].path) == root / "Pack" / "A" / "song.sm" && songs[0].title == "A");
+		Check(fs::path(songs[1].path) == root / "Pack" / "B" / "song.ssc" && songs[1].title == "B");
+	}
+
+	fs::remove_all(root);
+}
+
+static void AddNote(Chart* chart, int row, int endrow, NoteType type)
+{
+	chart->notes.append({row, endrow, 0u, 0u, (uint)type, 4u, 0u});
+}
+
+TestMethod(SongIndexSummaryTest)
+{
+	// The summary of a simfile with known notes and BPMs. The first chart uses the song timing of
+	// 120 BPM for two measures and 240 BPM after that, the second chart has its own 300 BPM.
+	Style style = {};
+	style.id = "dance-single";
+	Simfile sim;
+	sim.title = "Summary";
+	sim.artist = "Vortex";
+	sim.tempo->offset = 0.0;
+	sim.tempo->segments->append(BpmChange(0, 120.0));
+	sim.tempo->segments->append(BpmChange(192 * 2, 240.0));
+
+	// Four quarter notes, then a hold and a mine, then eight eighth notes.
+	Chart* chart = new Chart;
+	chart->style = &style;
+	chart->artist = "Stepper";
+	chart->difficulty = DIFF_HARD;
+	chart->meter = 8;
+	for(int i = 0; i < 4; ++i) AddNote(chart, i * 48, i * 48, NOTE_STEP_OR_HOLD);
+	AddNote(chart, 192, 288, NOTE_STEP_OR_HOLD);
+	AddNote(chart, 240, 240, NOTE_MINE);
+	for(int i = 0; i < 8; ++i) AddNote(chart, 384 + i * 24, 384 + i * 24, NOTE_STEP_OR_HOLD);
+	sim.charts.push_back(chart);
+
+	Chart* split = new Chart;
+	split->style = &style;
+	split->tempo = new Tempo;
+	split->tempo->offset = 0.0;
+	split->tempo->segments->append(BpmChange(0, 300.0));
+	AddNote(split, 0, 0, NOTE_STEP_OR_HOLD);
+	sim.charts.push_back(split);
+
+	IndexedSong song = {};
+	SongIndex::summarize(sim, song);
+	Check(song.title == "Summary" && song.artist == "Vortex");
+	Check(song.minBpm == 120.0 && song.maxBpm == 300.0);
+
+	// The last row is 552, which is two measures of two seconds and 3.5 beats of 0.25 seconds.
+	Check(fabs(song.length - 4.875) < 1e-6);
+
+	Check(song.charts.size() == 2);
+	if(song.charts.size() == 2)
+	{
+		const IndexedChart& a = song.charts[0];
+		Check(a.style == "dance-single" && a.artist == "Stepper");
+		Check(a.difficulty == DIFF_HARD && a.meter == 8);
+		Check(a.numSteps == 13 && a.numHolds == 1 && a.numMines == 1);
+		Check(fabs(a.peakNps - 8.0f) < 1e-3f);
+
+		const IndexedChart& b = song.charts[1];
+		Check(b.numSteps == 1 && b.numHolds == 0 && b.numMines == 0);
+		Check(fabs(b.peakNps - 1.25f) < 1e-3f);
+	}
+}
+
+BenchmarkMethod(SongIndexBenchmark)
+{
+	// Reads and writes the index of a library of ten thousand songs.
+	using Clock = chrono::high_resolution_clock;
+	fs::path path = fs::temp_directory_path() / "vortex-song-index-benchmark.idx";
+	vector<IndexedSong> songs, read;
+	for(int i = 0; i < 10000; ++i) songs.push_back(MakeSong(i));
+
+	auto start = Clock::now();
+	Check(SongIndex::write(path, songs));
+	double writing = chrono::duration<double>(Clock::now() - start).count();
+
+	start = Clock::now();
+	Check(SongIndex::read(path, read) && read.size() == songs.size());
+	double reading = chrono::duration<double>(Clock::now() - start).count();
+
+	Report("%i songs, %.1f MB: %.1f ms written, %.1f ms read", (int)songs.size(),
+		fs::file_size(path) / 1e6, writing * 1000.0, reading * 1000.0);
+	fs::remove(path);
+
+	// Rescans a library of two thousand unchanged songs.
+	fs::path root = fs::temp_directory_path() / "vortex-song-index-benchmark";
+	fs::remove_all(root);
+	songs.clear();
+	for(int i = 0; i < 2000; ++i)
+	{
+		fs::path file = root / ("Pack " + to_string(i / 100)) / ("Song " + to_string(i)) / "song.sm";
+		WriteText(file, "#TITLE:Song;\n");
+		songs.push_back(IndexedEntry(file));
+	}
+	path = root / "index.idx";
+	Check(SongIndex::write(path, songs));
+
+	SongIndexStats stats;
+	start = Clock::now();
+	Check(SongIndex::update(root, path, read, stop_token(), &stats) && stats.numReused == 2000);
+	double rescan = chrono::duration<double>(Clock::now() - start).count();
+	Report("%i unchanged songs: %.1f ms rescan", stats.numFiles, rescan * 1000.0);
+	fs::remove_all(root);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
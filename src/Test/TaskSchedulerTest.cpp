@@ -0,0 +1,182 @@
+#include <Precomp.h>
+
+#include <System/TaskScheduler.h>
+#include <System/Thread.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+TestMethod(ParallelForSlotsTest)
+{
+	// Every item is processed once, and no two concurrent calls share a slot.
+	const int numItems = 20000, numSlots = 4;
+	vector<atomic<int>> visits(numItems);
+	vector<atomic<int>> busy(numSlots);
+	atomic<int> numSharedSlots(0), numBadSlots(0);
+	TaskScheduler::parallelFor(numItems, numSlots, [&](int item, int slot)
+	{
+		if(slot < 0 || slot >= numSlots)
+		{
+			++numBadSlots;
+			return;
+		}
+		if(busy[slot].exchange(1)) ++numSharedSlots;
+		++visits[item];
+		busy[slot] = 0;
+	});
+
+	int numWrong = 0;
+	for(auto& v : visits) numWrong += (v != 1);
+	Check(numWrong == 0);
+	Check(numBadSlots == 0);
+	Check(numSharedSlots == 0);
+}
+
+TestMethod(NestedParallelForTest)
+{
+	// Parallel loops inside parallel loops inside tasks finish without extra threads, even when
+	// there are more tasks than workers.
+	atomic<long long> sum(0);
+	vector<TaskHandle> tasks;
+	for(int t = 0; t < TaskScheduler::numWorkers() * 2; ++t)
+	{
+		tasks.push_back(TaskScheduler::submit(TaskPriority::Analysis, [&sum](Task&)
+		{
+			TaskScheduler::parallelFor(64, ParallelThreads::concurrency(), [&sum](int outer, int)
+			{
+				TaskScheduler::parallelFor(64, ParallelThreads::concurrency(), [&sum, outer](int inner, int)
+				{
+					sum += outer * 64 + inner;
+				});
+			});
+		}));
+	}
+	for(auto& task : tasks) task->wait();
+	long long expected = (long long)tasks.size() * (4096LL * 4095LL / 2);
+	Check(sum == expected);
+}
+
+TestMethod(ParallelForPriorityTest)
+{
+	// Every item of a loop with an explicit priority runs at that priority, including the items on
+	// the calling thread, which is back at its own priority afterwards.
+	atomic<int> numWrong(0);
+	TaskScheduler::parallelFor(256, TaskScheduler::numWorkers(), TaskPriority::Analysis, [&](int, int)
+	{
+		numWrong += (TaskScheduler::currentPriority() != TaskPriority::Analysis);
+	});
+	Check(numWrong == 0);
+	Check(TaskScheduler::currentPriority() == TaskPriority::Interactive);
+}
+
+TestMethod(TaskCancelTest)
+{
+	// A task that is cancelled before it starts is skipped, and a running task sees the request
+	// through its stop token.
+	atomic<bool> release(false);
+	atomic<int> numBlocked(0);
+	vector<TaskHandle> blockers;
+	for(int i = 0; i < TaskScheduler::numWorkers(); ++i)
+	{
+		blockers.push_back(TaskScheduler::submit(TaskPriority::Decode, [&](Task&)
+		{
+			++numBlocked;
+			while(!release) this_thread::yield();
+		}));
+	}
+	while(numBlocked < TaskScheduler::numWorkers()) this_thread::yield();
+
+	bool ran = false;
+	auto skipped = TaskScheduler::submit(TaskPriority::Analysis, [&ran](Task&) { ran = true; });
+	skipped->cancel();
+	Check(skipped->isDone());
+	release = true;
+	for(auto& blocker : blockers) blocker->wait();
+	skipped->wait();
+	Check(!ran);
+
+	auto running = TaskScheduler::submit(TaskPriority::Analysis, [](Task& task)
+	{
+		task.setProgress(0.5f);
+		while(!task.getStopToken().stop_requested()) this_thread::yield();
+	});
+	while(running->getProgress() < 0.5f) this_thread::yield();
+	running->cancel();
+	running->wait();
+	Check(running->isDone());
+}
+
+TestMethod(TaskScopeTest)
+{
+	// A task that runs on a thread while it waits for another task does not see the scopes of the
+	// thread, which are back when the task returns. With all workers blocked, the waiting thread
+	// runs the task itself.
+	atomic<bool> release(false);
+	atomic<int> numBlocked(0);
+	vector<TaskHandle> blockers;
+	for(int i = 0; i < TaskScheduler::numWorkers(); ++i)
+	{
+		blockers.push_back(TaskScheduler::submit(TaskPriority::Decode, [&](Task&)
+		{
+			++numBlocked;
+			while(!release) this_thread::yield();
+		}));
+	}
+	while(numBlocked < TaskScheduler::numWorkers()) this_thread::yield();
+
+	int scope = 0;
+	void* seen = &scope;
+	TaskScheduler::setScope(TaskScope::HudMute, &scope);
+	auto task = TaskScheduler::submit(TaskPriority::Analysis, [&seen](Task&)
+	{
+		seen = TaskScheduler::getScope(TaskScope::HudMute);
+	});
+	task->wait();
+	Check(seen == nullptr);
+	Check(TaskScheduler::getScope(TaskScope::HudMute) == &scope);
+	TaskScheduler::setScope(TaskScope::HudMute, nullptr);
+
+	release = true;
+	for(auto& blocker : blockers) blocker->wait();
+}
+
+TestMethod(BackgroundThreadTest)
+{
+	// Background threads run as tasks, and results are handed to the main thread in order.
+	struct Counter : public BackgroundThread
+	{
+		Counter() : BackgroundThread(TaskPriority::Decode) {}
+		~Counter() override { terminate(); }
+		void exec() override
+		{
+			for(int i = 0; i < 3; ++i)
+			{
+				TaskScheduler::postToMainThread([this, i]() { order.push_back(i); });
+			}
+		}
+		vector<int> order;
+	};
+
+	Counter counter;
+	Check(!counter.isDone());
+	counter.start();
+	counter.waitUntilDone();
+	Check(counter.isDone());
+	Check(counter.order.empty());
+	TaskScheduler::runMainThreadTasks();
+	Check(counter.order == vector<int>({0, 1, 2}));
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -5,6 +5,15 @@
 #include <Core/Common/Singleton.h>
 #include <Core/Common/Event.h>
 
+#include <Editor/AudioAnalysis.h>
+#include <Editor/BeatTracker.h>
+#include <Editor/FFT.h>
+
+#include <math.h>
+#include <stdarg.h>
+
+#include "TestUtils.h"
+
 namespace Vortex {
 
 using namespace std;
@@ -15,6 +24,7 @@ struct TestMethodData
 	const char* name;
 	const char* file;
 	int line;
+	bool isBenchmark;
 };
 
 static vector<TestMethodData>& GetTestMethods()
@@ -32,10 +42,10 @@ static const char* StripRoot(const char* path)
 	return stripped ? (stripped + strlen(root)) : path;
 }
 
-int TestMethodRegister(void (*method)(), const char* name, const char* file, int line)
+int TestMethodRegister(void (*method)(), const char* name, const char* file, int line, bool isBenchmark)
 {
 	auto& methods = GetTestMethods();
-	methods.push_back({ method, name, StripRoot(file), line });
+	methods.push_back({ method, name, StripRoot(file), line, isBenchmark });
 	return (int)methods.size();
 }
 
@@ -48,6 +58,15 @@ void TestMethodCheck(bool conditionHolds, const char* description, int line)
 	failedChecks++;
 }
 
+void TestMethodReport(const char* format, ...)
+{
+	printf("\n  ");
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+}
+
 struct TestSingletonRegistry : public SingletonRegistry
 {
 	vector<deinitializeFunction> deinitializeFunctions;
@@ -67,6 +86,11 @@ struct TestSingletonRegistry : public SingletonRegistry
 int RunUnitTests()
 {
 	int failedTests = 0;
+	int skippedTests = 0;
+
+	// Benchmarks take a long time, and are only run on request.
+	const char* benchmarks = getenv("VORTEX_BENCHMARKS");
+	bool runBenchmarks = benchmarks && *benchmarks && strcmp(benchmarks, "0") != 0;
 
 	TestSingletonRegistry registry;
 	EventSystem::initialize(registry);
@@ -74,6 +98,11 @@ int RunUnitTests()
 	printf(":: Running Arrow Vortex unit tests ::\n\n");
 	for (auto& data : GetTestMethods())
 	{
+		if (data.isBenchmark && !runBenchmarks)
+		{
+			skippedTests++;
+			continue;
+		}
 		printf("[%s:%i] %s", data.file, data.line, data.name);
 		failedChecks = 0;
 		data.method();
@@ -91,15 +120,96 @@ int RunUnitTests()
 	for (auto& deinit : registry.deinitializeFunctions)
 		deinit();
 
-	int passedTests = (int)GetTestMethods().size() - failedTests;
+	int passedTests = (int)GetTestMethods().size() - failedTests - skippedTests;
 	if (failedTests == 0)
 		printf("\n:: All tests passed (%i) ::\n", passedTests);
 	else
 		printf("\n:: Some tests failed (%i PASS, %i FAIL) ::\n", passedTests, failedTests);
+	if (skippedTests > 0)
+		printf(":: %i benchmarks skipped, set VORTEX_BENCHMARKS=1 to run them ::\n", skippedTests);
 
 	return 0;
 }
 
+// ================================================================================================
+// Synthetic audio.
+
+SyntheticDrums::SyntheticDrums(int samplerate, double seconds, unsigned int seed)
+	: samplerate(samplerate)
+	, seed(seed)
+	, samples((int)(samplerate * seconds), 0.0f)
+{
+}
+
+int SyntheticDrums::random()
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7FFF;
+}
+
+double SyntheticDrums::uniform()
+{
+	seed = seed * 1103515245 + 12345;
+	return (double)((seed >> 8) & 0xFFFF) / 65536.0;
+}
+
+float SyntheticDrums::noise()
+{
+	return (float)random() / 16384.0f - 1.0f;
+}
+
+void SyntheticDrums::addPad(double pitch, float gain)
+{
+	for(int i = 0; i < (int)samples.size(); ++i)
+	{
+		samples[i] += gain * (float)sin(i * 2.0 * M_PI * pitch / samplerate);
+	}
+}
+
+void SyntheticDrums::addNoise(int begin, int length, float gain, double decay)
+{
+	for(int i = 0; i < length && begin + i < (int)samples.size(); ++i)
+	{
+		samples[begin + i] += gain * noise() * (float)exp(-i * decay / samplerate);
+	}
+}
+
+void SyntheticDrums::addTone(int begin, int length, float gain, double pitch, double decay)
+{
+	for(int i = 0; i < length && begin + i < (int)samples.size(); ++i)
+	{
+		double envelope = exp(-i * decay / samplerate);
+		samples[begin + i] += gain * (float)(sin(i * 2.0 * M_PI * pitch / samplerate) * envelope);
+	}
+}
+
+void AnalyzeSamples(const vector<float>& samples, int samplerate, AnalysisFrames& out)
+{
+	out.frameSize = BEAT_FRAME_SIZE;
+	out.hopSize = BEAT_HOP_SIZE;
+	out.sampleRate = samplerate;
+	out.numBins = BEAT_FRAME_SIZE / 2;
+	out.numFrames = ((int)samples.size() - BEAT_FRAME_SIZE) / BEAT_HOP_SIZE + 1;
+	out.magnitude.assign((size_t)out.numFrames * out.numBins, 0.0f);
+
+	const RealFFT& fft = RealFFT::get(BEAT_FRAME_SIZE);
+	vector<float> frame(BEAT_FRAME_SIZE), spectrum(BEAT_FRAME_SIZE + 2);
+	for(int f = 0; f < out.numFrames; ++f)
+	{
+		for(int i = 0; i < BEAT_FRAME_SIZE; ++i)
+		{
+			float window = 0.5f - 0.5f * (float)cos(2.0 * M_PI * i / (BEAT_FRAME_SIZE - 1));
+			frame[i] = samples[(size_t)f * BEAT_HOP_SIZE + i] * window;
+		}
+		fft.forward(frame.data(), spectrum.data());
+		float* magnitude = out.magnitude.data() + (size_t)f * out.numBins;
+		for(int b = 0; b < out.numBins; ++b)
+		{
+			magnitude[b] = hypotf(spectrum[b * 2], spectrum[b * 2 + 1]);
+		}
+	}
+}
+
 }; // namespace Vortex
 
 #endif // UNIT_TEST_BUILD
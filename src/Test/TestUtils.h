@@ -2,6 +2,8 @@
 
 #include <Precomp.h>
 
+#include <vector>
+
 #ifdef UNIT_TEST_BUILD
 
 namespace Vortex {
@@ -11,13 +13,59 @@ namespace Vortex {
     static int name##_id = TestMethodRegister(name, #name, __FILE__, __LINE__); \
     static void name()
 
+// Benchmarks only run when the VORTEX_BENCHMARKS environment variable is set.
+#define BenchmarkMethod(name) \
+	static void name(); \
+    static int name##_id = TestMethodRegister(name, #name, __FILE__, __LINE__, true); \
+    static void name()
+
 #define Check(condition) \
     TestMethodCheck(condition, #condition, __LINE__)
+
+// Adds a line of results, such as timings, to the output of the running test.
+#define Report(...) \
+    TestMethodReport(__VA_ARGS__)
     
-int TestMethodRegister(void (*method)(), const char* name, const char* file, int line);
+int TestMethodRegister(void (*method)(), const char* name, const char* file, int line, bool isBenchmark = false);
 void TestMethodCheck(bool conditionHolds, const char* description, int line);
+void TestMethodReport(const char* format, ...);
 int RunUnitTests();
 
+struct AnalysisFrames;
+
+/// Synthetic drum track for the audio analysis tests. Noise and random choices come from a linear
+/// congruential generator with a fixed seed, so a track is identical on every run.
+struct SyntheticDrums
+{
+	SyntheticDrums(int samplerate, double seconds, unsigned int seed);
+
+	/// Returns the next random value, in the range [0, 32768).
+	int random();
+
+	/// Returns the next random value, in the range [0, 1).
+	double uniform();
+
+	/// Returns the next noise sample, in the range [-1, 1).
+	float noise();
+
+	/// Adds a sine at the given pitch to the whole track, like a soft pad underneath the drums.
+	void addPad(double pitch, float gain);
+
+	/// Adds a burst of noise at the given frame, which decays by a factor e in 1 / decay seconds.
+	void addNoise(int begin, int length, float gain, double decay);
+
+	/// Adds a decaying sine at the given frame, like addNoise.
+	void addTone(int begin, int length, float gain, double pitch, double decay);
+
+	int samplerate;
+	unsigned int seed;
+	std::vector<float> samples;
+};
+
+/// Computes the magnitudes of Hann windowed frames at the beat tracking resolution, like the audio
+/// analysis does for the loaded music.
+void AnalyzeSamples(const std::vector<float>& samples, int samplerate, AnalysisFrames& out);
+
 }; // namespace Vortex
 
 #endif // UNIT_TEST_BUILD
\ No newline at end of file
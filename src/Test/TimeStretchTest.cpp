@@ -0,0 +1,102 @@
+#include <Precomp.h>
+
+#include <Editor/TimeStretch.h>
+
+#include <System/CpuFeatures.h>
+
+#include <chrono>
+#include <math.h>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+static const int TEST_RATE = 44100;
+static const int TEST_BLOCK = 1024;
+
+static void MakeTone(vector<short>& out, int numFrames, double frequency)
+{
+	out.resize(numFrames);
+	for(int i = 0; i < numFrames; ++i)
+	{
+		out[i] = (short)(10000.0 * sin(2.0 * 3.14159265358979323846 * frequency * i / TEST_RATE));
+	}
+}
+
+// Stretches the signal at the given speed, and returns the number of output frames.
+static int Stretch(TimeStretch& stretch, const vector<short>& src, double speed, vector<short>& out)
+{
+	int srcFrames = (int)src.size();
+	int numFrames = (int)((srcFrames - TEST_RATE) / speed);
+	numFrames -= numFrames % TEST_BLOCK;
+	out.resize(numFrames * 2);
+
+	double pos = 0.0;
+	for(int i = 0; i < numFrames; i += TEST_BLOCK)
+	{
+		stretch.process(out.data() + i * 2, TEST_BLOCK, pos, speed, src.data(), src.data(), srcFrames);
+		pos += TEST_BLOCK * speed;
+	}
+	return numFrames;
+}
+
+TestMethod(TimeStretchPitchTest)
+{
+	vector<short> src, out;
+	MakeTone(src, TEST_RATE * 10, 440.0);
+
+	// The scalar and the vector kernels both keep the pitch.
+	for(int level = CpuFeatures::SCALAR; level <= CpuFeatures::SSE2; ++level)
+	{
+		CpuFeatures::setMaxLevel((CpuFeatures::Level)level);
+		if(CpuFeatures::getLevel() != level) continue;
+
+		TimeStretch stretch;
+		stretch.setSampleRates(TEST_RATE, TEST_RATE);
+		for(double speed : {0.5, 0.75, 1.5})
+		{
+			int numFrames = Stretch(stretch, src, speed, out);
+
+			// The tone keeps its frequency, and the waveform has no discontinuities.
+			int crossings = 0, maxStep = 0;
+			for(int i = 1; i < numFrames; ++i)
+			{
+				short a = out[i * 2 - 2], b = out[i * 2];
+				if((a < 0) != (b < 0)) ++crossings;
+				maxStep = max(maxStep, abs(b - a));
+			}
+			double frequency = crossings * 0.5 * TEST_RATE / numFrames;
+			Check(fabs(frequency - 440.0) < 2.0);
+			Check(maxStep < 700);
+		}
+	}
+	CpuFeatures::setMaxLevel(CpuFeatures::AVX2);
+}
+
+BenchmarkMethod(TimeStretchBenchmark)
+{
+	vector<short> src, out;
+	MakeTone(src, TEST_RATE * 60, 440.0);
+	for(int i = 0; i < (int)src.size(); ++i)
+	{
+		src[i] = (short)(src[i] / 2 + (rand() % 8192) - 4096);
+	}
+
+	TimeStretch stretch;
+	stretch.setSampleRates(TEST_RATE, TEST_RATE);
+	for(double speed : {0.5, 0.75, 1.25, 1.5, 2.0})
+	{
+		auto start = chrono::steady_clock::now();
+		int numFrames = Stretch(stretch, src, speed, out);
+		chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+		Report("speed %3i%%: %.1f ns per output frame", (int)(speed * 100), elapsed.count() / numFrames);
+	}
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD
@@ -0,0 +1,202 @@
+#include <Precomp.h>
+
+#include <Editor/Sound.h>
+#include <Editor/VoiceScheduler.h>
+
+#include <chrono>
+#include <fstream>
+#include <stdint.h>
+
+#include "TestUtils.h"
+
+#ifdef UNIT_TEST_BUILD
+
+namespace Vortex {
+
+using namespace std;
+
+typedef VoiceScheduler::Event Event;
+
+static const int RATE = 44100;
+
+// Writes a 16-bit stereo wav file with the given samples on both channels, and loads it.
+static bool LoadTestSound(Sound& sound, const vector<short>& samples, const char* name)
+{
+	fs::path path = fs::temp_directory_path() / name;
+	{
+		ofstream file(path, ios::out | ios::binary);
+		auto write32 = [&](uint32_t v) { file.write((const char*)&v, 4); };
+		auto write16 = [&](uint16_t v) { file.write((const char*)&v, 2); };
+
+		uint32_t dataSize = (uint32_t)samples.size() * 4;
+		file.write("RIFF", 4), write32(36 + dataSize), file.write("WAVE", 4);
+		file.write("fmt ", 4), write32(16), write16(1), write16(2);
+		write32(RATE), write32(RATE * 4), write16(4), write16(16);
+		file.write("data", 4), write32(dataSize);
+		for(short s : samples) write16((uint16_t)s), write16((uint16_t)s);
+	}
+	string title, artist;
+	bool success = sound.load(path, false, title, artist);
+	fs::remove(path);
+	return success && sound.getNumFrames() == (int)samples.size();
+}
+
+// Mixes the scheduler from the given music frame in blocks, and returns the left channel.
+static vector<short> MixBlocks(VoiceScheduler& voices, int64_t startPos, int numFrames, int blockSize)
+{
+	vector<short> buffer(blockSize * 2), out;
+	for(int pos = 0; pos < numFrames; pos += blockSize)
+	{
+		int n = min(blockSize, numFrames - pos);
+		fill(buffer.begin(), buffer.end(), 0);
+		voices.mix(buffer.data(), n, (double)(startPos + pos), 1.0, 1.0, RATE);
+		for(int i = 0; i < n; ++i) out.push_back(buffer[i * 2]);
+	}
+	return out;
+}
+
+// Returns the frames at which the output is not silent.
+static vector<int> FindSound(const vector<short>& out)
+{
+	vector<int> frames;
+	for(int i = 0; i < (int)out.size(); ++i)
+	{
+		if(out[i] != 0) frames.push_back(i);
+	}
+	return frames;
+}
+
+TestMethod(VoiceSchedulerTimingTest)
+{
+	Sound impulse;
+	Check(LoadTestSound(impulse, {10000, 0, 0, 0}, "voice_test_impulse.wav"));
+
+	// Events land on their exact frames, also across block boundaries and in the same block.
+	VoiceScheduler voices(2);
+	voices.setSounds({&impulse});
+	voices.setEvents(0, {{100, 0, VoiceScheduler::UNITY_GAIN}, {511, 0, VoiceScheduler::UNITY_GAIN},
+		{512, 0, VoiceScheduler::UNITY_GAIN}, {3000, 0, VoiceScheduler::UNITY_GAIN / 2}});
+	voices.setEvents(1, {{200, 0, VoiceScheduler::UNITY_GAIN}, {200, 0, VoiceScheduler::UNITY_GAIN}});
+
+	vector<short> out = MixBlocks(voices, 0, 4096, 512);
+	Check(FindSound(out) == vector<int>({100, 200, 511, 512, 3000}));
+	Check(out[100] == 10000 && out[200] == 10000 && out[3000] == 5000);
+
+	// Disabled tracks are silent, and seeking back plays the events again.
+	voices.setEnabled(1, false);
+	voices.reset();
+	out = MixBlocks(voices, 0, 4096, 300);
+	Check(FindSound(out) == vector<int>({100, 511, 512, 3000}));
+}
+
+TestMethod(VoiceSchedulerSeekTest)
+{
+	Sound ramp;
+	vector<short> samples(1000);
+	for(int i = 0; i < 1000; ++i) samples[i] = (short)(i + 1);
+	Check(LoadTestSound(ramp, samples, "voice_test_ramp.wav"));
+
+	vector<Event> events;
+	for(int i = 0; i < 1000; ++i) events.push_back({i * 5000LL, 0, VoiceScheduler::UNITY_GAIN});
+
+	VoiceScheduler voices(1);
+	voices.setSounds({&ramp});
+	voices.setEvents(0, events);
+
+	// Seeking into a sound plays the rest of it.
+	vector<short> out = MixBlocks(voices, 2500400, 1000, 256);
+	Check(out[0] == 401 && out[598] == 999 && out[599] == 1000 && out[600] == 0);
+
+	// A play position that jumps is treated as a seek.
+	out = MixBlocks(voices, 4000000 - 10, 100, 100);
+	Check(out[9] == 0 && out[10] == 1 && out[99] == 90);
+}
+
+TestMethod(VoiceSchedulerEditTest)
+{
+	Sound impulse;
+	Check(LoadTestSound(impulse, {10000, 0, 0, 0}, "voice_test_impulse.wav"));
+
+	VoiceScheduler voices(1);
+	voices.setSounds({&impulse});
+	voices.setEvents(0, {{100, 0, VoiceScheduler::UNITY_GAIN}, {1000, 0, VoiceScheduler::UNITY_GAIN},
+		{2000, 0, VoiceScheduler::UNITY_GAIN}});
+
+	vector<short> out = MixBlocks(voices, 0, 1500, 500);
+	Check(FindSound(out) == vector<int>({100, 1000}));
+
+	// Events that already played are not played again after an edit, events after the play
+	// position are replaced, and playback continues without a seek.
+	voices.setEvents(0, {{100, 0, VoiceScheduler::UNITY_GAIN}, {1000, 0, VoiceScheduler::UNITY_GAIN},
+		{1200, 0, VoiceScheduler::UNITY_GAIN}, {1600, 0, VoiceScheduler::UNITY_GAIN},
+		{2500, 0, VoiceScheduler::UNITY_GAIN}});
+	out = MixBlocks(voices, 1500, 1500, 500);
+	Check(FindSound(out) == vector<int>({100, 1000}));
+
+	// An edit that reaches back before the play position keeps the cursor on it.
+	voices.setEvents(0, {{50, 0, VoiceScheduler::UNITY_GAIN}, {3200, 0, VoiceScheduler::UNITY_GAIN}});
+	out = MixBlocks(voices, 3000, 500, 500);
+	Check(FindSound(out) == vector<int>({200}));
+
+	// Replacing a range of events only changes that range, and keeps the cursor past it.
+	voices.setEvents(0, {{100, 0, VoiceScheduler::UNITY_GAIN}, {600, 0, VoiceScheduler::UNITY_GAIN},
+		{1400, 0, VoiceScheduler::UNITY_GAIN}});
+	voices.reset();
+	out = MixBlocks(voices, 0, 500, 500);
+	voices.replaceEvents(0, 1, 1, {{700, 0, VoiceScheduler::UNITY_GAIN}, {900, 0, VoiceScheduler::UNITY_GAIN}});
+	out = MixBlocks(voices, 500, 1000, 500);
+	Check(FindSound(out) == vector<int>({200, 400, 900}));
+}
+
+BenchmarkMethod(VoiceSchedulerBenchmark)
+{
+	// A dense keysounded chart: sixteen keysounds of half a second, with a note every 20 frames.
+	vector<Sound> sounds(16);
+	vector<const Sound*> table;
+	for(int i = 0; i < 16; ++i)
+	{
+		vector<short> samples(RATE / 2);
+		for(auto& s : samples) s = (short)((rand() & 0x3FF) - 512);
+		Check(LoadTestSound(sounds[i], samples, "voice_test_keysound.wav"));
+		table.push_back(&sounds[i]);
+	}
+
+	const int numEvents = 100000, blockSize = 2048, numBlocks = 200;
+	vector<Event> events;
+	for(int i = 0; i < numEvents; ++i)
+	{
+		events.push_back({i * 20LL, i % 16, (i % 3) ? VoiceScheduler::UNITY_GAIN : 20000});
+	}
+
+	VoiceScheduler voices(1);
+	voices.setSounds(table);
+	voices.setEvents(0, events);
+
+	vector<short> buffer(blockSize * 2);
+	for(double pitch : {1.0, 1.25})
+	{
+		voices.reset();
+		auto start = chrono::steady_clock::now();
+		for(int i = 0; i < numBlocks; ++i)
+		{
+			voices.mix(buffer.data(), blockSize, (double)i * blockSize, 1.0, pitch, RATE);
+		}
+		chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+		Report("pitch %.2f, %i voices: %.2f us per %i frame callback",
+			pitch, VoiceScheduler::MAX_VOICES, elapsed.count() / numBlocks, blockSize);
+	}
+
+	// Seeking only needs a binary search through the events.
+	auto start = chrono::steady_clock::now();
+	for(int i = 0; i < 1000; ++i)
+	{
+		voices.reset();
+		voices.mix(buffer.data(), 1, (double)(rand() % (numEvents * 20)), 1.0, 1.0, RATE);
+	}
+	chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+	Report("seek and mix one frame: %.2f us", elapsed.count() / 1000);
+}
+
+}; // namespace Vortex
+
+#endif // UNIT_TEST_BUILD